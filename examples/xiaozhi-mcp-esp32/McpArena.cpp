@@ -0,0 +1,55 @@
+/**
+ * McpArena.cpp
+ * 线性分配区实现
+ */
+
+#include "McpArena.h"
+
+#include <stdlib.h>
+
+McpArena::~McpArena() {
+  free(_buffer);
+}
+
+bool McpArena::begin(size_t capacity) {
+  if (_buffer) {
+    return true;
+  }
+  _buffer = (uint8_t *)malloc(capacity);
+  if (!_buffer) {
+    return false;
+  }
+  _capacity = capacity;
+  _used = 0;
+  return true;
+}
+
+void *McpArena::allocate(size_t size) {
+  size_t align = sizeof(void *);
+  size_t offset = (_used + align - 1) & ~(align - 1);
+  if (!_buffer || offset > _capacity || size > _capacity - offset) {
+    _failures++;
+    return nullptr;
+  }
+  _used = offset + size;
+  if (_used > _highWater) {
+    _highWater = _used;
+  }
+  return _buffer + offset;
+}
+
+char *McpArena::tail(size_t *size) {
+  if (!_buffer) {
+    *size = 0;
+    return nullptr;
+  }
+  *size = _capacity - _used;
+  return (char *)_buffer + _used;
+}
+
+void McpArena::commit(size_t size) {
+  _used += size < _capacity - _used ? size : _capacity - _used;
+  if (_used > _highWater) {
+    _highWater = _used;
+  }
+}
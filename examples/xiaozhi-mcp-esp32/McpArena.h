@@ -0,0 +1,54 @@
+/**
+ * McpArena.h
+ * 固定内存模式使用的线性分配区：启动时一次性申请存储，之后按请求分配、整体复位，不再调用malloc/free
+ * 长时间运行时堆上不会因为每个请求的临时对象产生碎片
+ */
+
+#ifndef MCP_ARENA_H
+#define MCP_ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * McpArena
+ * 只能整体复位，不能单独释放；分配失败返回nullptr
+ */
+class McpArena {
+public:
+  McpArena() : _buffer(nullptr), _capacity(0), _used(0), _highWater(0), _failures(0) {}
+  ~McpArena();
+
+  // 申请capacity字节的存储，重复调用时保留已有存储
+  bool begin(size_t capacity);
+
+  // 分配size字节，按指针宽度对齐
+  void *allocate(size_t size);
+  // 剩余空间的起始地址和长度，用于长度事先未知的输出；不占用空间，用完后用commit()占用实际写入的长度
+  // 使用期间不能再调用allocate()
+  char *tail(size_t *size);
+  void commit(size_t size);
+  // 回退到之前usedBytes()返回的位置，之后分配的内存失效
+  void rewind(size_t used) { _used = used < _used ? used : _used; }
+  // 复位，之前分配的内存全部失效
+  void reset() { _used = 0; }
+
+  size_t capacity() const { return _capacity; }
+  size_t usedBytes() const { return _used; }
+  // 单个请求占用字节数的历史最高值
+  size_t highWater() const { return _highWater; }
+  // 空间不足导致的分配失败次数
+  uint32_t failures() const { return _failures; }
+
+private:
+  McpArena(const McpArena &);
+  McpArena &operator=(const McpArena &);
+
+  uint8_t *_buffer;
+  size_t _capacity;
+  size_t _used;
+  size_t _highWater;
+  uint32_t _failures;
+};
+
+#endif // MCP_ARENA_H
@@ -0,0 +1,636 @@
+/**
+ * McpExpression.cpp
+ * 表达式编译(递归下降)和字节码求值
+ */
+
+#include "McpExpression.h"
+#include "McpRegistry.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static_assert(MCP_EXPR_MAX_CODE <= 255 && MCP_EXPR_MAX_CONSTS <= 255 && MCP_EXPR_MAX_VARS <= 255,
+              "McpExpression的指令、常量和变量下标为8位");
+static_assert(MCP_EXPR_CACHE_TEXT <= 255, "MCP_EXPR_CACHE_TEXT不能超过255");
+
+namespace {
+
+enum Opcode {
+  OP_CONST,
+  OP_VAR,
+  OP_NEG,
+  OP_CALL,
+  // 以下为二元运算
+  OP_ADD,
+  OP_SUB,
+  OP_MUL,
+  OP_DIV,
+  OP_MOD,
+  OP_POW,
+  OP_LT,
+  OP_LE,
+  OP_GT,
+  OP_GE,
+  OP_EQ,
+  OP_NE,
+  OP_AND,
+  OP_OR
+};
+
+// 函数表，下标即OP_CALL的参数
+enum FunctionId {
+  FN_ABS,
+  FN_SQRT,
+  FN_FLOOR,
+  FN_CEIL,
+  FN_ROUND,
+  FN_EXP,
+  FN_LN,
+  FN_LOG10,
+  FN_SIN,
+  FN_COS,
+  FN_TAN,
+  FN_MIN,
+  FN_MAX
+};
+
+struct FunctionEntry {
+  const char *name;
+  uint8_t argc;
+};
+
+const FunctionEntry FUNCTIONS[] = {
+  {"abs", 1}, {"sqrt", 1}, {"floor", 1}, {"ceil", 1}, {"round", 1}, {"exp", 1}, {"ln", 1},
+  {"log10", 1}, {"sin", 1}, {"cos", 1}, {"tan", 1}, {"min", 2}, {"max", 2},
+};
+const size_t FUNCTION_COUNT = sizeof(FUNCTIONS) / sizeof(FUNCTIONS[0]);
+
+inline double applyBinary(uint8_t op, double a, double b) {
+  switch (op) {
+    case OP_ADD: return a + b;
+    case OP_SUB: return a - b;
+    case OP_MUL: return a * b;
+    case OP_DIV: return a / b;
+    case OP_MOD: return fmod(a, b);
+    case OP_POW: return pow(a, b);
+    case OP_LT: return a < b ? 1 : 0;
+    case OP_LE: return a <= b ? 1 : 0;
+    case OP_GT: return a > b ? 1 : 0;
+    case OP_GE: return a >= b ? 1 : 0;
+    case OP_EQ: return a == b ? 1 : 0;
+    case OP_NE: return a != b ? 1 : 0;
+    case OP_AND: return a != 0 && b != 0 ? 1 : 0;
+    default: return a != 0 || b != 0 ? 1 : 0;
+  }
+}
+
+inline double callFunction(uint8_t id, const double *args) {
+  switch (id) {
+    case FN_ABS: return fabs(args[0]);
+    case FN_SQRT: return sqrt(args[0]);
+    case FN_FLOOR: return floor(args[0]);
+    case FN_CEIL: return ceil(args[0]);
+    case FN_ROUND: return round(args[0]);
+    case FN_EXP: return exp(args[0]);
+    case FN_LN: return log(args[0]);
+    case FN_LOG10: return log10(args[0]);
+    case FN_SIN: return sin(args[0]);
+    case FN_COS: return cos(args[0]);
+    case FN_TAN: return tan(args[0]);
+    case FN_MIN: return args[0] < args[1] ? args[0] : args[1];
+    default: return args[0] > args[1] ? args[0] : args[1];
+  }
+}
+
+inline bool isNameStart(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+inline bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+} // namespace
+
+/**
+ * McpExpressionCompiler
+ * 递归下降解析，边解析边生成字节码；每一级对应一个优先级(从低到高)：
+ *   逻辑或 ||、逻辑与 &&(两侧都会求值，结果为1或0)
+ *   比较 < <= > >= == !=
+ *   加减 + -
+ *   乘除 * / %
+ *   一元 + -
+ *   乘方 ^ **(右结合，-2^2 = -4)
+ *   基本项 数字、常量、变量、函数调用、括号
+ */
+class McpExpressionCompiler {
+public:
+  McpExpressionCompiler(McpExpression &expr, const char *text, size_t length)
+      : _expr(expr), _begin(text), _pos(text), _end(text + length), _error(McpExpression::OK),
+        _errorAt(text), _nesting(0), _depth(0) {}
+
+  McpExpression::Error run(size_t *errorPosition) {
+    _expr.reset();
+    skipSpace();
+    if (_pos == _end) {
+      fail(McpExpression::ERR_EMPTY);
+    } else if (parseOr()) {
+      skipSpace();
+      if (_pos != _end) {
+        fail(*_pos == ')' ? McpExpression::ERR_PARENTHESES : McpExpression::ERR_SYNTAX);
+      }
+    }
+    if (_error != McpExpression::OK) {
+      _expr.reset();
+      if (errorPosition) {
+        *errorPosition = _errorAt - _begin;
+      }
+    }
+    return _error;
+  }
+
+private:
+  McpExpression &_expr;
+  const char *_begin;
+  const char *_pos;
+  const char *_end;
+  McpExpression::Error _error;
+  const char *_errorAt;
+  int _nesting;
+  int _depth; // 当前求值栈深度
+
+  bool fail(McpExpression::Error error) {
+    if (_error == McpExpression::OK) {
+      _error = error;
+      _errorAt = _pos;
+    }
+    return false;
+  }
+
+  void skipSpace() {
+    while (_pos < _end && (*_pos == ' ' || *_pos == '\t' || *_pos == '\n' || *_pos == '\r')) {
+      _pos++;
+    }
+  }
+
+  // 跳过空白后匹配运算符
+  bool accept(const char *token) {
+    skipSpace();
+    size_t length = strlen(token);
+    if ((size_t)(_end - _pos) >= length && memcmp(_pos, token, length) == 0) {
+      _pos += length;
+      return true;
+    }
+    return false;
+  }
+
+  bool peek(char c) {
+    skipSpace();
+    return _pos < _end && *_pos == c;
+  }
+
+  // ---------- 代码生成(末尾的常量运算直接折叠) ----------
+
+  bool emit(uint8_t op, uint8_t arg) {
+    if (_expr._codeSize >= MCP_EXPR_MAX_CODE) {
+      return fail(McpExpression::ERR_TOO_COMPLEX);
+    }
+    _expr._code[_expr._codeSize].op = op;
+    _expr._code[_expr._codeSize].arg = arg;
+    _expr._codeSize++;
+    return true;
+  }
+
+  bool push() {
+    if (++_depth > MCP_EXPR_MAX_STACK) {
+      return fail(McpExpression::ERR_TOO_COMPLEX);
+    }
+    return true;
+  }
+
+  bool emitConst(double value) {
+    if (_expr._constCount >= MCP_EXPR_MAX_CONSTS) {
+      return fail(McpExpression::ERR_TOO_COMPLEX);
+    }
+    _expr._consts[_expr._constCount] = value;
+    if (!emit(OP_CONST, _expr._constCount)) {
+      return false;
+    }
+    _expr._constCount++;
+    return push();
+  }
+
+  bool emitVariable(const char *name, size_t length) {
+    if (length > MCP_EXPR_MAX_NAME) {
+      return fail(McpExpression::ERR_NAME_TOO_LONG);
+    }
+    size_t index = 0;
+    while (index < _expr._varCount &&
+           !(strlen(_expr._varNames[index]) == length && memcmp(_expr._varNames[index], name, length) == 0)) {
+      index++;
+    }
+    if (index == _expr._varCount) {
+      if (_expr._varCount >= MCP_EXPR_MAX_VARS) {
+        return fail(McpExpression::ERR_TOO_MANY_VARIABLES);
+      }
+      memcpy(_expr._varNames[index], name, length);
+      _expr._varNames[index][length] = '\0';
+      _expr._varCount++;
+    }
+    return emit(OP_VAR, (uint8_t)index) && push();
+  }
+
+  // 末尾count条指令都是常量时返回true(常量按出现顺序追加，末尾的常量指令对应常量池末尾)
+  bool trailingConstants(size_t count) const {
+    if (_expr._codeSize < count) {
+      return false;
+    }
+    for (size_t i = _expr._codeSize - count; i < _expr._codeSize; i++) {
+      if (_expr._code[i].op != OP_CONST) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool emitNegate() {
+    if (trailingConstants(1)) {
+      double &value = _expr._consts[_expr._constCount - 1];
+      value = -value;
+      return true;
+    }
+    return emit(OP_NEG, 0);
+  }
+
+  bool emitBinary(uint8_t op) {
+    _depth--;
+    if (trailingConstants(2)) {
+      double *consts = _expr._consts + _expr._constCount - 2;
+      consts[0] = applyBinary(op, consts[0], consts[1]);
+      _expr._constCount--;
+      _expr._codeSize--;
+      return true;
+    }
+    return emit(op, 0);
+  }
+
+  bool emitCall(uint8_t id, uint8_t argc) {
+    _depth -= argc - 1;
+    if (trailingConstants(argc)) {
+      double *args = _expr._consts + _expr._constCount - argc;
+      args[0] = callFunction(id, args);
+      _expr._constCount -= argc - 1;
+      _expr._codeSize -= argc - 1;
+      return true;
+    }
+    return emit(OP_CALL, id);
+  }
+
+  // ---------- 解析 ----------
+
+  bool parseOr() {
+    if (!parseAnd()) {
+      return false;
+    }
+    while (accept("||")) {
+      if (!parseAnd() || !emitBinary(OP_OR)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool parseAnd() {
+    if (!parseComparison()) {
+      return false;
+    }
+    while (accept("&&")) {
+      if (!parseComparison() || !emitBinary(OP_AND)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool parseComparison() {
+    if (!parseAdditive()) {
+      return false;
+    }
+    for (;;) {
+      uint8_t op;
+      if (accept("<=")) {
+        op = OP_LE;
+      } else if (accept(">=")) {
+        op = OP_GE;
+      } else if (accept("==")) {
+        op = OP_EQ;
+      } else if (accept("!=")) {
+        op = OP_NE;
+      } else if (accept("<")) {
+        op = OP_LT;
+      } else if (accept(">")) {
+        op = OP_GT;
+      } else {
+        return true;
+      }
+      if (!parseAdditive() || !emitBinary(op)) {
+        return false;
+      }
+    }
+  }
+
+  bool parseAdditive() {
+    if (!parseTerm()) {
+      return false;
+    }
+    for (;;) {
+      uint8_t op;
+      if (accept("+")) {
+        op = OP_ADD;
+      } else if (accept("-")) {
+        op = OP_SUB;
+      } else {
+        return true;
+      }
+      if (!parseTerm() || !emitBinary(op)) {
+        return false;
+      }
+    }
+  }
+
+  bool parseTerm() {
+    if (!parseUnary()) {
+      return false;
+    }
+    for (;;) {
+      uint8_t op;
+      if (peek('*') && (_end - _pos < 2 || _pos[1] != '*')) {
+        _pos++;
+        op = OP_MUL;
+      } else if (accept("/")) {
+        op = OP_DIV;
+      } else if (accept("%")) {
+        op = OP_MOD;
+      } else {
+        return true;
+      }
+      if (!parseUnary() || !emitBinary(op)) {
+        return false;
+      }
+    }
+  }
+
+  bool parseUnary() {
+    if (accept("-")) {
+      return enter() && parseUnary() && emitNegate() && leave();
+    }
+    if (accept("+")) {
+      return enter() && parseUnary() && leave();
+    }
+    return parsePower();
+  }
+
+  bool parsePower() {
+    if (!parsePrimary()) {
+      return false;
+    }
+    if (accept("^") || accept("**")) {
+      return enter() && parseUnary() && emitBinary(OP_POW) && leave();
+    }
+    return true;
+  }
+
+  bool parsePrimary() {
+    skipSpace();
+    if (_pos == _end) {
+      return fail(McpExpression::ERR_SYNTAX);
+    }
+    char c = *_pos;
+    if (c == '(') {
+      _pos++;
+      if (!enter() || !parseOr()) {
+        return false;
+      }
+      if (!accept(")")) {
+        return fail(McpExpression::ERR_PARENTHESES);
+      }
+      return leave();
+    }
+    if (isDigit(c) || c == '.') {
+      return parseNumber();
+    }
+    if (isNameStart(c)) {
+      return parseName();
+    }
+    return fail(c == ')' ? McpExpression::ERR_PARENTHESES : McpExpression::ERR_SYNTAX);
+  }
+
+  bool parseNumber() {
+    const char *start = _pos;
+    while (_pos < _end && isDigit(*_pos)) {
+      _pos++;
+    }
+    if (_pos < _end && *_pos == '.') {
+      _pos++;
+      while (_pos < _end && isDigit(*_pos)) {
+        _pos++;
+      }
+    }
+    if (_pos < _end && (*_pos == 'e' || *_pos == 'E')) {
+      const char *exponent = _pos + 1;
+      if (exponent < _end && (*exponent == '+' || *exponent == '-')) {
+        exponent++;
+      }
+      if (exponent < _end && isDigit(*exponent)) {
+        _pos = exponent;
+        while (_pos < _end && isDigit(*_pos)) {
+          _pos++;
+        }
+      }
+    }
+    // 文本不一定以'\0'结尾，复制到栈上再转换
+    char digits[40];
+    size_t length = _pos - start;
+    if (length >= sizeof(digits) || (length == 1 && *start == '.')) {
+      _pos = start;
+      return fail(McpExpression::ERR_SYNTAX);
+    }
+    memcpy(digits, start, length);
+    digits[length] = '\0';
+    return emitConst(strtod(digits, nullptr));
+  }
+
+  bool parseName() {
+    const char *name = _pos;
+    while (_pos < _end && (isNameStart(*_pos) || isDigit(*_pos))) {
+      _pos++;
+    }
+    size_t length = _pos - name;
+    if (peek('(')) {
+      return parseCall(name, length);
+    }
+    if (length == 2 && memcmp(name, "pi", 2) == 0) {
+      return emitConst(3.14159265358979323846);
+    }
+    if (length == 1 && *name == 'e') {
+      return emitConst(2.71828182845904523536);
+    }
+    if (length > MCP_EXPR_MAX_NAME) {
+      _pos = name;
+    }
+    return emitVariable(name, length);
+  }
+
+  bool parseCall(const char *name, size_t length) {
+    size_t id = 0;
+    while (id < FUNCTION_COUNT && !(strlen(FUNCTIONS[id].name) == length && memcmp(FUNCTIONS[id].name, name, length) == 0)) {
+      id++;
+    }
+    if (id == FUNCTION_COUNT) {
+      _pos = name;
+      return fail(McpExpression::ERR_UNKNOWN_FUNCTION);
+    }
+    _pos++; // '('
+    if (!enter()) {
+      return false;
+    }
+    uint8_t argc = 0;
+    if (!peek(')')) {
+      do {
+        if (!parseOr()) {
+          return false;
+        }
+        argc++;
+      } while (accept(","));
+    }
+    if (!accept(")")) {
+      return fail(McpExpression::ERR_PARENTHESES);
+    }
+    if (argc != FUNCTIONS[id].argc) {
+      _pos = name;
+      return fail(McpExpression::ERR_ARGUMENT_COUNT);
+    }
+    return emitCall((uint8_t)id, argc) && leave();
+  }
+
+  bool enter() {
+    if (++_nesting > MCP_EXPR_MAX_NESTING) {
+      return fail(McpExpression::ERR_TOO_COMPLEX);
+    }
+    return true;
+  }
+
+  bool leave() {
+    _nesting--;
+    return true;
+  }
+};
+
+void McpExpression::reset() {
+  _codeSize = 0;
+  _constCount = 0;
+  _varCount = 0;
+}
+
+McpExpression::Error McpExpression::compile(const char *text, size_t length, size_t *errorPosition) {
+  McpExpressionCompiler compiler(*this, text, length);
+  return compiler.run(errorPosition);
+}
+
+bool McpExpression::evaluate(const double *values, size_t count, double &result) const {
+  if (_codeSize == 0 || count < _varCount) {
+    return false;
+  }
+  // 栈深度已在编译时检查
+  double stack[MCP_EXPR_MAX_STACK];
+  size_t top = 0;
+  for (size_t i = 0; i < _codeSize; i++) {
+    const Instruction &instruction = _code[i];
+    switch (instruction.op) {
+      case OP_CONST:
+        stack[top++] = _consts[instruction.arg];
+        break;
+      case OP_VAR:
+        stack[top++] = values[instruction.arg];
+        break;
+      case OP_NEG:
+        stack[top - 1] = -stack[top - 1];
+        break;
+      case OP_CALL:
+        top -= FUNCTIONS[instruction.arg].argc;
+        stack[top] = callFunction(instruction.arg, stack + top);
+        top++;
+        break;
+      default:
+        top--;
+        stack[top - 1] = applyBinary(instruction.op, stack[top - 1], stack[top]);
+        break;
+    }
+  }
+  result = stack[0];
+  return true;
+}
+
+const char *McpExpression::errorText(Error error) {
+  switch (error) {
+    case OK: return "ok";
+    case ERR_EMPTY: return "empty expression";
+    case ERR_SYNTAX: return "syntax error";
+    case ERR_PARENTHESES: return "unbalanced parentheses";
+    case ERR_UNKNOWN_FUNCTION: return "unknown function";
+    case ERR_ARGUMENT_COUNT: return "wrong number of arguments";
+    case ERR_TOO_COMPLEX: return "expression too complex";
+    case ERR_TOO_MANY_VARIABLES: return "too many variables";
+    case ERR_NAME_TOO_LONG: return "variable name too long";
+  }
+  return "unknown error";
+}
+
+McpExpressionCache::McpExpressionCache() : _clock(0), _hits(0), _misses(0) {
+  clear();
+}
+
+const McpExpression *McpExpressionCache::compile(const char *text, size_t length, McpExpression::Error &error,
+                                                 size_t &errorPosition) {
+  error = McpExpression::OK;
+  errorPosition = 0;
+  uint32_t hash = mcpHashBytes(text, length);
+  bool cacheable = length <= MCP_EXPR_CACHE_TEXT;
+  Entry *target = nullptr;
+  if (cacheable) {
+    for (size_t i = 0; i < MCP_EXPR_CACHE_ENTRIES; i++) {
+      Entry &entry = _entries[i];
+      if (entry.used && entry.hash == hash && entry.length == length && memcmp(entry.text, text, length) == 0) {
+        entry.lastUsed = ++_clock;
+        _hits++;
+        return &entry.expression;
+      }
+      if (!target || (target->used && (!entry.used || entry.lastUsed < target->lastUsed))) {
+        target = &entry;
+      }
+    }
+  }
+  _misses++;
+
+  // 先编译到临时对象，失败的表达式不挤掉缓存中的项
+  error = _scratch.compile(text, length, &errorPosition);
+  if (error != McpExpression::OK) {
+    return nullptr;
+  }
+  if (!cacheable) {
+    return &_scratch;
+  }
+  target->hash = hash;
+  target->lastUsed = ++_clock;
+  target->length = (uint8_t)length;
+  target->used = true;
+  memcpy(target->text, text, length);
+  target->expression = _scratch;
+  return &target->expression;
+}
+
+void McpExpressionCache::clear() {
+  for (size_t i = 0; i < MCP_EXPR_CACHE_ENTRIES; i++) {
+    _entries[i].used = false;
+  }
+}
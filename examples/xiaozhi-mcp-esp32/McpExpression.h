@@ -0,0 +1,150 @@
+/**
+ * McpExpression.h
+ * 算术表达式引擎：把表达式编译为紧凑的字节码(不使用堆)，再对给定的变量值求值
+ * 支持 + - * / % ^(乘方)、比较和逻辑运算(结果为1或0)、括号、常用函数、常量pi和e，以及最多MCP_EXPR_MAX_VARS个变量
+ * McpExpressionCache缓存最近编译的表达式，重复的公式(如单位换算)只在第一次解析
+ * 不依赖Arduino，可在主机上单独编译做基准测试
+ *
+ *   McpExpressionCache cache;
+ *   McpExpression::Error error;
+ *   size_t position;
+ *   const McpExpression *expr = cache.compile("(f-32)*5/9", 10, error, position);
+ *   double f = 98.6, c;
+ *   if (expr && expr->evaluate(&f, 1, c)) { ... }
+ */
+
+#ifndef MCP_EXPRESSION_H
+#define MCP_EXPRESSION_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 字节码指令数上限
+#ifndef MCP_EXPR_MAX_CODE
+#define MCP_EXPR_MAX_CODE 64
+#endif
+// 常量池大小
+#ifndef MCP_EXPR_MAX_CONSTS
+#define MCP_EXPR_MAX_CONSTS 16
+#endif
+// 变量个数上限及变量名最大长度(不含'\0')
+#ifndef MCP_EXPR_MAX_VARS
+#define MCP_EXPR_MAX_VARS 8
+#endif
+#ifndef MCP_EXPR_MAX_NAME
+#define MCP_EXPR_MAX_NAME 15
+#endif
+// 求值栈深度，编译时检查，超出的表达式编译失败
+#ifndef MCP_EXPR_MAX_STACK
+#define MCP_EXPR_MAX_STACK 16
+#endif
+// 括号和函数调用的最大嵌套层数(解析器是递归下降，限制层数以控制栈用量)
+#ifndef MCP_EXPR_MAX_NESTING
+#define MCP_EXPR_MAX_NESTING 16
+#endif
+// 缓存的表达式个数，以及可缓存的表达式最大长度(字节)，更长的表达式每次重新编译
+#ifndef MCP_EXPR_CACHE_ENTRIES
+#define MCP_EXPR_CACHE_ENTRIES 4
+#endif
+#ifndef MCP_EXPR_CACHE_TEXT
+#define MCP_EXPR_CACHE_TEXT 96
+#endif
+
+/**
+ * McpExpression
+ * 编译后的表达式：定长指令数组和常量池，全部内嵌在对象中
+ * 常量子表达式在编译时折叠，如"c*(9/5)+32"编译为 VAR c, CONST 1.8, MUL, CONST 32, ADD
+ */
+class McpExpression {
+public:
+  enum Error {
+    OK = 0,
+    ERR_EMPTY,           // 空表达式
+    ERR_SYNTAX,          // 意外的字符或缺少操作数
+    ERR_PARENTHESES,     // 括号不匹配
+    ERR_UNKNOWN_FUNCTION,
+    ERR_ARGUMENT_COUNT,  // 函数参数个数不对
+    ERR_TOO_COMPLEX,     // 超出指令数、常量数、栈深度或嵌套层数
+    ERR_TOO_MANY_VARIABLES,
+    ERR_NAME_TOO_LONG
+  };
+
+  McpExpression() { reset(); }
+
+  /**
+   * 编译表达式(不要求以'\0'结尾)
+   * @param errorPosition 出错时写入出错位置(字节偏移)，可为nullptr
+   */
+  Error compile(const char *text, size_t length, size_t *errorPosition = nullptr);
+
+  /**
+   * 求值
+   * @param values 各变量的值，values[i]对应variableName(i)
+   * @param count values的个数，少于variableCount()时返回false
+   * @return 是否求值成功；除零等情况结果为无穷大或NaN，仍返回true
+   */
+  bool evaluate(const double *values, size_t count, double &result) const;
+
+  size_t variableCount() const { return _varCount; }
+  const char *variableName(size_t index) const { return _varNames[index]; }
+  // 指令数(用于测试常量折叠等)
+  size_t codeSize() const { return _codeSize; }
+  bool valid() const { return _codeSize > 0; }
+
+  static const char *errorText(Error error);
+
+private:
+  friend class McpExpressionCompiler;
+
+  struct Instruction {
+    uint8_t op;
+    uint8_t arg; // 常量下标、变量下标或函数编号
+  };
+
+  void reset();
+
+  Instruction _code[MCP_EXPR_MAX_CODE];
+  double _consts[MCP_EXPR_MAX_CONSTS];
+  char _varNames[MCP_EXPR_MAX_VARS][MCP_EXPR_MAX_NAME + 1];
+  uint8_t _codeSize;
+  uint8_t _constCount;
+  uint8_t _varCount;
+};
+
+/**
+ * McpExpressionCache
+ * 按表达式文本缓存编译结果，满时替换最久未使用的项
+ * 不加锁，只能在一个线程中使用
+ */
+class McpExpressionCache {
+public:
+  McpExpressionCache();
+
+  /**
+   * 返回编译好的表达式，未命中时编译并存入缓存
+   * 返回的指针在下一次调用compile()之前有效；编译失败时返回nullptr，error和errorPosition写入错误
+   */
+  const McpExpression *compile(const char *text, size_t length, McpExpression::Error &error, size_t &errorPosition);
+
+  void clear();
+  uint32_t hits() const { return _hits; }
+  uint32_t misses() const { return _misses; }
+
+private:
+  struct Entry {
+    uint32_t hash;
+    uint32_t lastUsed;
+    uint8_t length;
+    bool used;
+    char text[MCP_EXPR_CACHE_TEXT];
+    McpExpression expression;
+  };
+
+  Entry _entries[MCP_EXPR_CACHE_ENTRIES];
+  McpExpression _scratch; // 过长、不缓存的表达式
+  uint32_t _clock;
+  uint32_t _hits;
+  uint32_t _misses;
+};
+
+#endif // MCP_EXPRESSION_H
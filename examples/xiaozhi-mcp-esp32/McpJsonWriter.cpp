@@ -0,0 +1,105 @@
+/**
+ * McpJsonWriter.cpp
+ * 流式JSON写入器实现
+ */
+
+#include "McpJsonWriter.h"
+
+McpJsonWriter::McpJsonWriter(McpFrameSink &sink)
+    : _sink(sink), _length(0), _total(0), _capture(nullptr), _first(true), _ok(true) {}
+
+void McpJsonWriter::begin() {
+  _length = 0;
+  _total = 0;
+  _capture = nullptr;
+  _first = true;
+  _ok = true;
+}
+
+bool McpJsonWriter::end() {
+  flush(true);
+  return _ok;
+}
+
+bool McpJsonWriter::flushPending() {
+  if (_length == 0) {
+    return _ok;
+  }
+  return flush(false);
+}
+
+// 发出缓冲区中的内容；失败后丢弃本消息剩余部分
+bool McpJsonWriter::flush(bool fin) {
+  if (_ok) {
+    _ok = _sink.writeFrame(_buffer, _length, _first, fin);
+  }
+  _first = false;
+  _length = 0;
+  return _ok;
+}
+
+size_t McpJsonWriter::write(uint8_t c) {
+  if (_length == MCP_FRAME_CHUNK) {
+    flush(false);
+  }
+  _buffer[WEBSOCKETS_MAX_HEADER_SIZE + _length++] = c;
+  _total++;
+  if (_capture) {
+    _capture->write(c);
+  }
+  return 1;
+}
+
+size_t McpJsonWriter::write(const uint8_t *data, size_t length) {
+  if (_capture) {
+    _capture->write(data, length);
+  }
+  size_t remaining = length;
+  while (remaining > 0) {
+    if (_length == MCP_FRAME_CHUNK) {
+      flush(false);
+    }
+    size_t n = MCP_FRAME_CHUNK - _length;
+    if (n > remaining) {
+      n = remaining;
+    }
+    memcpy(_buffer + WEBSOCKETS_MAX_HEADER_SIZE + _length, data, n);
+    _length += n;
+    data += n;
+    remaining -= n;
+  }
+  _total += length;
+  return length;
+}
+
+McpJsonWriter &McpJsonWriter::raw(const char *text) {
+  return raw(text, strlen(text));
+}
+
+McpJsonWriter &McpJsonWriter::raw(const char *text, size_t length) {
+  write((const uint8_t *)text, length);
+  return *this;
+}
+
+McpJsonWriter &McpJsonWriter::string(const char *text) {
+  return string(text, strlen(text));
+}
+
+McpJsonWriter &McpJsonWriter::string(const char *text, size_t length) {
+  mcpWriteJsonString(*this, text, length);
+  return *this;
+}
+
+McpJsonWriter &McpJsonWriter::number(long value) {
+  char digits[24];
+  int n = snprintf(digits, sizeof(digits), "%ld", value);
+  return raw(digits, n);
+}
+
+McpJsonWriter &McpJsonWriter::value(JsonVariantConst variant) {
+  if (variant.isNull()) {
+    return raw("null", 4);
+  }
+  serializeJson(variant, *this);
+  return *this;
+}
@@ -0,0 +1,213 @@
+/**
+ * McpJsonWriter.h
+ * 流式JSON写入器：按固定大小的块直接写入WebSocket帧，不在内存中拼出整条消息
+ */
+
+#ifndef MCP_JSON_WRITER_H
+#define MCP_JSON_WRITER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#ifndef WEBSOCKETS_MAX_HEADER_SIZE
+#define WEBSOCKETS_MAX_HEADER_SIZE (14)
+#endif
+
+// 每个WebSocket分片帧携带的最大载荷字节数
+#ifndef MCP_FRAME_CHUNK
+#define MCP_FRAME_CHUNK 1024
+#endif
+
+// 是否需要转义：控制字符、双引号和反斜杠；UTF-8多字节字符原样输出
+inline bool mcpJsonNeedsEscape(uint8_t c) {
+  return c < 0x20 || c == '"' || c == '\\';
+}
+
+/**
+ * 从from开始查找下一个需要转义的字节，没有时返回length
+ * 按机器字(ESP32上4字节)一次检查多个字节(SWAR)：某字节小于0x20或等于'"'、'\\'时对应的最高位被置位，
+ * 整个字都不需要转义时直接跳过；先逐字节走到字对齐的位置，避免非对齐读取
+ */
+inline size_t mcpJsonFindEscape(const char *text, size_t from, size_t length) {
+  typedef uintptr_t Word;
+  static const Word ONES = (Word)-1 / 0xFF;  // 0x0101...01
+  static const Word HIGHS = ONES * 0x80;     // 0x8080...80
+  size_t i = from;
+  while (i < length && ((uintptr_t)(text + i) & (sizeof(Word) - 1)) != 0) {
+    if (mcpJsonNeedsEscape((uint8_t)text[i])) {
+      return i;
+    }
+    i++;
+  }
+  for (; i + sizeof(Word) <= length; i += sizeof(Word)) {
+    Word word;
+    memcpy(&word, __builtin_assume_aligned(text + i, sizeof(Word)), sizeof(Word));
+    Word quote = word ^ (ONES * '"');
+    Word backslash = word ^ (ONES * '\\');
+    Word hits = ((word - ONES * 0x20) | (quote - ONES) | (backslash - ONES)) & ~word & HIGHS;
+    if (hits != 0) {
+      break;
+    }
+  }
+  for (; i < length; i++) {
+    if (mcpJsonNeedsEscape((uint8_t)text[i])) {
+      return i;
+    }
+  }
+  return length;
+}
+
+// 转义后的长度(不含两侧引号)，用于预先分配输出缓冲区
+inline size_t mcpJsonEscapedLength(const char *text, size_t length) {
+  size_t total = length;
+  for (size_t i = mcpJsonFindEscape(text, 0, length); i < length; i = mcpJsonFindEscape(text, i + 1, length)) {
+    uint8_t c = (uint8_t)text[i];
+    bool shortForm = c == '"' || c == '\\' || c == '\b' || c == '\f' || c == '\n' || c == '\r' || c == '\t';
+    total += shortForm ? 1 : 5;
+  }
+  return total;
+}
+
+/**
+ * 写入转义后的JSON字符串内容(不含两侧引号)，无需转义的部分整段写入
+ * out需要提供write(uint8_t)和write(const uint8_t *, size_t)
+ */
+template<typename TWriter>
+void mcpWriteJsonEscaped(TWriter &out, const char *text, size_t length) {
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  size_t runStart = 0;
+  for (size_t i = mcpJsonFindEscape(text, 0, length); i < length; i = mcpJsonFindEscape(text, i + 1, length)) {
+    uint8_t c = (uint8_t)text[i];
+    if (i > runStart) {
+      out.write((const uint8_t *)text + runStart, i - runStart);
+    }
+    runStart = i + 1;
+    char escaped[6] = {'\\', 0, '0', '0', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0x0F]};
+    size_t escapedLength = 2;
+    switch (c) {
+      case '"':  escaped[1] = '"'; break;
+      case '\\': escaped[1] = '\\'; break;
+      case '\b': escaped[1] = 'b'; break;
+      case '\f': escaped[1] = 'f'; break;
+      case '\n': escaped[1] = 'n'; break;
+      case '\r': escaped[1] = 'r'; break;
+      case '\t': escaped[1] = 't'; break;
+      default:
+        escaped[1] = 'u';
+        escapedLength = sizeof(escaped);
+        break;
+    }
+    out.write((const uint8_t *)escaped, escapedLength);
+  }
+  if (length > runStart) {
+    out.write((const uint8_t *)text + runStart, length - runStart);
+  }
+}
+
+// 写入带引号并转义的JSON字符串
+template<typename TWriter>
+void mcpWriteJsonString(TWriter &out, const char *text, size_t length) {
+  out.write((uint8_t)'"');
+  mcpWriteJsonEscaped(out, text, length);
+  out.write((uint8_t)'"');
+}
+
+/**
+ * 追加到String的写入器，配合mcpWriteJsonEscaped在String中生成JSON
+ */
+class McpStringWriter {
+public:
+  explicit McpStringWriter(String &target) : _target(target) {}
+  size_t write(uint8_t c) {
+    _target += (char)c;
+    return 1;
+  }
+  size_t write(const uint8_t *data, size_t length) {
+    _target.concat((const char *)data, length);
+    return length;
+  }
+
+private:
+  String &_target;
+};
+
+// 把转义后的JSON字符串内容追加到target，先按转义后的长度预留空间，追加时不再重新分配
+inline void mcpAppendJsonEscaped(String &target, const char *text, size_t length) {
+  target.reserve(target.length() + mcpJsonEscapedLength(text, length));
+  McpStringWriter writer(target);
+  mcpWriteJsonEscaped(writer, text, length);
+}
+
+inline void mcpAppendJsonEscaped(String &target, const String &text) {
+  mcpAppendJsonEscaped(target, text.c_str(), text.length());
+}
+
+/**
+ * 帧输出接口
+ * frame前WEBSOCKETS_MAX_HEADER_SIZE字节为预留的帧头空间，载荷从frame + WEBSOCKETS_MAX_HEADER_SIZE开始
+ * first表示这是消息的第一帧(文本帧)，否则为延续帧；fin表示消息结束
+ */
+class McpFrameSink {
+public:
+  virtual ~McpFrameSink() {}
+  virtual bool writeFrame(uint8_t *frame, size_t length, bool first, bool fin) = 0;
+};
+
+/**
+ * McpJsonWriter
+ * 缓冲区写满时作为一个分片帧发出，end()时发出最后一帧
+ * 消息不超过一个块时只发一个普通文本帧
+ * 同时满足ArduinoJson自定义Writer的接口，可直接serializeJson(doc, writer)
+ */
+class McpJsonWriter {
+public:
+  explicit McpJsonWriter(McpFrameSink &sink);
+
+  // 开始一条新消息
+  void begin();
+  // 结束当前消息并发出最后一帧，返回整条消息是否都发送成功
+  bool end();
+  // 不等缓冲区写满，把已写入的内容作为一个分片帧立即发出(消息不结束)
+  bool flushPending();
+
+  // ArduinoJson Writer接口
+  size_t write(uint8_t c);
+  size_t write(const uint8_t *data, size_t length);
+
+  // 原样写入(调用方保证是合法JSON片段)
+  McpJsonWriter &raw(const char *text);
+  McpJsonWriter &raw(const char *text, size_t length);
+  McpJsonWriter &raw(const String &text) { return raw(text.c_str(), text.length()); }
+
+  // 写入带引号并转义的JSON字符串
+  McpJsonWriter &string(const char *text);
+  McpJsonWriter &string(const char *text, size_t length);
+  McpJsonWriter &string(const String &text) { return string(text.c_str(), text.length()); }
+
+  // 写入数字、布尔值
+  McpJsonWriter &number(long value);
+  McpJsonWriter &boolean(bool value) { return raw(value ? "true" : "false"); }
+
+  // 写入任意JSON值(例如请求中的id，保持原类型)，空值写为null
+  McpJsonWriter &value(JsonVariantConst variant);
+
+  // 同时把之后写入的内容复制到capture(例如记录响应的一部分用于缓存)，传nullptr停止
+  void setCapture(Print *capture) { _capture = capture; }
+
+  bool ok() const { return _ok; }
+  // 当前消息已写入的字节数
+  size_t bytesWritten() const { return _total; }
+
+private:
+  bool flush(bool fin);
+
+  McpFrameSink &_sink;
+  uint8_t _buffer[WEBSOCKETS_MAX_HEADER_SIZE + MCP_FRAME_CHUNK];
+  size_t _length;
+  size_t _total;
+  Print *_capture;
+  bool _first;
+  bool _ok;
+};
+
+#endif // MCP_JSON_WRITER_H
@@ -0,0 +1,328 @@
+/**
+ * McpLog.cpp
+ * 日志缓冲区、后台输出任务和延迟格式化
+ */
+
+#include "McpLog.h"
+#include "McpSendQueue.h"
+#include <mutex>
+
+#if defined(ARDUINO_ARCH_ESP32) && !defined(MCP_HOST_BUILD)
+#define MCP_LOG_FREERTOS 1
+#else
+#define MCP_LOG_FREERTOS 0
+#include <condition_variable>
+#include <thread>
+#endif
+
+// 记录头：级别(1) + 时间戳(4) + 格式串指针
+static const size_t RECORD_HEADER = 1 + 4 + sizeof(const char *);
+
+// 参数类型标记
+enum {
+  ARG_INT = 'i',
+  ARG_UNSIGNED = 'u',
+  ARG_DOUBLE = 'd',
+  ARG_STRING = 's'
+};
+
+volatile int McpLog::_level = MCP_LOG_LEVEL;
+
+// 共享状态放在堆上且不释放，程序退出时后台线程仍可安全访问
+namespace {
+struct LogState {
+  uint8_t storage[MCP_LOG_BUFFER];
+  McpMessageRing ring;
+  std::mutex mutex;       // 保护ring
+  std::mutex drainMutex;  // 保证同一时间只有一个线程在输出
+  McpLog::Callback callback;
+  bool taskStarted;
+#if MCP_LOG_FREERTOS
+  TaskHandle_t task;
+#else
+  std::condition_variable ready;
+#endif
+
+  LogState() : ring(storage, sizeof(storage)), taskStarted(false) {
+#if MCP_LOG_FREERTOS
+    task = nullptr;
+#endif
+  }
+};
+
+LogState &logState() {
+  static LogState *state = new LogState();
+  return *state;
+}
+} // namespace
+
+McpLogRecord::McpLogRecord(uint8_t level, const char *format) : _size(RECORD_HEADER) {
+  uint32_t now = millis();
+  _data[0] = level;
+  memcpy(_data + 1, &now, 4);
+  memcpy(_data + 5, &format, sizeof(format));
+}
+
+bool McpLogRecord::reserve(size_t length) {
+  return _size + length <= sizeof(_data);
+}
+
+void McpLogRecord::addInt(long value) {
+  if (reserve(1 + sizeof(value))) {
+    _data[_size++] = ARG_INT;
+    memcpy(_data + _size, &value, sizeof(value));
+    _size += sizeof(value);
+  }
+}
+
+void McpLogRecord::addUnsigned(unsigned long value) {
+  if (reserve(1 + sizeof(value))) {
+    _data[_size++] = ARG_UNSIGNED;
+    memcpy(_data + _size, &value, sizeof(value));
+    _size += sizeof(value);
+  }
+}
+
+void McpLogRecord::addDouble(double value) {
+  if (reserve(1 + sizeof(value))) {
+    _data[_size++] = ARG_DOUBLE;
+    memcpy(_data + _size, &value, sizeof(value));
+    _size += sizeof(value);
+  }
+}
+
+// 字符串参数按剩余空间截断，最长255字节
+void McpLogRecord::add(const char *value) {
+  if (!value) {
+    value = "(null)";
+  }
+  if (!reserve(2)) {
+    return;
+  }
+  size_t length = strlen(value);
+  size_t room = sizeof(_data) - _size - 2;
+  if (length > room) {
+    length = room;
+  }
+  if (length > 255) {
+    length = 255;
+  }
+  _data[_size++] = ARG_STRING;
+  _data[_size++] = (uint8_t)length;
+  memcpy(_data + _size, value, length);
+  _size += length;
+}
+
+void McpLogRecord::add(const String &value) {
+  add(value.c_str());
+}
+
+void McpLog::setLevel(int level) {
+  _level = level;
+}
+
+void McpLog::setCallback(Callback callback) {
+  LogState &state = logState();
+  std::lock_guard<std::mutex> lock(state.drainMutex);
+  state.callback = callback;
+}
+
+uint32_t McpLog::dropped() {
+  LogState &state = logState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  return state.ring.dropped();
+}
+
+// 写入缓冲区，不等待输出；缓冲区满时丢弃本条
+void McpLog::push(const McpLogRecord &record) {
+  LogState &state = logState();
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.ring.beginMessage();
+    state.ring.append(record.data(), record.size());
+    state.ring.commitMessage();
+    if (!state.taskStarted) {
+      startTask();
+    }
+  }
+#if MCP_LOG_FREERTOS
+  if (state.task) {
+    xTaskNotifyGive(state.task);
+  }
+#else
+  state.ready.notify_one();
+#endif
+}
+
+// 取出一条记录格式化并输出，缓冲区为空时返回false
+bool McpLog::drainOne() {
+  LogState &state = logState();
+  uint8_t record[MCP_LOG_RECORD];
+  size_t size = 0;
+  uint32_t dropped = 0;
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (state.ring.empty()) {
+      return false;
+    }
+    size_t length = state.ring.frontLength();
+    while (size < length) {
+      size_t n;
+      const uint8_t *data = state.ring.frontData(size, &n);
+      memcpy(record + size, data, n);
+      size += n;
+    }
+    state.ring.popFront();
+    dropped = state.ring.dropped();
+  }
+
+  char line[MCP_LOG_LINE];
+  format(record, size, line, sizeof(line));
+  if (state.callback) {
+    state.callback(record[0], line);
+  } else {
+    Serial.print("[WebSocketMCP] ");
+    Serial.println(line);
+  }
+
+  // 报告新增的丢弃条数
+  static uint32_t reportedDrops = 0;
+  if (dropped != reportedDrops) {
+    snprintf(line, sizeof(line), "日志缓冲区已满，丢弃%lu条日志", (unsigned long)(dropped - reportedDrops));
+    reportedDrops = dropped;
+    if (state.callback) {
+      state.callback(MCP_LOG_LEVEL_WARN, line);
+    } else {
+      Serial.print("[WebSocketMCP] ");
+      Serial.println(line);
+    }
+  }
+  return true;
+}
+
+void McpLog::flush() {
+  LogState &state = logState();
+  std::lock_guard<std::mutex> lock(state.drainMutex);
+  while (drainOne()) {
+  }
+}
+
+// 按格式串逐个取出参数格式化；参数类型与转换符不符时按参数本身的类型输出
+void McpLog::format(const uint8_t *record, size_t size, char *line, size_t lineSize) {
+  const char *fmt;
+  memcpy(&fmt, record + 5, sizeof(fmt));
+  size_t pos = RECORD_HEADER;
+  size_t out = 0;
+
+  while (*fmt && out + 1 < lineSize) {
+    if (*fmt != '%') {
+      line[out++] = *fmt++;
+      continue;
+    }
+    if (fmt[1] == '%') {
+      line[out++] = '%';
+      fmt += 2;
+      continue;
+    }
+
+    // 复制标志、宽度和精度，跳过长度修饰符
+    char spec[16];
+    size_t specLength = 0;
+    spec[specLength++] = *fmt++;
+    while (*fmt && strchr("-+ #0123456789.", *fmt) && specLength < sizeof(spec) - 4) {
+      spec[specLength++] = *fmt++;
+    }
+    while (*fmt && strchr("hlLqjzt", *fmt)) {
+      fmt++;
+    }
+    char conversion = *fmt ? *fmt++ : 's';
+
+    size_t room = lineSize - out;
+    int written = 0;
+    if (pos >= size) {
+      // 参数不足(可能因记录空间不够被截断)
+      written = snprintf(line + out, room, "?");
+    } else {
+      uint8_t tag = record[pos++];
+      bool numeric = strchr("diouxXc", conversion) != nullptr;
+      bool floating = strchr("fFeEgGaA", conversion) != nullptr;
+      if (tag == ARG_STRING) {
+        uint8_t length = record[pos++];
+        written = snprintf(line + out, room, "%.*s", (int)length, (const char *)record + pos);
+        pos += length;
+      } else if (tag == ARG_DOUBLE) {
+        double value;
+        memcpy(&value, record + pos, sizeof(value));
+        pos += sizeof(value);
+        if (floating) {
+          spec[specLength] = conversion;
+          spec[specLength + 1] = '\0';
+          written = snprintf(line + out, room, spec, value);
+        } else {
+          written = snprintf(line + out, room, "%g", value);
+        }
+      } else {
+        long value;
+        memcpy(&value, record + pos, sizeof(value));
+        pos += sizeof(value);
+        if (numeric && conversion != 'c') {
+          spec[specLength] = 'l';
+          spec[specLength + 1] = (tag == ARG_UNSIGNED && (conversion == 'd' || conversion == 'i')) ? 'u' : conversion;
+          spec[specLength + 2] = '\0';
+          written = snprintf(line + out, room, spec, value);
+        } else if (conversion == 'c') {
+          written = snprintf(line + out, room, "%c", (char)value);
+        } else if (floating) {
+          spec[specLength] = conversion;
+          spec[specLength + 1] = '\0';
+          written = snprintf(line + out, room, spec, tag == ARG_UNSIGNED ? (double)(unsigned long)value : (double)value);
+        } else {
+          written = snprintf(line + out, room, tag == ARG_UNSIGNED ? "%lu" : "%ld", value);
+        }
+      }
+    }
+    if (written < 0) {
+      break;
+    }
+    out += (size_t)written < room ? (size_t)written : room - 1;
+  }
+  line[out] = '\0';
+}
+
+#if MCP_LOG_FREERTOS
+
+static void logTask(void *arg) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    McpLog::flush();
+  }
+}
+
+// 调用方已持有state.mutex
+void McpLog::startTask() {
+  LogState &state = logState();
+  state.taskStarted = true;
+  // 优先级与loop任务相同，不绑定核心，串口较慢时只会积压在缓冲区中
+  xTaskCreatePinnedToCore(logTask, "mcp_log", 3072, nullptr, 1, &state.task, tskNO_AFFINITY);
+}
+
+#else
+
+void McpLog::startTask() {
+  LogState &state = logState();
+  state.taskStarted = true;
+  std::thread([]() {
+    LogState &state = logState();
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(state.mutex);
+        while (state.ring.empty()) {
+          state.ready.wait(lock);
+        }
+      }
+      McpLog::flush();
+    }
+  }).detach();
+}
+
+#endif
@@ -0,0 +1,136 @@
+/**
+ * McpLog.h
+ * 日志：编译期级别过滤 + 延迟格式化
+ * 调用处只把格式串指针和参数原样写入内存环形缓冲区，由后台任务格式化后输出到Serial(或回调)，
+ * 不在消息处理路径上拼接String，也不等待串口
+ */
+
+#ifndef MCP_LOG_H
+#define MCP_LOG_H
+
+#include <Arduino.h>
+#include <functional>
+
+#define MCP_LOG_LEVEL_NONE  0
+#define MCP_LOG_LEVEL_ERROR 1
+#define MCP_LOG_LEVEL_WARN  2
+#define MCP_LOG_LEVEL_INFO  3
+#define MCP_LOG_LEVEL_DEBUG 4
+
+// 编译期日志级别，高于此级别的日志调用编译为空语句(参数也不会求值)
+#ifndef MCP_LOG_LEVEL
+#define MCP_LOG_LEVEL MCP_LOG_LEVEL_INFO
+#endif
+
+// 日志环形缓冲区大小(字节)，写满时新日志被丢弃并计数
+#ifndef MCP_LOG_BUFFER
+#define MCP_LOG_BUFFER 2048
+#endif
+
+// 单条日志记录(格式串指针+参数)的最大字节数，字符串参数超出部分被截断
+#ifndef MCP_LOG_RECORD
+#define MCP_LOG_RECORD 192
+#endif
+
+// 格式化后一行日志的最大长度
+#ifndef MCP_LOG_LINE
+#define MCP_LOG_LINE 256
+#endif
+
+/**
+ * 日志记录：按调用顺序保存带类型标记的参数
+ * 格式串必须是字符串常量(只保存指针)，字符串参数会被拷贝
+ */
+class McpLogRecord {
+public:
+  McpLogRecord(uint8_t level, const char *format);
+
+  void add(bool value) { addInt(value ? 1 : 0); }
+  void add(char value) { addInt(value); }
+  void add(int value) { addInt(value); }
+  void add(long value) { addInt(value); }
+  void add(long long value) { addInt((long)value); }
+  void add(unsigned int value) { addUnsigned(value); }
+  void add(unsigned long value) { addUnsigned(value); }
+  void add(unsigned long long value) { addUnsigned((unsigned long)value); }
+  void add(float value) { addDouble(value); }
+  void add(double value) { addDouble(value); }
+  void add(const char *value);
+  void add(char *value) { add((const char *)value); }
+  void add(const String &value);
+
+  const uint8_t *data() const { return _data; }
+  size_t size() const { return _size; }
+
+private:
+  friend class McpLog;
+  void addInt(long value);
+  void addUnsigned(unsigned long value);
+  void addDouble(double value);
+  bool reserve(size_t length);
+
+  uint8_t _data[MCP_LOG_RECORD];
+  size_t _size;
+};
+
+class McpLog {
+public:
+  // 日志回调：收到格式化好的一行(不含换行)
+  typedef std::function<void(int level, const char *line)> Callback;
+
+  // 运行期级别，只能在编译期级别范围内进一步降低输出
+  static void setLevel(int level);
+  static int level() { return _level; }
+  // 设置输出回调，为空时输出到Serial；应在开始记录日志前设置
+  static void setCallback(Callback callback);
+
+  // 立即在当前线程输出缓冲区中的全部日志(例如重启前)
+  static void flush();
+  // 因缓冲区已满丢弃的日志条数
+  static uint32_t dropped();
+
+  template <typename... Args>
+  static void write(uint8_t level, const char *format, const Args &...args) {
+    if (level > _level) {
+      return;
+    }
+    McpLogRecord record(level, format);
+    int expand[] = {0, (record.add(args), 0)...};
+    (void)expand;
+    push(record);
+  }
+
+private:
+  static void push(const McpLogRecord &record);
+  static bool drainOne();
+  static void format(const uint8_t *record, size_t size, char *line, size_t lineSize);
+  static void startTask();
+
+  static volatile int _level;
+};
+
+#if MCP_LOG_LEVEL >= MCP_LOG_LEVEL_ERROR
+#define MCP_LOGE(...) McpLog::write(MCP_LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define MCP_LOGE(...) do {} while (0)
+#endif
+
+#if MCP_LOG_LEVEL >= MCP_LOG_LEVEL_WARN
+#define MCP_LOGW(...) McpLog::write(MCP_LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define MCP_LOGW(...) do {} while (0)
+#endif
+
+#if MCP_LOG_LEVEL >= MCP_LOG_LEVEL_INFO
+#define MCP_LOGI(...) McpLog::write(MCP_LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define MCP_LOGI(...) do {} while (0)
+#endif
+
+#if MCP_LOG_LEVEL >= MCP_LOG_LEVEL_DEBUG
+#define MCP_LOGD(...) McpLog::write(MCP_LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define MCP_LOGD(...) do {} while (0)
+#endif
+
+#endif // MCP_LOG_H
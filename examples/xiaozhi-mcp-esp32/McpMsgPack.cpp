@@ -0,0 +1,424 @@
+/**
+ * McpMsgPack.cpp
+ * JSON到MessagePack的直接转码
+ */
+
+#include "McpMsgPack.h"
+#include <stdlib.h>
+
+namespace {
+
+// 写入类型字节和大端序的value；out为空时只计算长度(下同)
+size_t putTag(uint8_t *out, uint8_t tag, uint64_t value, int bytes) {
+  if (out) {
+    out[0] = tag;
+    for (int i = 0; i < bytes; i++) {
+      out[1 + i] = (uint8_t)(value >> (8 * (bytes - 1 - i)));
+    }
+  }
+  return 1 + bytes;
+}
+
+size_t putByte(uint8_t *out, uint8_t value) {
+  if (out) {
+    *out = value;
+  }
+  return 1;
+}
+
+size_t putStringHeader(uint8_t *out, size_t length) {
+  if (length < 32) {
+    return putByte(out, (uint8_t)(0xA0 | length));
+  }
+  if (length < 256) {
+    return putTag(out, 0xD9, length, 1);
+  }
+  if (length < 65536) {
+    return putTag(out, 0xDA, length, 2);
+  }
+  return putTag(out, 0xDB, length, 4);
+}
+
+size_t putContainerHeader(uint8_t *out, uint32_t count, bool object) {
+  if (count < 16) {
+    return putByte(out, (uint8_t)((object ? 0x80 : 0x90) | count));
+  }
+  if (count < 65536) {
+    return putTag(out, object ? 0xDE : 0xDC, count, 2);
+  }
+  return putTag(out, object ? 0xDF : 0xDD, count, 4);
+}
+
+const char *skipSpace(const char *p, const char *end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+    p++;
+  }
+  return p;
+}
+
+bool readHex4(const char *p, const char *end, uint32_t &value) {
+  if (end - p < 4) {
+    return false;
+  }
+  value = 0;
+  for (int i = 0; i < 4; i++) {
+    char c = p[i];
+    uint32_t digit;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      digit = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      digit = c - 'A' + 10;
+    } else {
+      return false;
+    }
+    value = (value << 4) | digit;
+  }
+  return true;
+}
+
+// 码点按UTF-8写出
+size_t putUtf8(uint8_t *out, uint32_t codepoint) {
+  if (codepoint < 0x80) {
+    return putByte(out, (uint8_t)codepoint);
+  }
+  if (codepoint < 0x800) {
+    if (out) {
+      out[0] = (uint8_t)(0xC0 | (codepoint >> 6));
+      out[1] = (uint8_t)(0x80 | (codepoint & 0x3F));
+    }
+    return 2;
+  }
+  if (codepoint < 0x10000) {
+    if (out) {
+      out[0] = (uint8_t)(0xE0 | (codepoint >> 12));
+      out[1] = (uint8_t)(0x80 | ((codepoint >> 6) & 0x3F));
+      out[2] = (uint8_t)(0x80 | (codepoint & 0x3F));
+    }
+    return 3;
+  }
+  if (out) {
+    out[0] = (uint8_t)(0xF0 | (codepoint >> 18));
+    out[1] = (uint8_t)(0x80 | ((codepoint >> 12) & 0x3F));
+    out[2] = (uint8_t)(0x80 | ((codepoint >> 6) & 0x3F));
+    out[3] = (uint8_t)(0x80 | (codepoint & 0x3F));
+  }
+  return 4;
+}
+
+/**
+ * 解码JSON字符串的内容(p指向开头的引号)，out非空时写出解码后的字节
+ * 成功时返回true，length为解码后的字节数，next指向结束引号之后
+ */
+bool decodeString(const char *p, const char *end, uint8_t *out, size_t &length, const char *&next) {
+  length = 0;
+  for (p++; p < end; ) {
+    char c = *p;
+    if (c == '"') {
+      next = p + 1;
+      return true;
+    }
+    if (c != '\\') {
+      // 无需转义的部分整段复制
+      const char *run = p;
+      while (p < end && *p != '"' && *p != '\\') {
+        p++;
+      }
+      if (out) {
+        memcpy(out + length, run, p - run);
+      }
+      length += p - run;
+      continue;
+    }
+    if (end - p < 2) {
+      return false;
+    }
+    uint32_t codepoint;
+    switch (p[1]) {
+      case '"':  codepoint = '"'; break;
+      case '\\': codepoint = '\\'; break;
+      case '/':  codepoint = '/'; break;
+      case 'b':  codepoint = '\b'; break;
+      case 'f':  codepoint = '\f'; break;
+      case 'n':  codepoint = '\n'; break;
+      case 'r':  codepoint = '\r'; break;
+      case 't':  codepoint = '\t'; break;
+      case 'u':
+        if (!readHex4(p + 2, end, codepoint)) {
+          return false;
+        }
+        // 代理对合成一个码点，单独的代理项原样编码
+        if (codepoint >= 0xD800 && codepoint < 0xDC00 && end - p >= 12 && p[6] == '\\' && p[7] == 'u') {
+          uint32_t low;
+          if (readHex4(p + 8, end, low) && low >= 0xDC00 && low < 0xE000) {
+            codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+            p += 6;
+          }
+        }
+        p += 4;
+        break;
+      default:
+        return false;
+    }
+    p += 2;
+    length += putUtf8(out ? out + length : nullptr, codepoint);
+  }
+  return false;
+}
+
+size_t packString(const char *p, const char *end, const char *&next, uint8_t *out) {
+  size_t length;
+  if (!decodeString(p, end, nullptr, length, next)) {
+    return 0;
+  }
+  size_t header = putStringHeader(out, length);
+  if (out) {
+    decodeString(p, end, out + header, length, next);
+  }
+  return header + length;
+}
+
+size_t packInteger(uint8_t *out, uint64_t magnitude, bool negative) {
+  if (!negative || magnitude == 0) {
+    if (magnitude < 0x80) {
+      return putByte(out, (uint8_t)magnitude);
+    }
+    if (magnitude <= 0xFF) {
+      return putTag(out, 0xCC, magnitude, 1);
+    }
+    if (magnitude <= 0xFFFF) {
+      return putTag(out, 0xCD, magnitude, 2);
+    }
+    if (magnitude <= 0xFFFFFFFFu) {
+      return putTag(out, 0xCE, magnitude, 4);
+    }
+    return putTag(out, 0xCF, magnitude, 8);
+  }
+  int64_t value = (int64_t)(0 - magnitude);
+  if (value >= -32) {
+    return putByte(out, (uint8_t)(int8_t)value);
+  }
+  if (value >= -128) {
+    return putTag(out, 0xD0, (uint8_t)(int8_t)value, 1);
+  }
+  if (value >= -32768) {
+    return putTag(out, 0xD1, (uint16_t)(int16_t)value, 2);
+  }
+  if (value >= INT32_MIN) {
+    return putTag(out, 0xD2, (uint32_t)(int32_t)value, 4);
+  }
+  return putTag(out, 0xD3, (uint64_t)value, 8);
+}
+
+size_t packNumber(const char *p, const char *end, const char *&next, uint8_t *out) {
+  const char *q = p;
+  bool negative = q < end && *q == '-';
+  if (negative) {
+    q++;
+  }
+  const char *digits = q;
+  uint64_t magnitude = 0;
+  bool overflow = false;
+  while (q < end && *q >= '0' && *q <= '9') {
+    uint32_t digit = *q - '0';
+    if (magnitude > (UINT64_MAX - digit) / 10) {
+      overflow = true;
+    } else {
+      magnitude = magnitude * 10 + digit;
+    }
+    q++;
+  }
+  if (q == digits) {
+    return 0;
+  }
+  bool isFloat = false;
+  if (q < end && *q == '.') {
+    isFloat = true;
+    const char *fraction = ++q;
+    while (q < end && *q >= '0' && *q <= '9') {
+      q++;
+    }
+    if (q == fraction) {
+      return 0;
+    }
+  }
+  if (q < end && (*q == 'e' || *q == 'E')) {
+    isFloat = true;
+    q++;
+    if (q < end && (*q == '+' || *q == '-')) {
+      q++;
+    }
+    const char *exponent = q;
+    while (q < end && *q >= '0' && *q <= '9') {
+      q++;
+    }
+    if (q == exponent) {
+      return 0;
+    }
+  }
+  next = q;
+  // 和ArduinoJson一样，超出64位整数范围的整数按浮点数处理
+  if (!isFloat && !overflow && (!negative || magnitude <= (uint64_t)INT64_MAX + 1)) {
+    return packInteger(out, magnitude, negative);
+  }
+  char text[40];
+  size_t length = q - p;
+  if (length >= sizeof(text)) {
+    return 0;
+  }
+  memcpy(text, p, length);
+  text[length] = '\0';
+  double value = strtod(text, nullptr);
+  float single = (float)value;
+  if ((double)single == value) {
+    uint32_t bits;
+    memcpy(&bits, &single, sizeof(bits));
+    return putTag(out, 0xCA, bits, 4);
+  }
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return putTag(out, 0xCB, bits, 8);
+}
+
+size_t packLiteral(const char *p, const char *end, const char *&next, uint8_t *out, const char *literal,
+                   uint8_t value) {
+  size_t length = strlen(literal);
+  if ((size_t)(end - p) < length || memcmp(p, literal, length) != 0) {
+    return 0;
+  }
+  next = p + length;
+  return putByte(out, value);
+}
+
+// 字符串、数字、true/false/null，格式错误时返回0
+size_t packScalar(const char *p, const char *end, const char *&next, uint8_t *out) {
+  switch (*p) {
+    case '"': return packString(p, end, next, out);
+    case 't': return packLiteral(p, end, next, out, "true", 0xC3);
+    case 'f': return packLiteral(p, end, next, out, "false", 0xC2);
+    case 'n': return packLiteral(p, end, next, out, "null", 0xC0);
+    default:  return packNumber(p, end, next, out);
+  }
+}
+
+} // namespace
+
+bool McpMsgPackEncoder::measure(const char *json, size_t length) {
+  struct Level {
+    uint32_t index;
+    bool object;
+  };
+  // FIRST_*为容器中第一个成员之前，这时可以直接遇到结束括号
+  enum State { VALUE, FIRST_VALUE, KEY, FIRST_KEY, COLON, NEXT };
+
+  const char *p = json;
+  const char *end = json + length;
+  Level stack[MCP_MSGPACK_MAX_DEPTH];
+  size_t depth = 0;
+  size_t containers = 0;
+  size_t size = 0;
+  State state = VALUE;
+  _size = 0;
+  for (;;) {
+    p = skipSpace(p, end);
+    if (p >= end) {
+      return false;
+    }
+    char c = *p;
+    if (state == COLON) {
+      if (c != ':') {
+        return false;
+      }
+      p++;
+      state = VALUE;
+      continue;
+    }
+    if (state == NEXT && c == ',') {
+      p++;
+      state = stack[depth - 1].object ? KEY : VALUE;
+      continue;
+    }
+    if (state == NEXT || ((state == FIRST_VALUE || state == FIRST_KEY) && (c == ']' || c == '}'))) {
+      // 容器结束，成员数已知，计入头部长度
+      if (c != (stack[depth - 1].object ? '}' : ']')) {
+        return false;
+      }
+      p++;
+      depth--;
+      size += putContainerHeader(nullptr, _counts[stack[depth].index], stack[depth].object);
+    } else if (state == KEY || state == FIRST_KEY) {
+      const char *next;
+      size_t n = c == '"' ? packString(p, end, next, nullptr) : 0;
+      if (n == 0) {
+        return false;
+      }
+      size += n;
+      p = next;
+      _counts[stack[depth - 1].index]++;
+      state = COLON;
+      continue;
+    } else {
+      if (depth > 0 && !stack[depth - 1].object) {
+        _counts[stack[depth - 1].index]++;
+      }
+      if (c == '{' || c == '[') {
+        if (containers >= _capacity || depth >= MCP_MSGPACK_MAX_DEPTH) {
+          return false;
+        }
+        _counts[containers] = 0;
+        stack[depth].index = (uint32_t)containers++;
+        stack[depth].object = c == '{';
+        depth++;
+        p++;
+        state = c == '{' ? FIRST_KEY : FIRST_VALUE;
+        continue;
+      }
+      const char *next;
+      size_t n = packScalar(p, end, next, nullptr);
+      if (n == 0) {
+        return false;
+      }
+      size += n;
+      p = next;
+    }
+    // 一个值结束：顶层值结束即完成，否则等待逗号或结束括号
+    if (depth == 0) {
+      break;
+    }
+    state = NEXT;
+  }
+  if (skipSpace(p, end) != end) {
+    return false;
+  }
+  _size = size;
+  return true;
+}
+
+// 第二遍：JSON已经检查过，按顺序取出成员数写出头部，标点和空白直接跳过
+size_t McpMsgPackEncoder::encode(const char *json, size_t length, uint8_t *out) const {
+  const char *p = json;
+  const char *end = json + length;
+  uint8_t *start = out;
+  size_t container = 0;
+  while (p < end) {
+    switch (*p) {
+      case '{':
+      case '[':
+        out += putContainerHeader(out, _counts[container++], *p == '{');
+        p++;
+        break;
+      case '}': case ']': case ',': case ':':
+      case ' ': case '\t': case '\n': case '\r':
+        p++;
+        break;
+      default: {
+        const char *next = end;
+        out += packScalar(p, end, next, out);
+        p = next;
+        break;
+      }
+    }
+  }
+  return out - start;
+}
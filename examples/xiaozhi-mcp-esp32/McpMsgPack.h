@@ -0,0 +1,48 @@
+/**
+ * McpMsgPack.h
+ * JSON文本直接转为MessagePack，不经过JsonDocument：出站消息已经是写好的JSON，
+ * 不必解析成节点树再序列化一遍
+ */
+
+#ifndef MCP_MSGPACK_H
+#define MCP_MSGPACK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// 直接转码支持的对象和数组总数，超过时由调用方改用JsonDocument转码
+#ifndef MCP_MSGPACK_MAX_CONTAINERS
+#define MCP_MSGPACK_MAX_CONTAINERS 64
+#endif
+
+// 直接转码支持的最大嵌套深度
+#ifndef MCP_MSGPACK_MAX_DEPTH
+#define MCP_MSGPACK_MAX_DEPTH 16
+#endif
+
+/**
+ * McpMsgPackEncoder
+ * 分两遍转码：measure()检查JSON、按出现顺序记下每个对象/数组的成员数并计算输出长度，
+ * encode()再按这些成员数写出头部和各个值；编码规则与ArduinoJson的serializeMsgPack()一致
+ * (整数用最短的编码，能精确表示为float的小数用float32)
+ * 成员数存在调用方提供的数组中，转码过程不分配内存
+ */
+class McpMsgPackEncoder {
+public:
+  McpMsgPackEncoder(uint32_t *counts, size_t capacity) : _counts(counts), _capacity(capacity), _size(0) {}
+
+  // JSON无效、对象和数组总数超过capacity或嵌套超过MCP_MSGPACK_MAX_DEPTH时返回false
+  bool measure(const char *json, size_t length);
+  // measure()成功后转码输出的字节数
+  size_t size() const { return _size; }
+  // 写出MessagePack，out至少有size()字节；json必须是刚才measure()成功的同一段文本
+  size_t encode(const char *json, size_t length, uint8_t *out) const;
+
+private:
+  uint32_t *_counts;
+  size_t _capacity;
+  size_t _size;
+};
+
+#endif // MCP_MSGPACK_H
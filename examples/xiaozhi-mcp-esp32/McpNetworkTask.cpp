@@ -0,0 +1,152 @@
+/**
+ * McpNetworkTask.cpp
+ * 网络任务实现
+ */
+
+#include "McpNetworkTask.h"
+
+#if MCP_NET_TASK_FREERTOS
+
+McpNetworkTask::McpNetworkTask()
+    : _started(false), _stopping(false), _task(nullptr), _taskLock(nullptr), _exited(nullptr) {}
+
+McpNetworkTask::~McpNetworkTask() {
+  stop();
+  if (_taskLock) {
+    vSemaphoreDelete(_taskLock);
+  }
+}
+
+void McpNetworkTask::stop() {
+  if (!_started) {
+    return;
+  }
+  _stopping = true;
+  wake();
+  xSemaphoreTake(_exited, portMAX_DELAY);
+  vSemaphoreDelete(_exited);
+  _exited = nullptr;
+  _started = false;
+}
+
+bool McpNetworkTask::begin(Body body, uint32_t stackSize, int priority, int core) {
+  if (_started) {
+    return true;
+  }
+  _body = body;
+  _stopping = false;
+  if (!_taskLock) {
+    _taskLock = xSemaphoreCreateMutex();
+    if (!_taskLock) {
+      return false;
+    }
+  }
+  _exited = xSemaphoreCreateBinary();
+  if (!_exited) {
+    return false;
+  }
+  if (xTaskCreatePinnedToCore(taskEntry, "mcp_net", stackSize, this, priority, &_task, core) != pdPASS) {
+    _task = nullptr;
+    vSemaphoreDelete(_exited);
+    _exited = nullptr;
+    return false;
+  }
+  _started = true;
+  return true;
+}
+
+void McpNetworkTask::wake() {
+  if (!_taskLock) {
+    return;
+  }
+  // 任务清空_task前要拿到同一把锁，持锁期间_task指向的任务不会被删除
+  xSemaphoreTake(_taskLock, portMAX_DELAY);
+  if (_task) {
+    xTaskNotifyGive(_task);
+  }
+  xSemaphoreGive(_taskLock);
+}
+
+void McpNetworkTask::wait(uint32_t timeoutMs) {
+  // 至少等待一个tick，让同一核心上的空闲任务有机会运行(任务看门狗)
+  TickType_t ticks = pdMS_TO_TICKS(timeoutMs);
+  ulTaskNotifyTake(pdTRUE, ticks > 0 ? ticks : 1);
+}
+
+bool McpNetworkTask::isCurrent() const {
+  return _task && xTaskGetCurrentTaskHandle() == _task;
+}
+
+void McpNetworkTask::taskEntry(void *arg) {
+  McpNetworkTask *task = static_cast<McpNetworkTask *>(arg);
+  while (!task->_stopping) {
+    task->_body();
+  }
+  // 清空_task之后其他线程的wake()不再通知本任务
+  xSemaphoreTake(task->_taskLock, portMAX_DELAY);
+  task->_task = nullptr;
+  xSemaphoreGive(task->_taskLock);
+  // 释放信号量之后析构函数可能立即销毁对象，此后不能再访问task
+  xSemaphoreGive(task->_exited);
+  vTaskDelete(nullptr);
+}
+
+#else
+
+McpNetworkTask::McpNetworkTask() : _started(false), _stopping(false), _wakePending(false) {}
+
+McpNetworkTask::~McpNetworkTask() {
+  stop();
+}
+
+void McpNetworkTask::stop() {
+  if (!_started) {
+    return;
+  }
+  _stopping = true;
+  wake();
+  _thread.join();
+  _started = false;
+}
+
+bool McpNetworkTask::begin(Body body, uint32_t stackSize, int priority, int core) {
+  if (_started) {
+    return true;
+  }
+  // 主机线程使用默认栈大小和调度策略
+  (void)stackSize;
+  (void)priority;
+  (void)core;
+  _body = body;
+  _stopping = false;
+  _thread = std::thread(&McpNetworkTask::threadEntry, this);
+  _started = true;
+  return true;
+}
+
+void McpNetworkTask::wake() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _wakePending = true;
+  }
+  _woken.notify_one();
+}
+
+void McpNetworkTask::wait(uint32_t timeoutMs) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _woken.wait_for(lock, std::chrono::milliseconds(timeoutMs > 0 ? timeoutMs : 1),
+                  [this]() { return _wakePending || _stopping; });
+  _wakePending = false;
+}
+
+bool McpNetworkTask::isCurrent() const {
+  return _started && std::this_thread::get_id() == _thread.get_id();
+}
+
+void McpNetworkTask::threadEntry() {
+  while (!_stopping) {
+    _body();
+  }
+}
+
+#endif
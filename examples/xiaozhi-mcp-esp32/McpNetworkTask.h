@@ -0,0 +1,124 @@
+/**
+ * McpNetworkTask.h
+ * 网络任务：WebSocketMCP在自己的任务中处理连接和请求，不依赖Arduino loop()的轮询
+ * ESP32上是固定在指定核心的FreeRTOS任务，其他平台(主机测试)基于std::thread
+ * 与应用线程之间通过单生产者单消费者的无锁队列传递操作和事件
+ */
+
+#ifndef MCP_NETWORK_TASK_H
+#define MCP_NETWORK_TASK_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <functional>
+#include <utility>
+
+#if defined(ARDUINO_ARCH_ESP32) && !defined(MCP_HOST_BUILD)
+#define MCP_NET_TASK_FREERTOS 1
+#else
+#define MCP_NET_TASK_FREERTOS 0
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+/**
+ * McpSpscQueue
+ * 单生产者单消费者的无锁环形队列，容量N必须是2的幂(实际可用N-1项)
+ * 生产者只写_tail，消费者只写_head，两端都不加锁
+ */
+template<typename T, size_t N>
+class McpSpscQueue {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "McpSpscQueue的容量必须是2的幂");
+
+public:
+  McpSpscQueue() : _head(0), _tail(0) {}
+
+  // 生产者调用，队列已满时返回false
+  bool push(T item) {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    size_t next = (tail + 1) & (N - 1);
+    if (next == _head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    _items[tail] = std::move(item);
+    _tail.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // 消费者调用，队列为空时返回false
+  bool pop(T &item) {
+    size_t head = _head.load(std::memory_order_relaxed);
+    if (head == _tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = std::move(_items[head]);
+    _items[head] = T();
+    _head.store((head + 1) & (N - 1), std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const { return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire); }
+
+private:
+  T _items[N];
+  std::atomic<size_t> _head; // 下一个要取出的位置
+  std::atomic<size_t> _tail; // 下一个要写入的位置
+};
+
+/**
+ * McpNetworkTask
+ * 反复调用body，body在没有工作时自行调用wait()或在套接字上阻塞
+ */
+class McpNetworkTask {
+public:
+  typedef std::function<void()> Body;
+
+  McpNetworkTask();
+  // 等同于stop()
+  ~McpNetworkTask();
+
+  /**
+   * 启动任务
+   * @param body 每一轮执行的函数
+   * @param stackSize 任务栈大小(字节，仅FreeRTOS)
+   * @param priority 任务优先级(仅FreeRTOS)
+   * @param core 固定运行的核心(仅FreeRTOS，tskNO_AFFINITY表示不固定)
+   * @return 是否启动成功
+   */
+  bool begin(Body body, uint32_t stackSize, int priority, int core);
+
+  // 停止并等待任务退出(当前一轮body执行完)；不能在任务自身中调用
+  void stop();
+
+  // 唤醒在wait()中等待的任务，可在任意线程调用；任务未在等待时，下一次wait()立即返回；stop()之后不做任何事
+  void wake();
+
+  // 在任务中调用：等到wake()或超时
+  void wait(uint32_t timeoutMs);
+
+  bool started() const { return _started; }
+  // 当前是否在本任务中执行
+  bool isCurrent() const;
+
+private:
+  bool _started;
+  Body _body;
+  std::atomic<bool> _stopping;
+
+#if MCP_NET_TASK_FREERTOS
+  static void taskEntry(void *arg);
+  TaskHandle_t _task;        // 任务退出前在_taskLock保护下清空
+  SemaphoreHandle_t _taskLock; // wake()持有期间任务不会退出
+  SemaphoreHandle_t _exited; // 任务退出前释放
+#else
+  void threadEntry();
+  std::thread _thread;
+  std::mutex _mutex;
+  std::condition_variable _woken;
+  bool _wakePending;
+#endif
+};
+
+#endif // MCP_NETWORK_TASK_H
@@ -0,0 +1,169 @@
+/**
+ * McpRegistry.h
+ * JSON-RPC方法名和工具名的哈希索引
+ * 不依赖Arduino，可在主机上单独编译做基准测试
+ */
+
+#ifndef MCP_REGISTRY_H
+#define MCP_REGISTRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+
+// FNV-1a 32位哈希，constexpr版本用于在编译期计算方法名哈希
+constexpr uint32_t mcpHashStr(const char *s, uint32_t h = 2166136261u) {
+  return *s ? mcpHashStr(s + 1, (h ^ (uint8_t)*s) * 16777619u) : h;
+}
+
+// 运行期版本，按长度计算(名称不要求以'\0'结尾)
+inline uint32_t mcpHashBytes(const char *s, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h = (h ^ (uint8_t)s[i]) * 16777619u;
+  }
+  return h;
+}
+
+/**
+ * McpHashIndex
+ * 开放寻址(线性探测)哈希表，把名称哈希映射到调用方存储中的下标
+ * 表中只保存哈希和下标，名称比较由调用方提供的谓词完成
+ *
+ * Capacity > 0 时为固定容量模式：表内嵌在对象中，不使用堆，最多Capacity个条目
+ * Capacity == 0 时为动态模式：按需扩容(装载因子超过3/4时翻倍)
+ */
+template <size_t Capacity = 0>
+class McpHashIndex;
+
+namespace mcp_detail {
+
+struct HashSlot {
+  uint32_t hash;
+  uint16_t index; // 调用方下标+1，0表示空槽
+};
+
+// 不小于n*4/3的2的幂，保证固定容量表装载因子不超过3/4
+constexpr size_t tableSizeFor(size_t n, size_t size = 8) {
+  return size * 3 >= n * 4 ? size : tableSizeFor(n, size * 2);
+}
+
+// 线性探测的公共实现，slots/mask由具体存储提供
+struct HashProbe {
+  template <typename Eq>
+  static int find(const HashSlot *slots, size_t mask, uint32_t hash, const Eq &eq) {
+    size_t pos = hash & mask;
+    for (size_t n = 0; n <= mask; n++) {
+      const HashSlot &slot = slots[pos];
+      if (slot.index == 0) {
+        return -1;
+      }
+      if (slot.hash == hash && eq(slot.index - 1)) {
+        return slot.index - 1;
+      }
+      pos = (pos + 1) & mask;
+    }
+    return -1;
+  }
+
+  static void insert(HashSlot *slots, size_t mask, uint32_t hash, uint16_t index) {
+    size_t pos = hash & mask;
+    while (slots[pos].index != 0) {
+      pos = (pos + 1) & mask;
+    }
+    slots[pos].hash = hash;
+    slots[pos].index = index + 1;
+  }
+};
+
+} // namespace mcp_detail
+
+// 固定容量模式
+template <size_t Capacity>
+class McpHashIndex {
+public:
+  static const size_t TABLE_SIZE = mcp_detail::tableSizeFor(Capacity);
+
+  McpHashIndex() { clear(); }
+
+  // 查找名称，eq(index)用于在哈希相同时确认名称一致，未找到返回-1
+  template <typename Eq>
+  int find(uint32_t hash, const Eq &eq) const {
+    return mcp_detail::HashProbe::find(_slots, TABLE_SIZE - 1, hash, eq);
+  }
+
+  // 插入新条目(调用方需先确认名称不存在)，已满时返回false
+  bool insert(uint32_t hash, size_t index) {
+    if (_count >= Capacity || index >= 0xFFFF) {
+      return false;
+    }
+    mcp_detail::HashProbe::insert(_slots, TABLE_SIZE - 1, hash, (uint16_t)index);
+    _count++;
+    return true;
+  }
+
+  void clear() {
+    memset(_slots, 0, sizeof(_slots));
+    _count = 0;
+  }
+
+  size_t size() const { return _count; }
+  size_t capacity() const { return Capacity; }
+
+private:
+  mcp_detail::HashSlot _slots[TABLE_SIZE];
+  size_t _count;
+};
+
+// 动态模式
+template <>
+class McpHashIndex<0> {
+public:
+  McpHashIndex() : _count(0) {}
+
+  template <typename Eq>
+  int find(uint32_t hash, const Eq &eq) const {
+    if (_slots.empty()) {
+      return -1;
+    }
+    return mcp_detail::HashProbe::find(_slots.data(), _slots.size() - 1, hash, eq);
+  }
+
+  bool insert(uint32_t hash, size_t index) {
+    if (index >= 0xFFFF) {
+      return false;
+    }
+    if ((_count + 1) * 4 > _slots.size() * 3) {
+      grow();
+    }
+    mcp_detail::HashProbe::insert(_slots.data(), _slots.size() - 1, hash, (uint16_t)index);
+    _count++;
+    return true;
+  }
+
+  void clear() {
+    _slots.assign(_slots.size(), mcp_detail::HashSlot());
+    _count = 0;
+  }
+
+  size_t size() const { return _count; }
+  size_t capacity() const { return (size_t)-1; }
+
+private:
+  void grow() {
+    std::vector<mcp_detail::HashSlot> old;
+    old.swap(_slots);
+    _slots.assign(old.empty() ? 8 : old.size() * 2, mcp_detail::HashSlot());
+    for (size_t i = 0; i < old.size(); i++) {
+      if (old[i].index != 0) {
+        mcp_detail::HashProbe::insert(_slots.data(), _slots.size() - 1, old[i].hash, old[i].index - 1);
+      }
+    }
+  }
+
+  std::vector<mcp_detail::HashSlot> _slots;
+  size_t _count;
+};
+
+#endif // MCP_REGISTRY_H
@@ -0,0 +1,138 @@
+/**
+ * McpResourceStore.cpp
+ * 资源存储实现
+ */
+
+#include "McpResourceStore.h"
+#include "McpLog.h"
+
+McpResourceStore::McpResourceStore() : _pendingChanges(0), _scanFrom(0), _version(0) {
+#if MCP_MAX_RESOURCES > 0
+  _resources.reserve(MCP_MAX_RESOURCES);
+#endif
+}
+
+bool McpResourceStore::add(const String &uri, const String &name, const String &description,
+                           const String &mimeType) {
+  int index = find(uri.c_str(), uri.length());
+  if (index >= 0) {
+    Resource &resource = _resources[index];
+    resource.name = name;
+    resource.description = description;
+    resource.mimeType = mimeType;
+    _version++;
+    return true;
+  }
+
+  Resource resource;
+  resource.uri = uri;
+  resource.uriHash = mcpHashBytes(uri.c_str(), uri.length());
+  resource.name = name;
+  resource.description = description;
+  resource.mimeType = mimeType;
+  resource.revision = 0;
+  resource.updatedAt = 0;
+  resource.subscribed = false;
+  resource.changed = false;
+  if (!_index.insert(resource.uriHash, _resources.size())) {
+    MCP_LOGE("资源数量已达上限(MCP_MAX_RESOURCES)，无法添加: %s", uri);
+    return false;
+  }
+  _resources.push_back(resource);
+  _version++;
+  return true;
+}
+
+bool McpResourceStore::remove(const String &uri) {
+  int index = find(uri.c_str(), uri.length());
+  if (index < 0) {
+    return false;
+  }
+  if (_resources[index].changed) {
+    _pendingChanges--;
+  }
+  _resources.erase(_resources.begin() + index);
+  rebuildIndex();
+  _scanFrom = 0;
+  _version++;
+  return true;
+}
+
+void McpResourceStore::clear() {
+  _resources.clear();
+  _index.clear();
+  _pendingChanges = 0;
+  _scanFrom = 0;
+  _version++;
+}
+
+bool McpResourceStore::update(size_t index, const char *text, size_t length) {
+  Resource &resource = _resources[index];
+  if (resource.revision > 0 && resource.text.length() == length && memcmp(resource.text.c_str(), text, length) == 0) {
+    return false;
+  }
+  resource.text = "";
+  resource.text.concat(text, length);
+  resource.revision++;
+  resource.updatedAt = millis();
+  if (resource.subscribed && !resource.changed) {
+    resource.changed = true;
+    _pendingChanges++;
+  }
+  return true;
+}
+
+int McpResourceStore::find(const char *uri, size_t length) const {
+  return _index.find(mcpHashBytes(uri, length), [&](size_t i) {
+    const String &candidate = _resources[i].uri;
+    return candidate.length() == length && memcmp(candidate.c_str(), uri, length) == 0;
+  });
+}
+
+bool McpResourceStore::setSubscribed(const char *uri, bool subscribed) {
+  int index = find(uri, strlen(uri));
+  if (index < 0) {
+    return false;
+  }
+  Resource &resource = _resources[index];
+  resource.subscribed = subscribed;
+  if (!subscribed && resource.changed) {
+    resource.changed = false;
+    _pendingChanges--;
+  }
+  return true;
+}
+
+void McpResourceStore::clearSubscriptions() {
+  for (size_t i = 0; i < _resources.size(); i++) {
+    _resources[i].subscribed = false;
+    _resources[i].changed = false;
+  }
+  _pendingChanges = 0;
+}
+
+// 从上次停下的位置继续找，变化频繁的资源不会让后面的资源一直得不到通知
+int McpResourceStore::takeChanged() {
+  if (_pendingChanges == 0) {
+    return -1;
+  }
+  size_t count = _resources.size();
+  for (size_t n = 0; n < count; n++) {
+    size_t i = (_scanFrom + n) % count;
+    if (_resources[i].changed) {
+      _resources[i].changed = false;
+      _pendingChanges--;
+      _scanFrom = (i + 1) % count;
+      return (int)i;
+    }
+  }
+  _pendingChanges = 0;
+  return -1;
+}
+
+void McpResourceStore::rebuildIndex() {
+  _index.clear();
+  for (size_t i = 0; i < _resources.size(); i++) {
+    _index.insert(_resources[i].uriHash, i);
+  }
+}
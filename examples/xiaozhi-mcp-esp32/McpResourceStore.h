@@ -0,0 +1,81 @@
+/**
+ * McpResourceStore.h
+ * 资源存储：应用写入的设备状态缓存，以MCP资源(resources/list、resources/read)的形式提供给客户端
+ * 客户端订阅的资源内容变化时记录待通知标记，由WebSocketMCP合并后发出notifications/resources/updated
+ */
+
+#ifndef MCP_RESOURCE_STORE_H
+#define MCP_RESOURCE_STORE_H
+
+#include <Arduino.h>
+#include <vector>
+#include "McpRegistry.h"
+
+// 资源数量上限：0表示不限(索引按需扩容)，大于0时资源索引为固定容量，存储一次性预留
+#ifndef MCP_MAX_RESOURCES
+#define MCP_MAX_RESOURCES 0
+#endif
+
+/**
+ * McpResourceStore
+ * 资源按URI哈希索引；内容保存为文本，写入时与当前内容比较，相同则不算变化
+ * 内容String在更新时复用已有容量，状态长度稳定后不再重新分配
+ * 不加锁，只能在处理请求的线程(loop()或网络任务)中访问
+ */
+class McpResourceStore {
+public:
+  struct Resource {
+    String uri;
+    uint32_t uriHash;
+    String name;
+    String description;
+    String mimeType;
+    String text;              // 当前内容
+    uint32_t revision;        // 内容每次变化时加一
+    unsigned long updatedAt;  // 最近一次变化的时间(millis())
+    bool subscribed;          // 本次连接的客户端已订阅
+    bool changed;             // 订阅后内容有变化，尚未通知
+  };
+
+  McpResourceStore();
+
+  // 声明资源，URI已存在时只更新名称、描述和类型(内容和订阅保留)
+  bool add(const String &uri, const String &name, const String &description, const String &mimeType);
+  bool remove(const String &uri);
+  void clear();
+
+  /**
+   * 写入资源内容
+   * @param index find()返回的下标
+   * @return 内容是否有变化(与当前内容相同时返回false)
+   */
+  bool update(size_t index, const char *text, size_t length);
+
+  // 按URI查找，未找到返回-1
+  int find(const char *uri, size_t length) const;
+  const Resource &at(size_t index) const { return _resources[index]; }
+  size_t size() const { return _resources.size(); }
+
+  // 设置订阅状态，资源不存在时返回false
+  bool setSubscribed(const char *uri, bool subscribed);
+  // 新连接或断开时清除全部订阅和待通知标记
+  void clearSubscriptions();
+  // 是否有待通知的变化
+  bool hasChanges() const { return _pendingChanges > 0; }
+  // 取出一个待通知的资源(清除其标记)，没有时返回-1
+  int takeChanged();
+
+  // 资源列表每次变化(声明新资源、移除、清空)时加一
+  uint32_t version() const { return _version; }
+
+private:
+  std::vector<Resource> _resources;
+  McpHashIndex<MCP_MAX_RESOURCES> _index;
+  size_t _pendingChanges;
+  size_t _scanFrom; // takeChanged()下一次开始查找的位置
+  uint32_t _version;
+
+  void rebuildIndex();
+};
+
+#endif // MCP_RESOURCE_STORE_H
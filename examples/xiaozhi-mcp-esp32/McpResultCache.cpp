@@ -0,0 +1,162 @@
+/**
+ * McpResultCache.cpp
+ * 工具结果缓存实现
+ */
+
+#include "McpResultCache.h"
+
+namespace {
+
+// 以ArduinoJson Writer接口接收序列化输出，边写边计算FNV-1a
+struct HashWriter {
+  uint32_t hash;
+  HashWriter() : hash(2166136261u) {}
+  size_t write(uint8_t c) {
+    hash = (hash ^ c) * 16777619u;
+    return 1;
+  }
+  size_t write(const uint8_t *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+      hash = (hash ^ data[i]) * 16777619u;
+    }
+    return length;
+  }
+};
+
+// 把序列化输出与保存的参数文本逐段比较，不生成中间字符串
+struct CompareWriter {
+  const String &text;
+  size_t offset;
+  bool equal;
+  explicit CompareWriter(const String &target) : text(target), offset(0), equal(true) {}
+  size_t write(uint8_t c) {
+    return write(&c, 1);
+  }
+  size_t write(const uint8_t *data, size_t length) {
+    if (equal && offset + length <= text.length() && memcmp(text.c_str() + offset, data, length) == 0) {
+      offset += length;
+    } else {
+      equal = false;
+    }
+    return length;
+  }
+};
+
+// 追加到String，超过上限后不再追加并记为溢出
+struct BoundedWriter {
+  String &text;
+  bool overflowed;
+  explicit BoundedWriter(String &target) : text(target), overflowed(false) {}
+  size_t write(uint8_t c) {
+    return write(&c, 1);
+  }
+  size_t write(const uint8_t *data, size_t length) {
+    if (overflowed || text.length() + length > MCP_RESULT_CACHE_MAX) {
+      overflowed = true;
+    } else {
+      text.concat((const char *)data, length);
+    }
+    return length;
+  }
+};
+
+} // namespace
+
+McpResultCache::McpResultCache() : _clock(0), _hits(0), _misses(0) {
+  for (size_t i = 0; i < MCP_RESULT_CACHE_ENTRIES; i++) {
+    _entries[i].used = false;
+  }
+}
+
+uint32_t McpResultCache::hashArguments(JsonObjectConst arguments) {
+  HashWriter writer;
+  serializeJson(arguments, writer);
+  return writer.hash;
+}
+
+bool McpResultCache::matches(const Entry &entry, uint32_t toolHash, uint32_t argsHash, JsonObjectConst arguments) {
+  if (!entry.used || entry.toolHash != toolHash || entry.argsHash != argsHash) {
+    return false;
+  }
+  // 哈希相同时再比较参数文本
+  CompareWriter compare(entry.arguments);
+  serializeJson(arguments, compare);
+  return compare.equal && compare.offset == entry.arguments.length();
+}
+
+const String *McpResultCache::find(uint32_t toolHash, uint32_t argsHash, JsonObjectConst arguments,
+                                   unsigned long now) {
+  for (size_t i = 0; i < MCP_RESULT_CACHE_ENTRIES; i++) {
+    Entry &entry = _entries[i];
+    if (!matches(entry, toolHash, argsHash, arguments)) {
+      continue;
+    }
+    // 按差值比较，millis()回绕后仍然正确
+    if ((long)(now - entry.expiresAt) >= 0) {
+      entry.used = false;
+      break;
+    }
+    entry.lastUsed = ++_clock;
+    _hits++;
+    return &entry.result;
+  }
+  _misses++;
+  return nullptr;
+}
+
+void McpResultCache::store(uint32_t toolHash, uint32_t argsHash, JsonObjectConst arguments, uint32_t ttl,
+                           unsigned long now, const char *result, size_t length) {
+  if (length > MCP_RESULT_CACHE_MAX) {
+    return;
+  }
+  // 优先复用同键条目，其次空闲条目，最后淘汰最久未使用的条目
+  Entry *target = nullptr;
+  for (size_t i = 0; i < MCP_RESULT_CACHE_ENTRIES; i++) {
+    Entry &entry = _entries[i];
+    if (matches(entry, toolHash, argsHash, arguments)) {
+      target = &entry;
+      break;
+    }
+    if (!target || (target->used && (!entry.used || entry.lastUsed < target->lastUsed))) {
+      target = &entry;
+    }
+  }
+  target->arguments = "";
+  BoundedWriter writer(target->arguments);
+  serializeJson(arguments, writer);
+  if (writer.overflowed) {
+    target->used = false;
+    return;
+  }
+  target->toolHash = toolHash;
+  target->argsHash = argsHash;
+  target->expiresAt = now + ttl;
+  target->lastUsed = ++_clock;
+  target->used = true;
+  target->result = "";
+  target->result.concat(result, length);
+}
+
+void McpResultCache::invalidate(uint32_t toolHash) {
+  for (size_t i = 0; i < MCP_RESULT_CACHE_ENTRIES; i++) {
+    if (_entries[i].toolHash == toolHash) {
+      _entries[i].used = false;
+    }
+  }
+}
+
+void McpResultCache::clear() {
+  for (size_t i = 0; i < MCP_RESULT_CACHE_ENTRIES; i++) {
+    _entries[i].used = false;
+  }
+}
+
+size_t McpResultCache::size() const {
+  size_t count = 0;
+  for (size_t i = 0; i < MCP_RESULT_CACHE_ENTRIES; i++) {
+    if (_entries[i].used) {
+      count++;
+    }
+  }
+  return count;
+}
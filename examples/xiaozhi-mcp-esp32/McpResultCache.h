@@ -0,0 +1,71 @@
+/**
+ * McpResultCache.h
+ * 幂等工具的结果缓存：按(工具, 参数)保存序列化后的tools/call结果，TTL内的相同调用直接返回缓存
+ * 条目数固定，满时淘汰最久未使用的条目
+ */
+
+#ifndef MCP_RESULT_CACHE_H
+#define MCP_RESULT_CACHE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// 缓存条目数
+#ifndef MCP_RESULT_CACHE_ENTRIES
+#define MCP_RESULT_CACHE_ENTRIES 8
+#endif
+
+// 单条缓存结果的最大字节数，更大的结果不缓存
+#ifndef MCP_RESULT_CACHE_MAX
+#define MCP_RESULT_CACHE_MAX 1024
+#endif
+
+/**
+ * McpResultCache
+ * 键为工具名哈希和参数哈希(参数按紧凑JSON计算FNV-1a)，值为响应中"result"部分的JSON文本
+ * 条目同时保存参数的紧凑JSON，哈希相同时再逐字节比较参数，哈希碰撞不会返回其他参数的结果
+ * 条目的String在替换时复用已有容量，稳定运行后不再重新分配
+ */
+class McpResultCache {
+public:
+  McpResultCache();
+
+  // 计算参数哈希(不生成中间字符串)
+  static uint32_t hashArguments(JsonObjectConst arguments);
+
+  // 查找未过期的结果，命中时返回缓存的文本并更新最近使用时间；计入命中/未命中次数
+  // argsHash为hashArguments(arguments)的值
+  const String *find(uint32_t toolHash, uint32_t argsHash, JsonObjectConst arguments, unsigned long now);
+  // 保存结果，ttl为有效期(毫秒)；参数的紧凑JSON超过MCP_RESULT_CACHE_MAX时不缓存
+  void store(uint32_t toolHash, uint32_t argsHash, JsonObjectConst arguments, uint32_t ttl, unsigned long now,
+             const char *result, size_t length);
+  // 使指定工具的全部缓存失效
+  void invalidate(uint32_t toolHash);
+  void clear();
+
+  uint32_t hits() const { return _hits; }
+  uint32_t misses() const { return _misses; }
+  // 当前有效(可能已过期但未被替换)的条目数
+  size_t size() const;
+
+private:
+  struct Entry {
+    uint32_t toolHash;
+    uint32_t argsHash;
+    unsigned long expiresAt;
+    uint32_t lastUsed;
+    bool used;
+    String arguments;  // 参数的紧凑JSON
+    String result;
+  };
+
+  // 条目的键与(工具, 参数)完全相同
+  static bool matches(const Entry &entry, uint32_t toolHash, uint32_t argsHash, JsonObjectConst arguments);
+
+  Entry _entries[MCP_RESULT_CACHE_ENTRIES];
+  uint32_t _clock;  // 每次访问递增，用于LRU
+  uint32_t _hits;
+  uint32_t _misses;
+};
+
+#endif // MCP_RESULT_CACHE_H
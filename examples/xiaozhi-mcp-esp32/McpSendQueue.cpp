@@ -0,0 +1,121 @@
+/**
+ * McpSendQueue.cpp
+ * 发送队列实现
+ */
+
+#include "McpSendQueue.h"
+
+McpMessageRing::McpMessageRing(uint8_t *storage, size_t capacity)
+    : _storage(storage), _capacity(capacity), _head(0), _used(0), _count(0),
+      _pendingLength(0), _pending(false), _pendingFailed(false), _highWater(0), _dropped(0) {}
+
+// 写入环形存储，跨越末尾时回绕
+void McpMessageRing::writeAt(size_t pos, const uint8_t *data, size_t length) {
+  pos %= _capacity;
+  size_t first = _capacity - pos;
+  if (first > length) {
+    first = length;
+  }
+  memcpy(_storage + pos, data, first);
+  memcpy(_storage, data + first, length - first);
+}
+
+void McpMessageRing::readAt(size_t pos, uint8_t *data, size_t length) const {
+  pos %= _capacity;
+  size_t first = _capacity - pos;
+  if (first > length) {
+    first = length;
+  }
+  memcpy(data, _storage + pos, first);
+  memcpy(data + first, _storage, length - first);
+}
+
+void McpMessageRing::beginMessage() {
+  _pending = true;
+  _pendingFailed = false;
+  _pendingLength = 0;
+}
+
+bool McpMessageRing::append(const uint8_t *data, size_t length) {
+  if (!_pending || _pendingFailed) {
+    return false;
+  }
+  if (_used + HEADER_SIZE + _pendingLength + length > _capacity) {
+    _pendingFailed = true;
+    return false;
+  }
+  // 长度头在提交时写入，内容紧跟在长度头之后
+  writeAt(_head + _used + HEADER_SIZE + _pendingLength, data, length);
+  _pendingLength += length;
+  return true;
+}
+
+bool McpMessageRing::commitMessage() {
+  if (!_pending) {
+    return false;
+  }
+  _pending = false;
+  if (_pendingFailed) {
+    _dropped++;
+    return false;
+  }
+  uint32_t length = (uint32_t)_pendingLength;
+  writeAt(_head + _used, (const uint8_t *)&length, HEADER_SIZE);
+  _used += HEADER_SIZE + _pendingLength;
+  _count++;
+  if (_used > _highWater) {
+    _highWater = _used;
+  }
+  return true;
+}
+
+void McpMessageRing::abortMessage() {
+  _pending = false;
+}
+
+size_t McpMessageRing::frontLength() const {
+  if (_count == 0) {
+    return 0;
+  }
+  uint32_t length;
+  readAt(_head, (uint8_t *)&length, HEADER_SIZE);
+  return length;
+}
+
+const uint8_t *McpMessageRing::frontData(size_t offset, size_t *contiguous) const {
+  size_t length = frontLength();
+  if (offset >= length) {
+    *contiguous = 0;
+    return nullptr;
+  }
+  size_t pos = (_head + HEADER_SIZE + offset) % _capacity;
+  size_t n = length - offset;
+  if (n > _capacity - pos) {
+    n = _capacity - pos;
+  }
+  *contiguous = n;
+  return _storage + pos;
+}
+
+void McpMessageRing::popFront() {
+  if (_count == 0) {
+    return;
+  }
+  size_t size = HEADER_SIZE + frontLength();
+  _head = (_head + size) % _capacity;
+  _used -= size;
+  _count--;
+  if (_count == 0 && !_pending) {
+    _head = 0;
+  }
+}
+
+void McpMessageRing::clear() {
+  _head = 0;
+  _used = 0;
+  _count = 0;
+  _pending = false;
+}
+
+McpSendQueue::McpSendQueue()
+    : _control(_controlStorage, sizeof(_controlStorage)), _bulk(_bulkStorage, sizeof(_bulkStorage)) {}
@@ -0,0 +1,107 @@
+/**
+ * McpSendQueue.h
+ * 发送队列：固定容量的环形缓冲区，断线或发送繁忙时暂存待发消息
+ * 分为控制通道(pong、initialize响应)和普通通道，控制通道优先发送
+ */
+
+#ifndef MCP_SEND_QUEUE_H
+#define MCP_SEND_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// 普通通道容量(字节)，工具结果等较大的消息放在这里
+#ifndef MCP_SEND_QUEUE_BYTES
+#define MCP_SEND_QUEUE_BYTES 4096
+#endif
+
+// 控制通道容量(字节)
+#ifndef MCP_CONTROL_QUEUE_BYTES
+#define MCP_CONTROL_QUEUE_BYTES 512
+#endif
+
+/**
+ * McpMessageRing
+ * 在调用方提供的存储上保存若干条完整消息，每条消息前有4字节长度头
+ * 消息可以分多次追加，提交后才对读取端可见；空间不足时整条消息被丢弃
+ */
+class McpMessageRing {
+public:
+  McpMessageRing(uint8_t *storage, size_t capacity);
+
+  // 开始追加一条新消息(上一条未提交的消息被放弃)
+  void beginMessage();
+  // 追加消息内容，空间不足时本条消息作废，返回false
+  bool append(const uint8_t *data, size_t length);
+  // 提交当前消息，返回是否成功入队(追加过程中空间不足则计为一次丢弃)
+  bool commitMessage();
+  // 放弃正在追加的消息
+  void abortMessage();
+
+  bool empty() const { return _count == 0; }
+  size_t count() const { return _count; }
+  // 队首消息长度
+  size_t frontLength() const;
+  // 队首消息从offset开始的一段连续数据，长度写入contiguous(环形回绕时需要分两段读取)
+  const uint8_t *frontData(size_t offset, size_t *contiguous) const;
+  // 移除队首消息
+  void popFront();
+  // 清空所有消息
+  void clear();
+
+  size_t capacity() const { return _capacity; }
+  size_t usedBytes() const { return _used; }
+  // 占用字节数的历史最高值
+  size_t highWater() const { return _highWater; }
+  // 因空间不足丢弃的消息数
+  uint32_t dropped() const { return _dropped; }
+
+private:
+  static const size_t HEADER_SIZE = 4;
+
+  void writeAt(size_t pos, const uint8_t *data, size_t length);
+  void readAt(size_t pos, uint8_t *data, size_t length) const;
+
+  uint8_t *_storage;
+  size_t _capacity;
+  size_t _head;          // 队首消息的长度头位置
+  size_t _used;          // 已提交消息占用的字节数
+  size_t _count;
+  size_t _pendingLength; // 正在追加的消息长度(不含长度头)
+  bool _pending;
+  bool _pendingFailed;
+  size_t _highWater;
+  uint32_t _dropped;
+};
+
+/**
+ * McpSendQueue
+ * 两个通道的存储都内嵌在对象中，不使用堆
+ */
+class McpSendQueue {
+public:
+  enum Lane {
+    LANE_CONTROL = 0, // 控制消息：pong、initialize响应，优先发送
+    LANE_BULK = 1     // 普通消息：工具结果、通知等
+  };
+
+  McpSendQueue();
+
+  McpMessageRing &lane(Lane lane) { return lane == LANE_CONTROL ? _control : _bulk; }
+  const McpMessageRing &lane(Lane lane) const { return lane == LANE_CONTROL ? _control : _bulk; }
+
+  bool empty() const { return _control.empty() && _bulk.empty(); }
+  // 下一条要发送的消息所在通道，控制通道优先
+  McpMessageRing &next() { return _control.empty() ? _bulk : _control; }
+
+  uint32_t dropped() const { return _control.dropped() + _bulk.dropped(); }
+
+private:
+  uint8_t _controlStorage[MCP_CONTROL_QUEUE_BYTES];
+  uint8_t _bulkStorage[MCP_SEND_QUEUE_BYTES];
+  McpMessageRing _control;
+  McpMessageRing _bulk;
+};
+
+#endif // MCP_SEND_QUEUE_H
@@ -0,0 +1,64 @@
+/**
+ * McpStats.cpp
+ * 耗时直方图实现
+ */
+
+#include "McpStats.h"
+
+size_t McpLatencyHistogram::bucketFor(uint32_t micros) {
+  if (micros == 0) {
+    return 0;
+  }
+  // 最高有效位的位置+1：1us -> 1，2~3us -> 2，4~7us -> 3 ...
+  size_t bucket = 32 - __builtin_clz(micros);
+  return bucket < MCP_STATS_BUCKETS ? bucket : MCP_STATS_BUCKETS - 1;
+}
+
+void McpLatencyHistogram::record(uint32_t micros) {
+  size_t bucket = bucketFor(micros);
+  if (_buckets[bucket] == UINT16_MAX) {
+    for (size_t i = 0; i < MCP_STATS_BUCKETS; i++) {
+      _buckets[i] >>= 1;
+    }
+  }
+  _buckets[bucket]++;
+  _count++;
+  _total += micros;
+  if (micros > _max) {
+    _max = micros;
+  }
+}
+
+void McpLatencyHistogram::reset() {
+  memset(_buckets, 0, sizeof(_buckets));
+  _count = 0;
+  _max = 0;
+  _total = 0;
+}
+
+uint32_t McpLatencyHistogram::percentile(uint8_t p) const {
+  // 桶计数可能被减半过，按桶内现有计数求百分位
+  uint32_t total = 0;
+  for (size_t i = 0; i < MCP_STATS_BUCKETS; i++) {
+    total += _buckets[i];
+  }
+  if (total == 0) {
+    return 0;
+  }
+  uint32_t target = (uint32_t)(((uint64_t)total * p + 99) / 100);
+  if (target == 0) {
+    target = 1;
+  }
+  uint32_t seen = 0;
+  for (size_t i = 0; i < MCP_STATS_BUCKETS; i++) {
+    seen += _buckets[i];
+    if (seen >= target) {
+      if (i == MCP_STATS_BUCKETS - 1) {
+        return _max;
+      }
+      uint32_t upper = i == 0 ? 0 : ((uint32_t)1 << i) - 1;
+      return upper < _max ? upper : _max;
+    }
+  }
+  return _max;
+}
@@ -0,0 +1,108 @@
+/**
+ * McpStats.h
+ * 运行统计：请求各阶段耗时、每个工具的调用次数/错误数/耗时分布、消息大小、堆内存低水位、重连次数
+ * 所有计数都是定长结构，记录时不分配内存
+ */
+
+#ifndef MCP_STATS_H
+#define MCP_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// 耗时直方图的桶数：第i个桶记录[2^(i-1), 2^i)微秒，最后一个桶收纳更长的耗时
+#ifndef MCP_STATS_BUCKETS
+#define MCP_STATS_BUCKETS 24
+#endif
+
+/**
+ * McpLatencyHistogram
+ * 按2的幂分桶的耗时直方图(微秒)，百分位为估算值，误差在2倍以内
+ * 桶计数为16位，任一桶将要溢出时所有桶减半，直方图随之偏向近期数据
+ */
+class McpLatencyHistogram {
+public:
+  McpLatencyHistogram() { reset(); }
+
+  void record(uint32_t micros);
+  void reset();
+
+  uint32_t count() const { return _count; }
+  uint32_t max() const { return _max; }
+  uint32_t average() const { return _count ? (uint32_t)(_total / _count) : 0; }
+  // 估算百分位(p取0~100)，返回所在桶的上界(不超过最大值)
+  uint32_t percentile(uint8_t p) const;
+
+private:
+  static size_t bucketFor(uint32_t micros);
+
+  uint16_t _buckets[MCP_STATS_BUCKETS];
+  uint32_t _count;
+  uint32_t _max;
+  uint64_t _total;
+};
+
+// 消息大小统计(字节)
+struct McpSizeStats {
+  uint32_t count;
+  uint64_t total;
+  uint32_t max;
+
+  McpSizeStats() : count(0), total(0), max(0) {}
+  void record(size_t size) {
+    count++;
+    total += size;
+    if (size > max) {
+      max = (uint32_t)size;
+    }
+  }
+  uint32_t average() const { return count ? (uint32_t)(total / count) : 0; }
+};
+
+// 单个工具的统计
+struct McpToolStats {
+  uint32_t calls;
+  uint32_t errors;
+  uint32_t cacheHits;          // 由结果缓存直接应答的次数(同时计入calls)
+  McpLatencyHistogram latency; // 工具回调耗时(异步工具为提交到返回结果的时间，缓存命中为查找缓存的时间)
+
+  McpToolStats() : calls(0), errors(0), cacheHits(0) {}
+  void record(uint32_t micros, bool error, bool cacheHit = false) {
+    calls++;
+    if (error) {
+      errors++;
+    }
+    if (cacheHit) {
+      cacheHits++;
+    }
+    latency.record(micros);
+  }
+};
+
+// 连接级统计
+struct McpServerStats {
+  uint32_t messages;            // 收到的JSON-RPC帧数
+  uint32_t parseErrors;         // 解析失败的帧数
+  McpLatencyHistogram parse;    // 请求帧解析耗时
+  McpLatencyHistogram handle;   // 一帧从收到到处理完(含工具执行和发送)的耗时
+  McpLatencyHistogram write;    // tools/call结果序列化并发送的耗时
+  McpSizeStats inbound;         // 收到的帧大小
+  McpSizeStats outbound;        // 发出的消息大小
+  uint32_t connects;            // 连接成功次数
+  uint32_t disconnects;         // 断开次数
+  uint32_t reconnectAttempts;   // 发起连接的次数(含失败)
+  McpLatencyHistogram reconnect; // 从断开(或begin())到WebSocket重新连上的时间(毫秒)
+  McpLatencyHistogram ready;    // 从断开(或begin())到客户端重新完成initialize、可以调用工具的时间(毫秒)
+  McpSizeStats encodedJson;     // MessagePack会话中转码前的JSON消息大小
+  McpSizeStats encoded;         // 转码后的MessagePack消息大小
+  McpLatencyHistogram encode;   // JSON转MessagePack的耗时
+  uint32_t minFreeHeap;         // 空闲堆低水位
+  uint32_t minMaxAllocHeap;     // 最大可分配块低水位
+
+  McpServerStats()
+      : messages(0), parseErrors(0), connects(0), disconnects(0), reconnectAttempts(0),
+        minFreeHeap(UINT32_MAX), minMaxAllocHeap(UINT32_MAX) {}
+};
+
+#endif // MCP_STATS_H
@@ -0,0 +1,182 @@
+/**
+ * McpToolArgs.cpp
+ * 参数schema生成和校验
+ */
+
+#include "McpToolArgs.h"
+#include "McpJsonWriter.h"
+#include "McpLog.h"
+
+static const char *kindName(McpArgKind kind) {
+  switch (kind) {
+    case MCP_ARG_BOOLEAN: return "boolean";
+    case MCP_ARG_INTEGER: return "integer";
+    case MCP_ARG_NUMBER: return "number";
+    case MCP_ARG_STRING: return "string";
+    case MCP_ARG_ARRAY: return "array";
+    case MCP_ARG_OBJECT: return "object";
+  }
+  return "null";
+}
+
+// 依次取出'|'分隔的可选值，返回false表示已取完
+static bool nextEnumValue(const char *&cursor, const char *&value, size_t &length) {
+  if (!cursor || !*cursor) {
+    return false;
+  }
+  value = cursor;
+  const char *end = strchr(cursor, '|');
+  length = end ? (size_t)(end - cursor) : strlen(cursor);
+  cursor = end ? end + 1 : cursor + length;
+  return true;
+}
+
+// 生成schema需要的文档容量：名称、说明和缺省文本是常量，文档中只保存指针；
+// 可选值是从'|'分隔的列表中截取的子串，需要复制到文档中
+static size_t argsSchemaCapacity(const McpArgSpec *specs, size_t count) {
+  // 根对象：type、properties、required
+  size_t capacity = JSON_OBJECT_SIZE(3) + JSON_OBJECT_SIZE(count) + JSON_ARRAY_SIZE(count);
+  for (size_t i = 0; i < count; i++) {
+    // 每个属性最多6个成员：type、description、minimum、maximum、enum、default
+    capacity += JSON_OBJECT_SIZE(6);
+    const char *cursor = specs[i].enumValues;
+    const char *value;
+    size_t length;
+    size_t values = 0;
+    while (nextEnumValue(cursor, value, length)) {
+      capacity += JSON_STRING_SIZE(length);
+      values++;
+    }
+    capacity += JSON_ARRAY_SIZE(values);
+  }
+  return capacity;
+}
+
+String mcpBuildArgsSchema(const McpArgSpec *specs, size_t count) {
+  // 只在注册时生成一次
+  DynamicJsonDocument doc(argsSchemaCapacity(specs, count));
+  doc["type"] = "object";
+  JsonObject properties = doc.createNestedObject("properties");
+  for (size_t i = 0; i < count; i++) {
+    const McpArgSpec &spec = specs[i];
+    JsonObject property = properties.createNestedObject(spec.name);
+    property["type"] = kindName(spec.kind);
+    if (spec.description && *spec.description) {
+      property["description"] = spec.description;
+    }
+    if (spec.hasMin) {
+      property["minimum"] = spec.min;
+    }
+    if (spec.hasMax) {
+      property["maximum"] = spec.max;
+    }
+    if (spec.enumValues) {
+      JsonArray values = property.createNestedArray("enum");
+      const char *cursor = spec.enumValues;
+      const char *value;
+      size_t length;
+      while (nextEnumValue(cursor, value, length)) {
+        values.add(String(value).substring(0, length));
+      }
+    }
+    if (!spec.required) {
+      if (spec.kind == MCP_ARG_STRING) {
+        if (spec.defaultText) {
+          property["default"] = spec.defaultText;
+        }
+      } else if (spec.kind == MCP_ARG_BOOLEAN) {
+        property["default"] = spec.defaultNumber != 0;
+      } else if (spec.kind == MCP_ARG_INTEGER) {
+        property["default"] = (long)spec.defaultNumber;
+      } else if (spec.kind == MCP_ARG_NUMBER) {
+        property["default"] = spec.defaultNumber;
+      }
+    }
+  }
+  JsonArray required = doc.createNestedArray("required");
+  for (size_t i = 0; i < count; i++) {
+    if (specs[i].required) {
+      required.add(specs[i].name);
+    }
+  }
+  // 内存不足时文档缺少部分成员，不能注册不完整的schema
+  if (doc.overflowed()) {
+    MCP_LOGE("参数schema生成失败：内存不足(%u字节)", (unsigned)doc.capacity());
+    return String();
+  }
+  String schema;
+  serializeJson(doc, schema);
+  return schema;
+}
+
+static bool matchesKind(JsonVariantConst value, McpArgKind kind) {
+  switch (kind) {
+    case MCP_ARG_BOOLEAN: return value.is<bool>();
+    case MCP_ARG_INTEGER: return value.is<long>() || value.is<unsigned long>();
+    case MCP_ARG_NUMBER: return value.is<double>();
+    case MCP_ARG_STRING: return value.is<const char *>();
+    case MCP_ARG_ARRAY: return value.is<JsonArrayConst>();
+    case MCP_ARG_OBJECT: return value.is<JsonObjectConst>();
+  }
+  return false;
+}
+
+// 写入{"error":"<before><name><after><detail>"}；参数名和可选值来自注册代码，可能含引号或反斜杠，需要转义
+static void printArgError(Print &error, const char *before, const char *name, const char *after,
+                          const char *detail = "") {
+  error.print("{\"error\":\"");
+  error.print(before);
+  mcpWriteJsonEscaped(error, name, strlen(name));
+  error.print(after);
+  mcpWriteJsonEscaped(error, detail, strlen(detail));
+  error.print("\"}");
+}
+
+bool mcpValidateArgs(const McpArgSpec *specs, size_t count, JsonObjectConst arguments, Print &error) {
+  for (size_t i = 0; i < count; i++) {
+    const McpArgSpec &spec = specs[i];
+    JsonVariantConst value = arguments[spec.name];
+    if (value.isNull()) {
+      if (spec.required) {
+        printArgError(error, "Missing required argument: ", spec.name, "");
+        return false;
+      }
+      continue;
+    }
+    if (!matchesKind(value, spec.kind)) {
+      printArgError(error, "Argument ", spec.name, " must be of type ", kindName(spec.kind));
+      return false;
+    }
+    if (spec.hasMin || spec.hasMax) {
+      double number = value.as<double>();
+      if ((spec.hasMin && number < spec.min) || (spec.hasMax && number > spec.max)) {
+        printArgError(error, "Argument ", spec.name, " out of range");
+        return false;
+      }
+    }
+    if (spec.enumValues) {
+      // 可选值也可以声明在数字、布尔参数上，这时按值的JSON文本比较
+      char number[32];
+      const char *text = number;
+      size_t textLength;
+      if (value.is<const char *>()) {
+        text = value.as<const char *>();
+        textLength = strlen(text);
+      } else {
+        textLength = serializeJson(value, number, sizeof(number));
+      }
+      const char *cursor = spec.enumValues;
+      const char *option;
+      size_t length;
+      bool found = false;
+      while (!found && nextEnumValue(cursor, option, length)) {
+        found = length == textLength && memcmp(option, text, length) == 0;
+      }
+      if (!found) {
+        printArgError(error, "Argument ", spec.name, " must be one of: ", spec.enumValues);
+        return false;
+      }
+    }
+  }
+  return true;
+}
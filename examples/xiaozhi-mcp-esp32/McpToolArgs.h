@@ -0,0 +1,202 @@
+/**
+ * McpToolArgs.h
+ * 类型化的工具参数：由参数描述生成inputSchema，在调用工具前按描述校验arguments并解码为C++类型
+ *
+ *   mcp.registerTool("set_light", "设置灯光",
+ *     mcpArgs(McpArg<const char *>("state", "开关").oneOf("on|off"),
+ *             McpArg<int>("brightness", "亮度").range(0, 100).optional(80)),
+ *     [](McpToolResult &result, const char *state, int brightness) { ... });
+ */
+
+#ifndef MCP_TOOL_ARGS_H
+#define MCP_TOOL_ARGS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <vector>
+#include <functional>
+#include <type_traits>
+#include "McpToolResult.h"
+
+// 参数的JSON类型
+enum McpArgKind {
+  MCP_ARG_BOOLEAN,
+  MCP_ARG_INTEGER,
+  MCP_ARG_NUMBER,
+  MCP_ARG_STRING,
+  MCP_ARG_ARRAY,
+  MCP_ARG_OBJECT
+};
+
+/**
+ * McpArgSpec
+ * 一个参数的描述，也是校验器使用的紧凑表项
+ * 名称、描述、枚举值只保存指针，应使用字符串字面量或在工具注册期间一直有效的字符串
+ */
+struct McpArgSpec {
+  const char *name;
+  const char *description;
+  McpArgKind kind;
+  bool required;
+  bool hasMin;
+  bool hasMax;
+  double min;
+  double max;
+  const char *enumValues;  // 以'|'分隔的可选值，仅用于字符串参数
+  double defaultNumber;    // 可选参数缺省时的值(布尔、整数、浮点)
+  const char *defaultText; // 可选参数缺省时的值(字符串)
+
+  McpArgSpec(const char *name, const char *description, McpArgKind kind)
+      : name(name), description(description), kind(kind), required(true), hasMin(false), hasMax(false),
+        min(0), max(0), enumValues(nullptr), defaultNumber(0), defaultText(nullptr) {}
+};
+
+// C++类型到参数类型的映射及解码；整数和浮点类型由主模板处理
+template<typename T>
+struct McpArgTraits {
+  static_assert(std::is_arithmetic<T>::value, "不支持的工具参数类型");
+  static const McpArgKind kind = std::is_integral<T>::value ? MCP_ARG_INTEGER : MCP_ARG_NUMBER;
+  static T decode(JsonVariantConst value, const McpArgSpec &spec) {
+    return value.isNull() ? (T)spec.defaultNumber : value.as<T>();
+  }
+};
+
+template<>
+struct McpArgTraits<bool> {
+  static const McpArgKind kind = MCP_ARG_BOOLEAN;
+  static bool decode(JsonVariantConst value, const McpArgSpec &spec) {
+    return value.isNull() ? spec.defaultNumber != 0 : value.as<bool>();
+  }
+};
+
+// 字符串直接指向请求帧，只在工具回调执行期间有效
+template<>
+struct McpArgTraits<const char *> {
+  static const McpArgKind kind = MCP_ARG_STRING;
+  static const char *decode(JsonVariantConst value, const McpArgSpec &spec) {
+    return value.isNull() ? spec.defaultText : value.as<const char *>();
+  }
+};
+
+template<>
+struct McpArgTraits<JsonArrayConst> {
+  static const McpArgKind kind = MCP_ARG_ARRAY;
+  static JsonArrayConst decode(JsonVariantConst value, const McpArgSpec &) { return value.as<JsonArrayConst>(); }
+};
+
+template<>
+struct McpArgTraits<JsonObjectConst> {
+  static const McpArgKind kind = MCP_ARG_OBJECT;
+  static JsonObjectConst decode(JsonVariantConst value, const McpArgSpec &) { return value.as<JsonObjectConst>(); }
+};
+
+/**
+ * McpArg
+ * 类型为T的参数，默认为必填
+ */
+template<typename T>
+class McpArg {
+public:
+  McpArg(const char *name, const char *description) : _spec(name, description, McpArgTraits<T>::kind) {}
+
+  // 数值参数的取值范围(闭区间)
+  McpArg &range(double min, double max) {
+    _spec.hasMin = _spec.hasMax = true;
+    _spec.min = min;
+    _spec.max = max;
+    return *this;
+  }
+  McpArg &minimum(double min) {
+    _spec.hasMin = true;
+    _spec.min = min;
+    return *this;
+  }
+  McpArg &maximum(double max) {
+    _spec.hasMax = true;
+    _spec.max = max;
+    return *this;
+  }
+  // 字符串参数的可选值，以'|'分隔，例如"on|off|blink"
+  McpArg &oneOf(const char *values) {
+    _spec.enumValues = values;
+    return *this;
+  }
+  // 设为可选参数，缺省时回调收到defaultValue
+  McpArg &optional(T defaultValue = T()) {
+    _spec.required = false;
+    setDefault(defaultValue);
+    return *this;
+  }
+
+  const McpArgSpec &spec() const { return _spec; }
+
+private:
+  template<typename U>
+  void setDefault(U value) { _spec.defaultNumber = (double)value; }
+  void setDefault(const char *value) { _spec.defaultText = value; }
+  void setDefault(JsonArrayConst) {}
+  void setDefault(JsonObjectConst) {}
+
+  McpArgSpec _spec;
+};
+
+// 一组参数描述，由mcpArgs()生成，Ts为各参数的C++类型
+template<typename... Ts>
+struct McpArgList {
+  std::vector<McpArgSpec> specs;
+};
+
+inline void mcpCollectArgs(std::vector<McpArgSpec> &) {}
+
+template<typename T, typename... Rest>
+void mcpCollectArgs(std::vector<McpArgSpec> &specs, const McpArg<T> &arg, const McpArg<Rest> &...rest) {
+  specs.push_back(arg.spec());
+  mcpCollectArgs(specs, rest...);
+}
+
+template<typename... Ts>
+McpArgList<Ts...> mcpArgs(const McpArg<Ts> &...args) {
+  McpArgList<Ts...> list;
+  list.specs.reserve(sizeof...(Ts));
+  mcpCollectArgs(list.specs, args...);
+  return list;
+}
+
+// 由参数描述生成inputSchema(JSON Schema对象)，内存不足时返回空字符串，注册随之失败
+String mcpBuildArgsSchema(const McpArgSpec *specs, size_t count);
+
+// 按参数描述校验arguments，不通过时把错误信息(JSON对象)写入error并返回false
+bool mcpValidateArgs(const McpArgSpec *specs, size_t count, JsonObjectConst arguments, Print &error);
+
+// 参数下标序列(C++11没有std::index_sequence)
+template<size_t... I>
+struct McpIndexSequence {};
+template<size_t N, size_t... I>
+struct McpMakeIndexSequence : McpMakeIndexSequence<N - 1, N - 1, I...> {};
+template<size_t... I>
+struct McpMakeIndexSequence<0, I...> {
+  typedef McpIndexSequence<I...> type;
+};
+
+// 解码各参数并调用回调：callback(result, 参数0, 参数1, ...)
+template<typename F, typename... Ts, size_t... I>
+void mcpInvokeWithArgs(F &callback, McpToolResult &result, JsonObjectConst arguments,
+                       const McpArgSpec *specs, const McpArgList<Ts...> *, McpIndexSequence<I...>) {
+  callback(result, McpArgTraits<Ts>::decode(arguments[specs[I].name], specs[I])...);
+}
+
+// 包装类型化回调：先按参数描述校验arguments，通过后解码并调用callback，不通过时写入错误
+template<typename... Ts, typename F>
+std::function<void(JsonObjectConst, McpToolResult &)> mcpTypedToolCallback(const McpArgList<Ts...> &args, F callback) {
+  std::vector<McpArgSpec> specs = args.specs;
+  return [specs, callback](JsonObjectConst arguments, McpToolResult &result) mutable {
+    if (!mcpValidateArgs(specs.data(), specs.size(), arguments, result)) {
+      result.setError();
+      return;
+    }
+    mcpInvokeWithArgs(callback, result, arguments, specs.data(), (const McpArgList<Ts...> *)nullptr,
+                      typename McpMakeIndexSequence<sizeof...(Ts)>::type());
+  };
+}
+
+#endif // MCP_TOOL_ARGS_H
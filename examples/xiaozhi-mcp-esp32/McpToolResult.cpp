@@ -0,0 +1,174 @@
+/**
+ * McpToolResult.cpp
+ * 工具结果写入器实现
+ */
+
+#include "McpToolResult.h"
+
+McpToolResult::McpToolResult(char *buffer, size_t capacity, bool pretty)
+    : _buffer(buffer), _capacity(buffer ? capacity : 0), _length(0), _error(false), _overflowed(false),
+      _pretty(pretty), _afterKey(false), _depth(0), _hasItems(0) {
+  if (_capacity > 0) {
+    _buffer[0] = '\0';
+  }
+}
+
+size_t McpToolResult::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t McpToolResult::write(const uint8_t *data, size_t length) {
+  // 保留一个字节给结尾的'\0'，text()始终是C字符串
+  size_t space = _capacity > _length ? _capacity - _length - 1 : 0;
+  if (length > space) {
+    _overflowed = true;
+    length = space;
+  }
+  if (length > 0) {
+    memcpy(_buffer + _length, data, length);
+    _length += length;
+    _buffer[_length] = '\0';
+  }
+  return length;
+}
+
+void McpToolResult::clear() {
+  _length = 0;
+  _error = false;
+  _overflowed = false;
+  _afterKey = false;
+  _depth = 0;
+  _hasItems = 0;
+  if (_capacity > 0) {
+    _buffer[0] = '\0';
+  }
+}
+
+void McpToolResult::newline() {
+  static const char SPACES[] = "                                ";
+  write('\n');
+  size_t indent = (size_t)_depth * 2;
+  while (indent > 0) {
+    size_t n = indent < sizeof(SPACES) - 1 ? indent : sizeof(SPACES) - 1;
+    write((const uint8_t *)SPACES, n);
+    indent -= n;
+  }
+}
+
+void McpToolResult::separate() {
+  if (_afterKey) {
+    _afterKey = false;
+    return;
+  }
+  if (_depth == 0) {
+    return;
+  }
+  uint32_t bit = (uint32_t)1 << (_depth - 1);
+  if (_hasItems & bit) {
+    write(',');
+  }
+  _hasItems |= bit;
+  if (_pretty) {
+    newline();
+  }
+}
+
+McpToolResult &McpToolResult::open(char bracket) {
+  separate();
+  write((uint8_t)bracket);
+  if (_depth >= MCP_RESULT_MAX_DEPTH) {
+    // 超过最大嵌套层数时不再能保证输出合法，按溢出处理
+    _overflowed = true;
+    return *this;
+  }
+  _depth++;
+  _hasItems &= ~((uint32_t)1 << (_depth - 1));
+  return *this;
+}
+
+McpToolResult &McpToolResult::close(char bracket) {
+  if (_depth > 0) {
+    bool hadItems = (_hasItems & ((uint32_t)1 << (_depth - 1))) != 0;
+    _depth--;
+    if (_pretty && hadItems) {
+      newline();
+    }
+  }
+  write((uint8_t)bracket);
+  return *this;
+}
+
+McpToolResult &McpToolResult::beginObject() {
+  return open('{');
+}
+
+McpToolResult &McpToolResult::endObject() {
+  return close('}');
+}
+
+McpToolResult &McpToolResult::beginArray() {
+  return open('[');
+}
+
+McpToolResult &McpToolResult::endArray() {
+  return close(']');
+}
+
+McpToolResult &McpToolResult::key(const char *name) {
+  separate();
+  mcpWriteJsonString(*this, name, strlen(name));
+  if (_pretty) {
+    write((const uint8_t *)": ", 2);
+  } else {
+    write(':');
+  }
+  _afterKey = true;
+  return *this;
+}
+
+McpToolResult &McpToolResult::value(const char *text) {
+  if (!text) {
+    return rawValue("null");
+  }
+  separate();
+  mcpWriteJsonString(*this, text, strlen(text));
+  return *this;
+}
+
+McpToolResult &McpToolResult::value(bool flag) {
+  return rawValue(flag ? "true" : "false");
+}
+
+McpToolResult &McpToolResult::value(long number) {
+  separate();
+  char digits[24];
+  int n = snprintf(digits, sizeof(digits), "%ld", number);
+  write((const uint8_t *)digits, n);
+  return *this;
+}
+
+McpToolResult &McpToolResult::value(unsigned long number) {
+  separate();
+  char digits[24];
+  int n = snprintf(digits, sizeof(digits), "%lu", number);
+  write((const uint8_t *)digits, n);
+  return *this;
+}
+
+McpToolResult &McpToolResult::value(double number) {
+  // JSON没有NaN和无穷大
+  if (isnan(number) || isinf(number)) {
+    return rawValue("null");
+  }
+  separate();
+  char digits[32];
+  int n = snprintf(digits, sizeof(digits), "%.9g", number);
+  write((const uint8_t *)digits, n);
+  return *this;
+}
+
+McpToolResult &McpToolResult::rawValue(const char *json) {
+  separate();
+  write((const uint8_t *)json, strlen(json));
+  return *this;
+}
@@ -0,0 +1,88 @@
+/**
+ * McpToolResult.h
+ * 工具结果写入器：工具把结果文本print/printf到调用方提供的缓冲区，不构造String和ToolResponse
+ * 也可以用beginObject()/add()等结构化写入，按服务端设置一次性输出紧凑或缩进格式的JSON
+ * 固定内存模式下缓冲区来自McpArena，一次工具调用不产生堆分配
+ */
+
+#ifndef MCP_TOOL_RESULT_H
+#define MCP_TOOL_RESULT_H
+
+#include <Arduino.h>
+#include "McpJsonWriter.h"
+
+// 结构化写入支持的最大嵌套层数
+#ifndef MCP_RESULT_MAX_DEPTH
+#define MCP_RESULT_MAX_DEPTH 16
+#endif
+
+/**
+ * McpToolResult
+ * 作为一个text内容项返回；缓冲区写满后多出的内容被丢弃并标记为溢出，
+ * 服务端对溢出的结果返回错误，不会发出被截断的JSON
+ *
+ *   result.beginObject().add("success", true).add("brightness", 80)
+ *         .key("devices").beginArray().value("light.a").value("light.b").endArray()
+ *         .endObject();
+ */
+class McpToolResult : public Print {
+public:
+  // pretty为true时结构化写入的JSON带换行和两个空格的缩进
+  McpToolResult(char *buffer, size_t capacity, bool pretty = false);
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *data, size_t length) override;
+  using Print::write;
+
+  // 标记本次调用出错(isError为true)，内容照常返回
+  void setError(bool error = true) { _error = error; }
+  bool isError() const { return _error; }
+
+  const char *text() const { return _buffer ? _buffer : ""; }
+  size_t length() const { return _length; }
+  // 是否有内容因缓冲区不足被丢弃
+  bool overflowed() const { return _overflowed; }
+  // 清空已写入的内容和错误标记
+  void clear();
+
+  // 结构化写入：逗号、冒号和缩进由写入器处理
+  McpToolResult &beginObject();
+  McpToolResult &endObject();
+  McpToolResult &beginArray();
+  McpToolResult &endArray();
+  // 对象中的键，后面紧跟一个值
+  McpToolResult &key(const char *name);
+  // 值(对象中跟在key()之后，数组中直接写)；字符串会被转义，nullptr写为null
+  McpToolResult &value(const char *text);
+  McpToolResult &value(const String &text) { return value(text.c_str()); }
+  McpToolResult &value(bool flag);
+  McpToolResult &value(int number) { return value((long)number); }
+  McpToolResult &value(unsigned int number) { return value((unsigned long)number); }
+  McpToolResult &value(long number);
+  McpToolResult &value(unsigned long number);
+  McpToolResult &value(double number);
+  // 原样写入一个已是合法JSON的值
+  McpToolResult &rawValue(const char *json);
+  // key(name).value(v)
+  template<typename T>
+  McpToolResult &add(const char *name, const T &v) { return key(name).value(v); }
+
+private:
+  // 写值之前的逗号、换行和缩进
+  void separate();
+  void newline();
+  McpToolResult &open(char bracket);
+  McpToolResult &close(char bracket);
+
+  char *_buffer;
+  size_t _capacity;
+  size_t _length;
+  bool _error;
+  bool _overflowed;
+  bool _pretty;
+  bool _afterKey;        // 刚写完键，下一个值不需要分隔符
+  uint8_t _depth;
+  uint32_t _hasItems;    // 第i位表示第i层容器中已写过元素
+};
+
+#endif // MCP_TOOL_RESULT_H
@@ -0,0 +1,176 @@
+/**
+ * McpWorkerPool.cpp
+ * 工作线程池实现
+ */
+
+#include "McpWorkerPool.h"
+
+#if MCP_WORKERS_FREERTOS
+
+McpWorkerPool::McpWorkerPool() : _started(false), _queueDepth(0), _queue(nullptr), _exited(nullptr), _workers(0) {}
+
+McpWorkerPool::~McpWorkerPool() {
+  stop();
+}
+
+void McpWorkerPool::stop() {
+  if (!_started) {
+    return;
+  }
+  _started = false;
+  // 每个工作任务收到一个空指针后退出；空指针排在已提交的任务之后，队列中的任务先执行完
+  Job *stop = nullptr;
+  for (size_t i = 0; i < _workers; i++) {
+    xQueueSend(_queue, &stop, portMAX_DELAY);
+  }
+  for (size_t i = 0; i < _workers; i++) {
+    xSemaphoreTake(_exited, portMAX_DELAY);
+  }
+  vSemaphoreDelete(_exited);
+  _exited = nullptr;
+  vQueueDelete(_queue);
+  _queue = nullptr;
+  _workers = 0;
+}
+
+bool McpWorkerPool::begin(size_t workers, size_t queueDepth, uint32_t stackSize, int priority) {
+  if (_started) {
+    return true;
+  }
+  // 队列中只保存Job指针，任务对象本身在堆上
+  _queue = xQueueCreate(queueDepth, sizeof(Job *));
+  _exited = xSemaphoreCreateCounting(workers > 0 ? workers : 1, 0);
+  if (!_queue || !_exited) {
+    if (_queue) {
+      vQueueDelete(_queue);
+      _queue = nullptr;
+    }
+    if (_exited) {
+      vSemaphoreDelete(_exited);
+      _exited = nullptr;
+    }
+    return false;
+  }
+  _queueDepth = queueDepth;
+  for (size_t i = 0; i < workers; i++) {
+    if (xTaskCreatePinnedToCore(taskEntry, "mcp_worker", stackSize, this, priority, nullptr, tskNO_AFFINITY) != pdPASS) {
+      break;
+    }
+    _workers++;
+  }
+  // 至少有一个工作任务即可继续使用
+  if (_workers == 0) {
+    vSemaphoreDelete(_exited);
+    _exited = nullptr;
+    vQueueDelete(_queue);
+    _queue = nullptr;
+    return false;
+  }
+  _started = true;
+  return true;
+}
+
+bool McpWorkerPool::submit(Job job) {
+  if (!_started) {
+    return false;
+  }
+  Job *item = new Job(std::move(job));
+  if (xQueueSend(_queue, &item, 0) != pdTRUE) {
+    delete item;
+    return false;
+  }
+  return true;
+}
+
+void McpWorkerPool::taskEntry(void *arg) {
+  McpWorkerPool *pool = static_cast<McpWorkerPool *>(arg);
+  for (;;) {
+    Job *item = nullptr;
+    if (xQueueReceive(pool->_queue, &item, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+    if (!item) {
+      break;
+    }
+    (*item)();
+    delete item;
+  }
+  // 释放信号量之后析构函数可能立即销毁线程池，此后不能再访问pool
+  xSemaphoreGive(pool->_exited);
+  vTaskDelete(nullptr);
+}
+
+#else
+
+McpWorkerPool::McpWorkerPool() : _started(false), _queueDepth(0), _stopping(false) {}
+
+McpWorkerPool::~McpWorkerPool() {
+  stop();
+}
+
+void McpWorkerPool::stop() {
+  if (!_started) {
+    return;
+  }
+  _started = false;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _ready.notify_all();
+  for (size_t i = 0; i < _threads.size(); i++) {
+    _threads[i].join();
+  }
+  _threads.clear();
+}
+
+bool McpWorkerPool::begin(size_t workers, size_t queueDepth, uint32_t stackSize, int priority) {
+  if (_started) {
+    return true;
+  }
+  // 主机线程使用默认栈大小和调度优先级
+  (void)stackSize;
+  (void)priority;
+  _queueDepth = queueDepth;
+  _stopping = false;
+  for (size_t i = 0; i < workers; i++) {
+    _threads.push_back(std::thread(&McpWorkerPool::threadEntry, this));
+  }
+  _started = true;
+  return true;
+}
+
+bool McpWorkerPool::submit(Job job) {
+  if (!_started) {
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_jobs.size() >= _queueDepth) {
+      return false;
+    }
+    _jobs.push_back(std::move(job));
+  }
+  _ready.notify_one();
+  return true;
+}
+
+void McpWorkerPool::threadEntry() {
+  for (;;) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      while (!_stopping && _jobs.empty()) {
+        _ready.wait(lock);
+      }
+      if (_jobs.empty()) {
+        return;
+      }
+      job = std::move(_jobs.front());
+      _jobs.pop_front();
+    }
+    job();
+  }
+}
+
+#endif
@@ -0,0 +1,74 @@
+/**
+ * McpWorkerPool.h
+ * 异步工具使用的工作线程池
+ * ESP32上基于FreeRTOS任务和队列，其他平台(主机测试)基于std::thread
+ */
+
+#ifndef MCP_WORKER_POOL_H
+#define MCP_WORKER_POOL_H
+
+#include <Arduino.h>
+#include <functional>
+
+#if defined(ARDUINO_ARCH_ESP32) && !defined(MCP_HOST_BUILD)
+#define MCP_WORKERS_FREERTOS 1
+#else
+#define MCP_WORKERS_FREERTOS 0
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
+
+class McpWorkerPool {
+public:
+  typedef std::function<void()> Job;
+
+  McpWorkerPool();
+  // 等同于stop()
+  ~McpWorkerPool();
+
+  /**
+   * 启动工作线程
+   * @param workers 工作线程数量
+   * @param queueDepth 等待执行的任务队列深度
+   * @param stackSize 每个工作任务的栈大小(字节，仅FreeRTOS)
+   * @param priority 工作任务优先级(仅FreeRTOS)
+   * @return 是否启动成功
+   */
+  bool begin(size_t workers, size_t queueDepth, uint32_t stackSize, int priority);
+
+  /**
+   * 提交任务，队列已满或尚未启动时返回false
+   */
+  bool submit(Job job);
+
+  /**
+   * 停止并等待全部工作线程退出：已提交的任务先执行完，之后submit()返回false
+   * 不能在工作线程中调用，也不能与submit()并发调用
+   */
+  void stop();
+
+  bool started() const { return _started; }
+
+private:
+  bool _started;
+  size_t _queueDepth;
+
+#if MCP_WORKERS_FREERTOS
+  static void taskEntry(void *arg);
+  QueueHandle_t _queue;
+  SemaphoreHandle_t _exited; // 每个工作任务退出前释放一次
+  size_t _workers;
+#else
+  void threadEntry();
+  std::vector<std::thread> _threads;
+  std::mutex _mutex;
+  std::condition_variable _ready;
+  std::deque<Job> _jobs;
+  bool _stopping;
+#endif
+};
+
+#endif // MCP_WORKER_POOL_H
@@ -5,26 +5,194 @@
  */
 
 #include "WebSocketMCP.h"
-
-// 静态实例指针初始化
-WebSocketMCP* WebSocketMCP::instance = nullptr;
+#include <atomic>
 
 // 静态常量定义
 const int WebSocketMCP::INITIAL_BACKOFF;
 const int WebSocketMCP::MAX_BACKOFF;
 const int WebSocketMCP::PING_INTERVAL;
 const int WebSocketMCP::DISCONNECT_TIMEOUT;
+const uint8_t WebSocketMCP::DISCONNECT_PONG_COUNT;
+
+// JSON-RPC方法分发表，方法名哈希在编译期计算
+const WebSocketMCP::MethodEntry WebSocketMCP::METHOD_TABLE[] = {
+  {"ping",       mcpHashStr("ping"),       &WebSocketMCP::handlePing},
+  {"initialize", mcpHashStr("initialize"), &WebSocketMCP::handleInitialize},
+  {"tools/list", mcpHashStr("tools/list"), &WebSocketMCP::handleToolsList},
+  {"tools/call", mcpHashStr("tools/call"), &WebSocketMCP::handleToolsCall},
+  {"resources/list",        mcpHashStr("resources/list"),        &WebSocketMCP::handleResourcesList},
+  {"resources/read",        mcpHashStr("resources/read"),        &WebSocketMCP::handleResourcesRead},
+  {"resources/subscribe",   mcpHashStr("resources/subscribe"),   &WebSocketMCP::handleResourcesSubscribe},
+  {"resources/unsubscribe", mcpHashStr("resources/unsubscribe"), &WebSocketMCP::handleResourcesUnsubscribe},
+};
+
+// 异步调用的共享状态，由ToolResponder的所有副本共同持有
+struct WebSocketMCP::ToolResponder::State {
+  WebSocketMCP *owner;
+  String idJson;
+  String progressTokenJson; // 请求中的progressToken(JSON文本)，没有时为空
+  String toolName;
+  uint32_t startMicros;
+  std::atomic<bool> done;
+
+  State() : owner(nullptr), startMicros(0), done(false) {}
+  ~State() {
+    // 工具没有应答就丢弃了responder(或任务未能执行)，补发错误响应
+    if (!done.exchange(true)) {
+      owner->postAsyncResult(*this, ToolResponse("{\"error\":\"Tool did not respond\"}", true));
+    }
+  }
+};
+
+bool WebSocketMCP::ToolResponder::respond(const ToolResponse &response) const {
+  if (!_state || _state->done.exchange(true)) {
+    return false;
+  }
+  _state->owner->postAsyncResult(*_state, response);
+  return true;
+}
+
+bool WebSocketMCP::ToolResponder::progress(double progress, double total, const char *message) const {
+  if (!_state || _state->progressTokenJson.length() == 0 || _state->done.load()) {
+    return false;
+  }
+  _state->owner->postAsyncProgress(*_state, progress, total, message);
+  return true;
+}
+
+// 流式工具：响应头在第一项内容(或回调结束)时才写出，在此之前可以先发进度通知
+McpJsonWriter &WebSocketMCP::ToolStream::open() {
+  if (!_opened) {
+    _opened = true;
+    _owner._streamOpen = !_owner._inBatch;
+    McpJsonWriter &out = _owner.beginMessage();
+    out.raw("{\"jsonrpc\":\"2.0\",\"id\":").value(_id).raw(",\"result\":{\"content\":[");
+    return out;
+  }
+  return _owner._writer;
+}
+
+bool WebSocketMCP::ToolStream::progress(double progress, double total, const char *message) {
+  // 响应已开始写出(或在批量响应数组中)时不能再插入其他消息
+  if (_progressToken.isNull() || _opened || _owner._inBatch) {
+    return false;
+  }
+  McpJsonWriter &out = _owner.beginMessage(McpSendQueue::LANE_BULK, false);
+  out.raw("{\"jsonrpc\":\"2.0\",\"method\":\"notifications/progress\",\"params\":{\"progressToken\":").value(_progressToken);
+  writeProgress(out, progress, total, message);
+  return _owner.endMessage();
+}
+
+WebSocketMCP::ToolStream &WebSocketMCP::ToolStream::beginText() {
+  endText();
+  McpJsonWriter &out = open();
+  if (_items++ > 0) {
+    out.raw(",");
+  }
+  out.raw("{\"type\":\"text\",\"text\":\"");
+  _inText = true;
+  return *this;
+}
+
+WebSocketMCP::ToolStream &WebSocketMCP::ToolStream::endText() {
+  if (_inText) {
+    _owner._writer.raw("\"}");
+    _inText = false;
+  }
+  return *this;
+}
+
+WebSocketMCP::ToolStream &WebSocketMCP::ToolStream::text(const char *text) {
+  return this->text(text, strlen(text));
+}
+
+WebSocketMCP::ToolStream &WebSocketMCP::ToolStream::text(const char *text, size_t length) {
+  beginText();
+  write((const uint8_t *)text, length);
+  return endText();
+}
+
+size_t WebSocketMCP::ToolStream::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+// 文本直接转义写入帧缓冲区
+size_t WebSocketMCP::ToolStream::write(const uint8_t *data, size_t length) {
+  if (!_inText) {
+    beginText();
+  }
+  mcpWriteJsonEscaped(_owner._writer, (const char *)data, length);
+  return length;
+}
+
+void WebSocketMCP::ToolStream::flush() {
+  if (_opened && !_owner._inBatch) {
+    _owner._writer.flushPending();
+  }
+}
+
+void WebSocketMCP::ToolStream::finish() {
+  endText();
+  McpJsonWriter &out = open();
+  out.raw("],\"isError\":").boolean(_error).raw("}}");
+  _owner.endMessage();
+  _owner._streamOpen = false;
+  _owner.sendDeferred();
+}
+
+WebSocketMCP::WebSocketMCP() : _writer(*this), connected(false), lastReconnectAttempt(0), 
+                              currentBackoff(INITIAL_BACKOFF), reconnectAttempt(0),
+                              _ownedRegistry(new ToolRegistry()), _registry(_ownedRegistry.get()) {
+  connectionCallback = nullptr;
+
+  // 建立方法名索引
+  for (size_t i = 0; i < sizeof(METHOD_TABLE) / sizeof(METHOD_TABLE[0]); i++) {
+    _methodIndex.insert(METHOD_TABLE[i].hash, i);
+  }
+}
 
-WebSocketMCP::WebSocketMCP() : connected(false), lastReconnectAttempt(0), 
-                              currentBackoff(INITIAL_BACKOFF), reconnectAttempt(0) {
-  // 设置静态实例指针
-  instance = this;
+WebSocketMCP::WebSocketMCP(ToolRegistry &registry) : _writer(*this), connected(false), lastReconnectAttempt(0),
+                                                    currentBackoff(INITIAL_BACKOFF), reconnectAttempt(0),
+                                                    _registry(&registry) {
   connectionCallback = nullptr;
+
+  for (size_t i = 0; i < sizeof(METHOD_TABLE) / sizeof(METHOD_TABLE[0]); i++) {
+    _methodIndex.insert(METHOD_TABLE[i].hash, i);
+  }
+}
+
+WebSocketMCP::~WebSocketMCP() {
+  // 网络任务停止后不再提交新的异步任务；工作线程退出前提交的结果和进度只入队，不再发送
+  _netTask.stop();
+  _workers.stop();
+}
+
+WebSocketMCP::ToolRegistry::ToolRegistry() {
+#if MCP_MAX_TOOLS > 0
+  // 固定容量模式：一次性预留工具存储，注册时不再扩容
+  _tools.reserve(MCP_MAX_TOOLS);
+#endif
 }
 
 bool WebSocketMCP::begin(const char *mcpEndpoint,  ConnectionCallback connCb) {
   // 保存回调函数
   connectionCallback = connCb;
+
+#if MCP_FIXED_MEMORY
+  // 请求处理用到的内存在这里一次性分配，之后每个请求复用
+  if (!_requestDoc) {
+    _requestDoc.reset(new DynamicJsonDocument(MCP_REQUEST_DOC_SIZE));
+  }
+  if (_requestDoc->capacity() == 0 || !_arena.begin(MCP_ARENA_SIZE)) {
+    MCP_LOGE("固定内存模式分配失败");
+    return false;
+  }
+  if (_binaryEnabled && !_transcodeDoc) {
+    _transcodeDoc.reset(new DynamicJsonDocument(MCP_MSGPACK_DOC_SIZE));
+    _binaryText.reserve(MCP_MSGPACK_MAX_MESSAGE);
+    _binaryFrame.reserve(WEBSOCKETS_MAX_HEADER_SIZE + MCP_MSGPACK_MAX_MESSAGE);
+  }
+#endif
   
   // 解析WebSocket URL
   String url = String(mcpEndpoint);
@@ -66,55 +234,74 @@ bool WebSocketMCP::begin(const char *mcpEndpoint,  ConnectionCallback connCb) {
     webSocket.begin(host.c_str(), port, path.c_str());
   }
   
-  // 设置断开连接超时为60秒
-  // webSocket.setReconnectInterval(DISCONNECT_TIMEOUT);
-  webSocket.enableHeartbeat(PING_INTERVAL, PING_INTERVAL, DISCONNECT_TIMEOUT);
+  // 重连时间由loop()按退避计划控制，库在每次被允许时立即发起连接
+  webSocket.setReconnectInterval(0);
+  webSocket.enableHeartbeat(PING_INTERVAL, PING_INTERVAL, DISCONNECT_PONG_COUNT);
+  resetReconnectParams();
+  _nextReconnectAt = millis();
+  _disconnectedAt = millis();
+  _timingReconnect = true;
   
-  // 注册事件回调
-  webSocket.onEvent(webSocketEvent);
+  // 注册事件回调，事件按实例分发(多个实例可以同时连接不同的端点)
+  webSocket.onEvent([this](WStype_t type, uint8_t *payload, size_t length) {
+    handleWebSocketEvent(type, payload, length);
+  });
   
-  Serial.println("[WebSocketMCP] 正在连接WebSocket服务器: " + url);
+  MCP_LOGI("正在连接WebSocket服务器: %s", url);
   return true;
 }
 
-void WebSocketMCP::webSocketEvent(WStype_t type, uint8_t *payload, size_t length) {
-  // 确保实例存在
-  if (!instance) {
-    return;
-  }
-  
+void WebSocketMCP::handleWebSocketEvent(WStype_t type, uint8_t *payload, size_t length) {
   switch (type) {
     case WStype_DISCONNECTED:
-      if (instance->connected) {
-        instance->connected = false;
-        Serial.println("[WebSocketMCP] WebSocket连接已断开");
-        if (instance->connectionCallback) {
-          instance->connectionCallback(false);
+      if (connected) {
+        connected = false;
+        _clientInitialized = false;
+        _binarySession = false;
+        // 订阅只对本次连接有效
+        _resources.clearSubscriptions();
+        _stats.disconnects++;
+        // pong和initialize响应只对原连接有意义，重连后不再发送
+        _sendQueue.lane(McpSendQueue::LANE_CONTROL).clear();
+        _connectAttempt = false;
+        _disconnectedAt = millis();
+        _timingReconnect = true;
+        MCP_LOGI("WebSocket连接已断开");
+        scheduleReconnect();
+        if (connectionCallback) {
+          notifyConnection(false);
         }
       }
       break;
       
     case WStype_CONNECTED:
       {
-        instance->connected = true;
-        instance->resetReconnectParams();
-        Serial.println("[WebSocketMCP] WebSocket已连接");
-        if (instance->connectionCallback) {
-          instance->connectionCallback(true);
+        connected = true;
+        _connectAttempt = false;
+        _stats.connects++;
+        if (_timingReconnect) {
+          _stats.reconnect.record(millis() - _disconnectedAt);
+        }
+        resetReconnectParams();
+        MCP_LOGI("WebSocket已连接");
+        if (connectionCallback) {
+          notifyConnection(true);
         }
       }
       break;
       
     case WStype_TEXT:
-      {
-        // 接收到WebSocket消息，处理JSON-RPC请求
-        String message = String((char *)payload);
-        instance->handleJsonRpcMessage(message);
-      }
+      // 接收到WebSocket消息，直接在接收缓冲区上处理JSON-RPC请求，不再拷贝成String
+      handleJsonRpcMessage((char *)payload, length);
       break;
       
     case WStype_BIN:
-      Serial.println("[WebSocketMCP] 收到二进制数据，长度: " + String(length));
+      if (_binaryEnabled) {
+        // MessagePack编码的JSON-RPC消息
+        handleJsonRpcMessage((char *)payload, length, true);
+      } else {
+        MCP_LOGD("收到二进制数据，长度: %u", length);
+      }
       break;
       
     case WStype_ERROR:
@@ -123,36 +310,339 @@ void WebSocketMCP::webSocketEvent(WStype_t type, uint8_t *payload, size_t length
     case WStype_FRAGMENT:
     case WStype_FRAGMENT_FIN:
       break;
+
+    case WStype_PING:
+    case WStype_PONG:
+      // 心跳由WebSocket库应答和计时
+      break;
   }
 }
 
 bool WebSocketMCP::sendMessage(const String &message) {
-  if (!connected) {
-    Serial.println("[WebSocketMCP] 未连接到WebSocket服务器，无法发送消息");
+  // 批量响应或流式工具的响应正在写出时不能插入其他数据帧，等它发完再发
+  if (_inBatch || _streamOpen) {
+    if (_deferredBytes + message.length() > MCP_SEND_QUEUE_BYTES) {
+      MCP_LOGW("响应写出期间暂存的消息过多，丢弃消息: %u字节", message.length());
+      return false;
+    }
+    _deferred.push_back(message);
+    _deferredBytes += message.length();
+    MCP_LOGD("响应写出中，消息暂存: %s", message);
+    return true;
+  }
+  // 发送文本消息到WebSocket服务器(相当于stdin)，直接发送原缓冲区，不再拷贝
+  if (canSendDirect(McpSendQueue::LANE_BULK) &&
+      sendWholeMessage((const uint8_t *)message.c_str(), message.length())) {
+    _stats.outbound.record(message.length());
+    MCP_LOGD("发送消息: %s", message);
+    return true;
+  }
+  McpMessageRing &ring = _sendQueue.lane(McpSendQueue::LANE_BULK);
+  ring.beginMessage();
+  ring.append((const uint8_t *)message.c_str(), message.length());
+  if (!ring.commitMessage()) {
+    MCP_LOGW("发送队列已满，丢弃消息: %u字节", message.length());
     return false;
   }
-  // 发送文本消息到WebSocket服务器(相当于stdin)
-  Serial.println("[WebSocketMCP] 发送消息: " + message);
-  String msg = message;
-  webSocket.sendTXT(msg);
+  MCP_LOGD("消息已加入发送队列: %s", message);
   return true;
 }
 
+// 发出响应写出期间暂存的消息
+void WebSocketMCP::sendDeferred() {
+  if (_deferred.empty()) {
+    return;
+  }
+  std::vector<String> deferred;
+  deferred.swap(_deferred);
+  _deferredBytes = 0;
+  for (const String &message : deferred) {
+    sendMessage(message);
+  }
+  // 保留容量，下次暂存时不再分配
+  deferred.clear();
+  deferred.swap(_deferred);
+}
+
+WebSocketMCP::SendQueueStats WebSocketMCP::getSendQueueStats() const {
+  const McpMessageRing &control = _sendQueue.lane(McpSendQueue::LANE_CONTROL);
+  const McpMessageRing &bulk = _sendQueue.lane(McpSendQueue::LANE_BULK);
+  SendQueueStats stats;
+  stats.queuedMessages = control.count() + bulk.count();
+  stats.queuedBytes = control.usedBytes() + bulk.usedBytes();
+  stats.controlHighWater = control.highWater();
+  stats.bulkHighWater = bulk.highWater();
+  stats.dropped = _sendQueue.dropped();
+  return stats;
+}
+
+const McpToolStats *WebSocketMCP::getToolStats(const String &name) const {
+  return _registry->getToolStats(name);
+}
+
+const McpToolStats *WebSocketMCP::ToolRegistry::getToolStats(const String &name) const {
+  int index = findTool(name.c_str(), name.length());
+  return index >= 0 ? &_tools[index].stats : nullptr;
+}
+
+// 追加 "name":{"count":..,"p50":..,"p99":..,"max":..}
+static void appendHistogram(String &json, const char *name, const McpLatencyHistogram &h) {
+  char buf[160];
+  snprintf(buf, sizeof(buf), "\"%s\":{\"count\":%lu,\"avg\":%lu,\"p50\":%lu,\"p99\":%lu,\"max\":%lu}", name,
+           (unsigned long)h.count(), (unsigned long)h.average(), (unsigned long)h.percentile(50),
+           (unsigned long)h.percentile(99), (unsigned long)h.max());
+  json += buf;
+}
+
+static void appendSizes(String &json, const char *name, const McpSizeStats &sizes) {
+  char buf[96];
+  snprintf(buf, sizeof(buf), "\"%s\":{\"count\":%lu,\"avg\":%lu,\"max\":%lu}", name,
+           (unsigned long)sizes.count, (unsigned long)sizes.average(), (unsigned long)sizes.max);
+  json += buf;
+}
+
+String WebSocketMCP::getStatsJson() const {
+  char buf[256];
+  const std::vector<Tool> &tools = _registry->_tools;
+  const McpResultCache &cache = _registry->_resultCache;
+  String json;
+  json.reserve(512 + tools.size() * 96);
+
+  SendQueueStats queue = getSendQueueStats();
+  snprintf(buf, sizeof(buf),
+           "{\"uptime_ms\":%lu,\"messages\":%lu,\"parse_errors\":%lu,\"connects\":%lu,\"disconnects\":%lu,"
+           "\"heap\":{\"free\":%lu,\"min_free\":%lu,\"max_alloc\":%lu,\"min_max_alloc\":%lu},",
+           (unsigned long)millis(), (unsigned long)_stats.messages, (unsigned long)_stats.parseErrors,
+           (unsigned long)_stats.connects, (unsigned long)_stats.disconnects,
+           (unsigned long)ESP.getFreeHeap(), (unsigned long)_stats.minFreeHeap,
+           (unsigned long)ESP.getMaxAllocHeap(), (unsigned long)_stats.minMaxAllocHeap);
+  json += buf;
+  appendSizes(json, "in_bytes", _stats.inbound);
+  json += ",";
+  appendSizes(json, "out_bytes", _stats.outbound);
+  json += ",";
+  appendHistogram(json, "parse_us", _stats.parse);
+  json += ",";
+  appendHistogram(json, "handle_us", _stats.handle);
+  json += ",";
+  appendHistogram(json, "write_us", _stats.write);
+  snprintf(buf, sizeof(buf), ",\"reconnect_attempts\":%lu,", (unsigned long)_stats.reconnectAttempts);
+  json += buf;
+  appendHistogram(json, "reconnect_ms", _stats.reconnect);
+  json += ",";
+  appendHistogram(json, "ready_ms", _stats.ready);
+  if (_binaryEnabled) {
+    json += ",\"msgpack\":{";
+    appendSizes(json, "json_bytes", _stats.encodedJson);
+    json += ",";
+    appendSizes(json, "bytes", _stats.encoded);
+    json += ",";
+    appendHistogram(json, "encode_us", _stats.encode);
+    json += "}";
+  }
+  snprintf(buf, sizeof(buf), ",\"send_queue\":{\"queued\":%lu,\"control_high_water\":%lu,\"bulk_high_water\":%lu,\"dropped\":%lu}",
+           (unsigned long)queue.queuedMessages, (unsigned long)queue.controlHighWater,
+           (unsigned long)queue.bulkHighWater, (unsigned long)queue.dropped);
+  json += buf;
+  snprintf(buf, sizeof(buf), ",\"result_cache\":{\"hits\":%lu,\"misses\":%lu,\"entries\":%lu}",
+           (unsigned long)cache.hits(), (unsigned long)cache.misses(), (unsigned long)cache.size());
+  json += buf;
+  if (_arena.capacity() > 0) {
+    snprintf(buf, sizeof(buf), ",\"arena\":{\"capacity\":%lu,\"high_water\":%lu,\"failures\":%lu}",
+             (unsigned long)_arena.capacity(), (unsigned long)_arena.highWater(), (unsigned long)_arena.failures());
+    json += buf;
+  }
+
+  // 只列出被调用过的工具
+  json += ",\"tools\":{";
+  bool first = true;
+  for (size_t i = 0; i < tools.size(); i++) {
+    const McpToolStats &tool = tools[i].stats;
+    if (tool.calls == 0) {
+      continue;
+    }
+    if (!first) {
+      json += ",";
+    }
+    first = false;
+    json += "\"";
+    json += escapeJsonString(tools[i].nameText());
+    snprintf(buf, sizeof(buf),
+             "\":{\"calls\":%lu,\"errors\":%lu,\"cache_hits\":%lu,\"p50_us\":%lu,\"p99_us\":%lu,\"max_us\":%lu}",
+             (unsigned long)tool.calls, (unsigned long)tool.errors, (unsigned long)tool.cacheHits,
+             (unsigned long)tool.latency.percentile(50),
+             (unsigned long)tool.latency.percentile(99), (unsigned long)tool.latency.max());
+    json += buf;
+  }
+  json += "}}";
+  return json;
+}
+
+// 更新堆内存低水位
+void WebSocketMCP::sampleHeap(bool includeLargestBlock) {
+  uint32_t freeHeap = ESP.getFreeHeap();
+  if (freeHeap < _stats.minFreeHeap) {
+    _stats.minFreeHeap = freeHeap;
+  }
+  if (includeLargestBlock) {
+    uint32_t maxAlloc = ESP.getMaxAllocHeap();
+    if (maxAlloc < _stats.minMaxAllocHeap) {
+      _stats.minMaxAllocHeap = maxAlloc;
+    }
+  }
+}
+
+void WebSocketMCP::ToolRegistry::recordToolCall(int index, uint32_t nameHash, uint32_t micros, bool error,
+                                                bool cacheHit) {
+  if (index >= 0 && (size_t)index < _tools.size() && _tools[index].nameHash == nameHash) {
+    _tools[index].stats.record(micros, error, cacheHit);
+  }
+}
+
 void WebSocketMCP::loop() {
+  if (_taskMode) {
+    // 网络由网络任务处理，这里只在调用线程上执行连接状态回调
+    uint8_t state;
+    while (_connectionEvents.pop(state)) {
+      if (connectionCallback) {
+        connectionCallback(state != 0);
+      }
+    }
+    return;
+  }
+  service();
+}
+
+void WebSocketMCP::notifyConnection(bool state) {
+  if (!connectionCallback) {
+    return;
+  }
+  if (_taskMode) {
+    if (!_connectionEvents.push(state ? 1 : 0)) {
+      MCP_LOGW("连接状态事件队列已满，丢弃一次状态变化");
+    }
+    return;
+  }
+  connectionCallback(state);
+}
+
+bool WebSocketMCP::beginTask(const char *mcpEndpoint, ConnectionCallback connCb) {
+  if (_netTask.started()) {
+    return false;
+  }
+  if (!_ownedRegistry) {
+    // 其他实例会在自己的线程中访问同一个注册表
+    MCP_LOGE("使用共享工具注册表的实例不能以网络任务模式运行");
+    return false;
+  }
+  if (!begin(mcpEndpoint, connCb)) {
+    return false;
+  }
+  _taskMode = true;
+  if (!_netTask.begin([this]() { networkTaskStep(); }, MCP_NET_TASK_STACK, MCP_NET_TASK_PRIORITY,
+                      MCP_NET_TASK_CORE)) {
+    MCP_LOGE("网络任务创建失败，改为在loop()中轮询");
+    _taskMode = false;
+  }
+  return true;
+}
+
+bool WebSocketMCP::post(Command command) {
+  // 网络任务自己提交的操作直接执行：排队要等本轮结束，队列满时还会卡住自己
+  if (!_taskMode || _netTask.isCurrent()) {
+    command(*this);
+    return true;
+  }
+  if (!_commands.push(command)) {
+    MCP_LOGW("网络任务操作队列已满");
+    return false;
+  }
+  _netTask.wake();
+  return true;
+}
+
+void WebSocketMCP::networkTaskStep() {
+  Command command;
+  while (_commands.pop(command)) {
+    command(*this);
+  }
+  service();
+
+  // 发送预算用完后还有排队的消息、或已有待发送的结果时，只让出一下就继续
+  uint32_t waitMs = MCP_NET_SLICE_MS;
+  if (hasPendingWork()) {
+    waitMs = 1;
+  } else if (!connected && !_connectAttempt) {
+    // 断线期间没有套接字可等，睡到下一次重连(或被post()、异步结果唤醒)
+    long untilReconnect = (long)(_nextReconnectAt - millis());
+    waitMs = untilReconnect <= 1 ? 1 : (untilReconnect < 1000 ? (uint32_t)untilReconnect : 1000);
+  }
+  if (waitMs > 1 && connected && webSocket.waitReadable(waitMs)) {
+    return;
+  }
+  _netTask.wait(waitMs);
+}
+
+bool WebSocketMCP::hasPendingWork() {
+  if (!_commands.empty() || (connected && !_sendQueue.empty())) {
+    return true;
+  }
+  std::lock_guard<std::mutex> lock(_asyncMutex);
+  return !_asyncResults.empty();
+}
+
+void WebSocketMCP::service() {
+  _sentThisLoop = 0;
+  
+  // 断线期间只在退避时间到达后才让WebSocket库发起连接；连接发起后持续处理直到连上或失败
+  bool serviceSocket = connected || _connectAttempt;
+  if (!serviceSocket && (long)(millis() - _nextReconnectAt) >= 0) {
+    _connectAttempt = true;
+    reconnectAttempt++;
+    lastReconnectAttempt = millis();
+    _stats.reconnectAttempts++;
+    serviceSocket = true;
+  }
+  
   // 处理WebSocket连接
-  webSocket.loop();
+  if (serviceSocket) {
+    webSocket.loop();
+  }
+  
+  // 先发出排队中的消息，保持发送顺序
+  flushSendQueue();
+  
+  // 每秒采样一次堆内存(最大可分配块需要遍历空闲链表，不在每条消息后采样)
+  if (_lastHeapSample == 0 || millis() - _lastHeapSample >= 1000) {
+    _lastHeapSample = millis();
+    sampleHeap(true);
+  }
   
   // 检查是否需要重连
   if (!connected) {
     handleReconnect();
   }
   
+  // 发送工作线程已完成的异步工具结果
+  sendAsyncResults();
+  
+  // 工具列表有变化时通知客户端重新获取(多次注册合并为一次通知)
+  if (connected && _clientInitialized && _toolsVersion != _registry->version()) {
+    _toolsVersion = _registry->version();
+    sendMessage("{\"jsonrpc\":\"2.0\",\"method\":\"notifications/tools/list_changed\"}");
+  }
+  
+  // 资源列表和已订阅资源的变化通知
+  if (connected && _clientInitialized) {
+    sendResourceNotifications();
+  }
+  
   // 处理可能的ping超时
   if (connected && lastPingTime > 0) {
     unsigned long now = millis();
     // 如果超过2分钟没收到ping，可能连接已经断开
     if (now - lastPingTime > 120000) {
-      Serial.println("[WebSocketMCP] Ping超时，重置连接");
+      MCP_LOGW("Ping超时，重置连接");
       disconnect();
     }
   }
@@ -166,23 +656,35 @@ void WebSocketMCP::disconnect() {
   if (connected) {
     webSocket.disconnect();
     connected = false;
+    _clientInitialized = false;
+    _sendQueue.lane(McpSendQueue::LANE_CONTROL).clear();
     lastPingTime = 0;
   }
 }
 
+void WebSocketMCP::setLogLevel(int level, McpLog::Callback logCb) {
+  McpLog::setLevel(level);
+  McpLog::setCallback(logCb);
+}
+
 void WebSocketMCP::handleReconnect() {
-  // WebSocket库已经有自动重连功能，这里主要是处理重连状态的日志和通知
-  unsigned long now = millis();
-  if (!connected && (now - lastReconnectAttempt > currentBackoff || lastReconnectAttempt == 0)) {
-    reconnectAttempt++;
-    lastReconnectAttempt = now;
-    
-    // 计算下一次重连的等待时间(指数退避)
-    currentBackoff = min(currentBackoff * 2, MAX_BACKOFF);
-    
-    Serial.println("[WebSocketMCP] 正在尝试重新连接(尝试次数: " + String(reconnectAttempt) + 
-        ", 下次等待时间: " + String(currentBackoff / 1000.0, 2) + "秒)");
+  // TCP已连上时WebSocket握手还在进行，继续等待
+  if (!_connectAttempt || webSocket.transportConnected()) {
+    return;
   }
+  // 本次连接失败(无法连接或握手被拒绝)，安排下一次
+  _connectAttempt = false;
+  MCP_LOGW("连接失败(尝试次数: %d)", reconnectAttempt);
+  scheduleReconnect();
+}
+
+// 去相关抖动退避：下一次等待在[INITIAL_BACKOFF, 上一次等待*3]中随机选取，不超过MAX_BACKOFF
+// 服务端重启时各设备的重连时间被打散，不会同时涌入；ESP32上random()取自硬件随机数发生器
+void WebSocketMCP::scheduleReconnect() {
+  long upper = min((long)currentBackoff * 3, (long)MAX_BACKOFF);
+  currentBackoff = (int)random(INITIAL_BACKOFF, upper + 1);
+  _nextReconnectAt = millis() + currentBackoff;
+  MCP_LOGI("%.2f秒后重新连接", currentBackoff / 1000.0);
 }
 
 void WebSocketMCP::resetReconnectParams() {
@@ -191,266 +693,1336 @@ void WebSocketMCP::resetReconnectParams() {
   lastReconnectAttempt = 0;
 }
 
-// 新增处理JSON-RPC消息的方法
-void WebSocketMCP::handleJsonRpcMessage(const String &message) {
-  DynamicJsonDocument doc(1024);
-  DeserializationError error = deserializeJson(doc, message);
-  
-  if (error) {
-    Serial.println("[WebSocketMCP] 解析JSON失败: " + String(error.c_str()));
-    return;
+static const char *skipJsonSpace(const char *p, const char *end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+    p++;
   }
-  
-  // 检查是否是ping请求
-  if (doc.containsKey("method") && doc["method"] == "ping") {
-    // 记录最后一次ping时间
-    lastPingTime = millis();
-    
-    // 构造pong响应 - 使用原始id进行回应，不做修改
-    String id = doc["id"].as<String>();
-    Serial.println("[WebSocketMCP] 收到ping请求: " + id);
-
-    String response = "{\"jsonrpc\":\"2.0\",\"id\":" + id + ",\"result\":{}}";
-    sendMessage(response);
-
-    Serial.println("[WebSocketMCP] 响应ping请求: " + id);
-  }
-  // 处理初始化请求
-  else if (doc.containsKey("method") && doc["method"] == "initialize") {
-    String id = doc["id"].as<String>();
-    
-    String serverName = "ESP-HA"; 
-
-    // 发送初始化响应
-    String response = "{\"jsonrpc\":\"2.0\",\"id\":" + id + 
-      ",\"result\":{\"protocolVersion\":\"2024-11-05\",\"capabilities\":{\"experimental\":{},\"prompts\":{\"listChanged\":false},\"resources\":{\"subscribe\":false,\"listChanged\":false},\"tools\":{\"listChanged\":false}},\"serverInfo\":{\"name\":\"" + serverName + "\",\"version\":\"1.0.0\"}}}";
-    
-    sendMessage(response);
-    Serial.println("[WebSocketMCP] 响应initialize请求");
-    
-    // 发送initialized通知
-    sendMessage("{\"jsonrpc\":\"2.0\",\"method\":\"notifications/initialized\"}");
-  }
-  // 处理tools/list请求
-  else if (doc.containsKey("method") && doc["method"] == "tools/list") {
-    String id = doc["id"].as<String>();
-    
-    // 这里可以根据实际情况定制工具列表
-    String response = "{\"jsonrpc\":\"2.0\",\"id\":" + id + 
-      ",\"result\":{\"tools\":[";
-    
-    // 从已注册工具列表生成工具信息
-    if (_tools.size() > 0) {
-      for (size_t i = 0; i < _tools.size(); i++) {
-        if (i > 0) {
-          response += ",";
-        }
-        response += "{\"name\":\"" + _tools[i].name + "\",";
-        response += "\"description\":\"" + _tools[i].description + "\",";
-        response += "\"inputSchema\":" + _tools[i].inputSchema + "}";
+  return p;
+}
+
+// 跳过一个字符串(p指向开头的引号)，返回结束引号之后的位置，没有结束时返回nullptr
+static const char *skipJsonString(const char *p, const char *end) {
+  for (p++; p < end; p++) {
+    if (*p == '\\') {
+      p++;
+    } else if (*p == '"') {
+      return p + 1;
+    }
+  }
+  return nullptr;
+}
+
+// 跳过一个值，返回其后的位置(对象、数组按括号配对跳过)
+static const char *skipJsonValue(const char *p, const char *end) {
+  int depth = 0;
+  while (p < end) {
+    char c = *p;
+    if (c == '"') {
+      p = skipJsonString(p, end);
+      if (!p || depth == 0) {
+        return p;
       }
+      continue;
     }
-    
-    response += "]}}";
-    
-    sendMessage(response);
-    Serial.println("[WebSocketMCP] 响应tools/list请求，共" + String(_tools.size()) + "个工具");
-  }
-  // 处理tools/call请求
-  else if (doc.containsKey("method") && doc["method"] == "tools/call") {
-    int id = doc["id"].as<int>();
-    String toolName = doc["params"]["name"].as<String>();
-    JsonObject arguments = doc["params"]["arguments"].as<JsonObject>();
-    
-    Serial.println("[WebSocketMCP] 收到工具调用请求: " + toolName);
-    
-    // 查找工具
-    bool toolFound = false;
-    ToolResponse toolResponse;
-    
-    for (size_t i = 0; i < _tools.size(); i++) {
-      if (_tools[i].name == toolName) {
-        toolFound = true;
-        // 调用工具回调，传入参数并获取结果
-        if (_tools[i].callback) {
-          String argumentsJson;
-          serializeJson(arguments, argumentsJson);
-          
-          // 调用回调并获取结构化结果
-          toolResponse = _tools[i].callback(argumentsJson);
-        } else {
-          toolResponse = ToolResponse("{\"error\":\"Tool callback not registered\"}", true);
-        }
-        break;
+    if (c == '{' || c == '[') {
+      depth++;
+    } else if (c == '}' || c == ']') {
+      if (depth == 0) {
+        return p;
+      }
+      if (--depth == 0) {
+        return p + 1;
       }
+    } else if (c == ',' && depth == 0) {
+      return p;
     }
-    
-    if (!toolFound) {
-      toolResponse = ToolResponse("{\"error\":\"Tool not found: " + toolName + "\"}", true);
+    p++;
+  }
+  return nullptr;
+}
+
+// 解析前取出顶层"id"的原文(数字或字符串)，写入out并返回长度，取不到时返回0
+// 零拷贝解析会原地改写payload，解析失败后无法再从中读取id；id通常紧跟在"jsonrpc"之后，只需扫描开头几十字节
+static size_t peekRequestId(const char *json, size_t length, char *out, size_t capacity) {
+  const char *end = json + length;
+  const char *p = skipJsonSpace(json, end);
+  if (p >= end || *p != '{') {
+    return 0;
+  }
+  p++;
+  for (;;) {
+    p = skipJsonSpace(p, end);
+    if (p >= end || *p != '"') {
+      return 0;
     }
-    
-    // 构造响应
-    DynamicJsonDocument responseDoc(2048);
-    responseDoc["jsonrpc"] = "2.0";
-    responseDoc["id"] = id;
-    
-    JsonObject result = responseDoc.createNestedObject("result");
-    
-    JsonArray content = result.createNestedArray("content");
-    for (const auto& item : toolResponse.content) {
-      JsonObject contentItem = content.createNestedObject();
-      contentItem["type"] = item.type;
-      contentItem["text"] = item.text;
+    const char *key = p;
+    p = skipJsonString(p, end);
+    if (!p) {
+      return 0;
     }
-
-    result["isError"] = toolResponse.isError;
-    
-    String response;
-    serializeJson(responseDoc, response);
-    
-    sendMessage(response);
-    Serial.println("[WebSocketMCP] 工具调用完成: " + toolName + (toolResponse.isError ? " (出错)" : ""));
+    bool isId = p - key == 4 && memcmp(key, "\"id\"", 4) == 0;
+    p = skipJsonSpace(p, end);
+    if (p >= end || *p != ':') {
+      return 0;
+    }
+    const char *value = skipJsonSpace(p + 1, end);
+    p = skipJsonValue(value, end);
+    if (!p) {
+      return 0;
+    }
+    if (isId) {
+      size_t n = p - value;
+      while (n > 0 && (value[n - 1] == ' ' || value[n - 1] == '\t' || value[n - 1] == '\n' || value[n - 1] == '\r')) {
+        n--;
+      }
+      if (n == 0 || n >= capacity || !(*value == '"' || *value == '-' || (*value >= '0' && *value <= '9'))) {
+        return 0;
+      }
+      memcpy(out, value, n);
+      out[n] = '\0';
+      return n;
+    }
+    p = skipJsonSpace(p, end);
+    if (p >= end || *p != ',') {
+      return 0;
+    }
+    p++;
   }
 }
 
-// 转义JSON字符串中的特殊字符
-String WebSocketMCP::escapeJsonString(const String &input) {
-  String result = "";
-  for (size_t i = 0; i < input.length(); i++) {
-    char c = input[i];
-    if (c == '\"' || c == '\\' || c == '/' || 
-        c == '\b' || c == '\f' || c == '\n' || 
-        c == '\r' || c == '\t') {
-      if (c == '\"') result += "\\\"";
-      else if (c == '\\') result += "\\\\";
-      else if (c == '/') result += "\\/";
-      else if (c == '\b') result += "\\b";
-      else if (c == '\f') result += "\\f";
-      else if (c == '\n') result += "\\n";
-      else if (c == '\r') result += "\\r";
-      else if (c == '\t') result += "\\t";
+// 新增处理JSON-RPC消息的方法
+void WebSocketMCP::handleJsonRpcMessage(char *payload, size_t length, bool binary) {
+  uint32_t start = micros();
+  _stats.messages++;
+  _stats.inbound.record(length);
+  
+  // 请求超出解析文档容量时按原id回复错误，id要在解析改写payload之前取出
+  char idJson[48];
+  size_t idLength = binary ? 0 : peekRequestId(payload, length, idJson, sizeof(idJson));
+
+  // 以可写char*输入时ArduinoJson使用零拷贝模式，字符串直接指向payload
+#if MCP_FIXED_MEMORY
+  // 复用begin()中分配的文档，deserializeJson会先清空它
+  JsonDocument &doc = *_requestDoc;
+#else
+  // 文档只存节点，批量请求较大时按帧长度放大
+  DynamicJsonDocument doc(length > 512 ? length * 2 : 1024);
+#endif
+  DeserializationError error = binary ? deserializeMsgPack(doc, payload, length) : deserializeJson(doc, payload, length);
+  _stats.parse.record(micros() - start);
+  
+  if (error) {
+    _stats.parseErrors++;
+    MCP_LOGE("解析%s失败: %s", binary ? "MessagePack" : "JSON", error.c_str());
+    // 请求本身合法但放不下(固定内存模式下超过MCP_REQUEST_DOC_SIZE)时回复内部错误，客户端不必等到超时；
+    // 无法解析的消息按JSON-RPC规定以null为id回复解析错误
+    if (error == DeserializationError::NoMemory || error == DeserializationError::TooDeep) {
+      sendError(idLength > 0 ? idJson : "null", -32603, "Request too large");
     } else {
-      result += c;
+      sendError("null", -32700, "Parse error");
     }
+    return;
   }
-  return result;
-}
 
-// 添加工具注册方法 - 带回调函数版
-bool WebSocketMCP::registerTool(const String &name, const String &description, 
-                              const String &inputSchema, ToolCallback callback) {
-  // 检查工具是否已存在
-  for (size_t i = 0; i < _tools.size(); i++) {
-    if (_tools[i].name == name) {
-      // 如果工具存在，可以选择更新回调
-      _tools[i].callback = callback;
-      Serial.println("[WebSocketMCP] 更新工具回调: " + name);
-      return true;
-    }
+  _inboundBinary = binary;
+  if (doc.is<JsonArrayConst>()) {
+    handleBatch(doc.as<JsonArrayConst>());
+  } else {
+    dispatchRequest(doc.as<JsonVariantConst>());
+  }
+  _inboundBinary = false;
+
+  // 发送initialized通知
+  if (_initializedPending) {
+    _initializedPending = false;
+    beginMessage(McpSendQueue::LANE_CONTROL, false).raw("{\"jsonrpc\":\"2.0\",\"method\":\"notifications/initialized\"}");
+    endMessage();
   }
   
-  // 创建新工具并添加到列表
-  Tool newTool;
-  newTool.name = name;
-  newTool.description = description;
-  newTool.inputSchema = inputSchema;
-  newTool.callback = callback;
-  
-  _tools.push_back(newTool);
-  Serial.println("[WebSocketMCP] 成功注册工具: " + name);
-  return true;
+  _arena.reset();
+  _stats.handle.record(micros() - start);
+  sampleHeap(false);
 }
 
-// 添加简化的工具注册方法
-bool WebSocketMCP::registerSimpleTool(const String &name, const String &description, 
-                                    const String &paramName, const String &paramDesc, 
-                                    const String &paramType, ToolCallback callback) {
-  // 构建简单的inputSchema
-  String inputSchema = "{\"type\":\"object\",\"properties\":{\"" + 
-                      paramName + "\":{\"type\":\"" + paramType + 
-                      "\",\"description\":\"" + paramDesc + 
-                      "\"}},\"required\":[\"" + paramName + "\"]}";
-                      
-  return registerTool(name, description, inputSchema, callback);
-}
+void WebSocketMCP::dispatchRequest(JsonVariantConst message) {
+  // 不是对象的消息或批量项按JSON-RPC规定以null为id回复无效请求
+  if (!message.is<JsonObjectConst>()) {
+    sendError("null", -32600, "Invalid Request");
+    return;
+  }
+  JsonObjectConst request = message.as<JsonObjectConst>();
+  const char *method = request["method"];
+  if (!method) {
+    // 对端发来的响应(带result或error)不是请求，不回复
+    if (!request.containsKey("result") && !request.containsKey("error")) {
+      sendError(request["id"], -32600, "Invalid Request");
+    }
+    return;
+  }
 
-// 卸载工具
-bool WebSocketMCP::unregisterTool(const String &name) {
-  for (size_t i = 0; i < _tools.size(); i++) {
-    if (_tools[i].name == name) {
-      _tools.erase(_tools.begin() + i);
-      Serial.println("[WebSocketMCP] 已卸载工具: " + name);
-      return true;
+  // 按方法名哈希查表分发
+  size_t methodLength = strlen(method);
+  int index = _methodIndex.find(mcpHashBytes(method, methodLength), [&](size_t i) {
+    return strcmp(METHOD_TABLE[i].name, method) == 0;
+  });
+  if (index < 0) {
+    // 通知(没有id)不回复，包括未处理的notifications/*
+    if (!request["id"].isNull()) {
+      MCP_LOGW("未知方法: %s", method);
+      sendError(request["id"], -32601, "Method not found");
     }
+    return;
   }
-  Serial.println("[WebSocketMCP] 工具 " + name + " 不存在，无法卸载");
-  return false;
+  (this->*METHOD_TABLE[index].handler)(request);
 }
 
-// 获取工具数量
-size_t WebSocketMCP::getToolCount() {
-  return _tools.size();
+// 批量请求：逐项分发，响应依次写入同一个数组，最后作为一条消息发出
+// 异步工具的结果完成后单独发送，不在数组中
+void WebSocketMCP::handleBatch(JsonArrayConst batch) {
+  if (batch.size() == 0) {
+    MCP_LOGW("收到空的批量请求，忽略");
+    return;
+  }
+  MCP_LOGD("收到批量请求，共%u项", batch.size());
+
+  _inBatch = true;
+  _batchResponses = 0;
+  for (JsonVariantConst entry : batch) {
+    dispatchRequest(entry);
+  }
+  _inBatch = false;
+
+  // 全部是通知时没有响应
+  if (_batchResponses > 0) {
+    _writer.raw("]");
+    endMessage();
+  }
+  // 批量中的initialize在数组发出后才切换编码；发送失败断开时连接状态已重置，不再切换
+  if (_binarySwitchPending) {
+    _binarySwitchPending = false;
+    if (connected) {
+      _binarySession = _pendingBinarySession;
+    }
+  }
+  sendDeferred();
 }
 
-// 清空所有工具
-void WebSocketMCP::clearTools() {
-  _tools.clear();
-  Serial.println("[WebSocketMCP] 已清空所有工具");
+void WebSocketMCP::handlePing(JsonObjectConst request) {
+  // 记录最后一次ping时间
+  lastPingTime = millis();
+  
+  // 构造pong响应 - 使用原始id进行回应，不做修改
+  JsonVariantConst id = request["id"];
+  MCP_LOGD("收到ping请求: %s", id.as<String>());
+
+  McpJsonWriter &out = beginMessage(McpSendQueue::LANE_CONTROL);
+  out.raw("{\"jsonrpc\":\"2.0\",\"id\":").value(id).raw(",\"result\":{}}");
+  endMessage();
+
+  MCP_LOGD("响应ping请求: %s", id.as<String>());
 }
 
-// 格式化JSON字符串，每个键值对占一行
-String WebSocketMCP::formatJsonString(const String &jsonStr) {
-  // 1. 处理空字符串或无效JSON
-  if (jsonStr.length() == 0) {
-    return "{}";
+// 处理初始化请求
+void WebSocketMCP::handleInitialize(JsonObjectConst request) {
+  const char *serverName = "ESP-HA"; 
+
+  // 编码由initialize请求决定：以MessagePack发来时本次连接改用MessagePack(从这条响应开始)
+  bool binary = _inboundBinary;
+#if MCP_FIXED_MEMORY
+  if (binary && !_transcodeDoc) {
+    MCP_LOGW("setBinaryEncoding()需在begin()之前调用，本次连接使用JSON文本帧");
+    binary = false;
+  }
+#endif
+  if (_inBatch) {
+    // 响应数组可能已经开始写出，整个数组沿用原编码，发出后再切换
+    _binarySwitchPending = true;
+    _pendingBinarySession = binary;
+  } else {
+    _binarySession = binary;
   }
 
-  // 2. 尝试解析JSON以确保其有效
-  DynamicJsonDocument doc(1024);
-  DeserializationError error = deserializeJson(doc, jsonStr);
+  // 发送初始化响应
+  McpJsonWriter &out = beginMessage(McpSendQueue::LANE_CONTROL);
+  out.raw("{\"jsonrpc\":\"2.0\",\"id\":").value(request["id"]);
+  out.raw(",\"result\":{\"protocolVersion\":\"2024-11-05\",\"capabilities\":{\"experimental\":");
+  out.raw(_binaryEnabled ? "{\"msgpack\":{}}" : "{}");
+  out.raw(",\"prompts\":{\"listChanged\":false},\"resources\":{\"subscribe\":true,\"listChanged\":true},\"tools\":{\"listChanged\":true}},\"serverInfo\":{\"name\":");
+  out.string(serverName).raw(",\"version\":\"1.0.0\"}}}");
+  endMessage();
+  MCP_LOGI("响应initialize请求");
+  _clientInitialized = true;
+  _toolsVersion = _registry->version();
+  _resourcesVersion = _resources.version();
+  _resources.clearSubscriptions();
+  if (_timingReconnect) {
+    _stats.ready.record(millis() - _disconnectedAt);
+    _timingReconnect = false;
+  }
   
-  if (error) {
-    // 如果解析失败，返回原字符串
-    return jsonStr;
+  // initialized通知在本帧处理完后发送
+  _initializedPending = true;
+}
+
+// 处理tools/list请求
+void WebSocketMCP::handleToolsList(JsonObjectConst request) {
+  // 工具目录只在注册表变化后重新生成，这里直接复用
+  const String &catalog = _registry->getToolsListJson();
+  // 客户端即将拿到最新目录，尚未发出的list_changed通知不再需要
+  _toolsVersion = _registry->version();
+
+  // MessagePack会话中直接发出缓存的目录编码，不再每次转码；不能直接发送时仍写成JSON进入发送队列
+  if (_binarySession && !_inBatch && catalog.length() < MCP_MSGPACK_MAX_MESSAGE &&
+      sendPackedResult(request["id"], _registry->getToolsListPacked())) {
+    MCP_LOGD("响应tools/list请求，共%u个工具", _registry->getToolCount());
+    return;
   }
+
+  McpJsonWriter &out = beginMessage();
+  out.raw("{\"jsonrpc\":\"2.0\",\"id\":").value(request["id"]);
+  out.raw(",\"result\":").raw(catalog).raw("}");
+  endMessage();
+  MCP_LOGD("响应tools/list请求，共%u个工具", _registry->getToolCount());
+}
+
+// 处理tools/call请求
+void WebSocketMCP::handleToolsCall(JsonObjectConst request) {
+  const char *toolName = request["params"]["name"] | "";
+  JsonObjectConst arguments = request["params"]["arguments"].as<JsonObjectConst>();
   
-  // 3. 初始化结果字符串
-  String result = "{\n";
+  MCP_LOGD("收到工具调用请求: %s", toolName);
   
-  // 4. 获取JSON中的所有键
-  JsonObject obj = doc.as<JsonObject>();
-  bool firstItem = true;
+  // 结果写入临时内存区，发完即归还(批量请求中的下一个调用可以复用)
+  size_t mark = _arena.usedBytes();
+  ToolResponse toolResponse;
+  McpToolResult result(nullptr, 0);
+  bool useResult = false;
+  uint32_t toolHash = 0;
+  uint32_t argsHash = 0;
+  uint32_t cacheTtl = 0;
+
+  // 按名称哈希查找工具
+  int index = _registry->findTool(toolName, strlen(toolName));
+  uint32_t start = micros();
   
-  // 5. 遍历JSON对象中的每个键值对
-  for (JsonPair p : obj) {
-    if (!firstItem) {
-      result += ",\n";
-    }
-    firstItem = false;
-    
-    // 添加两个空格的缩进
-    result += "  \"" + String(p.key().c_str()) + "\": ";
-    
-    // 根据值的类型添加相应的表示
-    if (p.value().is<JsonObject>() || p.value().is<JsonArray>()) {
-      // 如果值是对象或数组，使用serializeJson转换
-      String nestedJson;
-      serializeJson(p.value(), nestedJson);
-      result += nestedJson;
-    } else if (p.value().is<const char*>() || p.value().is<String>()) {
-      // 如果是字符串，添加引号
-      result += "\"" + String(p.value().as<const char*>()) + "\"";
-    } else {
-      // 对于其他类型（数字、布尔值等）
-      String valueStr;
-      serializeJson(p.value(), valueStr);
-      result += valueStr;
+  if (index >= 0) {
+    const Tool &tool = _registry->_tools[index];
+    uint32_t nameHash = tool.nameHash;
+    JsonVariantConst progressToken = request["params"]["_meta"]["progressToken"];
+    if (tool.handlers.asyncCallback) {
+      // 异步工具交给工作线程，响应稍后由loop()发出
+      startAsyncCall(tool, request["id"], progressToken, arguments);
+      return;
     }
+    if (tool.handlers.streamCallback) {
+      // 流式工具自己写出响应，回调返回时结束
+      ToolStream stream(*this, request["id"], progressToken);
+      tool.handlers.streamCallback(arguments, stream);
+      stream.finish();
+      _registry->recordToolCall(index, nameHash, micros() - start, stream.isError());
+      MCP_LOGI("工具调用完成: %s%s", toolName, stream.isError() ? " (出错)" : "");
+      return;
+    }
+    if (tool.cacheTtl > 0) {
+      // 幂等工具先查缓存，命中时直接发出缓存的result部分
+      toolHash = nameHash;
+      cacheTtl = tool.cacheTtl;
+      argsHash = McpResultCache::hashArguments(arguments);
+      const String *cached = _registry->_resultCache.find(toolHash, argsHash, arguments, millis());
+      if (cached) {
+        // 命中也计入工具统计，耗时为查找缓存的时间
+        _registry->recordToolCall(index, nameHash, micros() - start, false, true);
+        McpJsonWriter &out = beginMessage();
+        out.raw("{\"jsonrpc\":\"2.0\",\"id\":").value(request["id"]).raw(*cached);
+        endMessage();
+        MCP_LOGI("工具调用完成(缓存): %s", toolName);
+        return;
+      }
+    }
+    // 调用工具回调，传入参数并获取结果
+    if ((tool.handlers.resultCallback || tool.cacheTtl > 0) && !_arena.begin(MCP_ARENA_SIZE)) {
+      // 共享注册表中由其他实例注册的工具，本实例第一次调用时才分配结果缓冲区
+      MCP_LOGW("无法分配工具结果缓冲区: %s", toolName);
+    }
+    if (tool.handlers.resultCallback) {
+      size_t capacity = 0;
+      char *buffer = _arena.tail(&capacity);
+      result = McpToolResult(buffer, capacity, _prettyResults);
+      useResult = true;
+      tool.handlers.resultCallback(arguments, result);
+      _arena.commit(result.length() + 1);
+    } else if (tool.handlers.argsCallback) {
+      // 直接借用本帧解析出的arguments，无需序列化
+      toolResponse = tool.handlers.argsCallback(arguments);
+    } else if (tool.handlers.callback) {
+      String argumentsJson;
+      serializeJson(arguments, argumentsJson);
+      
+      // 调用回调并获取结构化结果
+      toolResponse = tool.handlers.callback(argumentsJson);
+    } else {
+      toolResponse = ToolResponse("{\"error\":\"Tool callback not registered\"}", true);
+    }
+    _registry->recordToolCall(index, nameHash, micros() - start,
+                   useResult ? result.isError() || result.overflowed() : toolResponse.isError);
+  } else {
+    String message = "{\"error\":\"Tool not found: ";
+    mcpAppendJsonEscaped(message, toolName, strlen(toolName));
+    message += "\"}";
+    toolResponse = ToolResponse(message, true);
+  }
+  bool isError = useResult ? result.isError() || result.overflowed() : toolResponse.isError;
+  
+  // 构造响应，内容逐项流式写入帧，不再经过中间文档和字符串
+  // 可缓存的工具同时把result部分记录到临时内存区，成功时存入缓存
+  uint32_t writeStart = micros();
+  size_t captureSize = 0;
+  char *captureBuffer = cacheTtl > 0 && !isError ? _arena.tail(&captureSize) : nullptr;
+  McpToolResult capture(captureBuffer, captureSize);
+  McpJsonWriter &out = beginMessage();
+  out.raw("{\"jsonrpc\":\"2.0\",\"id\":").value(request["id"]);
+  out.setCapture(captureBuffer ? &capture : nullptr);
+  if (useResult) {
+    writeToolResult(out, result);
+  } else {
+    writeToolResult(out, toolResponse);
+  }
+  out.setCapture(nullptr);
+  endMessage();
+  if (captureBuffer && !capture.overflowed()) {
+    _registry->_resultCache.store(toolHash, argsHash, arguments, cacheTtl, millis(), capture.text(),
+                                  capture.length());
+  }
+  _arena.rewind(mark);
+  _stats.write.record(micros() - writeStart);
+  MCP_LOGI("工具调用完成: %s%s", toolName, isError ? " (出错)" : "");
+}
+
+// 处理resources/list请求
+void WebSocketMCP::handleResourcesList(JsonObjectConst request) {
+  _resourcesVersion = _resources.version();
+
+  McpJsonWriter &out = beginMessage();
+  out.raw("{\"jsonrpc\":\"2.0\",\"id\":").value(request["id"]).raw(",\"result\":{\"resources\":[");
+  for (size_t i = 0; i < _resources.size(); i++) {
+    const McpResourceStore::Resource &resource = _resources.at(i);
+    if (i > 0) {
+      out.raw(",");
+    }
+    out.raw("{\"uri\":").string(resource.uri).raw(",\"name\":").string(resource.name);
+    if (resource.description.length() > 0) {
+      out.raw(",\"description\":").string(resource.description);
+    }
+    out.raw(",\"mimeType\":").string(resource.mimeType).raw("}");
+  }
+  out.raw("]}}");
+  endMessage();
+  MCP_LOGD("响应resources/list请求，共%u个资源", _resources.size());
+}
+
+// 处理resources/read请求：直接返回缓存的内容
+void WebSocketMCP::handleResourcesRead(JsonObjectConst request) {
+  const char *uri = request["params"]["uri"] | "";
+  int index = _resources.find(uri, strlen(uri));
+  if (index < 0) {
+    sendError(request["id"], -32002, "Resource not found");
+    MCP_LOGW("资源不存在: %s", uri);
+    return;
+  }
+  const McpResourceStore::Resource &resource = _resources.at(index);
+  McpJsonWriter &out = beginMessage();
+  out.raw("{\"jsonrpc\":\"2.0\",\"id\":").value(request["id"]);
+  out.raw(",\"result\":{\"contents\":[{\"uri\":").string(resource.uri);
+  out.raw(",\"mimeType\":").string(resource.mimeType);
+  out.raw(",\"text\":").string(resource.text).raw("}]}}");
+  endMessage();
+  MCP_LOGD("响应resources/read请求: %s", uri);
+}
+
+void WebSocketMCP::handleResourcesSubscribe(JsonObjectConst request) {
+  const char *uri = request["params"]["uri"] | "";
+  if (!_resources.setSubscribed(uri, true)) {
+    sendError(request["id"], -32002, "Resource not found");
+    return;
+  }
+  beginMessage().raw("{\"jsonrpc\":\"2.0\",\"id\":").value(request["id"]).raw(",\"result\":{}}");
+  endMessage();
+  MCP_LOGI("客户端订阅资源: %s", uri);
+}
+
+void WebSocketMCP::handleResourcesUnsubscribe(JsonObjectConst request) {
+  const char *uri = request["params"]["uri"] | "";
+  // 资源已被移除时订阅也随之消失，同样视为成功
+  _resources.setSubscribed(uri, false);
+  beginMessage().raw("{\"jsonrpc\":\"2.0\",\"id\":").value(request["id"]).raw(",\"result\":{}}");
+  endMessage();
+  MCP_LOGI("客户端取消订阅资源: %s", uri);
+}
+
+void WebSocketMCP::sendError(JsonVariantConst id, long code, const char *message) {
+  McpJsonWriter &out = beginMessage();
+  out.raw("{\"jsonrpc\":\"2.0\",\"id\":").value(id);
+  out.raw(",\"error\":{\"code\":").number(code).raw(",\"message\":").string(message).raw("}}");
+  endMessage();
+}
+
+void WebSocketMCP::sendError(const char *idJson, long code, const char *message) {
+  McpJsonWriter &out = beginMessage();
+  out.raw("{\"jsonrpc\":\"2.0\",\"id\":").raw(idJson);
+  out.raw(",\"error\":{\"code\":").number(code).raw(",\"message\":").string(message).raw("}}");
+  endMessage();
+}
+
+// 资源列表变化时通知客户端重新获取；已订阅资源的每次变化只通知URI，客户端按需再读取
+void WebSocketMCP::sendResourceNotifications() {
+  if (_resourcesVersion != _resources.version()) {
+    _resourcesVersion = _resources.version();
+    sendMessage("{\"jsonrpc\":\"2.0\",\"method\":\"notifications/resources/list_changed\"}");
+  }
+  int index;
+  while ((index = _resources.takeChanged()) >= 0) {
+    McpJsonWriter &out = beginMessage(McpSendQueue::LANE_BULK, false);
+    out.raw("{\"jsonrpc\":\"2.0\",\"method\":\"notifications/resources/updated\",\"params\":{\"uri\":");
+    out.string(_resources.at(index).uri).raw("}}");
+    endMessage();
+  }
+}
+
+// 写入tools/call响应的result部分(同步和异步工具共用)
+void WebSocketMCP::writeToolResult(McpJsonWriter &out, const ToolResponse &toolResponse) {
+  out.raw(",\"result\":{\"content\":[");
+  for (size_t i = 0; i < toolResponse.content.size(); i++) {
+    const ToolContentItem &item = toolResponse.content[i];
+    if (i > 0) {
+      out.raw(",");
+    }
+    out.raw("{\"type\":").string(item.type);
+    out.raw(",\"text\":").string(item.text).raw("}");
+  }
+  out.raw("],\"isError\":").boolean(toolResponse.isError).raw("}}");
+}
+
+// 写入McpToolResult形式的结果，结果超出缓冲区时返回错误而不是截断的内容
+void WebSocketMCP::writeToolResult(McpJsonWriter &out, const McpToolResult &result) {
+  out.raw(",\"result\":{\"content\":[{\"type\":\"text\",\"text\":");
+  if (result.overflowed()) {
+    MCP_LOGW("工具结果超出MCP_ARENA_SIZE，已丢弃");
+    out.string("{\"error\":\"Tool result exceeds MCP_ARENA_SIZE\"}");
+  } else {
+    out.string(result.text(), result.length());
+  }
+  out.raw("}],\"isError\":").boolean(result.isError() || result.overflowed()).raw("}}");
+}
+
+// 把异步工具调用提交到工作线程池
+void WebSocketMCP::startAsyncCall(const Tool &tool, JsonVariantConst id, JsonVariantConst progressToken,
+                                  JsonObjectConst arguments) {
+  std::shared_ptr<ToolResponder::State> state(new ToolResponder::State());
+  state->owner = this;
+  state->toolName = tool.nameText();
+  state->startMicros = micros();
+  serializeJson(id, state->idJson);
+  if (!progressToken.isNull()) {
+    serializeJson(progressToken, state->progressTokenJson);
+  }
+  ToolResponder responder(state);
+  
+  // 请求帧在本次回调结束后失效，arguments序列化后交给工作线程重新解析
+  String argumentsJson;
+  serializeJson(arguments, argumentsJson);
+  AsyncToolCallback callback = tool.handlers.asyncCallback;
+
+  // 共享注册表中由其他实例注册的异步工具，本实例第一次调用时才启动工作线程
+  if (!_workers.started()) {
+    _workers.begin(MCP_ASYNC_WORKERS, MCP_ASYNC_QUEUE, MCP_ASYNC_STACK, MCP_ASYNC_PRIORITY);
+  }
+  bool queued = _workers.submit([callback, argumentsJson, responder]() {
+    DynamicJsonDocument doc(512 + argumentsJson.length() * 2);
+    deserializeJson(doc, argumentsJson);
+    callback(doc.as<JsonObjectConst>(), responder);
+  });
+  if (!queued) {
+    MCP_LOGW("异步任务队列已满: %s", tool.nameText());
+    responder.respond(ToolResponse("{\"error\":\"Server busy, try again later\"}", true));
+    return;
+  }
+  MCP_LOGD("异步工具已提交: %s", tool.nameText());
+}
+
+// 工作线程调用：只入队(并唤醒网络任务)，不直接操作WebSocket
+void WebSocketMCP::postAsyncResult(const ToolResponder::State &state, const ToolResponse &response) {
+  AsyncResult result;
+  result.idJson = state.idJson;
+  result.toolName = state.toolName;
+  result.elapsedMicros = micros() - state.startMicros;
+  result.response = response;
+  {
+    std::lock_guard<std::mutex> lock(_asyncMutex);
+    _asyncResults.push_back(result);
+  }
+  _netTask.wake();
+}
+
+// 工作线程调用：进度通知与结果共用一个队列，按提交顺序发出
+void WebSocketMCP::postAsyncProgress(const ToolResponder::State &state, double progress, double total,
+                                     const char *message) {
+  AsyncResult result;
+  result.isProgress = true;
+  result.idJson = state.progressTokenJson;
+  result.progress = progress;
+  result.total = total;
+  if (message) {
+    result.message = message;
+  }
+  {
+    std::lock_guard<std::mutex> lock(_asyncMutex);
+    _asyncResults.push_back(result);
+  }
+  _netTask.wake();
+}
+
+// 写入 ,"progress":..[,"total":..][,"message":".."]}}
+void WebSocketMCP::writeProgress(McpJsonWriter &out, double progress, double total, const char *message) {
+  char number[32];
+  snprintf(number, sizeof(number), "%.9g", progress);
+  out.raw(",\"progress\":").raw(number);
+  if (total > 0) {
+    snprintf(number, sizeof(number), "%.9g", total);
+    out.raw(",\"total\":").raw(number);
+  }
+  if (message && *message) {
+    out.raw(",\"message\":").string(message);
+  }
+  out.raw("}}");
+}
+
+// loop()线程中发出已完成的异步结果
+void WebSocketMCP::sendAsyncResults() {
+  {
+    std::lock_guard<std::mutex> lock(_asyncMutex);
+    if (_asyncResults.empty()) {
+      return;
+    }
+  }
+  // 构造std::deque本身就会分配内存，确认有结果后再创建
+  std::deque<AsyncResult> results;
+  {
+    std::lock_guard<std::mutex> lock(_asyncMutex);
+    results.swap(_asyncResults);
+  }
+  for (size_t i = 0; i < results.size(); i++) {
+    const AsyncResult &result = results[i];
+    if (result.isProgress) {
+      McpJsonWriter &out = beginMessage(McpSendQueue::LANE_BULK, false);
+      out.raw("{\"jsonrpc\":\"2.0\",\"method\":\"notifications/progress\",\"params\":{\"progressToken\":").raw(result.idJson);
+      writeProgress(out, result.progress, result.total, result.message.c_str());
+      endMessage();
+      continue;
+    }
+    int index = _registry->findTool(result.toolName.c_str(), result.toolName.length());
+    if (index >= 0) {
+      _registry->recordToolCall(index, _registry->_tools[index].nameHash, result.elapsedMicros, result.response.isError);
+    }
+    // 断线期间完成的结果进入发送队列，重连后发出
+    McpJsonWriter &out = beginMessage();
+    out.raw("{\"jsonrpc\":\"2.0\",\"id\":").raw(result.idJson);
+    writeToolResult(out, result.response);
+    endMessage();
+    MCP_LOGI("异步工具调用完成: %s%s", result.toolName, result.response.isError ? " (出错)" : "");
+  }
+}
+
+// 开始一条流式发送的消息
+McpJsonWriter &WebSocketMCP::beginMessage(McpSendQueue::Lane lane, bool reply) {
+  if (_inBatch) {
+    // 批量响应：第一项开始数组，之后的项用逗号分隔
+    if (_batchResponses++ == 0) {
+      _messageLane = McpSendQueue::LANE_BULK;
+      _messageReply = true;
+      flushAheadOf(_messageLane);
+      _writer.begin();
+      _writer.raw("[");
+    } else {
+      _writer.raw(",");
+    }
+    return _writer;
+  }
+  _messageLane = lane;
+  _messageReply = reply;
+  if (reply) {
+    // 响应的内容还没有写入任何缓冲区，这时发出排在前面的消息不会打乱正在写出的内容
+    flushAheadOf(lane);
+  }
+  _writer.begin();
+  return _writer;
+}
+
+// 结束流式消息，发出最后一帧
+bool WebSocketMCP::endMessage() {
+  if (_inBatch) {
+    return _writer.ok();
+  }
+  _stats.outbound.record(_writer.bytesWritten());
+  if (!_writer.end()) {
+    if (_messageQueued) {
+      MCP_LOGW("发送队列已满，丢弃消息: %u字节", _writer.bytesWritten());
+    } else {
+      MCP_LOGW("消息发送失败: %u字节", _writer.bytesWritten());
+    }
+    return false;
+  }
+  if (_messageQueued) {
+    MCP_LOGD("消息已加入发送队列: %u字节", _writer.bytesWritten());
+  } else {
+    MCP_LOGD("发送消息: %u字节", _writer.bytesWritten());
+  }
+  return true;
+}
+
+// McpFrameSink实现：把写入器的块作为WebSocket分片帧发出，或写入发送队列
+bool WebSocketMCP::writeFrame(uint8_t *frame, size_t length, bool first, bool fin) {
+  const uint8_t *payload = frame + WEBSOCKETS_MAX_HEADER_SIZE;
+  if (_binarySession) {
+    // MessagePack需要完整的消息才能转码，先收集各块
+    if (first) {
+      _binaryText.clear();
+      _binaryOverflow = false;
+    }
+    if (!_binaryOverflow) {
+      if (_binaryText.size() + length <= MCP_MSGPACK_MAX_MESSAGE) {
+        _binaryText.insert(_binaryText.end(), payload, payload + length);
+        return fin ? sendBinaryMessage() : true;
+      }
+      // 消息太长，已收集的部分作为文本消息的第一片，其余照常按文本分片发送
+      _binaryOverflow = true;
+      if (!_binaryText.empty()) {
+        if (!writeTextFrame(nullptr, _binaryText.data(), _binaryText.size(), true, false)) {
+          return false;
+        }
+        first = false;
+      }
+    }
+  }
+  return writeTextFrame(frame, payload, length, first, fin);
+}
+
+bool WebSocketMCP::writeTextFrame(uint8_t *frame, const uint8_t *payload, size_t length, bool first, bool fin) {
+  if (first) {
+    // 在第一块时决定整条消息的去向，之后不再改变
+    _messageQueued = !canSendDirect(_messageLane, _messageReply) ||
+                     !(frame ? webSocket.sendFragment(WSop_text, frame, length, fin)
+                             : webSocket.sendFragmentCopy(WSop_text, payload, length, fin));
+    if (!_messageQueued) {
+      _sentThisLoop += length;
+      return true;
+    }
+    _sendQueue.lane(_messageLane).beginMessage();
+  } else if (!_messageQueued) {
+    _sentThisLoop += length;
+    return frame ? webSocket.sendFragment(WSop_continuation, frame, length, fin)
+                 : webSocket.sendFragmentCopy(WSop_continuation, payload, length, fin);
+  }
+
+  McpMessageRing &ring = _sendQueue.lane(_messageLane);
+  if (!ring.append(payload, length)) {
+    // 空间不足，本条消息作废并计入丢弃数
+    ring.commitMessage();
+    return false;
+  }
+  return fin ? ring.commitMessage() : true;
+}
+
+// MessagePack会话中一条消息写完：能直接发送时转码后发出，否则JSON原文排队，发送时再转码
+bool WebSocketMCP::sendBinaryMessage() {
+  _messageQueued = !canSendDirect(_messageLane, _messageReply) || !sendWholeMessage(_binaryText.data(), _binaryText.size());
+  if (!_messageQueued) {
+    return true;
+  }
+  McpMessageRing &ring = _sendQueue.lane(_messageLane);
+  ring.beginMessage();
+  if (!ring.append(_binaryText.data(), _binaryText.size())) {
+    // 空间不足，本条消息作废并计入丢弃数
+    ring.commitMessage();
+    return false;
+  }
+  return ring.commitMessage();
+}
+
+bool WebSocketMCP::sendWholeMessage(const uint8_t *json, size_t length) {
+  if (_binarySession && length <= MCP_MSGPACK_MAX_MESSAGE && encodeMsgPack(json, length)) {
+    if (!webSocket.sendFragment(WSop_binary, _binaryFrame.data(), _binaryLength, true)) {
+      return false;
+    }
+    _sentThisLoop += _binaryLength;
+    return true;
+  }
+  if (!webSocket.sendFragmentCopy(WSop_text, json, length, true)) {
+    return false;
+  }
+  _sentThisLoop += length;
+  return true;
+}
+
+// JSON文本转为MessagePack，结果写入_binaryFrame(帧头空间之后)
+// 一般的消息直接转码；对象和数组太多时按只读输入解析成文档(字符串拷贝进文档)再序列化
+// 转码失败时原文仍可用文本帧发送或排队
+bool WebSocketMCP::encodeMsgPack(const uint8_t *json, size_t length) {
+  uint32_t start = micros();
+  McpMsgPackEncoder encoder(_packCounts, MCP_MSGPACK_MAX_CONTAINERS);
+  if (encoder.measure((const char *)json, length)) {
+    if (_binaryFrame.size() < WEBSOCKETS_MAX_HEADER_SIZE + encoder.size()) {
+      _binaryFrame.resize(WEBSOCKETS_MAX_HEADER_SIZE + encoder.size());
+    }
+    _binaryLength = encoder.encode((const char *)json, length, _binaryFrame.data() + WEBSOCKETS_MAX_HEADER_SIZE);
+    _stats.encode.record(micros() - start);
+    _stats.encodedJson.record(length);
+    _stats.encoded.record(_binaryLength);
+    return true;
+  }
+#if MCP_FIXED_MEMORY
+  JsonDocument &doc = *_transcodeDoc;
+#else
+  DynamicJsonDocument doc(length * 3 / 2 + 512);
+#endif
+  DeserializationError error = deserializeJson(doc, (const char *)json, length);
+  if (error) {
+    MCP_LOGW("消息转码失败(%s)，改用文本帧: %u字节", error.c_str(), length);
+    return false;
+  }
+  size_t size = measureMsgPack(doc);
+  if (_binaryFrame.size() < WEBSOCKETS_MAX_HEADER_SIZE + size) {
+    _binaryFrame.resize(WEBSOCKETS_MAX_HEADER_SIZE + size);
+  }
+  _binaryLength = serializeMsgPack(doc, _binaryFrame.data() + WEBSOCKETS_MAX_HEADER_SIZE, size);
+  _stats.encode.record(micros() - start);
+  _stats.encodedJson.record(length);
+  _stats.encoded.record(_binaryLength);
+  return true;
+}
+
+// {"jsonrpc":"2.0","id":...,"result":...}中id之前和result键的MessagePack编码
+static const uint8_t PACKED_REPLY_HEAD[] = {0x83, 0xA7, 'j', 's', 'o', 'n', 'r', 'p', 'c', 0xA3, '2', '.', '0',
+                                            0xA2, 'i', 'd'};
+static const uint8_t PACKED_RESULT_KEY[] = {0xA6, 'r', 'e', 's', 'u', 'l', 't'};
+
+bool WebSocketMCP::sendPackedResult(JsonVariantConst id, const std::vector<uint8_t> &result) {
+  if (result.empty()) {
+    return false;
+  }
+  flushAheadOf(McpSendQueue::LANE_BULK);
+  if (!canSendDirect(McpSendQueue::LANE_BULK, true)) {
+    return false;
+  }
+  size_t idSize = measureMsgPack(id);
+  size_t length = sizeof(PACKED_REPLY_HEAD) + idSize + sizeof(PACKED_RESULT_KEY) + result.size();
+  if (_binaryFrame.size() < WEBSOCKETS_MAX_HEADER_SIZE + length) {
+    _binaryFrame.resize(WEBSOCKETS_MAX_HEADER_SIZE + length);
+  }
+  uint8_t *out = _binaryFrame.data() + WEBSOCKETS_MAX_HEADER_SIZE;
+  memcpy(out, PACKED_REPLY_HEAD, sizeof(PACKED_REPLY_HEAD));
+  out += sizeof(PACKED_REPLY_HEAD);
+  out += serializeMsgPack(id, out, idSize);
+  memcpy(out, PACKED_RESULT_KEY, sizeof(PACKED_RESULT_KEY));
+  out += sizeof(PACKED_RESULT_KEY);
+  memcpy(out, result.data(), result.size());
+  if (!webSocket.sendFragment(WSop_binary, _binaryFrame.data(), length, true)) {
+    return false;
+  }
+  _sentThisLoop += length;
+  _stats.outbound.record(length);
+  return true;
+}
+
+// 已连接、本轮发送量未超预算、且没有更早的消息在排队时才能直接发送
+// 控制消息只需等待控制通道，可以插到普通消息前面
+// 对请求的响应不受预算限制：排队等到下一轮时，超过队列剩余空间的响应会被整条丢弃
+bool WebSocketMCP::canSendDirect(McpSendQueue::Lane lane, bool reply) const {
+  if (!connected || (!reply && _sentThisLoop >= MCP_SEND_BUDGET)) {
+    return false;
+  }
+  if (lane == McpSendQueue::LANE_CONTROL) {
+    return _sendQueue.lane(McpSendQueue::LANE_CONTROL).empty();
+  }
+  return _sendQueue.empty();
+}
+
+// 按优先级发出排队的消息，本轮预算用完或发送失败时留到下一轮
+void WebSocketMCP::flushSendQueue() {
+  while (connected && !_sendQueue.empty() && _sentThisLoop < MCP_SEND_BUDGET) {
+    McpMessageRing &ring = _sendQueue.next();
+    if (!sendQueuedMessage(ring)) {
+      break;
+    }
+    ring.popFront();
+  }
+}
+
+// 响应直接发送前，先按优先级发出排在它前面的消息：控制消息之前是控制通道，普通消息之前是两个通道
+// 发送失败(连接已断开)时停止，响应随后也进入队列
+void WebSocketMCP::flushAheadOf(McpSendQueue::Lane lane) {
+  while (connected) {
+    McpMessageRing &ring = _sendQueue.next();
+    if (ring.empty() || (lane == McpSendQueue::LANE_CONTROL && &ring != &_sendQueue.lane(lane))) {
+      return;
+    }
+    if (!sendQueuedMessage(ring)) {
+      return;
+    }
+    ring.popFront();
+  }
+}
+
+// 发送队首消息，按MCP_FRAME_CHUNK分片，环形回绕处也分片
+bool WebSocketMCP::sendQueuedMessage(const McpMessageRing &ring) {
+  size_t length = ring.frontLength();
+  size_t offset = 0;
+  if (_binarySession && length <= MCP_MSGPACK_MAX_MESSAGE) {
+    // 队列中是JSON原文，拼成连续的一段后整条转码发送
+    _binaryText.resize(length);
+    while (offset < length) {
+      size_t n;
+      const uint8_t *data = ring.frontData(offset, &n);
+      memcpy(_binaryText.data() + offset, data, n);
+      offset += n;
+    }
+    if (!sendWholeMessage(_binaryText.data(), length)) {
+      return false;
+    }
+    MCP_LOGD("发送排队消息: %u字节", length);
+    return true;
+  }
+  bool first = true;
+  do {
+    size_t n;
+    const uint8_t *data = ring.frontData(offset, &n);
+    if (n > MCP_FRAME_CHUNK) {
+      n = MCP_FRAME_CHUNK;
+    }
+    bool fin = offset + n >= length;
+    if (!webSocket.sendFragmentCopy(first ? WSop_text : WSop_continuation, data, n, fin)) {
+      return false;
+    }
+    first = false;
+    offset += n;
+  } while (offset < length);
+  _sentThisLoop += length;
+  MCP_LOGD("发送排队消息: %u字节", length);
+  return true;
+}
+
+// 获取序列化好的工具目录({"tools":[...]})，过期时重新生成
+const String &WebSocketMCP::ToolRegistry::getToolsListJson() {
+  if (!_toolsListDirty) {
+    return _toolsListCache;
+  }
+  
+  // 先统计转义后的长度，一次性分配目录缓冲区
+  size_t total = 12;
+  for (size_t i = 0; i < _tools.size(); i++) {
+    const char *name = _tools[i].nameText();
+    const char *description = _tools[i].descriptionText();
+    total += mcpJsonEscapedLength(name, strlen(name)) + mcpJsonEscapedLength(description, strlen(description)) +
+             strlen(_tools[i].schemaText()) + 48;
   }
   
-  // 6. 添加结束括号（换行并闭合）
-  result += "\n}";
+  _toolsListCache = "";
+  _toolsListCache.reserve(total);
+  McpStringWriter writer(_toolsListCache);
+  _toolsListCache += "{\"tools\":[";
+  for (size_t i = 0; i < _tools.size(); i++) {
+    if (i > 0) {
+      _toolsListCache += ",";
+    }
+    const char *name = _tools[i].nameText();
+    const char *description = _tools[i].descriptionText();
+    _toolsListCache += "{\"name\":";
+    mcpWriteJsonString(writer, name, strlen(name));
+    _toolsListCache += ",\"description\":";
+    mcpWriteJsonString(writer, description, strlen(description));
+    _toolsListCache += ",\"inputSchema\":";
+    _toolsListCache += _tools[i].schemaText();
+    _toolsListCache += "}";
+  }
+  _toolsListCache += "]}";
   
+  _toolsListDirty = false;
+  _toolsListPackedDirty = true;
+  return _toolsListCache;
+}
+
+// 目录的MessagePack编码，只在目录重新生成后转码一次；无法直接转码(嵌套过深)时为空
+const std::vector<uint8_t> &WebSocketMCP::ToolRegistry::getToolsListPacked() {
+  const String &catalog = getToolsListJson();
+  if (!_toolsListPackedDirty) {
+    return _toolsListPacked;
+  }
+  _toolsListPackedDirty = false;
+  // 对象和数组数不超过左括号数
+  size_t brackets = 1;
+  for (size_t i = 0; i < catalog.length(); i++) {
+    if (catalog[i] == '{' || catalog[i] == '[') {
+      brackets++;
+    }
+  }
+  std::vector<uint32_t> counts(brackets);
+  McpMsgPackEncoder encoder(counts.data(), counts.size());
+  if (!encoder.measure(catalog.c_str(), catalog.length())) {
+    _toolsListPacked.clear();
+    return _toolsListPacked;
+  }
+  _toolsListPacked.resize(encoder.size());
+  encoder.encode(catalog.c_str(), catalog.length(), _toolsListPacked.data());
+  return _toolsListPacked;
+}
+
+// 工具注册表发生变化：目录缓存失效，各实例已初始化的客户端稍后收到list_changed通知
+void WebSocketMCP::ToolRegistry::markToolsChanged() {
+  _toolsListDirty = true;
+  _version++;
+}
+
+// 按名称查找工具，返回在_tools中的下标，未找到返回-1
+int WebSocketMCP::ToolRegistry::findTool(const char *name, size_t length) const {
+  return _toolIndex.find(mcpHashBytes(name, length), [&](size_t i) {
+    const char *candidate = _tools[i].nameText();
+    return strncmp(candidate, name, length) == 0 && candidate[length] == '\0';
+  });
+}
+
+// 工具下标发生变化(卸载)后重建索引
+void WebSocketMCP::ToolRegistry::rebuildToolIndex() {
+  _toolIndex.clear();
+  for (size_t i = 0; i < _tools.size(); i++) {
+    _toolIndex.insert(_tools[i].nameHash, i);
+  }
+}
+
+// 转义JSON字符串中的特殊字符
+String WebSocketMCP::escapeJsonString(const String &input) {
+  String result;
+  mcpAppendJsonEscaped(result, input);
   return result;
 }
 
+// 工具注册和管理方法转发到本实例使用的注册表
+bool WebSocketMCP::registerTool(const String &name, const String &description, 
+                              const String &inputSchema, ToolCallback callback,
+                              uint32_t cacheTtlMs) {
+  return _registry->registerTool(name, description, inputSchema, callback, cacheTtlMs);
+}
+
+bool WebSocketMCP::registerTool(const String &name, const String &description, 
+                              const String &inputSchema, ToolArgsCallback callback,
+                              uint32_t cacheTtlMs) {
+  return _registry->registerTool(name, description, inputSchema, callback, cacheTtlMs);
+}
+
+bool WebSocketMCP::registerTool(const String &name, const String &description, 
+                              const String &inputSchema, ToolResultCallback callback,
+                              uint32_t cacheTtlMs) {
+  // 结果缓冲区在第一次注册这类工具时分配(固定内存模式下已在begin()中分配)
+  if (!_arena.begin(MCP_ARENA_SIZE)) {
+    MCP_LOGE("无法分配工具结果缓冲区，注册失败: %s", name);
+    return false;
+  }
+  return _registry->registerTool(name, description, inputSchema, callback, cacheTtlMs);
+}
+
+// 注册内置统计工具
+bool WebSocketMCP::registerStatsTool(const String &name) {
+  return registerTool(name, "获取MCP连接的运行统计：各工具调用次数、错误数和耗时分布(微秒)，消息大小，堆内存低水位，重连次数",
+                      "{\"type\":\"object\",\"properties\":{}}",
+                      [this](JsonObjectConst) {
+                        return ToolResponse(getStatsJson());
+                      });
+}
+
+bool WebSocketMCP::registerAsyncTool(const String &name, const String &description, 
+                                   const String &inputSchema, AsyncToolCallback callback) {
+  // 第一次注册异步工具时才启动工作线程
+  if (!_workers.started() &&
+      !_workers.begin(MCP_ASYNC_WORKERS, MCP_ASYNC_QUEUE, MCP_ASYNC_STACK, MCP_ASYNC_PRIORITY)) {
+    MCP_LOGE("无法启动异步工作线程，注册失败: %s", name);
+    return false;
+  }
+  return _registry->registerAsyncTool(name, description, inputSchema, callback);
+}
+
+bool WebSocketMCP::registerStreamingTool(const String &name, const String &description,
+                                         const String &inputSchema, ToolStreamCallback callback) {
+  return _registry->registerStreamingTool(name, description, inputSchema, callback);
+}
+
+bool WebSocketMCP::registerTools(const StaticTool *tools, size_t count) {
+  // 与对应的注册方法一样，表中有这类工具时预先分配结果缓冲区、启动工作线程
+  for (size_t i = 0; i < count; i++) {
+    if (tools[i].async && !_workers.started() &&
+        !_workers.begin(MCP_ASYNC_WORKERS, MCP_ASYNC_QUEUE, MCP_ASYNC_STACK, MCP_ASYNC_PRIORITY)) {
+      MCP_LOGE("无法启动异步工作线程: %s", tools[i].name);
+    }
+    if ((tools[i].result || tools[i].cacheTtlMs > 0) && !_arena.begin(MCP_ARENA_SIZE)) {
+      MCP_LOGE("无法分配工具结果缓冲区: %s", tools[i].name);
+    }
+  }
+  return _registry->registerTools(tools, count);
+}
+
+bool WebSocketMCP::registerSimpleTool(const String &name, const String &description, 
+                                    const String &paramName, const String &paramDesc, 
+                                    const String &paramType, ToolCallback callback) {
+  return _registry->registerSimpleTool(name, description, paramName, paramDesc, paramType, callback);
+}
+
+bool WebSocketMCP::registerSimpleTool(const String &name, const String &description, 
+                                    const String &paramName, const String &paramDesc, 
+                                    const String &paramType, ToolArgsCallback callback) {
+  return _registry->registerSimpleTool(name, description, paramName, paramDesc, paramType, callback);
+}
+
+bool WebSocketMCP::unregisterTool(const String &name) {
+  return _registry->unregisterTool(name);
+}
+
+bool WebSocketMCP::registerResource(const String &uri, const String &name, const String &description,
+                                    const String &mimeType) {
+  if (!_resources.add(uri, name, description, mimeType)) {
+    return false;
+  }
+  MCP_LOGI("已注册资源: %s", uri);
+  return true;
+}
+
+bool WebSocketMCP::updateResource(const String &uri, const char *text, size_t length) {
+  int index = _resources.find(uri.c_str(), uri.length());
+  if (index < 0) {
+    MCP_LOGW("资源 %s 未注册，无法更新", uri);
+    return false;
+  }
+  return _resources.update(index, text, length);
+}
+
+bool WebSocketMCP::unregisterResource(const String &uri) {
+  if (!_resources.remove(uri)) {
+    MCP_LOGW("资源 %s 不存在，无法卸载", uri);
+    return false;
+  }
+  MCP_LOGI("已卸载资源: %s", uri);
+  return true;
+}
+
+void WebSocketMCP::clearResources() {
+  _resources.clear();
+  MCP_LOGI("已清空所有资源");
+}
+
+size_t WebSocketMCP::getToolCount() {
+  return _registry->getToolCount();
+}
+
+void WebSocketMCP::clearTools() {
+  _registry->clearTools();
+}
+
+void WebSocketMCP::invalidateToolCache(const String &name) {
+  _registry->invalidateToolCache(name);
+}
+
+void WebSocketMCP::clearToolCache() {
+  _registry->clearToolCache();
+}
+
+WebSocketMCP::CacheStats WebSocketMCP::getCacheStats() const {
+  return _registry->getCacheStats();
+}
+
+// 添加工具注册方法 - 带回调函数版
+bool WebSocketMCP::ToolRegistry::registerTool(const String &name, const String &description,
+                                              const String &inputSchema, ToolCallback callback,
+                                              uint32_t cacheTtlMs) {
+  ToolHandlers handlers;
+  handlers.callback = callback;
+  return addTool(name, description, inputSchema, handlers, cacheTtlMs);
+}
+
+// 添加工具注册方法 - 直接接收arguments对象版
+bool WebSocketMCP::ToolRegistry::registerTool(const String &name, const String &description,
+                                              const String &inputSchema, ToolArgsCallback callback,
+                                              uint32_t cacheTtlMs) {
+  ToolHandlers handlers;
+  handlers.argsCallback = callback;
+  return addTool(name, description, inputSchema, handlers, cacheTtlMs);
+}
+
+// 添加工具注册方法 - 结果写入McpToolResult版，结果缓冲区由执行调用的实例分配
+bool WebSocketMCP::ToolRegistry::registerTool(const String &name, const String &description,
+                                              const String &inputSchema, ToolResultCallback callback,
+                                              uint32_t cacheTtlMs) {
+  ToolHandlers handlers;
+  handlers.resultCallback = callback;
+  return addTool(name, description, inputSchema, handlers, cacheTtlMs);
+}
+
+// 添加工具注册方法 - 异步执行版
+bool WebSocketMCP::ToolRegistry::registerAsyncTool(const String &name, const String &description,
+                                                   const String &inputSchema, AsyncToolCallback callback) {
+  ToolHandlers handlers;
+  handlers.asyncCallback = callback;
+  return addTool(name, description, inputSchema, handlers);
+}
+
+// 添加工具注册方法 - 流式输出版(结果不缓存)
+bool WebSocketMCP::ToolRegistry::registerStreamingTool(const String &name, const String &description,
+                                                       const String &inputSchema, ToolStreamCallback callback) {
+  ToolHandlers handlers;
+  handlers.streamCallback = callback;
+  return addTool(name, description, inputSchema, handlers);
+}
+
+bool WebSocketMCP::ToolRegistry::addTool(const String &name, const String &description, const String &inputSchema,
+                                         const ToolHandlers &handlers, uint32_t cacheTtl) {
+  // 空schema会使tools/list输出无效的JSON(参数schema生成失败时也为空)
+  if (inputSchema.length() == 0) {
+    MCP_LOGE("工具inputSchema为空，注册失败: %s", name);
+    return false;
+  }
+  // 已存在时只更新回调，不复制名称和schema
+  int index = findTool(name.c_str(), name.length());
+  if (index >= 0) {
+    Tool &tool = _tools[index];
+    tool.handlers = handlers;
+    tool.cacheTtl = cacheTtl;
+    _resultCache.invalidate(tool.nameHash);
+    MCP_LOGI("更新工具回调: %s", name);
+    return true;
+  }
+
+  // 创建新工具，名称哈希在注册时计算一次
+  Tool newTool;
+  newTool.name = name;
+  newTool.nameHash = mcpHashBytes(name.c_str(), name.length());
+  newTool.description = description;
+  newTool.inputSchema = inputSchema;
+  newTool.handlers = handlers;
+  newTool.cacheTtl = cacheTtl;
+  return insertTool(newTool);
+}
+
+// 静态工具只记录表项指针，名称、描述和schema都不复制
+bool WebSocketMCP::ToolRegistry::addStaticTool(const StaticTool &entry) {
+  Tool newTool;
+  newTool.nameHash = mcpHashBytes(entry.name, strlen(entry.name));
+  newTool.entry = &entry;
+  // 普通函数指针存入std::function时不分配堆内存
+  if (entry.async) {
+    newTool.handlers.asyncCallback = entry.async;
+  } else if (entry.result) {
+    newTool.handlers.resultCallback = entry.result;
+  }
+  newTool.cacheTtl = entry.async ? 0 : entry.cacheTtlMs;
+  return insertTool(newTool);
+}
+
+bool WebSocketMCP::ToolRegistry::insertTool(const Tool &tool) {
+  const char *name = tool.nameText();
+  int index = findTool(name, strlen(name));
+  if (index >= 0) {
+    // 如果工具存在，可以选择更新回调，旧回调的缓存结果作废
+    Tool &existing = _tools[index];
+    existing.handlers = tool.handlers;
+    existing.cacheTtl = tool.cacheTtl;
+    if (tool.entry) {
+      existing.entry = tool.entry;
+    }
+    _resultCache.invalidate(existing.nameHash);
+    MCP_LOGI("更新工具回调: %s", name);
+    return true;
+  }
+
+  if (!_toolIndex.insert(tool.nameHash, _tools.size())) {
+    MCP_LOGE("工具数量已达上限，无法注册: %s", name);
+    return false;
+  }
+  _tools.push_back(tool);
+  markToolsChanged();
+  MCP_LOGI("成功注册工具: %s", name);
+  return true;
+}
+
+// 注册静态工具表，预先按表长扩容；目录在下一次tools/list时才重建，list_changed通知也合并为一次
+bool WebSocketMCP::ToolRegistry::registerTools(const StaticTool *tools, size_t count) {
+  _tools.reserve(_tools.size() + count);
+  bool ok = true;
+  for (size_t i = 0; i < count; i++) {
+    ok = addStaticTool(tools[i]) && ok;
+  }
+  return ok;
+}
+
+// 构建只有一个必填参数的inputSchema
+static String buildSimpleSchema(const String &paramName, const String &paramDesc, const String &paramType) {
+  String schema;
+  schema.reserve(paramName.length() * 2 + paramDesc.length() + paramType.length() + 96);
+  schema += "{\"type\":\"object\",\"properties\":{\"";
+  mcpAppendJsonEscaped(schema, paramName);
+  schema += "\":{\"type\":\"";
+  mcpAppendJsonEscaped(schema, paramType);
+  schema += "\",\"description\":\"";
+  mcpAppendJsonEscaped(schema, paramDesc);
+  schema += "\"}},\"required\":[\"";
+  mcpAppendJsonEscaped(schema, paramName);
+  schema += "\"]}";
+  return schema;
+}
+
+// 添加简化的工具注册方法
+bool WebSocketMCP::ToolRegistry::registerSimpleTool(const String &name, const String &description,
+                                                    const String &paramName, const String &paramDesc,
+                                                    const String &paramType, ToolCallback callback) {
+  return registerTool(name, description, buildSimpleSchema(paramName, paramDesc, paramType), callback);
+}
+
+bool WebSocketMCP::ToolRegistry::registerSimpleTool(const String &name, const String &description,
+                                                    const String &paramName, const String &paramDesc,
+                                                    const String &paramType, ToolArgsCallback callback) {
+  return registerTool(name, description, buildSimpleSchema(paramName, paramDesc, paramType), callback);
+}
+
+// 卸载工具
+bool WebSocketMCP::ToolRegistry::unregisterTool(const String &name) {
+  int index = findTool(name.c_str(), name.length());
+  if (index >= 0) {
+    _resultCache.invalidate(_tools[index].nameHash);
+    _tools.erase(_tools.begin() + index);
+    rebuildToolIndex();
+    markToolsChanged();
+    MCP_LOGI("已卸载工具: %s", name);
+    return true;
+  }
+  MCP_LOGW("工具 %s 不存在，无法卸载", name);
+  return false;
+}
+
+// 清空所有工具
+void WebSocketMCP::ToolRegistry::clearTools() {
+  _resultCache.clear();
+  _tools.clear();
+  _toolIndex.clear();
+  markToolsChanged();
+  MCP_LOGI("已清空所有工具");
+}
+
+void WebSocketMCP::ToolRegistry::invalidateToolCache(const String &name) {
+  _resultCache.invalidate(mcpHashBytes(name.c_str(), name.length()));
+}
+
+void WebSocketMCP::ToolRegistry::clearToolCache() {
+  _resultCache.clear();
+}
+
+WebSocketMCP::CacheStats WebSocketMCP::ToolRegistry::getCacheStats() const {
+  CacheStats stats;
+  stats.hits = _resultCache.hits();
+  stats.misses = _resultCache.misses();
+  stats.entries = _resultCache.size();
+  return stats;
+}
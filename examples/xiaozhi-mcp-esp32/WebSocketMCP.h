@@ -13,12 +13,150 @@
 #include <ArduinoJson.h>  // 需要添加这个库来解析JSON
 #include <vector>
 #include <functional>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include "McpRegistry.h"
+#include "McpJsonWriter.h"
+#include "McpMsgPack.h"
+#include "McpWorkerPool.h"
+#include "McpSendQueue.h"
+#include "McpLog.h"
+#include "McpStats.h"
+#include "McpArena.h"
+#include "McpToolResult.h"
+#include "McpToolArgs.h"
+#include "McpResultCache.h"
+#include "McpResourceStore.h"
+#include "McpNetworkTask.h"
+#if defined(ARDUINO_ARCH_ESP32) && !defined(MCP_HOST_BUILD)
+#include <lwip/sockets.h>
+#endif
+
+// 工具数量上限：0表示不限(索引按需扩容)；大于0时名称索引为固定容量数组，不使用堆，
+// 工具表在构造时一次性预留；每个用registerTool注册的工具仍在堆上保存名称、描述、schema和回调
+// (std::function捕获较大时另行分配)，用registerTools注册的静态工具只保存表项指针
+#ifndef MCP_MAX_TOOLS
+#define MCP_MAX_TOOLS 0
+#endif
+
+// 异步工具线程池设置：工作任务数、排队深度、任务栈大小(字节)、任务优先级
+#ifndef MCP_ASYNC_WORKERS
+#define MCP_ASYNC_WORKERS 2
+#endif
+#ifndef MCP_ASYNC_QUEUE
+#define MCP_ASYNC_QUEUE 8
+#endif
+#ifndef MCP_ASYNC_STACK
+#define MCP_ASYNC_STACK 6144
+#endif
+#ifndef MCP_ASYNC_PRIORITY
+#define MCP_ASYNC_PRIORITY 1
+#endif
+
+// 每次loop()最多直接发送的字节数，超出的消息进入发送队列下一轮再发，避免一次塞满lwIP发送缓冲区
+#ifndef MCP_SEND_BUDGET
+#define MCP_SEND_BUDGET 4096
+#endif
+
+// 固定内存模式：请求解析文档和工具结果缓冲区在begin()中一次性分配并在每个请求间复用，
+// ping、tools/list和McpToolResult形式的工具调用不再分配堆内存，长时间运行堆状态保持不变
+// (不分配堆内存的结论来自host/中用ArduinoJson替身的长时间运行检查，尚未用真实的ArduinoJson 6.21.5验证)
+#ifndef MCP_FIXED_MEMORY
+#define MCP_FIXED_MEMORY 0
+#endif
+// 固定内存模式下请求解析文档的容量(字节)，超出的请求帧(如很大的批量请求)收到-32603错误响应
+#ifndef MCP_REQUEST_DOC_SIZE
+#define MCP_REQUEST_DOC_SIZE 4096
+#endif
+// 每个请求可用的临时内存(字节)，McpToolResult的结果文本写在这里
+#ifndef MCP_ARENA_SIZE
+#define MCP_ARENA_SIZE 2048
+#endif
+// 网络任务模式(beginTask())设置：任务栈大小(字节)、优先级、固定运行的核心
+// 默认放在WiFi协议栈所在的核心0，Arduino loop()在核心1
+#ifndef MCP_NET_TASK_STACK
+#define MCP_NET_TASK_STACK 8192
+#endif
+#ifndef MCP_NET_TASK_PRIORITY
+#define MCP_NET_TASK_PRIORITY 3
+#endif
+#ifndef MCP_NET_TASK_CORE
+#define MCP_NET_TASK_CORE 0
+#endif
+// 已连接时在套接字上每次最多阻塞的时间(毫秒)，也是post()的操作和异步结果最长的等待时间
+#ifndef MCP_NET_SLICE_MS
+#define MCP_NET_SLICE_MS 10
+#endif
+// 应用线程提交给网络任务的操作队列深度(2的幂)
+#ifndef MCP_NET_COMMAND_QUEUE
+#define MCP_NET_COMMAND_QUEUE 16
+#endif
+
+// MessagePack会话中超过该长度(字节)的JSON消息不转码，仍用文本帧发送
+#ifndef MCP_MSGPACK_MAX_MESSAGE
+#define MCP_MSGPACK_MAX_MESSAGE 8192
+#endif
+// 固定内存模式下出站消息转码文档的容量(字节)：对象和数组多于MCP_MSGPACK_MAX_CONTAINERS的消息才用文档转码，
+// 放不下的消息用文本帧发送
+#ifndef MCP_MSGPACK_DOC_SIZE
+#define MCP_MSGPACK_DOC_SIZE 12288
+#endif
+
+/**
+ * McpSocketClient
+ * 在WebSocketsClient基础上开放分片帧发送，供McpJsonWriter流式发送消息
+ */
+class McpSocketClient : public WebSocketsClient {
+public:
+  // frame前预留WEBSOCKETS_MAX_HEADER_SIZE字节，帧头直接写入该空间，避免再拷贝一次载荷
+  bool sendFragment(WSopcode_t opcode, uint8_t *frame, size_t length, bool fin) {
+    return sendFrame(&_client, opcode, frame, length, fin, true);
+  }
+  // 载荷前没有预留帧头空间(例如发送队列中的数据)，由库另行处理帧头
+  bool sendFragmentCopy(WSopcode_t opcode, const uint8_t *payload, size_t length, bool fin) {
+    return sendFrame(&_client, opcode, (uint8_t *)payload, length, fin, false);
+  }
+  // TCP(TLS)连接已建立，WebSocket握手可能尚未完成
+  bool transportConnected() { return clientIsConnected(&_client); }
+  // 在套接字上阻塞到有数据可读或超时；还没有可等待的套接字时立即返回false
+#if defined(ARDUINO_ARCH_ESP32) && !defined(MCP_HOST_BUILD)
+  bool waitReadable(uint32_t timeoutMs) {
+    if (!_client.tcp || !_client.tcp->connected()) {
+      return false;
+    }
+    // TLS层可能已缓存了解密后的数据，这时套接字本身不会再变为可读
+    if (_client.tcp->available() > 0) {
+      return true;
+    }
+#if defined(HAS_SSL)
+    int fd = _client.isSSL ? _client.ssl->fd() : _client.tcp->fd();
+#else
+    int fd = _client.tcp->fd();
+#endif
+    if (fd < 0) {
+      return false;
+    }
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(fd, &readable);
+    struct timeval timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_usec = (timeoutMs % 1000) * 1000;
+    select(fd + 1, &readable, nullptr, nullptr, &timeout);
+    return true;
+  }
+#else
+  bool waitReadable(uint32_t timeoutMs) { return hostWaitReadable(timeoutMs); }
+#endif
+};
 
 /**
  * WebSocketMCP类
  * 封装了与MCP服务器的WebSocket连接及其通信
  */
-class WebSocketMCP {
+class WebSocketMCP : private McpFrameSink {
 public:
   // 定义工具响应内容结构
   //Sending to WebSocket: {"jsonrpc":"2.0","id":48,"result":{"content":[{"type":"text","text":"{\n  \"success\": true,\n  \"result\": 2\n}"}],"isError":false}}
@@ -37,22 +175,8 @@ public:
       ToolContentItem item;
       item.type = "text";
       
-      // 尝试检测是否为JSON并格式化（通过查找开头的 { 和结尾的 }）
-      String trimmedText = textContent;
-      trimmedText.trim();
-      
-      if (trimmedText.startsWith("{") && trimmedText.endsWith("}")) {
-        // 使用WebSocketMCP的formatJsonString方法格式化
-        // 由于这是一个静态方法内，我们需要创建一个临时实例来调用非静态方法
-        WebSocketMCP* instance = WebSocketMCP::instance;
-        if (instance) {
-          item.text = instance->formatJsonString(textContent);
-        } else {
-          item.text = textContent;
-        }
-      } else {
-        item.text = textContent;
-      }
+      // 文本原样返回，不再解析重排；需要格式化的结果用McpToolResult结构化写入
+      item.text = textContent;
       
       content.push_back(item);
       isError = error;
@@ -78,7 +202,69 @@ public:
     }
   };
 
-  // 用于参数处理的辅助类
+  /**
+   * 参数视图：不拥有数据，直接读取请求帧解析结果中的某个值(arguments或其中嵌套的对象/数组元素)
+   * 每个访问函数只查找一次键；视图和它引用的数据一样只在工具回调执行期间有效
+   */
+  class ToolParamsView {
+  public:
+    ToolParamsView() {}
+    // 可由JsonVariantConst、JsonObjectConst、JsonArrayConst等构造
+    template<typename TVariant>
+    ToolParamsView(const TVariant &root) : _root(root) {}
+
+    // 键不存在或值为null时返回defaultValue
+    template<typename T>
+    T get(const char *key, T defaultValue) const {
+      JsonVariantConst value = _root[key];
+      return value.isNull() ? defaultValue : value.as<T>();
+    }
+    template<typename T>
+    T get(const String &key, T defaultValue) const { return get<T>(key.c_str(), defaultValue); }
+
+    JsonVariantConst getJsonValue(const char *key) const { return _root[key]; }
+    JsonVariantConst getJsonValue(const String &key) const { return _root[key.c_str()]; }
+
+    // 值不是数组时返回空数组(isNull()为true，size()为0)
+    JsonArrayConst getJsonArray(const char *key) const { return _root[key].as<JsonArrayConst>(); }
+    JsonArrayConst getJsonArray(const String &key) const { return getJsonArray(key.c_str()); }
+    bool isArray(const char *key) const { return _root[key].is<JsonArrayConst>(); }
+    bool isArray(const String &key) const { return isArray(key.c_str()); }
+    size_t getArraySize(const char *key) const { return getJsonArray(key).size(); }
+    size_t getArraySize(const String &key) const { return getArraySize(key.c_str()); }
+
+    bool contains(const char *key) const { return _root.as<JsonObjectConst>().containsKey(key); }
+    bool contains(const String &key) const { return contains(key.c_str()); }
+
+    // 嵌套对象和数组元素同样以视图返回，不拷贝
+    ToolParamsView child(const char *key) const { return ToolParamsView(_root[key]); }
+    ToolParamsView child(const String &key) const { return child(key.c_str()); }
+    ToolParamsView at(size_t index) const { return ToolParamsView(_root[index]); }
+    // 根为数组时的元素个数，为对象时的键个数
+    size_t size() const { return _root.size(); }
+
+    bool isJsonObject() const { return _root.is<JsonObjectConst>(); }
+    bool isJsonArray() const { return _root.is<JsonArrayConst>(); }
+    JsonObjectConst getAsJsonObject() const { return _root.as<JsonObjectConst>(); }
+    JsonArrayConst getAsJsonArray() const { return _root.as<JsonArrayConst>(); }
+    JsonVariantConst variant() const { return _root; }
+
+    String getDebugJson() const {
+      String result;
+      serializeJson(_root, result);
+      return result;
+    }
+
+    bool isValid() const { return !_root.isNull(); }
+
+  private:
+    JsonVariantConst _root;
+  };
+
+  /**
+   * 拥有数据的参数对象：把参数复制到自己的文档中
+   * 只在参数需要保存到回调返回之后时使用，其余情况使用ToolParamsView
+   */
   class ToolParams {
   public:
     ToolParams(const String& json) {
@@ -86,89 +272,67 @@ public:
       valid = !error;
     }
 
-    // NEW: Static factory method from JsonVariantConst
-    // This creates a new ToolParams instance by serializing the variant and re-parsing it.
-    // Useful for handling items from JsonArray or nested JsonObjects reliably.
+    // 复制variant到新文档(直接复制节点，不经过序列化和二次解析)
+    explicit ToolParams(JsonVariantConst variant) {
+      valid = doc.set(variant) && !doc.overflowed();
+    }
+
+    // 需要拥有数据时使用；只是读取嵌套对象或数组元素时用ToolParamsView(variant)，不拷贝
     static ToolParams fromVariant(const JsonVariantConst& variant) {
-      String variantJson;
-      serializeJson(variant, variantJson);
-      return ToolParams(variantJson);
+      return ToolParams(variant);
+    }
+
+    // 当前文档的视图
+    ToolParamsView view() const {
+      return valid ? ToolParamsView(doc.as<JsonVariantConst>()) : ToolParamsView();
     }
     
     template<typename T>
     T get(const String& key, T defaultValue) const {
-      if (!valid || !doc.is<JsonObject>() || !doc.as<JsonObjectConst>().containsKey(key)) {
-        return defaultValue;
-      }
-      return doc.as<JsonObjectConst>()[key].as<T>();
+      return view().get<T>(key, defaultValue);
     }
     
     JsonVariantConst getJsonValue(const String& key) const {
-      if (!valid || !doc.is<JsonObject>() || !doc.as<JsonObjectConst>().containsKey(key)) {
-        return JsonVariantConst();
-      }
-      return doc.as<JsonObjectConst>()[key];
+      return view().getJsonValue(key);
     }
     
     JsonArrayConst getJsonArray(const String& key) const {
-      if (!valid || !doc.is<JsonObject>() || !doc.as<JsonObjectConst>().containsKey(key) || !doc.as<JsonObjectConst>()[key].is<JsonArray>()) {
-        return JsonArrayConst();
-      }
-      return doc.as<JsonObjectConst>()[key].as<JsonArrayConst>();
+      return view().getJsonArray(key);
     }
     
     bool isArray(const String& key) const {
-      if (!valid || !doc.is<JsonObject>() || !doc.as<JsonObjectConst>().containsKey(key)) {
-        return false;
-      }
-      return doc.as<JsonObjectConst>()[key].is<JsonArray>();
+      return view().isArray(key);
     }
     
     size_t getArraySize(const String& key) const {
-      if (!valid || !doc.is<JsonObject>() || !doc.as<JsonObjectConst>().containsKey(key) || !doc.as<JsonObjectConst>()[key].is<JsonArray>()) {
-        return 0;
-      }
-      return doc.as<JsonObjectConst>()[key].as<JsonArrayConst>().size();
+      return view().getArraySize(key);
     }
 
-    // NEW: Method to check if the root of this ToolParams' document is a JSON object
     bool isJsonObject() const {
-      return valid && doc.is<JsonObject>();
+      return view().isJsonObject();
     }
 
-    // NEW: Method to check if the root of this ToolParams' document is a JSON array
     bool isJsonArray() const {
-      return valid && doc.is<JsonArray>();
+      return view().isJsonArray();
     }
 
-    // NEW: Method to get the root as a JsonObjectConst if it is one
     JsonObjectConst getAsJsonObject() const {
-      if (isJsonObject()) {
-        return doc.as<JsonObjectConst>();
-      }
-      return JsonObjectConst(); // Returns a null JsonObjectConst
+      return view().getAsJsonObject();
     }
 
-    // NEW: Method to get the root as a JsonArrayConst if it is one
     JsonArrayConst getAsJsonArray() const {
-      if (isJsonArray()) {
-        return doc.as<JsonArrayConst>();
-      }
-      return JsonArrayConst(); // Returns a null JsonArrayConst
+      return view().getAsJsonArray();
     }
     
     bool contains(const String& key) const {
-      return valid && doc.is<JsonObject>() && doc.as<JsonObjectConst>().containsKey(key);
+      return view().contains(key);
     }
     
     String getDebugJson() const {
-      String result;
-      if (valid) {
-        serializeJson(doc, result);
-      } else {
-        result = "{\"error\":\"Invalid JSON document in ToolParams\"}";
+      if (!valid) {
+        return "{\"error\":\"Invalid JSON document in ToolParams\"}";
       }
-      return result;
+      return view().getDebugJson();
     }
     
     bool isValid() const {
@@ -183,6 +347,110 @@ public:
   // 重新定义工具回调函数类型 - 接收JSON字符串参数，返回ToolResponse结构
   typedef std::function<ToolResponse(const String&)> ToolCallback; // 更改为接收 ToolParams&
 
+  // 工具回调函数类型 - 直接接收请求帧解析出的arguments对象，不再序列化和二次解析
+  // 注意：arguments借用自当前请求帧的解析结果，只在回调执行期间有效，不要保存
+  typedef std::function<ToolResponse(JsonObjectConst)> ToolArgsCallback;
+
+  // 工具回调函数类型 - 结果直接写入result(print/printf)，不构造ToolResponse和String
+  // result的缓冲区来自每个请求复位一次的内存区(MCP_ARENA_SIZE)，适合长时间运行的设备
+  typedef std::function<void(JsonObjectConst, McpToolResult&)> ToolResultCallback;
+
+  /**
+   * 异步工具的应答句柄
+   * 可以复制、可以在任意线程调用respond()，只有第一次调用有效
+   * 所有副本都销毁而仍未应答时，自动返回错误响应，保证每个请求都有回复
+   */
+  class ToolResponder {
+  public:
+    ToolResponder() {}
+    bool respond(const ToolResponse &response) const;
+    // 请求带有progressToken时发送notifications/progress(可在任意线程调用，应答之后无效)，返回是否已提交
+    bool progress(double progress, double total = 0, const char *message = nullptr) const;
+    bool isValid() const { return _state != nullptr; }
+
+  private:
+    friend class WebSocketMCP;
+    struct State;
+    explicit ToolResponder(const std::shared_ptr<State> &state) : _state(state) {}
+    std::shared_ptr<State> _state;
+  };
+
+  // 异步工具回调函数类型 - 在工作线程中执行，结果通过responder返回
+  // arguments在回调返回前有效；回调可以把responder交给其他任务稍后应答
+  typedef std::function<void(JsonObjectConst, ToolResponder)> AsyncToolCallback;
+
+  /**
+   * 流式工具的输出：内容项在产生时直接写入WebSocket帧，不先收集到ToolResponse::content中
+   * 第一项内容开始输出前可以用progress()报告进度；回调返回后自动结束响应
+   *
+   *   stream.progress(1, 3, "扫描客厅");
+   *   stream.text("第一项");
+   *   stream.beginText();
+   *   stream.printf("%s: %d\n", name, value);   // 多次写入同一项
+   *   stream.endText();
+   */
+  class ToolStream : public Print {
+  public:
+    // 请求带有progressToken时发送notifications/progress；开始输出内容后或在批量请求中不再发送，返回是否已发送
+    bool progress(double progress, double total = 0, const char *message = nullptr);
+    bool hasProgressToken() const { return !_progressToken.isNull(); }
+
+    // 输出一个完整的text内容项
+    ToolStream &text(const char *text);
+    ToolStream &text(const char *text, size_t length);
+    // 分段输出一个text内容项：之间print/printf/write的内容都写入这一项(不在项内时write会自动开始一项)
+    ToolStream &beginText();
+    ToolStream &endText();
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *data, size_t length) override;
+    using Print::write;
+    // 不等凑满一个分片帧，把已输出的内容立即发出
+    void flush() override;
+
+    void setError(bool error = true) { _error = error; }
+    bool isError() const { return _error; }
+
+  private:
+    friend class WebSocketMCP;
+    ToolStream(WebSocketMCP &owner, JsonVariantConst id, JsonVariantConst progressToken)
+        : _owner(owner), _id(id), _progressToken(progressToken) {}
+    // 第一项内容之前写出响应头
+    McpJsonWriter &open();
+    // 回调返回后结束响应
+    void finish();
+
+    WebSocketMCP &_owner;
+    JsonVariantConst _id;
+    JsonVariantConst _progressToken;
+    bool _opened = false;
+    bool _inText = false;
+    bool _error = false;
+    size_t _items = 0;
+  };
+
+  // 流式工具回调函数类型 - 在loop()线程中执行，内容通过stream边产生边发送
+  typedef std::function<void(JsonObjectConst, ToolStream&)> ToolStreamCallback;
+
+  /**
+   * 静态工具表项：名称、描述和schema引用常量字符串(ESP32上常量数据直接从flash读取)，注册时不复制到堆上
+   * 表应为全局常量，注册后一直有效；在begin()之前注册一次即可，重连不需要重新注册
+   *
+   *   static const WebSocketMCP::StaticTool TOOLS[] = {
+   *     {"system-info", "获取系统信息", "{\"type\":\"object\",\"properties\":{}}", systemInfo, nullptr, 5000},
+   *     {"led_blink", "控制LED", LED_SCHEMA, nullptr, ledBlink, 0},
+   *   };
+   *   mcpClient.registerTools(TOOLS);
+   */
+  struct StaticTool {
+    const char *name;
+    const char *description;
+    const char *inputSchema;
+    void (*result)(JsonObjectConst arguments, McpToolResult &result);  // 同步工具，结果写入McpToolResult
+    void (*async)(JsonObjectConst arguments, ToolResponder responder); // 异步工具，与result二选一
+    uint32_t cacheTtlMs;                                               // 同registerTool的cacheTtlMs
+  };
+
   // 回调类型定义
   // 输出回调：void(const String&)
   typedef void (*OutputCallback)(const String&);
@@ -191,7 +459,22 @@ public:
   // 连接状态回调：void(bool)
   typedef void (*ConnectionCallback)(bool);
 
+  /**
+   * 工具注册表：工具列表、名称索引、tools/list目录缓存和结果缓存
+   * 可由多个WebSocketMCP实例共享(例如同时连接云端和局域网的两个端点)，工具只注册一次，
+   * 各实例保留自己的连接、请求分发和发送队列；共享的实例须在同一任务中调用loop()和注册方法
+   */
+  class ToolRegistry;
+
+  // 使用实例自己的工具注册表
   WebSocketMCP();
+  // 使用共享的工具注册表，registry的生命周期须长于本实例
+  explicit WebSocketMCP(ToolRegistry &registry);
+  // 先停止网络任务，再等工作线程执行完已提交的任务(其结果不再发送)，之后才销毁其他成员
+  ~WebSocketMCP();
+
+  // 本实例使用的工具注册表
+  ToolRegistry &registry() { return *_registry; }
 
   /**
    * 初始化WebSocket连接
@@ -202,20 +485,61 @@ public:
    * @return 初始化是否成功
    * 
    * 注意：连接会使用以下超时设置：
-   * - PING_INTERVAL: 心跳ping间隔，默认为45秒
-   * - DISCONNECT_TIMEOUT: 断开连接超时，默认为60秒
-   * - INITIAL_BACKOFF: 初始重连等待时间，默认为1秒
+   * - PING_INTERVAL: 心跳ping间隔，默认为10秒
+   * - DISCONNECT_TIMEOUT: 断开连接超时，默认为60秒(连续DISCONNECT_TIMEOUT / PING_INTERVAL次收不到pong)
+   * - INITIAL_BACKOFF: 最短重连等待时间，默认为1秒
    * - MAX_BACKOFF: 最大重连等待时间，默认为60秒
+   * 断开后的重连时间由本类按去相关抖动退避安排，不使用WebSocket库自己的固定间隔
    */
   bool begin(const char *mcpEndpoint, ConnectionCallback connCb = nullptr);
 
+  /**
+   * 以网络任务模式启动：连接、请求处理和工具回调都在独立的任务中进行，
+   * 没有工作时阻塞在套接字上，不依赖loop()被调用的频率
+   * loop()仍需在主循环中调用，它只在调用线程上执行连接状态回调，不再处理网络
+   * 启动后在主循环中操作本对象(发送消息、注册工具、断开连接等)需通过post()交给网络任务
+   * 共享工具注册表的实例不能使用(注册表没有加锁，只能在一个任务中访问)，返回false
+   * 参数与begin()相同
+   */
+  bool beginTask(const char *mcpEndpoint, ConnectionCallback connCb = nullptr);
+
+  // 提交给网络任务执行的操作
+  typedef std::function<void(WebSocketMCP &mcp)> Command;
+  /**
+   * 在网络任务中执行command；未使用网络任务模式或已在网络任务中(如工具回调里)时立即执行
+   * 除网络任务外只能从一个线程(通常是Arduino主循环)调用
+   * @return 是否已执行或已提交(队列已满时返回false)
+   */
+  bool post(Command command);
+  // 是否以网络任务模式运行
+  bool isTaskMode() const { return _taskMode; }
+
   /**
    * 发送数据到WebSocket服务器(相当于stdin)
+   * 未连接或队列中还有更早的消息时先放入发送队列，连接恢复后依次发出
+   * 批量响应或流式工具的响应正在写出时，消息暂存到该响应发完之后再发
    * @param message 要发送的消息
-   * @return 发送是否成功
+   * @return 是否已发送、已加入发送队列或已暂存(队列已满或暂存超过MCP_SEND_QUEUE_BYTES时返回false)
    */
   bool sendMessage(const String &message);
 
+  // 发送队列统计
+  struct SendQueueStats {
+    size_t queuedMessages;   // 当前排队的消息数
+    size_t queuedBytes;      // 当前占用字节数
+    size_t controlHighWater; // 控制通道占用最高值(字节)
+    size_t bulkHighWater;    // 普通通道占用最高值(字节)
+    uint32_t dropped;        // 因队列已满丢弃的消息数
+  };
+  SendQueueStats getSendQueueStats() const;
+
+  // 运行统计：各阶段耗时、消息大小、堆内存低水位、重连次数
+  const McpServerStats &getStats() const { return _stats; }
+  // 指定工具的统计，工具不存在时返回nullptr
+  const McpToolStats *getToolStats(const String &name) const;
+  // 全部统计(含有调用记录的工具)序列化为JSON，延迟为估算值(微秒)
+  String getStatsJson() const;
+
   /**
    * 处理WebSocket事件和保持连接
    * 需要在主循环中频繁调用
@@ -235,64 +559,403 @@ public:
 
   /**
    * 设置日志级别和回调函数
-   * @param level 日志级别
-   * @param logCb 日志回调函数
+   * @param level 日志级别(MCP_LOG_LEVEL_ERROR ~ MCP_LOG_LEVEL_DEBUG)，
+   *              高于编译期MCP_LOG_LEVEL的日志已在编译时移除，这里无法再打开
+   * @param logCb 日志回调函数，在后台日志任务中调用；为空时输出到Serial
    */
+  void setLogLevel(int level, McpLog::Callback logCb = nullptr);
+
+  /**
+   * 设置McpToolResult结构化写入的输出格式
+   * @param pretty true为带换行和缩进(默认)，false为紧凑格式(消息更短)
+   */
+  void setPrettyResults(bool pretty) { _prettyResults = pretty; }
+
+  /**
+   * 允许使用MessagePack二进制帧(默认关闭，需在begin()之前调用)
+   * 开启后接受MessagePack编码的二进制帧请求；客户端以二进制帧发送initialize时，
+   * 本次连接的响应和通知也改为MessagePack二进制帧，否则仍为JSON文本帧
+   */
+  void setBinaryEncoding(bool enable) { _binaryEnabled = enable; }
+  // 本次连接的出站消息是否使用MessagePack
+  bool isBinarySession() const { return _binarySession; }
 
   // 工具注册和管理方法
-  bool registerTool(const String &name, const String &description, const String &inputSchema, ToolCallback callback);
+  // cacheTtlMs大于0时工具视为幂等：相同参数的调用在cacheTtlMs毫秒内直接返回缓存的结果(出错的结果不缓存)
+  bool registerTool(const String &name, const String &description, const String &inputSchema, ToolCallback callback,
+                    uint32_t cacheTtlMs = 0);
+  // 注册直接接收arguments对象的工具(推荐，省去参数的序列化和二次解析)
+  bool registerTool(const String &name, const String &description, const String &inputSchema, ToolArgsCallback callback,
+                    uint32_t cacheTtlMs = 0);
+  // 注册把结果写入McpToolResult的工具(调用时不分配堆内存)
+  bool registerTool(const String &name, const String &description, const String &inputSchema, ToolResultCallback callback,
+                    uint32_t cacheTtlMs = 0);
+  /**
+   * 注册类型化参数的工具：inputSchema由参数描述生成，arguments按描述校验并解码后才调用工具，
+   * 校验不通过时直接返回错误响应，工具不会被调用
+   * @param args mcpArgs(McpArg<T0>(...), McpArg<T1>(...), ...)
+   * @param callback void(McpToolResult &result, T0 arg0, T1 arg1, ...)
+   */
+  template<typename... Ts, typename F>
+  bool registerTool(const String &name, const String &description, const McpArgList<Ts...> &args, F callback,
+                    uint32_t cacheTtlMs = 0) {
+    return registerTool(name, description, mcpBuildArgsSchema(args.specs.data(), args.specs.size()),
+                        ToolResultCallback(mcpTypedToolCallback(args, callback)), cacheTtlMs);
+  }
   // 简化工具注册API
   bool registerSimpleTool(const String &name, const String &description, 
                          const String &paramName, const String &paramDesc, 
                          const String &paramType, ToolCallback callback);
+  bool registerSimpleTool(const String &name, const String &description, 
+                         const String &paramName, const String &paramDesc, 
+                         const String &paramType, ToolArgsCallback callback);
+  // 注册流式工具：可以发送进度通知，内容项边产生边发送(结果不缓存)
+  bool registerStreamingTool(const String &name, const String &description, const String &inputSchema, ToolStreamCallback callback);
+  // 注册异步工具：回调在工作线程池中执行，不阻塞loop()，多个调用可以并行
+  bool registerAsyncTool(const String &name, const String &description, const String &inputSchema, AsyncToolCallback callback);
+  // 注册静态工具表，返回是否全部注册成功
+  bool registerTools(const StaticTool *tools, size_t count);
+  template<size_t N>
+  bool registerTools(const StaticTool (&tools)[N]) { return registerTools(tools, N); }
+  // 注册内置的统计工具，返回本实例getStatsJson()的内容
+  bool registerStatsTool(const String &name = "mcp-stats");
   
   bool unregisterTool(const String &name);
   size_t getToolCount();
   void clearTools();
 
+  // 使指定工具的缓存结果失效(例如设备状态已被其他工具改变)
+  void invalidateToolCache(const String &name);
+  void clearToolCache();
+  // 结果缓存统计
+  struct CacheStats {
+    uint32_t hits;
+    uint32_t misses;
+    size_t entries;
+  };
+  CacheStats getCacheStats() const;
+
+  /**
+   * 资源：应用把设备状态写入本地缓存，客户端通过resources/list、resources/read直接读取，不必调用工具；
+   * 订阅了某个资源的客户端在其内容变化后收到notifications/resources/updated(一轮loop()内多次变化合并为一次)
+   * 以下方法只能在loop()所在线程调用，网络任务模式下通过post()调用
+   * @param uri 资源URI，如"device://living-room/light"
+   * @param mimeType 内容类型，updateResource()写入的文本按此类型提供
+   */
+  bool registerResource(const String &uri, const String &name, const String &description = "",
+                        const String &mimeType = "application/json");
+  // 写入资源内容，返回内容是否有变化(与当前内容相同时不通知客户端)；资源需先注册
+  bool updateResource(const String &uri, const char *text, size_t length);
+  bool updateResource(const String &uri, const String &text) {
+    return updateResource(uri, text.c_str(), text.length());
+  }
+  bool unregisterResource(const String &uri);
+  size_t getResourceCount() const { return _resources.size(); }
+  void clearResources();
+
 private:
-  WebSocketsClient webSocket;
+  // 流式消息写入器，响应按块直接写入WebSocket帧
+  McpJsonWriter _writer;
+  // 批量请求处理期间，各响应写入同一个数组消息，endMessage()不结束消息
+  // lane指定消息进入发送队列时使用的通道
+  // 对请求的响应(reply)在已连接时总是直接发送，不受本轮发送预算限制，不会因队列已满被丢弃；
+  // 通知(reply为false)受预算限制，队列满时丢弃
+  McpJsonWriter &beginMessage(McpSendQueue::Lane lane = McpSendQueue::LANE_BULK, bool reply = true);
+  bool endMessage();
+  bool _inBatch = false;
+  size_t _batchResponses = 0;
+  // 流式工具的响应正在写出，期间其他消息进入发送队列
+  bool _streamOpen = false;
+  bool writeFrame(uint8_t *frame, size_t length, bool first, bool fin) override;
+  // 文本分片：直接发出或写入发送队列；frame非空时payload前有预留的帧头空间
+  bool writeTextFrame(uint8_t *frame, const uint8_t *payload, size_t length, bool first, bool fin);
+
+  // MessagePack二进制帧：出站消息仍由McpJsonWriter写成JSON，整条写完后转码发送；
+  // 发送队列中保存JSON原文，发送时按当时连接的编码转码
+  bool _binaryEnabled = false;
+  bool _binarySession = false;  // 本次连接的出站消息用MessagePack编码
+  // 批量请求中的initialize：响应数组沿用原编码，数组发出后才切换为pendingBinarySession
+  bool _binarySwitchPending = false;
+  bool _pendingBinarySession = false;
+  bool _inboundBinary = false;  // 正在处理的请求帧是MessagePack
+  bool _binaryOverflow = false; // 当前消息超过MCP_MSGPACK_MAX_MESSAGE，改用文本帧
+  std::vector<uint8_t> _binaryText;  // 正在写出(或从队列取出)的消息的JSON文本
+  std::vector<uint8_t> _binaryFrame; // 转码结果，前面预留帧头空间
+  size_t _binaryLength = 0;          // _binaryFrame中MessagePack数据的长度
+  uint32_t _packCounts[MCP_MSGPACK_MAX_CONTAINERS]; // 直接转码时各对象/数组的成员数
+#if MCP_FIXED_MEMORY
+  std::unique_ptr<DynamicJsonDocument> _transcodeDoc;
+#endif
+  bool sendBinaryMessage();
+  // 发出一条完整的消息，MessagePack会话中先转码，无法转码时仍用文本帧
+  bool sendWholeMessage(const uint8_t *json, size_t length);
+  bool encodeMsgPack(const uint8_t *json, size_t length);
+  // MessagePack会话中发出result部分已编码好的响应，无法直接发送时返回false
+  bool sendPackedResult(JsonVariantConst id, const std::vector<uint8_t> &result);
+
+  // 发送队列：断线期间暂存消息，重连后先发控制通道再发普通通道
+  McpSendQueue _sendQueue;
+  McpSendQueue::Lane _messageLane = McpSendQueue::LANE_BULK;
+  bool _messageQueued = false; // 当前消息写入队列而不是直接发送
+  bool _messageReply = true;   // 当前消息是对请求的响应
+  size_t _sentThisLoop = 0;    // 本轮loop()已发送的字节数
+  bool canSendDirect(McpSendQueue::Lane lane, bool reply = false) const;
+  void flushSendQueue();
+  // 发出排在lane的消息之前的全部排队消息(不受预算限制)
+  void flushAheadOf(McpSendQueue::Lane lane);
+  bool sendQueuedMessage(const McpMessageRing &ring);
+  // 批量响应或流式响应写出期间sendMessage()收到的消息，响应发完后按序发出
+  // 不能放进发送队列：写出中的响应可能正占用普通通道，控制通道只为短消息预留
+  std::vector<String> _deferred;
+  size_t _deferredBytes = 0;
+  void sendDeferred();
+
+  McpSocketClient webSocket;
   ConnectionCallback connectionCallback;
 
-  bool connected;
+  std::atomic<bool> connected; // 网络任务模式下由网络任务写入，isConnected()可在其他线程读取
   unsigned long lastReconnectAttempt;
 
   // 重连设置
-  static const int INITIAL_BACKOFF = 1000; // 初始等待时间(毫秒)
+  // WebSocket库每次连接都新建TLS客户端且不开放会话缓存，重连时无法复用TLS会话，
+  // 完整握手的耗时计入stats中的reconnect/ready；DNS结果由lwIP按TTL缓存
+  static const int INITIAL_BACKOFF = 1000; // 最短等待时间(毫秒)
   static const int MAX_BACKOFF = 60000;    // 最大等待时间(毫秒)
   static const int PING_INTERVAL = 10000;  // ping发送间隔(毫秒)
   static const int DISCONNECT_TIMEOUT = 60000; // 断开连接超时(毫秒)
-  int currentBackoff;
+  // WebSocket库按连续收不到pong的次数判定断开，次数只能是uint8_t
+  static const uint8_t DISCONNECT_PONG_COUNT = DISCONNECT_TIMEOUT / PING_INTERVAL;
+  int currentBackoff;   // 上一次的等待时间(毫秒)
   int reconnectAttempt;
+  unsigned long _nextReconnectAt = 0; // 下一次发起连接的时间
+  bool _connectAttempt = false;       // 已发起连接，尚未连上或确认失败
+  unsigned long _disconnectedAt = 0;  // 断开(或begin())的时间
+  bool _timingReconnect = false;      // 正在统计从断开到重新可用的时间
+
+  // WebSocket事件处理函数，由begin()中注册的回调转发到本实例
+  void handleWebSocketEvent(WStype_t type, uint8_t *payload, size_t length);
+  // 连接状态变化：网络任务模式下交给应用线程，否则直接调用回调
+  void notifyConnection(bool state);
 
-  // WebSocket事件处理函数
-  static void webSocketEvent(WStype_t type, uint8_t *payload, size_t length);
-  static WebSocketMCP *instance;
+  // 处理一轮连接、请求和发送(轮询模式下即loop())
+  void service();
+  // 网络任务模式
+  bool _taskMode = false;
+  McpSpscQueue<Command, MCP_NET_COMMAND_QUEUE> _commands; // 应用线程 -> 网络任务
+  McpSpscQueue<uint8_t, 8> _connectionEvents;             // 网络任务 -> 应用线程，1为连上，0为断开
+  // 网络任务的一轮：执行提交的操作和service()，没有待办工作时阻塞等待
+  void networkTaskStep();
+  bool hasPendingWork();
 
   // 重连处理
   void handleReconnect();
+  void scheduleReconnect();
   void resetReconnectParams();
 
   // 新增成员
   unsigned long lastPingTime = 0;
-  void handleJsonRpcMessage(const String &message);
+  // 处理一帧JSON-RPC消息(binary为true时是MessagePack)，payload会被原地解析(字符串不拷贝)，调用期间必须保持有效
+  void handleJsonRpcMessage(char *payload, size_t length, bool binary = false);
+  // 按方法名分发单个请求，无效请求和(带id的)未知方法回复JSON-RPC错误
+  void dispatchRequest(JsonVariantConst message);
+  // 处理JSON-RPC批量请求，所有响应合并为一个数组帧
+  void handleBatch(JsonArrayConst batch);
+  // initialize响应之后待发送的initialized通知(批量请求结束后再发，不混入响应数组)
+  bool _initializedPending = false;
+
+  // JSON-RPC方法处理函数
+  void handlePing(JsonObjectConst request);
+  void handleInitialize(JsonObjectConst request);
+  void handleToolsList(JsonObjectConst request);
+  void handleToolsCall(JsonObjectConst request);
+  void handleResourcesList(JsonObjectConst request);
+  void handleResourcesRead(JsonObjectConst request);
+  void handleResourcesSubscribe(JsonObjectConst request);
+  void handleResourcesUnsubscribe(JsonObjectConst request);
+  // 发送JSON-RPC错误响应
+  void sendError(JsonVariantConst id, long code, const char *message);
+  // id为请求id的JSON原文(解析失败时无法再从文档中取得)
+  void sendError(const char *idJson, long code, const char *message);
+
+  // 方法分发表项
+  typedef void (WebSocketMCP::*MethodHandler)(JsonObjectConst request);
+  struct MethodEntry {
+    const char *name;
+    uint32_t hash;
+    MethodHandler handler;
+  };
+  static const MethodEntry METHOD_TABLE[];
+  static const size_t MAX_METHODS = 16;
+  McpHashIndex<MAX_METHODS> _methodIndex;
+
+  // 工具回调，各种形式只设置其中一种
+  struct ToolHandlers {
+    ToolCallback callback;           // 接收JSON字符串
+    ToolArgsCallback argsCallback;   // 接收arguments对象
+    ToolResultCallback resultCallback; // 结果写入McpToolResult
+    AsyncToolCallback asyncCallback; // 在工作线程池中异步执行
+    ToolStreamCallback streamCallback; // 内容流式写出
+  };
 
   // 工具结构定义
   struct Tool {
     String name;           // 工具名称
+    uint32_t nameHash;     // 名称哈希，注册时计算
     String description;    // 工具描述 
     String inputSchema;    // 工具输入schema(JSON格式)
-    ToolCallback callback; // 工具调用回调函数
+    const StaticTool *entry = nullptr; // 静态工具表项，非空时名称、描述和schema引用表项，上面三个字段为空
+    ToolHandlers handlers; // 工具调用回调函数
+    uint32_t cacheTtl;     // 结果缓存有效期(毫秒)，0表示不缓存
+    McpToolStats stats;    // 调用统计
+
+    const char *nameText() const { return entry ? entry->name : name.c_str(); }
+    const char *descriptionText() const { return entry ? entry->description : description.c_str(); }
+    const char *schemaText() const { return entry ? entry->inputSchema : inputSchema.c_str(); }
   };
 
-  // 工具列表
-  std::vector<Tool> _tools;
+  // 写入notifications/progress中progressToken之后的部分
+  static void writeProgress(McpJsonWriter &out, double progress, double total, const char *message);
+
+  // 写入tools/call响应中id之后的部分
+  void writeToolResult(McpJsonWriter &out, const ToolResponse &toolResponse);
+  void writeToolResult(McpJsonWriter &out, const McpToolResult &result);
+
+  bool _prettyResults = true;
+
+  // 每个请求的临时内存，处理完一帧后复位
+  McpArena _arena;
+#if MCP_FIXED_MEMORY
+  // 复用的请求解析文档，begin()时分配
+  std::unique_ptr<DynamicJsonDocument> _requestDoc;
+#endif
+
+  // 异步工具调用
+  struct AsyncResult {
+    String idJson;       // 请求id(JSON文本)，进度通知为progressToken
+    String toolName;
+    uint32_t elapsedMicros; // 从提交到返回结果的耗时
+    ToolResponse response;
+    // 进度通知(isProgress为true时只使用idJson和以下字段)
+    bool isProgress = false;
+    double progress = 0;
+    double total = 0;
+    String message;
+  };
+  void startAsyncCall(const Tool &tool, JsonVariantConst id, JsonVariantConst progressToken, JsonObjectConst arguments);
+  // 工作线程提交结果，由loop()线程统一发送
+  void postAsyncResult(const ToolResponder::State &state, const ToolResponse &response);
+  void postAsyncProgress(const ToolResponder::State &state, double progress, double total, const char *message);
+  void sendAsyncResults();
+  std::mutex _asyncMutex;
+  std::deque<AsyncResult> _asyncResults;
+  // 运行统计
+  McpServerStats _stats;
+  unsigned long _lastHeapSample = 0;
+  void sampleHeap(bool includeLargestBlock);
+
+  // 由析构函数在网络任务之后停止，工作线程提交结果时用到的成员都还有效
+  McpWorkerPool _workers;
+
+  // 工具注册表：默认构造时为自己持有的_ownedRegistry，否则指向共享的注册表
+  std::unique_ptr<ToolRegistry> _ownedRegistry;
+  ToolRegistry *_registry;
+
+  // 客户端已完成initialize，之后的注册表变化需要发送list_changed通知
+  bool _clientInitialized = false;
+  // 客户端最近一次拿到的工具目录对应的注册表版本，与当前版本不同时发送list_changed
+  uint32_t _toolsVersion = 0;
+
+  // 资源存储及客户端最近一次拿到的资源列表版本
+  McpResourceStore _resources;
+  uint32_t _resourcesVersion = 0;
+  // 发送资源列表变化和已订阅资源的内容变化通知
+  void sendResourceNotifications();
 
   // 辅助方法
-  String escapeJsonString(const String &input);
-  
-  // 格式化JSON字符串，每个键值对占一行
-  String formatJsonString(const String &jsonStr);
+  static String escapeJsonString(const String &input);
+
+  // 由析构函数最先停止；停止后wake()不做任何事，工作线程仍可安全调用
+  McpNetworkTask _netTask;
+};
+
+class WebSocketMCP::ToolRegistry {
+public:
+  ToolRegistry();
+
+  // 注册方法与WebSocketMCP的同名方法相同，注册的工具对共享本注册表的所有实例可见
+  bool registerTool(const String &name, const String &description, const String &inputSchema, ToolCallback callback,
+                    uint32_t cacheTtlMs = 0);
+  bool registerTool(const String &name, const String &description, const String &inputSchema, ToolArgsCallback callback,
+                    uint32_t cacheTtlMs = 0);
+  bool registerTool(const String &name, const String &description, const String &inputSchema, ToolResultCallback callback,
+                    uint32_t cacheTtlMs = 0);
+  template<typename... Ts, typename F>
+  bool registerTool(const String &name, const String &description, const McpArgList<Ts...> &args, F callback,
+                    uint32_t cacheTtlMs = 0) {
+    return registerTool(name, description, mcpBuildArgsSchema(args.specs.data(), args.specs.size()),
+                        ToolResultCallback(mcpTypedToolCallback(args, callback)), cacheTtlMs);
+  }
+  bool registerSimpleTool(const String &name, const String &description,
+                          const String &paramName, const String &paramDesc,
+                          const String &paramType, ToolCallback callback);
+  bool registerSimpleTool(const String &name, const String &description,
+                          const String &paramName, const String &paramDesc,
+                          const String &paramType, ToolArgsCallback callback);
+  // 异步工具由调用它的实例在自己的工作线程池中执行(第一次调用时启动)
+  bool registerAsyncTool(const String &name, const String &description, const String &inputSchema, AsyncToolCallback callback);
+  bool registerStreamingTool(const String &name, const String &description, const String &inputSchema, ToolStreamCallback callback);
+  bool registerTools(const StaticTool *tools, size_t count);
+  template<size_t N>
+  bool registerTools(const StaticTool (&tools)[N]) { return registerTools(tools, N); }
+
+  bool unregisterTool(const String &name);
+  size_t getToolCount() const { return _tools.size(); }
+  void clearTools();
+
+  void invalidateToolCache(const String &name);
+  void clearToolCache();
+  CacheStats getCacheStats() const;
+
+  // 指定工具的统计(所有实例的调用合计)，工具不存在时返回nullptr
+  const McpToolStats *getToolStats(const String &name) const;
+
+  // 工具列表每次变化(注册、卸载、清空)时加一
+  uint32_t version() const { return _version; }
+
+private:
+  friend class WebSocketMCP;
+  ToolRegistry(const ToolRegistry &);
+  ToolRegistry &operator=(const ToolRegistry &);
+
+  // 注册或更新工具
+  bool addTool(const String &name, const String &description, const String &inputSchema,
+               const ToolHandlers &handlers, uint32_t cacheTtl = 0);
+  bool addStaticTool(const StaticTool &entry);
+  // 同名工具已存在时只更新回调，否则加入列表
+  bool insertTool(const Tool &tool);
+
+  // 工具列表及按名称哈希建立的索引
+  std::vector<Tool> _tools;
+  McpHashIndex<MCP_MAX_TOOLS> _toolIndex;
+  int findTool(const char *name, size_t length) const;
+  void rebuildToolIndex();
+
+  // tools/list结果缓存，注册表变化时置为过期，下次请求时重新生成(各实例共用一份)
+  String _toolsListCache;
+  bool _toolsListDirty = true;
+  uint32_t _version = 0;
+  const String &getToolsListJson();
+  // 目录的MessagePack编码，MessagePack会话的tools/list直接使用，随目录一起过期
+  std::vector<uint8_t> _toolsListPacked;
+  bool _toolsListPackedDirty = true;
+  const std::vector<uint8_t> &getToolsListPacked();
+  void markToolsChanged();
+
+  // 幂等工具的结果缓存
+  McpResultCache _resultCache;
+
+  // 记录工具调用结果，工具可能已在回调中被卸载，按下标和名称哈希确认
+  void recordToolCall(int index, uint32_t nameHash, uint32_t micros, bool error, bool cacheHit = false);
 };
 
 #endif // WEBSOCKET_MCP_H
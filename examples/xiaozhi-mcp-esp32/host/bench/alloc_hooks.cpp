@@ -0,0 +1,78 @@
+/**
+ * alloc_hooks.cpp
+ * 通过覆盖malloc/calloc/realloc/free统计分配，实际分配交给glibc的__libc_*实现
+ * operator new/delete在libstdc++中也经由malloc/free，一并被统计
+ */
+
+#include "alloc_hooks.h"
+
+#include <atomic>
+#include <malloc.h>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+}
+
+static std::atomic<uint64_t> allocCount(0);
+static std::atomic<uint64_t> allocBytes(0);
+static std::atomic<uint64_t> freeCount(0);
+static std::atomic<int64_t> liveBytes(0);
+
+static void recordAlloc(void *ptr, size_t size) {
+  if (ptr) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    allocBytes.fetch_add(size, std::memory_order_relaxed);
+    liveBytes.fetch_add((int64_t)malloc_usable_size(ptr), std::memory_order_relaxed);
+  }
+}
+
+static void recordFree(void *ptr) {
+  if (ptr) {
+    freeCount.fetch_add(1, std::memory_order_relaxed);
+    liveBytes.fetch_sub((int64_t)malloc_usable_size(ptr), std::memory_order_relaxed);
+  }
+}
+
+extern "C" {
+
+void *malloc(size_t size) {
+  void *ptr = __libc_malloc(size);
+  recordAlloc(ptr, size);
+  return ptr;
+}
+
+void *calloc(size_t count, size_t size) {
+  void *ptr = __libc_calloc(count, size);
+  recordAlloc(ptr, count * size);
+  return ptr;
+}
+
+void *realloc(void *ptr, size_t size) {
+  recordFree(ptr);
+  void *result = __libc_realloc(ptr, size);
+  recordAlloc(result, size);
+  return result;
+}
+
+void free(void *ptr) {
+  recordFree(ptr);
+  __libc_free(ptr);
+}
+
+} // extern "C"
+
+AllocStats allocSnapshot() {
+  AllocStats stats;
+  stats.count = allocCount.load(std::memory_order_relaxed);
+  stats.bytes = allocBytes.load(std::memory_order_relaxed);
+  stats.frees = freeCount.load(std::memory_order_relaxed);
+  return stats;
+}
+
+uint32_t allocLiveBytes() {
+  int64_t live = liveBytes.load(std::memory_order_relaxed);
+  return live > 0 ? (uint32_t)live : 0;
+}
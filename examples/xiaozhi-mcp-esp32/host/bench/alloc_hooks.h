@@ -0,0 +1,25 @@
+/**
+ * alloc_hooks.h
+ * 统计进程内的堆分配(替换glibc的malloc系列函数)
+ * 基准程序用它计算每条消息的分配次数和分配字节数
+ */
+
+#ifndef ALLOC_HOOKS_H
+#define ALLOC_HOOKS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct AllocStats {
+  uint64_t count;  // 分配次数(malloc/calloc/realloc)
+  uint64_t bytes;  // 申请的字节数
+  uint64_t frees;  // 释放次数
+};
+
+// 当前累计值，两次调用相减得到区间内的分配情况
+AllocStats allocSnapshot();
+
+// 当前仍在使用的堆字节数
+uint32_t allocLiveBytes();
+
+#endif // ALLOC_HOOKS_H
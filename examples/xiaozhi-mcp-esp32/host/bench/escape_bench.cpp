@@ -0,0 +1,179 @@
+/**
+ * escape_bench.cpp
+ * JSON字符串转义基准：逐字节检查(原实现)与按机器字检查(mcpWriteJsonEscaped)写入缓冲区的吞吐量，
+ * 以及逐字符追加String(原escapeJsonString)与预留空间后整段追加(mcpAppendJsonEscaped)的吞吐量和分配次数
+ * 开始前用随机文本核对两种实现的输出完全一致
+ *
+ * 用法：escape_bench [每项迭代次数]
+ */
+
+#include <Arduino.h>
+#include "McpJsonWriter.h"
+#include "alloc_hooks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <string>
+
+// 典型输入：英文和中文的工具描述、设备名、带引号和换行的日志文本、嵌入字符串的JSON
+static const char *const INPUTS[][2] = {
+  {"ascii", "Control the living room light. Supports on, off and blink, with an optional brightness from 0 to 100 "
+            "percent and a transition time in milliseconds for smooth fading between states."},
+  {"chinese", "控制客厅的灯：支持开、关和闪烁，可选亮度0到100，以及状态切换时的渐变时间(毫秒)。"
+              "设备名称来自米家，例如客厅吸顶灯、卧室台灯和走廊感应灯。"},
+  {"quoted", "设备\"客厅灯\"已上线\n亮度: 80%\t色温: 4000K\n上次错误: \"timeout\" (C:\\logs\\light.txt)\n"},
+  {"json", "{\"entity_id\":\"light.living_room\",\"state\":\"on\",\"attributes\":{\"brightness\":204,"
+           "\"color_mode\":\"color_temp\",\"friendly_name\":\"客厅灯\"}}"},
+};
+
+// 原实现：逐字节判断
+template<typename TWriter>
+static void writeEscapedBytewise(TWriter &out, const char *text, size_t length) {
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  size_t runStart = 0;
+  for (size_t i = 0; i < length; i++) {
+    uint8_t c = (uint8_t)text[i];
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+    out.write((const uint8_t *)text + runStart, i - runStart);
+    runStart = i + 1;
+    char escaped[6] = {'\\', 0, '0', '0', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0x0F]};
+    size_t escapedLength = 2;
+    switch (c) {
+      case '"':  escaped[1] = '"'; break;
+      case '\\': escaped[1] = '\\'; break;
+      case '\b': escaped[1] = 'b'; break;
+      case '\f': escaped[1] = 'f'; break;
+      case '\n': escaped[1] = 'n'; break;
+      case '\r': escaped[1] = 'r'; break;
+      case '\t': escaped[1] = 't'; break;
+      default:
+        escaped[1] = 'u';
+        escapedLength = sizeof(escaped);
+        break;
+    }
+    out.write((const uint8_t *)escaped, escapedLength);
+  }
+  out.write((const uint8_t *)text + runStart, length - runStart);
+}
+
+// 原escapeJsonString：逐字符追加到未预留空间的String
+static String escapeCharwise(const String &input) {
+  String result = "";
+  for (size_t i = 0; i < input.length(); i++) {
+    char c = input[i];
+    if (c == '\"') result += "\\\"";
+    else if (c == '\\') result += "\\\\";
+    else if (c == '\b') result += "\\b";
+    else if (c == '\f') result += "\\f";
+    else if (c == '\n') result += "\\n";
+    else if (c == '\r') result += "\\r";
+    else if (c == '\t') result += "\\t";
+    else result += c;
+  }
+  return result;
+}
+
+// 写入定长缓冲区(相当于McpJsonWriter的帧缓冲区)
+struct BufferWriter {
+  char data[4096];
+  size_t length = 0;
+  size_t write(uint8_t c) {
+    data[length++] = (char)c;
+    return 1;
+  }
+  size_t write(const uint8_t *bytes, size_t n) {
+    memcpy(data + length, bytes, n);
+    length += n;
+    return n;
+  }
+};
+
+static volatile size_t sink;
+
+// 随机文本(含控制字符、引号、反斜杠、UTF-8字节)在各个起始偏移上核对输出
+static bool verify() {
+  std::mt19937 random(1);
+  const char alphabet[] = "abc \"\\\n\t\x01\x1f\xe5\xae\xa2/{}";
+  for (int round = 0; round < 20000; round++) {
+    char text[80];
+    size_t length = random() % sizeof(text);
+    for (size_t i = 0; i < length; i++) {
+      text[i] = alphabet[random() % (sizeof(alphabet) - 1)];
+    }
+    size_t offset = random() % 8;
+    char shifted[96];
+    memcpy(shifted + offset, text, length);
+    BufferWriter expected, actual;
+    writeEscapedBytewise(expected, text, length);
+    mcpWriteJsonEscaped(actual, shifted + offset, length);
+    if (expected.length != actual.length || memcmp(expected.data, actual.data, actual.length) != 0 ||
+        mcpJsonEscapedLength(shifted + offset, length) != expected.length) {
+      printf("输出不一致: %.*s\n", (int)length, text);
+      return false;
+    }
+  }
+  return true;
+}
+
+template<typename F>
+static double measure(size_t iterations, size_t bytes, F body, double *allocsPerCall) {
+  AllocStats before = allocSnapshot();
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; i++) {
+    body();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  AllocStats after = allocSnapshot();
+  if (allocsPerCall) {
+    *allocsPerCall = (double)(after.count - before.count) / iterations;
+  }
+  return bytes * (double)iterations / elapsed.count() / 1e6;
+}
+
+int main(int argc, char **argv) {
+  size_t iterations = argc > 1 ? (size_t)atol(argv[1]) : 200000;
+  if (!verify()) {
+    return 1;
+  }
+
+  printf("%-8s %6s %6s %12s %12s %12s %12s %8s %8s\n", "input", "bytes", "esc", "bytewise", "swar", "String old",
+         "String new", "allocs", "allocs");
+  printf("%-8s %6s %6s %12s %12s %12s %12s %8s %8s\n", "", "", "", "MB/s", "MB/s", "MB/s", "MB/s", "old", "new");
+  for (size_t n = 0; n < sizeof(INPUTS) / sizeof(INPUTS[0]); n++) {
+    const char *text = INPUTS[n][1];
+    size_t length = strlen(text);
+    String input(text);
+    BufferWriter buffer;
+
+    double bytewise = measure(iterations, length, [&]() {
+      buffer.length = 0;
+      writeEscapedBytewise(buffer, text, length);
+      sink = buffer.length;
+    }, nullptr);
+    double swar = measure(iterations, length, [&]() {
+      buffer.length = 0;
+      mcpWriteJsonEscaped(buffer, text, length);
+      sink = buffer.length;
+    }, nullptr);
+    double oldAllocs, newAllocs;
+    double stringOld = measure(iterations / 4, length, [&]() {
+      String escaped = escapeCharwise(input);
+      sink = escaped.length();
+    }, &oldAllocs);
+    double stringNew = measure(iterations / 4, length, [&]() {
+      String escaped;
+      mcpAppendJsonEscaped(escaped, input);
+      sink = escaped.length();
+    }, &newAllocs);
+
+    printf("%-8s %6u %6u %12.0f %12.0f %12.0f %12.0f %8.1f %8.1f\n", INPUTS[n][0], (unsigned)length,
+           (unsigned)(mcpJsonEscapedLength(text, length) - length), bytewise, swar, stringOld, stringNew, oldAllocs,
+           newAllocs);
+  }
+  return 0;
+}
@@ -0,0 +1,95 @@
+/**
+ * expr_bench.cpp
+ * 表达式引擎基准：每次重新编译、经McpExpressionCache查找已编译的表达式、只对已编译的字节码求值，
+ * 三种方式每秒可计算的表达式数，以及每次计算的堆分配次数(应为0)
+ *
+ * 单独编译：g++ -O2 -std=c++11 -I../.. expr_bench.cpp alloc_hooks.cpp ../../McpExpression.cpp -o expr_bench
+ * 用法：expr_bench [每项迭代次数]
+ */
+
+#include "McpExpression.h"
+#include "alloc_hooks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+// 自动化中常见的公式：纯常量、单位换算、阈值判断、带函数的限幅
+static const char *const EXPRESSIONS[] = {
+  "12+30*2",
+  "(f-32)*5/9",
+  "t > 28 && h > 70",
+  "(t*1.8+32) >= limit",
+  "max(0, min(100, (lux-50)*0.4))",
+  "sqrt(x*x + y*y) * 2.54",
+};
+
+static const double VALUES[MCP_EXPR_MAX_VARS] = {98.6, 65, 30, 12.5, 3, 4, 0, 0};
+
+static volatile double sink;
+
+struct ExprResult {
+  double nsPerExpression;
+  double allocsPerExpression;
+};
+
+// mode 0: 每次编译；1: 经缓存；2: 只求值
+static ExprResult run(const char *text, int mode, size_t iterations) {
+  size_t length = strlen(text);
+  McpExpression compiled;
+  McpExpressionCache cache;
+  McpExpression::Error error;
+  size_t position;
+  compiled.compile(text, length);
+  cache.compile(text, length, error, position);
+
+  AllocStats before = allocSnapshot();
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  double result = 0;
+  for (size_t i = 0; i < iterations; i++) {
+    if (mode == 0) {
+      McpExpression expr;
+      expr.compile(text, length);
+      expr.evaluate(VALUES, MCP_EXPR_MAX_VARS, result);
+    } else if (mode == 1) {
+      const McpExpression *expr = cache.compile(text, length, error, position);
+      expr->evaluate(VALUES, MCP_EXPR_MAX_VARS, result);
+    } else {
+      compiled.evaluate(VALUES, MCP_EXPR_MAX_VARS, result);
+    }
+    sink = result;
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  AllocStats after = allocSnapshot();
+
+  ExprResult r;
+  r.nsPerExpression = elapsed.count() / iterations;
+  r.allocsPerExpression = (double)(after.count - before.count) / iterations;
+  return r;
+}
+
+int main(int argc, char **argv) {
+  size_t iterations = argc > 1 ? (size_t)atol(argv[1]) : 1000000;
+
+  printf("%-32s %6s %12s %12s %12s %12s %12s\n", "expression", "code", "compile/s", "cached/s", "eval/s",
+         "cached ns", "allocs");
+  for (size_t i = 0; i < sizeof(EXPRESSIONS) / sizeof(EXPRESSIONS[0]); i++) {
+    const char *text = EXPRESSIONS[i];
+    McpExpression expr;
+    size_t position = 0;
+    McpExpression::Error error = expr.compile(text, strlen(text), &position);
+    if (error != McpExpression::OK) {
+      printf("%-32s %s (位置%u)\n", text, McpExpression::errorText(error), (unsigned)position);
+      continue;
+    }
+    ExprResult compile = run(text, 0, iterations);
+    ExprResult cached = run(text, 1, iterations);
+    ExprResult eval = run(text, 2, iterations);
+    double allocs = compile.allocsPerExpression + cached.allocsPerExpression + eval.allocsPerExpression;
+    printf("%-32s %6u %12.0f %12.0f %12.0f %12.1f %12.1f\n", text, (unsigned)expr.codeSize(),
+           1e9 / compile.nsPerExpression, 1e9 / cached.nsPerExpression, 1e9 / eval.nsPerExpression,
+           cached.nsPerExpression, allocs);
+  }
+  return 0;
+}
@@ -0,0 +1,603 @@
+/**
+ * load_bench.cpp
+ * 本地压测：进程内模拟MCP服务端，对多个WebSocketMCP客户端并行施加ping、initialize、tools/list和tools/call，
+ * 按设定的速率发送请求并定期强制断线，逐条按id核对响应，
+ * 报告各方法的p50/p99/p999延迟、吞吐量和堆内存增长，可连续运行数小时
+ *
+ * 用法：load_bench [参数=值 ...]
+ *   seconds=20    运行时长(秒)
+ *   clients=4     并行的客户端(WebSocketMCP实例)数，每个实例在自己的线程中运行
+ *   task=0        1为网络任务模式(beginTask())，0为在线程中轮询loop()
+ *   ping=2        每个客户端每秒的ping数
+ *   call=100      每个客户端每秒的tools/call(同步工具echo)数
+ *   list=0.5      每个客户端每秒的tools/list数
+ *   slow=2        每个客户端每秒调用异步工具slow(在工作线程中耗时SLOW_TOOL_MS)的次数
+ *   block=0       每个客户端每秒调用同步工具block(阻塞处理线程BLOCK_TOOL_MS)的次数，用于观察ping是否被拖慢
+ *   drop=5        每隔多少秒强制断开一个客户端(轮流)，0为不断线
+ *   refuse=0      重连时连接被拒绝的概率(0~1)，模拟重连风暴
+ *   report=10     每隔多少秒输出一行统计
+ *   timeout=10    请求在同一连接上多少秒没有响应计为超时
+ *
+ * 核对失败(id不匹配、重复响应、内容不符、超时)时退出码为1
+ */
+
+#include <Arduino.h>
+#include "WebSocketMCP.h"
+#include "alloc_hooks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static const unsigned long SLOW_TOOL_MS = 50;
+static const unsigned long BLOCK_TOOL_MS = 20;
+// 丢弃前几个统计周期的堆数据(缓冲区和哈希表扩容)
+static const int WARMUP_REPORTS = 1;
+
+// ---------- 运行参数 ----------
+
+struct Options {
+  double seconds = 20;
+  int clients = 4;
+  bool task = false;
+  double rates[5] = {2, 100, 0.5, 2, 0}; // 与Method中PING..BLOCK的顺序一致
+  double drop = 5;
+  double refuse = 0;
+  double report = 10;
+  double timeout = 10;
+};
+
+static Options options;
+
+static bool parseOptions(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *eq = strchr(arg, '=');
+    if (!eq) {
+      return false;
+    }
+    std::string key(arg, eq - arg);
+    double value = atof(eq + 1);
+    if (key == "seconds") options.seconds = value;
+    else if (key == "clients") options.clients = (int)value;
+    else if (key == "task") options.task = value != 0;
+    else if (key == "ping") options.rates[0] = value;
+    else if (key == "call") options.rates[1] = value;
+    else if (key == "list") options.rates[2] = value;
+    else if (key == "slow") options.rates[3] = value;
+    else if (key == "block") options.rates[4] = value;
+    else if (key == "drop") options.drop = value;
+    else if (key == "refuse") options.refuse = value;
+    else if (key == "report") options.report = value;
+    else if (key == "timeout") options.timeout = value;
+    else return false;
+  }
+  return options.clients > 0 && options.seconds > 0 && options.report > 0;
+}
+
+// ---------- 延迟直方图 ----------
+
+/**
+ * 对数分桶的延迟直方图(微秒)，每个2的幂区间分32个桶，相对误差约3%
+ * 大小固定，长时间运行不增长
+ */
+class LatencyHistogram {
+public:
+  static const int SUB_BUCKETS = 32;
+  static const int BUCKETS = SUB_BUCKETS * 40;
+
+  LatencyHistogram() { clear(); }
+
+  void clear() {
+    memset(_counts, 0, sizeof(_counts));
+    _total = 0;
+    _max = 0;
+  }
+
+  void record(uint64_t us) {
+    _counts[bucketOf(us)]++;
+    _total++;
+    if (us > _max) {
+      _max = us;
+    }
+  }
+
+  void merge(const LatencyHistogram &other) {
+    for (int i = 0; i < BUCKETS; i++) {
+      _counts[i] += other._counts[i];
+    }
+    _total += other._total;
+    if (other._max > _max) {
+      _max = other._max;
+    }
+  }
+
+  // q为0~1，返回对应桶的上界
+  double percentileMs(double q) const {
+    if (_total == 0) {
+      return 0;
+    }
+    uint64_t rank = (uint64_t)(q * (_total - 1)) + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+      seen += _counts[i];
+      if (seen >= rank) {
+        double upper = (double)upperOf(i);
+        return (upper < _max ? upper : _max) / 1000.0;
+      }
+    }
+    return _max / 1000.0;
+  }
+
+  uint64_t total() const { return _total; }
+  double maxMs() const { return _max / 1000.0; }
+
+private:
+  static int bucketOf(uint64_t us) {
+    if (us < SUB_BUCKETS) {
+      return (int)us;
+    }
+    int msb = 63 - __builtin_clzll(us);
+    int shift = msb - 4;
+    int bucket = (shift + 1) * SUB_BUCKETS / 2 + (int)((us >> shift) - SUB_BUCKETS / 2);
+    return bucket < BUCKETS ? bucket : BUCKETS - 1;
+  }
+
+  static uint64_t upperOf(int bucket) {
+    if (bucket < SUB_BUCKETS) {
+      return (uint64_t)bucket;
+    }
+    int shift = bucket / (SUB_BUCKETS / 2) - 1;
+    uint64_t base = (uint64_t)(bucket % (SUB_BUCKETS / 2) + SUB_BUCKETS / 2);
+    return ((base + 1) << shift) - 1;
+  }
+
+  uint64_t _counts[BUCKETS];
+  uint64_t _total;
+  uint64_t _max;
+};
+
+// ---------- 模拟服务端 ----------
+
+enum Method { PING, CALL, LIST, SLOW, BLOCK, INITIALIZE, METHOD_COUNT };
+static const char *const METHOD_NAMES[METHOD_COUNT] = {"ping", "tools/call", "tools/list", "call slow", "call block",
+                                                      "initialize"};
+static const int RATED_METHODS = 5;
+
+struct Pending {
+  Method method;
+  Clock::time_point sent;
+  uint32_t epoch; // 发送时的连接序号，与当前不同说明中间断过线
+};
+
+struct Session {
+  WebSocketsClient *client = nullptr;
+  std::mutex mutex;
+  bool connected = false;
+  bool ready = false;     // initialize已完成，可以发送其他请求
+  bool needInit = false;  // 刚连上，等待驱动线程发送initialize
+  uint32_t epoch = 0;
+  uint32_t nextId = 1;
+  std::string frame;      // 正在拼接的分片消息
+  std::unordered_map<uint32_t, Pending> pending;
+  Clock::time_point next[RATED_METHODS];
+};
+
+struct Totals {
+  uint64_t sent = 0;
+  uint64_t answered = 0;
+  uint64_t late = 0;          // 断线前发出、重连后才收到的响应
+  uint64_t lostOnDrop = 0;    // 断线前发出、始终没有收到的响应(断线时允许丢失)
+  uint64_t timeouts = 0;
+  uint64_t mismatched = 0;    // 未知id、重复响应或内容不符
+  uint64_t notifications = 0;
+  uint64_t connects = 0;
+  uint64_t refused = 0;
+  uint64_t drops = 0;
+};
+
+class LoadServer : public HostWebSocketPeer {
+public:
+  std::vector<std::unique_ptr<Session>> sessions;
+  std::map<WebSocketsClient *, Session *> byClient;
+  Session *beginning = nullptr; // begin()期间的会话，onBegin时与客户端关联
+
+  std::mutex statsMutex;
+  LatencyHistogram total[METHOD_COUNT];    // 全程
+  LatencyHistogram interval;               // 本统计周期(全部方法)
+  Totals totals;
+  std::mt19937 random{7};
+
+  void onBegin(WebSocketsClient *client) override {
+    beginning->client = client;
+    byClient[client] = beginning;
+  }
+
+  bool onConnect(WebSocketsClient *client) override {
+    Session &session = *byClient[client];
+    {
+      std::lock_guard<std::mutex> lock(statsMutex);
+      if (options.refuse > 0 && std::uniform_real_distribution<double>(0, 1)(random) < options.refuse) {
+        totals.refused++;
+        return false;
+      }
+      totals.connects++;
+    }
+    std::lock_guard<std::mutex> lock(session.mutex);
+    session.connected = true;
+    session.ready = false;
+    session.needInit = true;
+    session.epoch++;
+    session.frame.clear();
+    return true;
+  }
+
+  void onFrame(WebSocketsClient *client, WSopcode_t opcode, const uint8_t *payload, size_t length, bool fin) override {
+    Session &session = *byClient[client];
+    std::lock_guard<std::mutex> lock(session.mutex);
+    session.frame.append((const char *)payload, length);
+    if (fin) {
+      handleMessage(session, Clock::now());
+      session.frame.clear();
+    }
+  }
+
+  // 发送一个请求(调用方持有session.mutex)
+  void send(Session &session, Method method, Clock::time_point now) {
+    uint32_t id = session.nextId++;
+    char frame[256];
+    int length;
+    switch (method) {
+      case PING:
+        length = snprintf(frame, sizeof(frame), "{\"jsonrpc\":\"2.0\",\"id\":%u,\"method\":\"ping\"}", id);
+        break;
+      case INITIALIZE:
+        length = snprintf(frame, sizeof(frame),
+                          "{\"jsonrpc\":\"2.0\",\"id\":%u,\"method\":\"initialize\",\"params\":{\"protocolVersion\":"
+                          "\"2024-11-05\",\"capabilities\":{},\"clientInfo\":{\"name\":\"load_bench\"}}}", id);
+        break;
+      case LIST:
+        length = snprintf(frame, sizeof(frame), "{\"jsonrpc\":\"2.0\",\"id\":%u,\"method\":\"tools/list\"}", id);
+        break;
+      default:
+        length = snprintf(frame, sizeof(frame),
+                          "{\"jsonrpc\":\"2.0\",\"id\":%u,\"method\":\"tools/call\",\"params\":{\"name\":\"%s\","
+                          "\"arguments\":{\"n\":%u}}}", id,
+                          method == CALL ? "echo" : method == SLOW ? "slow" : "block", id);
+        break;
+    }
+    Pending pending;
+    pending.method = method;
+    pending.sent = now;
+    pending.epoch = session.epoch;
+    session.pending[id] = pending;
+    session.client->hostPost(WStype_TEXT, (const uint8_t *)frame, length);
+    std::lock_guard<std::mutex> lock(statsMutex);
+    totals.sent++;
+  }
+
+  // 强制断开：未响应的请求从此算作断线前发出
+  void drop(Session &session) {
+    {
+      std::lock_guard<std::mutex> lock(session.mutex);
+      if (!session.connected) {
+        return;
+      }
+      session.connected = false;
+      session.ready = false;
+      session.epoch++;
+    }
+    session.client->hostDrop();
+    std::lock_guard<std::mutex> lock(statsMutex);
+    totals.drops++;
+  }
+
+  // 清理超时的请求
+  void sweep(Clock::time_point now) {
+    uint64_t timeouts = 0;
+    uint64_t lost = 0;
+    for (size_t i = 0; i < sessions.size(); i++) {
+      Session &session = *sessions[i];
+      std::lock_guard<std::mutex> lock(session.mutex);
+      for (auto it = session.pending.begin(); it != session.pending.end();) {
+        if (std::chrono::duration<double>(now - it->second.sent).count() < options.timeout) {
+          ++it;
+          continue;
+        }
+        if (it->second.epoch == session.epoch) {
+          if (timeouts == 0) {
+            printf("超时: 客户端%u的%s请求(id=%u)\n", (unsigned)i, METHOD_NAMES[it->second.method], it->first);
+          }
+          timeouts++;
+        } else {
+          lost++;
+        }
+        it = session.pending.erase(it);
+      }
+    }
+    std::lock_guard<std::mutex> lock(statsMutex);
+    totals.timeouts += timeouts;
+    totals.lostOnDrop += lost;
+  }
+
+private:
+  void mismatch(const Session &session, const char *reason) {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    if (totals.mismatched++ < 5) {
+      printf("核对失败(%s): %.200s\n", reason, session.frame.c_str());
+    }
+  }
+
+  // 核对一条完整的消息(调用方持有session.mutex)
+  void handleMessage(Session &session, Clock::time_point now) {
+    const char *text = session.frame.c_str();
+    static const char RESPONSE[] = "{\"jsonrpc\":\"2.0\",\"id\":";
+    static const char NOTIFICATION[] = "{\"jsonrpc\":\"2.0\",\"method\":";
+    if (strncmp(text, NOTIFICATION, sizeof(NOTIFICATION) - 1) == 0) {
+      std::lock_guard<std::mutex> lock(statsMutex);
+      totals.notifications++;
+      return;
+    }
+    if (strncmp(text, RESPONSE, sizeof(RESPONSE) - 1) != 0) {
+      mismatch(session, "无法识别的消息");
+      return;
+    }
+    char *end;
+    uint32_t id = (uint32_t)strtoul(text + sizeof(RESPONSE) - 1, &end, 10);
+    auto it = session.pending.find(id);
+    if (it == session.pending.end() || *end != ',') {
+      mismatch(session, "未知或重复的id");
+      return;
+    }
+    Pending pending = it->second;
+    session.pending.erase(it);
+
+    bool ok;
+    char expected[48];
+    switch (pending.method) {
+      case PING:
+        ok = strcmp(end, ",\"result\":{}}") == 0;
+        break;
+      case INITIALIZE:
+        ok = strstr(end, "\"protocolVersion\"") != nullptr;
+        break;
+      case LIST:
+        ok = strstr(end, "\"name\":\"echo\"") != nullptr;
+        break;
+      case CALL:
+        // echo返回收到的arguments，确认响应对应的是这一次调用
+        snprintf(expected, sizeof(expected), "\\\"n\\\":%u}", id);
+        ok = strstr(end, expected) != nullptr && strstr(end, "\"isError\":false") != nullptr;
+        break;
+      default:
+        ok = strstr(end, "\"isError\":false") != nullptr;
+        break;
+    }
+    if (!ok) {
+      mismatch(session, METHOD_NAMES[pending.method]);
+      return;
+    }
+    if (pending.method == INITIALIZE && pending.epoch == session.epoch) {
+      session.ready = true;
+      for (int m = 0; m < RATED_METHODS; m++) {
+        // 各类请求错开开始
+        session.next[m] = now + std::chrono::microseconds(random() % 100000);
+      }
+    }
+
+    uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(now - pending.sent).count();
+    std::lock_guard<std::mutex> lock(statsMutex);
+    totals.answered++;
+    if (pending.epoch != session.epoch) {
+      totals.late++;
+    }
+    total[pending.method].record(us);
+    interval.record(us);
+  }
+};
+
+static LoadServer server;
+
+// ---------- 客户端 ----------
+
+static void registerTools(WebSocketMCP &mcp) {
+  mcp.registerTool("echo", "原样返回参数", "{\"type\":\"object\",\"properties\":{\"n\":{\"type\":\"integer\"}}}",
+                   [](JsonObjectConst args) {
+                     String json;
+                     serializeJson(args, json);
+                     return WebSocketMCP::ToolResponse(json);
+                   });
+  mcp.registerAsyncTool("slow", "在工作线程中耗时的工具", "{\"type\":\"object\"}",
+                        [](JsonObjectConst, WebSocketMCP::ToolResponder responder) {
+                          delay(SLOW_TOOL_MS);
+                          responder.respond(WebSocketMCP::ToolResponse("{\"done\":true}"));
+                        });
+  mcp.registerTool("block", "阻塞处理线程的同步工具", "{\"type\":\"object\"}", [](JsonObjectConst) {
+    delay(BLOCK_TOOL_MS);
+    return WebSocketMCP::ToolResponse("{\"done\":true}");
+  });
+}
+
+static void clientLoop(WebSocketMCP *mcp, const std::atomic<bool> *running) {
+  while (*running) {
+    mcp->loop();
+    delay(options.task ? 50 : 1);
+  }
+}
+
+static uint32_t liveHeap() {
+  return allocLiveBytes();
+}
+
+int main(int argc, char **argv) {
+  if (!parseOptions(argc, argv)) {
+    fprintf(stderr, "用法: load_bench [seconds=20] [clients=4] [task=0] [ping=2] [call=100] [list=0.5] [slow=2] "
+                    "[block=0] [drop=5] [refuse=0] [report=10] [timeout=10]\n");
+    return 2;
+  }
+
+  hostSerialSetEnabled(false);
+  hostSetHeapProbe(liveHeap);
+  McpLog::setLevel(MCP_LOG_LEVEL_NONE);
+  WebSocketsClient::hostSetPeer(&server);
+
+  printf("clients=%d mode=%s 每客户端每秒: ping=%.1f call=%.1f list=%.1f slow=%.1f block=%.1f, drop=%.0fs refuse=%.2f\n",
+         options.clients, options.task ? "task" : "poll", options.rates[PING], options.rates[CALL],
+         options.rates[LIST], options.rates[SLOW], options.rates[BLOCK], options.drop, options.refuse);
+
+  std::vector<std::unique_ptr<WebSocketMCP>> clients;
+  for (int i = 0; i < options.clients; i++) {
+    server.sessions.emplace_back(new Session());
+    server.beginning = server.sessions.back().get();
+    clients.emplace_back(new WebSocketMCP());
+    registerTools(*clients.back());
+    bool started = options.task ? clients.back()->beginTask("ws://localhost:8080/mcp")
+                                : clients.back()->begin("ws://localhost:8080/mcp");
+    if (!started) {
+      fprintf(stderr, "客户端%d启动失败\n", i);
+      return 2;
+    }
+  }
+
+  std::atomic<bool> running(true);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < options.clients; i++) {
+    threads.emplace_back(clientLoop, clients[i].get(), &running);
+  }
+
+  printf("%8s %10s %10s %9s %9s %9s %8s %8s %12s\n", "time", "sent/s", "recv/s", "p50 ms", "p99 ms", "p999 ms",
+         "drops", "errors", "live heap");
+
+  Clock::time_point start = Clock::now();
+  Clock::time_point nextReport = start + std::chrono::milliseconds((long)(options.report * 1000));
+  Clock::time_point nextDrop = start + std::chrono::milliseconds((long)(options.drop * 1000));
+  size_t dropIndex = 0;
+  uint64_t lastSent = 0;
+  uint64_t lastAnswered = 0;
+  int reports = 0;
+  uint32_t heapAfterWarmup = 0;
+  uint32_t heapPeak = 0;
+  Clock::time_point lastReport = start;
+
+  for (;;) {
+    Clock::time_point now = Clock::now();
+    double elapsed = std::chrono::duration<double>(now - start).count();
+    if (elapsed >= options.seconds) {
+      break;
+    }
+
+    // 按速率发送请求
+    for (size_t i = 0; i < server.sessions.size(); i++) {
+      Session &session = *server.sessions[i];
+      std::lock_guard<std::mutex> lock(session.mutex);
+      if (!session.connected) {
+        continue;
+      }
+      if (session.needInit) {
+        session.needInit = false;
+        server.send(session, INITIALIZE, now);
+        continue;
+      }
+      if (!session.ready) {
+        continue;
+      }
+      for (int m = 0; m < RATED_METHODS; m++) {
+        if (options.rates[m] <= 0) {
+          continue;
+        }
+        std::chrono::microseconds interval((long)(1e6 / options.rates[m]));
+        while (session.next[m] <= now) {
+          server.send(session, (Method)m, now);
+          session.next[m] += interval;
+        }
+      }
+    }
+
+    // 轮流强制断开
+    if (options.drop > 0 && now >= nextDrop) {
+      server.drop(*server.sessions[dropIndex++ % server.sessions.size()]);
+      nextDrop += std::chrono::milliseconds((long)(options.drop * 1000));
+    }
+
+    if (now >= nextReport) {
+      server.sweep(now);
+      uint32_t heap = allocLiveBytes();
+      double period = std::chrono::duration<double>(now - lastReport).count();
+      lastReport = now;
+      std::lock_guard<std::mutex> lock(server.statsMutex);
+      const Totals &t = server.totals;
+      printf("%7.0fs %10.0f %10.0f %9.2f %9.2f %9.2f %8llu %8llu %12u\n", elapsed, (t.sent - lastSent) / period,
+             (t.answered - lastAnswered) / period, server.interval.percentileMs(0.5),
+             server.interval.percentileMs(0.99), server.interval.percentileMs(0.999), (unsigned long long)t.drops,
+             (unsigned long long)(t.mismatched + t.timeouts), heap);
+      fflush(stdout);
+      lastSent = t.sent;
+      lastAnswered = t.answered;
+      server.interval.clear();
+      if (++reports == WARMUP_REPORTS) {
+        heapAfterWarmup = heap;
+      }
+      if (reports > WARMUP_REPORTS && heap > heapPeak) {
+        heapPeak = heap;
+      }
+      nextReport += std::chrono::milliseconds((long)(options.report * 1000));
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  // 停止发送，等待最后的响应后再核对
+  delay((unsigned long)(SLOW_TOOL_MS * 4 + BLOCK_TOOL_MS * 4 + 200));
+  uint32_t heapEnd = allocLiveBytes();
+  running = false;
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i].join();
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  // 剩下的请求：断线前发出的算作断线丢失，其余是超时
+  options.timeout = 0;
+  server.sweep(Clock::now() + std::chrono::seconds(1));
+  clients.clear();
+
+  const Totals &t = server.totals;
+  printf("\n%-12s %10s %9s %9s %9s %9s\n", "method", "count", "p50 ms", "p99 ms", "p999 ms", "max ms");
+  LatencyHistogram all;
+  for (int m = 0; m < METHOD_COUNT; m++) {
+    const LatencyHistogram &h = server.total[m];
+    all.merge(h);
+    if (h.total() == 0) {
+      continue;
+    }
+    printf("%-12s %10llu %9.2f %9.2f %9.2f %9.2f\n", METHOD_NAMES[m], (unsigned long long)h.total(),
+           h.percentileMs(0.5), h.percentileMs(0.99), h.percentileMs(0.999), h.maxMs());
+  }
+  printf("%-12s %10llu %9.2f %9.2f %9.2f %9.2f\n", "all", (unsigned long long)all.total(), all.percentileMs(0.5),
+         all.percentileMs(0.99), all.percentileMs(0.999), all.maxMs());
+
+  printf("\nsent %llu, answered %llu (%.0f/s), late after reconnect %llu, lost on drop %llu, timeouts %llu, "
+         "mismatched %llu, notifications %llu\n",
+         (unsigned long long)t.sent, (unsigned long long)t.answered, t.answered / seconds, (unsigned long long)t.late,
+         (unsigned long long)t.lostOnDrop, (unsigned long long)t.timeouts, (unsigned long long)t.mismatched,
+         (unsigned long long)t.notifications);
+  printf("connects %llu, refused %llu, drops %llu\n", (unsigned long long)t.connects, (unsigned long long)t.refused,
+         (unsigned long long)t.drops);
+  if (reports > WARMUP_REPORTS) {
+    printf("heap: after warm-up %u B, peak %u B, end %u B, growth %lld B\n", heapAfterWarmup, heapPeak, heapEnd,
+           (long long)heapEnd - heapAfterWarmup);
+  }
+  bool ok = t.mismatched == 0 && t.timeouts == 0 && t.answered > 0;
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,242 @@
+/**
+ * mcp_bench.cpp
+ * 消息处理基准：把录制的ping、tools/list、tools/call帧和resources/read帧经WebSocket事件回调重放给WebSocketMCP，
+ * 统计不同工具数量下每条消息的耗时、堆分配次数和分配字节数
+ * 每种目录规模再以MessagePack会话重放一遍(行名带/mp)，比较两种编码的耗时和收发字节数
+ * 最后连续处理SOAK_CALLS条消息，比较前后的堆状态；固定内存模式(MCP_FIXED_MEMORY)下要求没有任何分配
+ *
+ * 用法：mcp_bench [每项迭代次数]
+ */
+
+#include <Arduino.h>
+#include "WebSocketMCP.h"
+#include "alloc_hooks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <string>
+
+static const size_t CATALOG_SIZES[] = {3, 10, 50, 200, 500};
+static const size_t SOAK_CALLS = 100000;
+
+// 录制自小智服务端的请求帧(工具名在运行时替换为目录中的工具)
+static const char PING_FRAME[] = "{\"jsonrpc\":\"2.0\",\"id\":17,\"method\":\"ping\"}";
+static const char INIT_FRAME[] = "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"initialize\",\"params\":{}}";
+static const char LIST_FRAME[] = "{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"tools/list\",\"params\":{}}";
+static const char CALL_FRAME[] =
+    "{\"jsonrpc\":\"2.0\",\"id\":48,\"method\":\"tools/call\",\"params\":{\"name\":\"%s\","
+    "\"arguments\":{\"entity_id\":\"light.living_room\",\"state\":\"on\",\"brightness\":80}}}";
+
+// 结果写入McpToolResult的工具
+static const char STATUS_FRAME[] =
+    "{\"jsonrpc\":\"2.0\",\"id\":49,\"method\":\"tools/call\",\"params\":{\"name\":\"xiaomi_device_status\","
+    "\"arguments\":{\"entity_id\":\"light.living_room\"}}}";
+
+// 从资源存储读取同一设备的状态(不经过工具调用)
+static const char READ_FRAME[] =
+    "{\"jsonrpc\":\"2.0\",\"id\":50,\"method\":\"resources/read\",\"params\":{\"uri\":\"device://light.living_room\"}}";
+
+static const char TOOL_SCHEMA[] =
+    "{\"type\":\"object\",\"properties\":{\"entity_id\":{\"type\":\"string\",\"description\":\"设备实体ID\"},"
+    "\"state\":{\"type\":\"string\",\"enum\":[\"on\",\"off\"]},\"brightness\":{\"type\":\"integer\"}},"
+    "\"required\":[\"entity_id\",\"state\"]}";
+
+/**
+ * 进程内服务端：只统计收到的字节数
+ */
+class BenchPeer : public HostWebSocketPeer {
+public:
+  BenchPeer() : client(nullptr), bytes(0), messages(0) {}
+
+  void onBegin(WebSocketsClient *c) override { client = c; }
+  void onFrame(WebSocketsClient *, WSopcode_t, const uint8_t *, size_t length, bool fin) override {
+    bytes += length;
+    if (fin) {
+      messages++;
+    }
+  }
+
+  WebSocketsClient *client;
+  uint64_t bytes;
+  uint64_t messages;
+};
+
+static BenchPeer peer;
+
+struct BenchResult {
+  double nsPerMessage;
+  double allocsPerMessage;
+  double bytesPerMessage;
+  double inBytesPerMessage;
+  double outBytesPerMessage;
+};
+
+// 请求帧的MessagePack编码
+static std::string toMsgPack(const char *json) {
+  DynamicJsonDocument doc(4096);
+  deserializeJson(doc, json);
+  std::string packed(measureMsgPack(doc), '\0');
+  serializeMsgPack(doc, &packed[0], packed.size());
+  return packed;
+}
+
+// 与设备上一样，每帧都在一次loop()中处理(发送预算、发送队列按轮次工作)
+static void deliver(WebSocketMCP &mcp, const std::string &frame, bool binary) {
+  mcp.loop();
+  peer.client->hostDeliver(binary ? WStype_BIN : WStype_TEXT, (const uint8_t *)frame.data(), frame.size());
+}
+
+// 以MessagePack发送initialize，之后本连接的响应也用MessagePack
+static void switchToMsgPack(WebSocketMCP &mcp) {
+  deliver(mcp, toMsgPack(INIT_FRAME), true);
+  mcp.loop();
+  if (!mcp.isBinarySession()) {
+    fprintf(stderr, "切换到MessagePack失败\n");
+    exit(1);
+  }
+}
+
+// 重放同一帧iterations次，前面少量迭代用于预热(建立缓存、缓冲区扩容)
+static BenchResult replay(WebSocketMCP &mcp, const char *json, size_t iterations) {
+  bool binary = mcp.isBinarySession();
+  std::string frame = binary ? toMsgPack(json) : std::string(json);
+  for (size_t i = 0; i < 16; i++) {
+    deliver(mcp, frame, binary);
+  }
+
+  uint64_t outBefore = peer.bytes;
+  AllocStats before = allocSnapshot();
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; i++) {
+    deliver(mcp, frame, binary);
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  AllocStats after = allocSnapshot();
+
+  BenchResult result;
+  result.nsPerMessage = elapsed.count() / iterations;
+  result.allocsPerMessage = (double)(after.count - before.count) / iterations;
+  result.bytesPerMessage = (double)(after.bytes - before.bytes) / iterations;
+  result.inBytesPerMessage = (double)frame.size();
+  result.outBytesPerMessage = (double)(peer.bytes - outBefore) / iterations;
+  return result;
+}
+
+static WebSocketMCP *createServer(size_t tools) {
+  WebSocketMCP *mcp = new WebSocketMCP();
+  mcp->setBinaryEncoding(true);
+  char name[48];
+  for (size_t i = 0; i < tools; i++) {
+    snprintf(name, sizeof(name), "xiaomi_device_control_%03u", (unsigned)i);
+    mcp->registerTool(name, "控制米家设备的开关和亮度", TOOL_SCHEMA, [](JsonObjectConst args) {
+      return WebSocketMCP::ToolResponse("{\"success\":true}");
+    });
+  }
+  mcp->registerTool("xiaomi_device_status", "查询米家设备状态", TOOL_SCHEMA,
+                    [](JsonObjectConst args, McpToolResult &result) {
+                      result.beginObject()
+                          .add("entity_id", args["entity_id"] | "")
+                          .add("state", "on")
+                          .add("brightness", 80)
+                          .endObject();
+                    });
+  mcp->registerResource("device://light.living_room", "客厅灯", "客厅灯的开关和亮度");
+  mcp->updateResource("device://light.living_room", "{\"entity_id\":\"light.living_room\",\"state\":\"on\",\"brightness\":80}");
+  mcp->begin("ws://localhost:8080/mcp", nullptr);
+  mcp->loop();
+  if (!mcp->isConnected()) {
+    fprintf(stderr, "连接失败\n");
+    exit(1);
+  }
+  return mcp;
+}
+
+// 轮流处理ping、tools/list、McpToolResult形式的tools/call和resources/read，比较前后的分配次数和在用堆字节数
+// binary为true时在MessagePack会话中进行
+static bool soak(size_t calls, bool binary) {
+  static const char *const json[] = {PING_FRAME, LIST_FRAME, STATUS_FRAME, READ_FRAME};
+  const size_t frameCount = sizeof(json) / sizeof(json[0]);
+  WebSocketMCP *mcp = createServer(10);
+  if (binary) {
+    switchToMsgPack(*mcp);
+  }
+  std::string frames[frameCount];
+  for (size_t i = 0; i < frameCount; i++) {
+    frames[i] = binary ? toMsgPack(json[i]) : std::string(json[i]);
+  }
+  for (size_t i = 0; i < 16 * frameCount; i++) {
+    deliver(*mcp, frames[i % frameCount], binary);
+  }
+
+  uint64_t messagesBefore = peer.messages;
+  AllocStats before = allocSnapshot();
+  uint32_t liveBefore = allocLiveBytes();
+  for (size_t i = 0; i < calls; i++) {
+    deliver(*mcp, frames[i % frameCount], binary);
+  }
+  mcp->loop();
+  AllocStats after = allocSnapshot();
+  int64_t liveDelta = (int64_t)allocLiveBytes() - liveBefore;
+  uint64_t replies = peer.messages - messagesBefore;
+  delete mcp;
+
+  uint64_t allocs = after.count - before.count;
+  const char *name = binary ? "soak/mp" : "soak";
+  printf("\n%s: %u messages, %llu replies, %llu allocs, %llu frees, live heap delta %lld B\n",
+         name, (unsigned)calls, (unsigned long long)replies, (unsigned long long)allocs,
+         (unsigned long long)(after.frees - before.frees), (long long)liveDelta);
+  bool ok = replies == calls && liveDelta == 0;
+#if MCP_FIXED_MEMORY
+  ok = ok && allocs == 0;
+#endif
+  printf("%s: %s\n", name, ok ? "PASS" : "FAIL");
+  return ok;
+}
+
+static void printResult(size_t tools, const char *name, const BenchResult &r) {
+  printf("%-6u %-11s %12.0f %12.1f %12.0f %12.0f %12.0f\n", (unsigned)tools, name,
+         r.nsPerMessage, r.allocsPerMessage, r.bytesPerMessage, r.inBytesPerMessage, r.outBytesPerMessage);
+}
+
+int main(int argc, char **argv) {
+  size_t iterations = argc > 1 ? (size_t)atol(argv[1]) : 20000;
+
+  hostSerialSetEnabled(false);
+  hostSetHeapProbe(allocLiveBytes);
+  McpLog::setLevel(MCP_LOG_LEVEL_NONE);
+  WebSocketsClient::hostSetPeer(&peer);
+
+  printf("MCP_FIXED_MEMORY=%d\n", MCP_FIXED_MEMORY);
+  printf("%-6s %-11s %12s %12s %12s %12s %12s\n", "tools", "frame", "ns/msg", "allocs/msg", "bytes/msg", "in B/msg",
+         "out B/msg");
+  for (size_t c = 0; c < sizeof(CATALOG_SIZES) / sizeof(CATALOG_SIZES[0]); c++) {
+    size_t tools = CATALOG_SIZES[c];
+    WebSocketMCP *mcp = createServer(tools);
+    char name[48];
+
+    // 调用目录中间位置的工具
+    char callFrame[sizeof(CALL_FRAME) + 48];
+    snprintf(name, sizeof(name), "xiaomi_device_control_%03u", (unsigned)(tools / 2));
+    snprintf(callFrame, sizeof(callFrame), CALL_FRAME, name);
+
+    printResult(tools, "ping", replay(*mcp, PING_FRAME, iterations));
+    printResult(tools, "tools/list", replay(*mcp, LIST_FRAME, iterations));
+    printResult(tools, "tools/call", replay(*mcp, callFrame, iterations));
+    printResult(tools, "call/result", replay(*mcp, STATUS_FRAME, iterations));
+    printResult(tools, "res/read", replay(*mcp, READ_FRAME, iterations));
+
+    // 同一服务端切换到MessagePack会话(超过MCP_MSGPACK_MAX_MESSAGE的目录仍以文本帧发出)
+    switchToMsgPack(*mcp);
+    printResult(tools, "ping/mp", replay(*mcp, PING_FRAME, iterations));
+    printResult(tools, "list/mp", replay(*mcp, LIST_FRAME, iterations));
+    printResult(tools, "call/mp", replay(*mcp, callFrame, iterations));
+    printResult(tools, "result/mp", replay(*mcp, STATUS_FRAME, iterations));
+    printResult(tools, "read/mp", replay(*mcp, READ_FRAME, iterations));
+
+    delete mcp;
+  }
+  bool ok = soak(SOAK_CALLS, false);
+  ok = soak(SOAK_CALLS, true) && ok;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+/**
+ * registry_bench.cpp
+ * 工具名查找基准：哈希索引 vs 原先的线性扫描
+ * 验证注册5到500个工具时单次查找耗时基本不变
+ *
+ * 单独编译：g++ -O2 -std=c++11 -I../.. registry_bench.cpp -o registry_bench
+ */
+
+#include "McpRegistry.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+static const size_t TOOL_COUNTS[] = {5, 50, 500};
+static const size_t LOOKUPS = 2000000;
+
+static volatile int sink;
+
+template <typename Index>
+static double benchHashed(const std::vector<std::string> &names, const std::vector<size_t> &order) {
+  Index index;
+  for (size_t i = 0; i < names.size(); i++) {
+    index.insert(mcpHashBytes(names[i].data(), names[i].size()), i);
+  }
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (size_t n = 0; n < LOOKUPS; n++) {
+    const std::string &key = names[order[n % order.size()]];
+    const char *name = key.data();
+    size_t length = key.size();
+    sink = index.find(mcpHashBytes(name, length), [&](size_t i) {
+      return names[i].size() == length && memcmp(names[i].data(), name, length) == 0;
+    });
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / LOOKUPS;
+}
+
+static double benchLinear(const std::vector<std::string> &names, const std::vector<size_t> &order) {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (size_t n = 0; n < LOOKUPS; n++) {
+    const char *name = names[order[n % order.size()]].c_str();
+    int found = -1;
+    for (size_t i = 0; i < names.size(); i++) {
+      if (strcmp(names[i].c_str(), name) == 0) {
+        found = (int)i;
+        break;
+      }
+    }
+    sink = found;
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / LOOKUPS;
+}
+
+int main() {
+  printf("%-8s %14s %14s %14s\n", "tools", "linear ns", "hash ns", "fixed ns");
+  for (size_t c = 0; c < sizeof(TOOL_COUNTS) / sizeof(TOOL_COUNTS[0]); c++) {
+    size_t count = TOOL_COUNTS[c];
+    // 名称带公共前缀，贴近真实固件里的设备工具命名
+    std::vector<std::string> names;
+    char buf[48];
+    for (size_t i = 0; i < count; i++) {
+      snprintf(buf, sizeof(buf), "xiaomi_device_control_%03u", (unsigned)i);
+      names.push_back(buf);
+    }
+    // 伪随机访问顺序，覆盖所有工具
+    std::vector<size_t> order;
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < 4096; i++) {
+      seed = seed * 1103515245u + 12345u;
+      order.push_back((seed >> 8) % count);
+    }
+    double linear = benchLinear(names, order);
+    double hashed = benchHashed<McpHashIndex<0> >(names, order);
+    double fixed = benchHashed<McpHashIndex<512> >(names, order);
+    printf("%-8u %14.1f %14.1f %14.1f\n", (unsigned)count, linear, hashed, fixed);
+  }
+  return 0;
+}
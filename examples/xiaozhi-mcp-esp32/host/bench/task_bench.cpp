@@ -0,0 +1,171 @@
+/**
+ * task_bench.cpp
+ * 轮询模式(在主循环中调用loop())与网络任务模式(beginTask())对比：
+ * 主循环中有阻塞的用户代码时ping请求的响应延迟和抖动，以及没有请求时整个进程占用的CPU
+ * 请求由另一个线程按随机间隔投递，相当于服务器随时发来的消息
+ *
+ * 用法：task_bench [每种模式的请求数]
+ */
+
+#include <Arduino.h>
+#include "WebSocketMCP.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// 主循环中模拟的阻塞用户代码(LED闪烁、传感器读取等)
+static const unsigned long USER_BLOCK_MS = 20;
+// 测量空闲CPU的时长
+static const unsigned long IDLE_MS = 2000;
+
+/**
+ * 进程内服务端：记录每个响应到达的时间
+ */
+class TaskPeer : public HostWebSocketPeer {
+public:
+  TaskPeer() : client(nullptr) {}
+
+  void onBegin(WebSocketsClient *c) override { client = c; }
+  void onFrame(WebSocketsClient *, WSopcode_t, const uint8_t *payload, size_t length, bool fin) override {
+    int id;
+    std::string text((const char *)payload, length);
+    if (sscanf(text.c_str(), "{\"jsonrpc\":\"2.0\",\"id\":%d,\"result\"", &id) == 1) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (id >= 0 && (size_t)id < received.size()) {
+        received[id] = Clock::now();
+      }
+    }
+  }
+
+  void reset(size_t requests) {
+    std::lock_guard<std::mutex> lock(mutex);
+    sent.assign(requests, Clock::time_point());
+    received.assign(requests, Clock::time_point());
+  }
+
+  WebSocketsClient *client;
+  std::mutex mutex;
+  std::vector<Clock::time_point> sent;
+  std::vector<Clock::time_point> received;
+};
+
+static TaskPeer peer;
+
+static double processCpuSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 模拟Arduino主循环：调用loop()，再执行阻塞的用户代码(blockMs为0时相当于空的loop())
+static void appLoop(WebSocketMCP &mcp, unsigned long blockMs, const std::atomic<bool> &running) {
+  while (running) {
+    mcp.loop();
+    if (blockMs > 0) {
+      delay(blockMs);
+    } else {
+      yield();
+    }
+  }
+}
+
+struct TaskResult {
+  double p50Us;
+  double p99Us;
+  double maxUs;
+  size_t lost;
+  double idleCpuPercent;
+};
+
+static TaskResult run(bool taskMode, unsigned long blockMs, size_t requests) {
+  WebSocketMCP *mcp = new WebSocketMCP();
+  bool started = taskMode ? mcp->beginTask("ws://localhost:8080/mcp", nullptr)
+                          : mcp->begin("ws://localhost:8080/mcp", nullptr);
+  if (!started) {
+    fprintf(stderr, "启动失败\n");
+    exit(1);
+  }
+  while (!mcp->isConnected()) {
+    mcp->loop();
+    delay(1);
+  }
+
+  TaskResult result;
+  std::atomic<bool> running(true);
+
+  // 空闲：没有请求时主循环照常运行
+  double cpuBefore = processCpuSeconds();
+  Clock::time_point idleStart = Clock::now();
+  std::thread idleApp(appLoop, std::ref(*mcp), blockMs, std::cref(running));
+  delay(IDLE_MS);
+  running = false;
+  idleApp.join();
+  double wall = std::chrono::duration<double>(Clock::now() - idleStart).count();
+  result.idleCpuPercent = (processCpuSeconds() - cpuBefore) / wall * 100;
+
+  // 请求：按3~17毫秒的随机间隔投递ping
+  peer.reset(requests);
+  running = true;
+  std::thread app(appLoop, std::ref(*mcp), blockMs, std::cref(running));
+  char frame[64];
+  srand(1);
+  for (size_t i = 0; i < requests; i++) {
+    delay(3 + rand() % 15);
+    int length = snprintf(frame, sizeof(frame), "{\"jsonrpc\":\"2.0\",\"id\":%u,\"method\":\"ping\"}", (unsigned)i);
+    {
+      std::lock_guard<std::mutex> lock(peer.mutex);
+      peer.sent[i] = Clock::now();
+    }
+    peer.client->hostPost(WStype_TEXT, (const uint8_t *)frame, length);
+  }
+  delay(USER_BLOCK_MS * 2 + 50);
+  running = false;
+  app.join();
+  delete mcp;
+
+  std::vector<double> latencies;
+  result.lost = 0;
+  for (size_t i = 0; i < requests; i++) {
+    if (peer.received[i] == Clock::time_point()) {
+      result.lost++;
+      continue;
+    }
+    latencies.push_back(std::chrono::duration<double, std::micro>(peer.received[i] - peer.sent[i]).count());
+  }
+  std::sort(latencies.begin(), latencies.end());
+  if (latencies.empty()) {
+    latencies.push_back(0);
+  }
+  result.p50Us = latencies[latencies.size() / 2];
+  result.p99Us = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+  result.maxUs = latencies.back();
+  return result;
+}
+
+static void printResult(const char *mode, unsigned long blockMs, const TaskResult &r) {
+  printf("%-8s %9lu %10.0f %10.0f %10.0f %6u %10.1f\n", mode, blockMs, r.p50Us, r.p99Us, r.maxUs, (unsigned)r.lost,
+         r.idleCpuPercent);
+}
+
+int main(int argc, char **argv) {
+  size_t requests = argc > 1 ? (size_t)atol(argv[1]) : 300;
+
+  hostSerialSetEnabled(false);
+  McpLog::setLevel(MCP_LOG_LEVEL_NONE);
+  WebSocketsClient::hostSetPeer(&peer);
+
+  printf("%-8s %9s %10s %10s %10s %6s %10s\n", "mode", "block ms", "p50 us", "p99 us", "max us", "lost", "idle CPU%");
+  printResult("poll", 0, run(false, 0, requests));
+  printResult("poll", USER_BLOCK_MS, run(false, USER_BLOCK_MS, requests));
+  printResult("task", USER_BLOCK_MS, run(true, USER_BLOCK_MS, requests));
+  return 0;
+}
@@ -0,0 +1,469 @@
+/**
+ * Arduino.cpp (主机替身)
+ * String、Serial、时间函数等的主机实现
+ */
+
+#include "Arduino.h"
+
+#include <stdarg.h>
+#include <chrono>
+#include <random>
+#include <thread>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static bool serialEnabled = true;
+static uint32_t (*heapProbe)() = nullptr;
+static const uint32_t HOST_HEAP_SIZE = 320 * 1024;
+static uint32_t minFreeHeap = HOST_HEAP_SIZE;
+
+void hostSerialSetEnabled(bool enabled) {
+  serialEnabled = enabled;
+}
+
+void hostSetHeapProbe(uint32_t (*probe)()) {
+  heapProbe = probe;
+}
+
+// ---------------- Print ----------------
+
+int Print::printf(const char *format, ...) {
+  char small[128];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(small, sizeof(small), format, args);
+  va_end(args);
+  if (n < 0) {
+    return n;
+  }
+  if ((size_t)n < sizeof(small)) {
+    write((const uint8_t *)small, n);
+    return n;
+  }
+  char *big = (char *)malloc(n + 1);
+  if (!big) {
+    return 0;
+  }
+  va_start(args, format);
+  vsnprintf(big, n + 1, format, args);
+  va_end(args);
+  write((const uint8_t *)big, n);
+  free(big);
+  return n;
+}
+
+size_t Print::print(const String &s) {
+  return write((const uint8_t *)s.c_str(), s.length());
+}
+
+size_t Print::print(long n, int base) {
+  return print(String(n, (unsigned char)base).c_str());
+}
+
+size_t Print::print(unsigned long n, int base) {
+  return print(String(n, (unsigned char)base).c_str());
+}
+
+size_t Print::print(double n, int digits) {
+  return print(String(n, (unsigned int)digits).c_str());
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (serialEnabled) {
+    fputc(c, stdout);
+  }
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  if (serialEnabled) {
+    fwrite(buffer, 1, size, stdout);
+  }
+  return size;
+}
+
+// ---------------- String ----------------
+
+String::String(const char *cstr) {
+  if (cstr) {
+    copy(cstr, strlen(cstr));
+  }
+}
+
+String::String(const char *cstr, unsigned int length) {
+  if (cstr) {
+    copy(cstr, length);
+  }
+}
+
+String::String(const String &str) {
+  copy(str.c_str(), str.len);
+}
+
+String::String(String &&rval) : buffer(rval.buffer), capacity(rval.capacity), len(rval.len) {
+  rval.buffer = nullptr;
+  rval.capacity = 0;
+  rval.len = 0;
+}
+
+String::String(char c) {
+  copy(&c, 1);
+}
+
+static void formatInteger(String &out, unsigned long long value, bool negative, unsigned char base) {
+  char buf[72];
+  char *p = buf + sizeof(buf) - 1;
+  *p = '\0';
+  if (base < 2) {
+    base = 10;
+  }
+  do {
+    unsigned digit = (unsigned)(value % base);
+    *--p = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+    value /= base;
+  } while (value);
+  if (negative) {
+    *--p = '-';
+  }
+  out = p;
+}
+
+String::String(unsigned char value, unsigned char base) {
+  formatInteger(*this, value, false, base);
+}
+
+String::String(int value, unsigned char base) {
+  if (base == 10 && value < 0) {
+    formatInteger(*this, 0ULL - (unsigned long long)(long long)value, true, base);
+  } else {
+    formatInteger(*this, base == 10 ? (unsigned long long)value : (unsigned int)value, false, base);
+  }
+}
+
+String::String(unsigned int value, unsigned char base) {
+  formatInteger(*this, value, false, base);
+}
+
+String::String(long value, unsigned char base) {
+  if (base == 10 && value < 0) {
+    formatInteger(*this, 0ULL - (unsigned long long)(long long)value, true, base);
+  } else {
+    formatInteger(*this, base == 10 ? (unsigned long long)value : (unsigned long)value, false, base);
+  }
+}
+
+String::String(unsigned long value, unsigned char base) {
+  formatInteger(*this, value, false, base);
+}
+
+String::String(long long value, unsigned char base) {
+  if (base == 10 && value < 0) {
+    formatInteger(*this, 0ULL - (unsigned long long)value, true, base);
+  } else {
+    formatInteger(*this, (unsigned long long)value, false, base);
+  }
+}
+
+String::String(unsigned long long value, unsigned char base) {
+  formatInteger(*this, value, false, base);
+}
+
+String::String(float value, unsigned int decimalPlaces) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", (int)decimalPlaces, (double)value);
+  copy(buf, strlen(buf));
+}
+
+String::String(double value, unsigned int decimalPlaces) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", (int)decimalPlaces, value);
+  copy(buf, strlen(buf));
+}
+
+String::~String() {
+  free(buffer);
+}
+
+void String::invalidate() {
+  free(buffer);
+  buffer = nullptr;
+  capacity = 0;
+  len = 0;
+}
+
+bool String::reserve(unsigned int size) {
+  if (buffer && capacity >= size) {
+    return true;
+  }
+  char *newBuffer = (char *)realloc(buffer, size + 1);
+  if (!newBuffer) {
+    return false;
+  }
+  if (!buffer) {
+    newBuffer[0] = '\0';
+  }
+  buffer = newBuffer;
+  capacity = size;
+  return true;
+}
+
+bool String::copy(const char *cstr, unsigned int length) {
+  if (!reserve(length)) {
+    invalidate();
+    return false;
+  }
+  len = length;
+  memmove(buffer, cstr, length);
+  buffer[len] = '\0';
+  return true;
+}
+
+String &String::operator=(const String &rhs) {
+  if (this != &rhs) {
+    copy(rhs.c_str(), rhs.len);
+  }
+  return *this;
+}
+
+String &String::operator=(const char *cstr) {
+  if (cstr) {
+    copy(cstr, strlen(cstr));
+  } else {
+    invalidate();
+  }
+  return *this;
+}
+
+String &String::operator=(String &&rval) {
+  if (this != &rval) {
+    free(buffer);
+    buffer = rval.buffer;
+    capacity = rval.capacity;
+    len = rval.len;
+    rval.buffer = nullptr;
+    rval.capacity = 0;
+    rval.len = 0;
+  }
+  return *this;
+}
+
+bool String::concat(const char *cstr, unsigned int length) {
+  if (!cstr) {
+    return false;
+  }
+  if (length == 0) {
+    return true;
+  }
+  unsigned int newLen = len + length;
+  if (capacity < newLen) {
+    // 与Arduino-ESP32一致：按需增长，不做几何扩容
+    if (!reserve(newLen)) {
+      return false;
+    }
+  }
+  memmove(buffer + len, cstr, length);
+  len = newLen;
+  buffer[len] = '\0';
+  return true;
+}
+
+bool String::startsWith(const String &prefix) const {
+  return prefix.len <= len && memcmp(c_str(), prefix.c_str(), prefix.len) == 0;
+}
+
+bool String::endsWith(const String &suffix) const {
+  return suffix.len <= len && memcmp(c_str() + len - suffix.len, suffix.c_str(), suffix.len) == 0;
+}
+
+char &String::operator[](unsigned int index) {
+  static char dummy;
+  if (index >= len || !buffer) {
+    dummy = 0;
+    return dummy;
+  }
+  return buffer[index];
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const {
+  if (fromIndex >= len) {
+    return -1;
+  }
+  const char *p = (const char *)memchr(buffer + fromIndex, ch, len - fromIndex);
+  return p ? (int)(p - buffer) : -1;
+}
+
+int String::indexOf(const String &str, unsigned int fromIndex) const {
+  if (fromIndex >= len) {
+    return -1;
+  }
+  const char *p = strstr(buffer + fromIndex, str.c_str());
+  return p ? (int)(p - buffer) : -1;
+}
+
+int String::lastIndexOf(char ch) const {
+  if (!buffer) {
+    return -1;
+  }
+  const char *p = strrchr(buffer, ch);
+  return p ? (int)(p - buffer) : -1;
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const {
+  if (beginIndex > endIndex) {
+    std::swap(beginIndex, endIndex);
+  }
+  if (beginIndex >= len) {
+    return String();
+  }
+  if (endIndex > len) {
+    endIndex = len;
+  }
+  return String(buffer + beginIndex, endIndex - beginIndex);
+}
+
+void String::trim() {
+  if (!buffer || len == 0) {
+    return;
+  }
+  char *begin = buffer;
+  while (isspace((unsigned char)*begin)) {
+    begin++;
+  }
+  char *end = buffer + len - 1;
+  while (end >= begin && isspace((unsigned char)*end)) {
+    end--;
+  }
+  len = end + 1 - begin;
+  if (begin > buffer) {
+    memmove(buffer, begin, len);
+  }
+  buffer[len] = '\0';
+}
+
+void String::toLowerCase() {
+  for (unsigned int i = 0; i < len; i++) {
+    buffer[i] = (char)tolower((unsigned char)buffer[i]);
+  }
+}
+
+void String::toUpperCase() {
+  for (unsigned int i = 0; i < len; i++) {
+    buffer[i] = (char)toupper((unsigned char)buffer[i]);
+  }
+}
+
+String operator+(const String &lhs, const String &rhs) {
+  String result;
+  result.reserve(lhs.length() + rhs.length());
+  result.concat(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+String operator+(const String &lhs, const char *rhs) {
+  String result(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+String operator+(const char *lhs, const String &rhs) {
+  String result(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+String operator+(const String &lhs, char rhs) {
+  String result(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+// ---------------- ESP ----------------
+
+uint32_t EspClass::getFreeHeap() {
+  uint32_t used = heapProbe ? heapProbe() : 0;
+  uint32_t freeHeap = used < HOST_HEAP_SIZE ? HOST_HEAP_SIZE - used : 0;
+  if (freeHeap < minFreeHeap) {
+    minFreeHeap = freeHeap;
+  }
+  return freeHeap;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+  getFreeHeap();
+  return minFreeHeap;
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+  return getFreeHeap();
+}
+
+uint32_t EspClass::getHeapSize() {
+  return HOST_HEAP_SIZE;
+}
+
+// ---------------- 时间与GPIO ----------------
+
+static const std::chrono::steady_clock::time_point bootTime = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - bootTime).count();
+}
+
+unsigned long micros() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - bootTime).count();
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield() {
+  std::this_thread::yield();
+}
+
+static std::minstd_rand &rng() {
+  static std::minstd_rand engine(1);
+  return engine;
+}
+
+long random(long howbig) {
+  if (howbig <= 0) {
+    return 0;
+  }
+  return (long)(rng()() % (unsigned long)howbig);
+}
+
+long random(long howsmall, long howbig) {
+  if (howsmall >= howbig) {
+    return howsmall;
+  }
+  return howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed) {
+  rng().seed(seed ? seed : 1);
+}
+
+static uint8_t pinState[64];
+
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin < sizeof(pinState)) {
+    pinState[pin] = val;
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < sizeof(pinState) ? pinState[pin] : LOW;
+}
+
+// ---------------- WiFi ----------------
+
+#include "WiFi.h"
+
+WiFiClass WiFi;
@@ -0,0 +1,257 @@
+/**
+ * Arduino.h (主机替身)
+ * 仅用于在Linux主机上编译WebSocketMCP，提供String、Serial、millis()等最小实现
+ * 不追求与Arduino-ESP32完全一致，只覆盖本库及ArduinoJson用到的接口
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <ctype.h>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT  0x01
+#define OUTPUT 0x03
+
+#define DEC 10
+#define HEX 16
+
+// ESP32上常量数据本就位于flash，PROGMEM/F()在主机上退化为普通指针
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+
+class String;
+
+/**
+ * Print基类
+ * ArduinoJson的serializeJson(doc, Print&)依赖该接口
+ */
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (size--) {
+      n += write(*buffer++);
+    }
+    return n;
+  }
+  size_t write(const char *str) {
+    return str ? write((const uint8_t *)str, strlen(str)) : 0;
+  }
+  size_t write(const char *buffer, size_t size) {
+    return write((const uint8_t *)buffer, size);
+  }
+  int printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+  size_t print(const char *s) { return write(s); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(const String &s);
+  size_t print(long n, int base = DEC);
+  size_t print(unsigned long n, int base = DEC);
+  size_t print(int n, int base = DEC) { return print((long)n, base); }
+  size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+  size_t print(double n, int digits = 2);
+  size_t println() { return write("\r\n"); }
+  template <typename T>
+  size_t println(const T &value) {
+    size_t n = print(value);
+    return n + println();
+  }
+  template <typename T>
+  size_t println(const T &value, int arg) {
+    size_t n = print(value, arg);
+    return n + println();
+  }
+  virtual void flush() {}
+};
+
+/**
+ * Stream基类
+ * ArduinoJson的deserializeJson(doc, Stream&)依赖该接口
+ */
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  size_t readBytes(char *buffer, size_t length) {
+    size_t count = 0;
+    while (count < length) {
+      int c = read();
+      if (c < 0) {
+        break;
+      }
+      *buffer++ = (char)c;
+      count++;
+    }
+    return count;
+  }
+};
+
+/**
+ * String
+ * 与Arduino String语义一致的最小实现：以'\0'结尾的堆缓冲区
+ */
+class String {
+public:
+  String(const char *cstr = "");
+  String(const char *cstr, unsigned int length);
+  String(const String &str);
+  String(String &&rval);
+  explicit String(char c);
+  explicit String(unsigned char value, unsigned char base = 10);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(long long value, unsigned char base = 10);
+  explicit String(unsigned long long value, unsigned char base = 10);
+  explicit String(float value, unsigned int decimalPlaces = 2);
+  explicit String(double value, unsigned int decimalPlaces = 2);
+  ~String();
+
+  String &operator=(const String &rhs);
+  String &operator=(const char *cstr);
+  String &operator=(String &&rval);
+
+  bool reserve(unsigned int size);
+  unsigned int length() const { return len; }
+  const char *c_str() const { return buffer ? buffer : ""; }
+  char *begin() { return buffer; }
+  char *end() { return buffer + len; }
+
+  bool concat(const String &str) { return concat(str.c_str(), str.len); }
+  bool concat(const char *cstr) { return cstr ? concat(cstr, strlen(cstr)) : false; }
+  bool concat(const char *cstr, unsigned int length);
+  bool concat(char c) { return concat(&c, 1); }
+  bool concat(int num) { return concat(String(num)); }
+  bool concat(unsigned int num) { return concat(String(num)); }
+  bool concat(long num) { return concat(String(num)); }
+  bool concat(unsigned long num) { return concat(String(num)); }
+  bool concat(double num) { return concat(String(num)); }
+
+  template <typename T>
+  String &operator+=(const T &rhs) {
+    concat(rhs);
+    return *this;
+  }
+
+  bool equals(const String &s) const { return len == s.len && memcmp(c_str(), s.c_str(), len) == 0; }
+  bool equals(const char *cstr) const { return strcmp(c_str(), cstr ? cstr : "") == 0; }
+  bool operator==(const String &rhs) const { return equals(rhs); }
+  bool operator==(const char *cstr) const { return equals(cstr); }
+  bool operator!=(const String &rhs) const { return !equals(rhs); }
+  bool operator!=(const char *cstr) const { return !equals(cstr); }
+  bool operator<(const String &rhs) const { return strcmp(c_str(), rhs.c_str()) < 0; }
+
+  bool startsWith(const String &prefix) const;
+  bool endsWith(const String &suffix) const;
+
+  char charAt(unsigned int index) const { return index < len ? buffer[index] : 0; }
+  char operator[](unsigned int index) const { return charAt(index); }
+  char &operator[](unsigned int index);
+
+  int indexOf(char ch, unsigned int fromIndex = 0) const;
+  int indexOf(const String &str, unsigned int fromIndex = 0) const;
+  int lastIndexOf(char ch) const;
+  String substring(unsigned int beginIndex) const { return substring(beginIndex, len); }
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+  void trim();
+  void toLowerCase();
+  void toUpperCase();
+  long toInt() const { return buffer ? atol(buffer) : 0; }
+  float toFloat() const { return buffer ? (float)atof(buffer) : 0; }
+  double toDouble() const { return buffer ? atof(buffer) : 0; }
+  bool isEmpty() const { return len == 0; }
+
+private:
+  void invalidate();
+  bool copy(const char *cstr, unsigned int length);
+
+  char *buffer = nullptr;
+  unsigned int capacity = 0;
+  unsigned int len = 0;
+};
+
+// Arduino中字符串拼接的中间类型，ArduinoJson会按名字识别该类型
+class StringSumHelper : public String {
+public:
+  StringSumHelper(const String &s) : String(s) {}
+  StringSumHelper(const char *p) : String(p) {}
+};
+
+String operator+(const String &lhs, const String &rhs);
+String operator+(const String &lhs, const char *rhs);
+String operator+(const char *lhs, const String &rhs);
+String operator+(const String &lhs, char rhs);
+// 与Arduino的StringSumHelper一致，整数按十进制文本拼接
+inline String operator+(const String &lhs, int rhs) { return lhs + String(rhs); }
+inline String operator+(const String &lhs, unsigned int rhs) { return lhs + String(rhs); }
+inline String operator+(const String &lhs, long rhs) { return lhs + String(rhs); }
+inline String operator+(const String &lhs, unsigned long rhs) { return lhs + String(rhs); }
+
+/**
+ * 串口替身，输出到stdout；可通过hostSerialSetEnabled(false)静默
+ */
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long) {}
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+void hostSerialSetEnabled(bool enabled);
+
+/**
+ * ESP对象替身，堆信息来自主机分配统计
+ */
+class EspClass {
+public:
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap();
+  uint32_t getHeapSize();
+  const char *getChipModel() { return "host"; }
+  uint64_t getEfuseMac() { return 0x0000A1B2C3D4E5F6ULL; }
+  uint32_t getFlashChipSize() { return 4 * 1024 * 1024; }
+  void restart() { exit(0); }
+};
+
+extern EspClass ESP;
+// 注入堆占用探针(返回当前已分配字节数)，未注入时视为0
+void hostSetHeapProbe(uint32_t (*probe)());
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+#endif // HOST_ARDUINO_H
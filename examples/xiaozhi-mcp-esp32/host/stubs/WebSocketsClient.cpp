@@ -0,0 +1,214 @@
+/**
+ * WebSocketsClient.cpp (主机替身)
+ */
+
+#include "WebSocketsClient.h"
+
+static HostWebSocketPeer *globalPeer = nullptr;
+
+bool WebSockets::sendFrame(WSclient_t *client, WSopcode_t opcode, uint8_t *payload, size_t length, bool fin, bool headerToPayload) {
+  if (!client || !client->connected) {
+    return false;
+  }
+  // headerToPayload时payload前预留了WEBSOCKETS_MAX_HEADER_SIZE字节帧头空间
+  const uint8_t *data = payload;
+  if (headerToPayload && data) {
+    data += WEBSOCKETS_MAX_HEADER_SIZE;
+  }
+  hostSendFrame(opcode, data, length, fin);
+  return true;
+}
+
+WebSocketsClient::WebSocketsClient()
+    : _peer(nullptr), _begun(false), _reconnectInterval(500), _lastConnectionFail(0) {
+  _client.connected = false;
+  _client.ssl = false;
+  _client.port = 0;
+}
+
+WebSocketsClient::~WebSocketsClient() {}
+
+void WebSocketsClient::hostSetPeer(HostWebSocketPeer *peer) {
+  globalPeer = peer;
+}
+
+void WebSocketsClient::begin(const char *host, uint16_t port, const char *url, const char *) {
+  _client.host = host;
+  _client.port = port;
+  _client.url = url;
+  _client.ssl = false;
+  _begun = true;
+  _lastConnectionFail = 0;
+  _peer = globalPeer;
+  if (_peer) {
+    _peer->onBegin(this);
+  }
+}
+
+void WebSocketsClient::beginSSL(const char *host, uint16_t port, const char *url, const char *, const char *protocol) {
+  begin(host, port, url, protocol);
+  _client.ssl = true;
+}
+
+void WebSocketsClient::onEvent(WebSocketClientEvent cbEvent) {
+  _cbEvent = cbEvent;
+}
+
+void WebSocketsClient::loop(void) {
+  if (!_begun) {
+    return;
+  }
+  if (!_client.connected && _peer) {
+    unsigned long now = millis();
+    if (_lastConnectionFail == 0 || now - _lastConnectionFail >= _reconnectInterval) {
+      if (_peer->onConnect(this)) {
+        hostConnect();
+      } else {
+        _lastConnectionFail = now ? now : 1;
+      }
+    }
+  }
+  for (;;) {
+    PendingEvent event;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_pending.empty()) {
+        break;
+      }
+      event.type = _pending.front().type;
+      event.payload.swap(_pending.front().payload);
+      _pending.pop_front();
+    }
+    hostDeliver(event.type, event.payload.data(), event.payload.size());
+  }
+}
+
+void WebSocketsClient::dispatch(WStype_t type, uint8_t *payload, size_t length) {
+  if (_cbEvent) {
+    _cbEvent(type, payload, length);
+  }
+}
+
+void WebSocketsClient::hostDeliver(WStype_t type, const uint8_t *payload, size_t length) {
+  switch (type) {
+    case WStype_CONNECTED:
+      _client.connected = true;
+      break;
+    case WStype_DISCONNECTED:
+      if (!_client.connected) {
+        return;
+      }
+      _client.connected = false;
+      _lastConnectionFail = millis();
+      if (_lastConnectionFail == 0) {
+        _lastConnectionFail = 1;
+      }
+      break;
+    default:
+      break;
+  }
+  // 与真实库一致：TEXT/BIN载荷可写且以'\0'结尾
+  _scratch.assign(payload, payload + length);
+  _scratch.push_back(0);
+  dispatch(type, _scratch.data(), length);
+}
+
+void WebSocketsClient::hostPost(WStype_t type, const uint8_t *payload, size_t length) {
+  PendingEvent event;
+  event.type = type;
+  if (payload && length) {
+    event.payload.assign(payload, payload + length);
+  }
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pending.push_back(std::move(event));
+  }
+  _pendingReady.notify_all();
+}
+
+bool WebSocketsClient::hostWaitReadable(uint32_t timeoutMs) {
+  if (!_client.connected) {
+    return false;
+  }
+  std::unique_lock<std::mutex> lock(_mutex);
+  _pendingReady.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this]() { return !_pending.empty(); });
+  return true;
+}
+
+void WebSocketsClient::hostConnect() {
+  if (!_client.connected) {
+    hostDeliver(WStype_CONNECTED, (const uint8_t *)"/", 1);
+  }
+}
+
+void WebSocketsClient::hostDrop() {
+  hostPost(WStype_DISCONNECTED, nullptr, 0);
+}
+
+void WebSocketsClient::hostSendFrame(WSopcode_t opcode, const uint8_t *payload, size_t length, bool fin) {
+  if (_peer) {
+    _peer->onFrame(this, opcode, payload, length, fin);
+  }
+}
+
+bool WebSocketsClient::sendTXT(uint8_t *payload, size_t length, bool headerToPayload) {
+  if (length == 0) {
+    length = strlen((const char *)payload + (headerToPayload ? WEBSOCKETS_MAX_HEADER_SIZE : 0));
+  }
+  return sendFrame(&_client, WSop_text, payload, length, true, headerToPayload);
+}
+
+bool WebSocketsClient::sendTXT(const uint8_t *payload, size_t length) {
+  return sendTXT((uint8_t *)payload, length);
+}
+
+bool WebSocketsClient::sendTXT(char *payload, size_t length, bool headerToPayload) {
+  return sendTXT((uint8_t *)payload, length, headerToPayload);
+}
+
+bool WebSocketsClient::sendTXT(const char *payload, size_t length) {
+  return sendTXT((uint8_t *)payload, length);
+}
+
+bool WebSocketsClient::sendTXT(String &payload) {
+  return sendTXT((uint8_t *)payload.c_str(), payload.length());
+}
+
+bool WebSocketsClient::sendTXT(char payload) {
+  uint8_t buf[WEBSOCKETS_MAX_HEADER_SIZE + 2] = {0};
+  buf[WEBSOCKETS_MAX_HEADER_SIZE] = (uint8_t)payload;
+  return sendTXT(buf, 1, true);
+}
+
+bool WebSocketsClient::sendBIN(uint8_t *payload, size_t length, bool headerToPayload) {
+  return sendFrame(&_client, WSop_binary, payload, length, true, headerToPayload);
+}
+
+bool WebSocketsClient::sendBIN(const uint8_t *payload, size_t length) {
+  return sendBIN((uint8_t *)payload, length);
+}
+
+bool WebSocketsClient::sendPing(uint8_t *payload, size_t length) {
+  return sendFrame(&_client, WSop_ping, payload, length);
+}
+
+void WebSocketsClient::disconnect(void) {
+  if (_client.connected) {
+    if (_peer) {
+      _peer->onDisconnect(this);
+    }
+    hostDeliver(WStype_DISCONNECTED, nullptr, 0);
+  }
+}
+
+void WebSocketsClient::setReconnectInterval(unsigned long time) {
+  _reconnectInterval = time;
+}
+
+void WebSocketsClient::enableHeartbeat(uint32_t, uint32_t, uint8_t) {}
+
+void WebSocketsClient::disableHeartbeat() {}
+
+bool WebSocketsClient::isConnected(void) {
+  return _client.connected;
+}
@@ -0,0 +1,150 @@
+/**
+ * WebSocketsClient.h (主机替身)
+ * 模拟arduinoWebSockets库的客户端接口，不走真实网络：
+ * 帧通过HostWebSocketPeer在进程内收发，便于基准测试和压测回放
+ */
+
+#ifndef HOST_WEBSOCKETS_CLIENT_H
+#define HOST_WEBSOCKETS_CLIENT_H
+
+#include <Arduino.h>
+#include <functional>
+#include <condition_variable>
+#include <mutex>
+#include <deque>
+#include <vector>
+
+#define WEBSOCKETS_MAX_HEADER_SIZE (14)
+
+typedef enum {
+  WStype_ERROR,
+  WStype_DISCONNECTED,
+  WStype_CONNECTED,
+  WStype_TEXT,
+  WStype_BIN,
+  WStype_FRAGMENT_TEXT_START,
+  WStype_FRAGMENT_BIN_START,
+  WStype_FRAGMENT,
+  WStype_FRAGMENT_FIN,
+  WStype_PING,
+  WStype_PONG,
+} WStype_t;
+
+typedef enum {
+  WSop_continuation = 0x00,
+  WSop_text = 0x01,
+  WSop_binary = 0x02,
+  WSop_close = 0x08,
+  WSop_ping = 0x09,
+  WSop_pong = 0x0A
+} WSopcode_t;
+
+typedef struct {
+  bool connected;
+  bool ssl;
+  String host;
+  uint16_t port;
+  String url;
+} WSclient_t;
+
+class WebSocketsClient;
+
+/**
+ * 进程内的"服务器端"，由基准程序或压测程序实现
+ */
+class HostWebSocketPeer {
+public:
+  virtual ~HostWebSocketPeer() {}
+  // 客户端调用begin()/beginSSL()时通知
+  virtual void onBegin(WebSocketsClient *client) {}
+  // 客户端尝试建立连接，返回false表示本次连接失败
+  virtual bool onConnect(WebSocketsClient *client) { return true; }
+  // 客户端发送的一帧(含分片帧)
+  virtual void onFrame(WebSocketsClient *client, WSopcode_t opcode, const uint8_t *payload, size_t length, bool fin) = 0;
+  // 客户端主动断开
+  virtual void onDisconnect(WebSocketsClient *client) {}
+};
+
+class WebSockets {
+public:
+  virtual ~WebSockets() {}
+
+protected:
+  bool sendFrame(WSclient_t *client, WSopcode_t opcode, uint8_t *payload = NULL, size_t length = 0, bool fin = true, bool headerToPayload = false);
+  virtual void hostSendFrame(WSopcode_t opcode, const uint8_t *payload, size_t length, bool fin) = 0;
+};
+
+class WebSocketsClient : protected WebSockets {
+public:
+  typedef std::function<void(WStype_t type, uint8_t *payload, size_t length)> WebSocketClientEvent;
+
+  WebSocketsClient();
+  virtual ~WebSocketsClient();
+
+  void begin(const char *host, uint16_t port, const char *url = "/", const char *protocol = "arduino");
+  void beginSSL(const char *host, uint16_t port, const char *url = "/", const char *fingerprint = "", const char *protocol = "arduino");
+
+  void loop(void);
+  void onEvent(WebSocketClientEvent cbEvent);
+
+  bool sendTXT(uint8_t *payload, size_t length = 0, bool headerToPayload = false);
+  bool sendTXT(const uint8_t *payload, size_t length = 0);
+  bool sendTXT(char *payload, size_t length = 0, bool headerToPayload = false);
+  bool sendTXT(const char *payload, size_t length = 0);
+  bool sendTXT(String &payload);
+  bool sendTXT(char payload);
+
+  bool sendBIN(uint8_t *payload, size_t length, bool headerToPayload = false);
+  bool sendBIN(const uint8_t *payload, size_t length);
+
+  bool sendPing(uint8_t *payload = NULL, size_t length = 0);
+
+  void disconnect(void);
+
+  void setReconnectInterval(unsigned long time);
+  void enableHeartbeat(uint32_t pingInterval, uint32_t pongTimeout, uint8_t disconnectTimeoutCount);
+  void disableHeartbeat();
+
+  bool isConnected(void);
+
+  // ---------- 主机专用接口 ----------
+  // 设置全局对端，之后begin()的客户端都连到它
+  static void hostSetPeer(HostWebSocketPeer *peer);
+  // 同步投递事件(必须在调用loop()的线程上使用)
+  void hostDeliver(WStype_t type, const uint8_t *payload, size_t length);
+  // 异步投递事件，可在任意线程调用，下一次loop()时派发
+  void hostPost(WStype_t type, const uint8_t *payload, size_t length);
+  // 相当于在套接字上select()：已连接时等到有投递的事件或超时，未连接时返回false
+  bool hostWaitReadable(uint32_t timeoutMs);
+  // 立即标记为已连接并派发WStype_CONNECTED
+  void hostConnect();
+  // 模拟服务器侧断开
+  void hostDrop();
+  unsigned long hostReconnectInterval() const { return _reconnectInterval; }
+  const WSclient_t &hostClient() const { return _client; }
+
+protected:
+  WSclient_t _client;
+  bool clientIsConnected(WSclient_t *client) { return client->connected; }
+  void hostSendFrame(WSopcode_t opcode, const uint8_t *payload, size_t length, bool fin) override;
+
+private:
+  struct PendingEvent {
+    WStype_t type;
+    std::vector<uint8_t> payload;
+  };
+
+  void dispatch(WStype_t type, uint8_t *payload, size_t length);
+
+  WebSocketClientEvent _cbEvent;
+  HostWebSocketPeer *_peer;
+  bool _begun;
+  unsigned long _reconnectInterval;
+  unsigned long _lastConnectionFail;
+  std::mutex _mutex;
+  std::condition_variable _pendingReady;
+  std::deque<PendingEvent> _pending;
+  std::vector<uint8_t> _scratch;
+};
+
+#endif // HOST_WEBSOCKETS_CLIENT_H
@@ -0,0 +1,54 @@
+/**
+ * WiFi.h (主机替身)
+ * 主机上视为始终已连接
+ */
+
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include <Arduino.h>
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+#define WIFI_STA 1
+
+class IPAddress {
+public:
+  IPAddress() : _addr(0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+      : _addr((uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24)) {}
+  explicit IPAddress(uint32_t addr) : _addr(addr) {}
+  operator uint32_t() const { return _addr; }
+  uint8_t operator[](int index) const { return (uint8_t)(_addr >> (8 * index)); }
+  String toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(buf);
+  }
+
+private:
+  uint32_t _addr;
+};
+
+class WiFiClass {
+public:
+  void mode(int) {}
+  void begin(const char *, const char *) {}
+  wl_status_t status() { return WL_CONNECTED; }
+  IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+  int32_t RSSI() { return -40; }
+  int hostByName(const char *, IPAddress &result) {
+    result = IPAddress(127, 0, 0, 1);
+    return 1;
+  }
+};
+
+extern WiFiClass WiFi;
+
+#endif // HOST_WIFI_H
@@ -0,0 +1,163 @@
+/**
+ * mcp_test.h
+ * 主机测试公用部分：断言宏，以及记录客户端发出的每条消息的进程内服务端
+ * 每个测试程序以MCP_TEST_RESULT()作为main()的返回值，有检查失败时退出码为1，由ctest判定
+ */
+
+#ifndef MCP_TEST_H
+#define MCP_TEST_H
+
+#include <Arduino.h>
+#include "WebSocketMCP.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static int mcpTestFailures = 0;
+
+// 条件不成立时记录失败并继续执行，一次运行报告全部失败项
+#define MCP_CHECK(condition)                                                   \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      mcpTestFailures++;                                                       \
+      printf("%s:%d: 检查失败: %s\n", __FILE__, __LINE__, #condition);        \
+    }                                                                          \
+  } while (0)
+
+#define MCP_CHECK_EQ(actual, expected)                                         \
+  do {                                                                         \
+    long long mcpActual = (long long)(actual);                                 \
+    long long mcpExpected = (long long)(expected);                             \
+    if (mcpActual != mcpExpected) {                                            \
+      mcpTestFailures++;                                                       \
+      printf("%s:%d: 检查失败: %s == %s (实际 %lld，期望 %lld)\n", __FILE__,   \
+             __LINE__, #actual, #expected, mcpActual, mcpExpected);            \
+    }                                                                          \
+  } while (0)
+
+// 文本中应包含part
+#define MCP_CHECK_CONTAINS(text, part)                                         \
+  do {                                                                         \
+    std::string mcpText(text);                                                 \
+    if (mcpText.find(part) == std::string::npos) {                             \
+      mcpTestFailures++;                                                       \
+      printf("%s:%d: 检查失败: 应包含 %s\n  实际: %.300s\n", __FILE__,         \
+             __LINE__, part, mcpText.c_str());                                 \
+    }                                                                          \
+  } while (0)
+
+#define MCP_TEST_RESULT()                                                      \
+  (mcpTestFailures == 0 ? (printf("PASS\n"), 0)                                \
+                        : (printf("FAIL: %d项检查失败\n", mcpTestFailures), 1))
+
+/**
+ * 进程内服务端：按帧拼出完整消息，MessagePack消息转回JSON文本后保存，便于逐条比对
+ */
+class TestPeer : public HostWebSocketPeer {
+public:
+  struct Message {
+    bool binary;
+    std::string json;  // 消息的JSON文本(二进制消息为解码后重新序列化的结果)
+    size_t bytes;      // 线上字节数
+  };
+
+  TestPeer() : client(nullptr), accept(true), _binary(false) {}
+
+  void onBegin(WebSocketsClient *c) override { client = c; }
+  bool onConnect(WebSocketsClient *) override { return accept; }
+  void onFrame(WebSocketsClient *, WSopcode_t opcode, const uint8_t *payload, size_t length, bool fin) override {
+    if (opcode != WSop_continuation) {
+      _binary = opcode == WSop_binary;
+      _current.clear();
+    }
+    _current.append((const char *)payload, length);
+    if (!fin) {
+      return;
+    }
+    Message message;
+    message.binary = _binary;
+    message.bytes = _current.size();
+    if (_binary) {
+      DynamicJsonDocument doc(_current.size() * 16 + 1024);
+      if (deserializeMsgPack(doc, _current.data(), _current.size())) {
+        message.json = "<invalid msgpack>";
+      } else {
+        serializeJson(doc, message.json);
+      }
+    } else {
+      message.json = _current;
+    }
+    messages.push_back(message);
+  }
+
+  // 服务端发来一条文本消息，下一次loop()时处理
+  void post(const char *json) { client->hostPost(WStype_TEXT, (const uint8_t *)json, strlen(json)); }
+  void post(const std::string &json) { client->hostPost(WStype_TEXT, (const uint8_t *)json.data(), json.size()); }
+
+  // 服务端发来一条MessagePack消息(由JSON文本转换)
+  void postBinary(const char *json) {
+    DynamicJsonDocument doc(strlen(json) * 16 + 1024);
+    deserializeJson(doc, json);
+    std::string packed;
+    packed.resize(measureMsgPack(doc));
+    serializeMsgPack(doc, &packed[0], packed.size());
+    client->hostPost(WStype_BIN, (const uint8_t *)packed.data(), packed.size());
+  }
+
+  // 收到的消息中第一条包含part的，没有时返回空字符串
+  std::string find(const char *part) const {
+    for (size_t i = 0; i < messages.size(); i++) {
+      if (messages[i].json.find(part) != std::string::npos) {
+        return messages[i].json;
+      }
+    }
+    return std::string();
+  }
+
+  size_t count(const char *part) const {
+    size_t n = 0;
+    for (size_t i = 0; i < messages.size(); i++) {
+      if (messages[i].json.find(part) != std::string::npos) {
+        n++;
+      }
+    }
+    return n;
+  }
+
+  WebSocketsClient *client;
+  bool accept;
+  std::vector<Message> messages;
+
+private:
+  bool _binary;
+  std::string _current;
+};
+
+// 连接到peer并完成initialize，清空握手期间收到的消息
+inline bool mcpTestConnect(WebSocketMCP &mcp, TestPeer &peer) {
+  hostSerialSetEnabled(false);
+  WebSocketsClient::hostSetPeer(&peer);
+  mcp.begin("ws://localhost:8080/mcp");
+  mcp.loop();
+  if (!mcp.isConnected()) {
+    return false;
+  }
+  peer.post("{\"jsonrpc\":\"2.0\",\"id\":0,\"method\":\"initialize\",\"params\":{}}");
+  mcp.loop();
+  mcp.loop();
+  peer.messages.clear();
+  return true;
+}
+
+// 发送一条请求并处理到发送队列清空
+inline void mcpTestRequest(WebSocketMCP &mcp, TestPeer &peer, const char *json) {
+  peer.post(json);
+  mcp.loop();
+  for (int i = 0; i < 8 && mcp.getSendQueueStats().queuedMessages > 0; i++) {
+    mcp.loop();
+  }
+}
+
+#endif // MCP_TEST_H
@@ -0,0 +1,102 @@
+/**
+ * test_batch.cpp
+ * 批量请求：各项响应按请求顺序写入同一个数组，通知不产生响应，未知方法和不是对象的项回复错误，
+ * 流式工具的输出也写在数组中
+ */
+
+#include "mcp_test.h"
+
+static void testBatchReplies() {
+  TestPeer peer;
+  WebSocketMCP mcp;
+  mcp.registerTool("sum", "求和", "{\"type\":\"object\"}", [](JsonObjectConst args, McpToolResult &result) {
+    result.print((long)(args["a"] | 0) + (long)(args["b"] | 0));
+  });
+  mcp.registerStreamingTool("lines", "逐行输出", "{\"type\":\"object\"}",
+                            [](JsonObjectConst, WebSocketMCP::ToolStream &stream) {
+                              stream.text("第一行");
+                              stream.text("第二行\"引号\"");
+                            });
+  MCP_CHECK(mcpTestConnect(mcp, peer));
+
+  mcpTestRequest(mcp, peer,
+                 "[{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"ping\"},"
+                 "{\"jsonrpc\":\"2.0\",\"method\":\"notifications/cancelled\",\"params\":{}},"
+                 "{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"tools/call\",\"params\":{\"name\":\"sum\",\"arguments\":{\"a\":2,\"b\":3}}},"
+                 "{\"jsonrpc\":\"2.0\",\"id\":3,\"method\":\"no/such/method\"},"
+                 "{\"jsonrpc\":\"2.0\",\"method\":\"notifications/no_such_event\"},"
+                 "5,"
+                 "{\"jsonrpc\":\"2.0\",\"id\":4},"
+                 "{\"jsonrpc\":\"2.0\",\"id\":\"s\",\"method\":\"tools/call\",\"params\":{\"name\":\"lines\",\"arguments\":{}}}]");
+  MCP_CHECK_EQ(peer.messages.size(), 1);
+  if (peer.messages.size() != 1) {
+    return;
+  }
+
+  DynamicJsonDocument doc(8192);
+  MCP_CHECK(!deserializeJson(doc, peer.messages[0].json));
+  JsonArrayConst replies = doc.as<JsonArrayConst>();
+  MCP_CHECK_EQ(replies.size(), 6);
+  MCP_CHECK_EQ(replies[0]["id"].as<long>(), 1);
+  MCP_CHECK(replies[0]["result"].is<JsonObjectConst>());
+  MCP_CHECK_EQ(replies[1]["id"].as<long>(), 2);
+  MCP_CHECK(strcmp(replies[1]["result"]["content"][0]["text"] | "", "5") == 0);
+  MCP_CHECK_EQ(replies[2]["id"].as<long>(), 3);
+  MCP_CHECK_EQ(replies[2]["error"]["code"].as<long>(), -32601);
+  MCP_CHECK(replies[3]["id"].isNull());
+  MCP_CHECK_EQ(replies[3]["error"]["code"].as<long>(), -32600);
+  MCP_CHECK_EQ(replies[4]["id"].as<long>(), 4);
+  MCP_CHECK_EQ(replies[4]["error"]["code"].as<long>(), -32600);
+  MCP_CHECK(strcmp(replies[5]["id"] | "", "s") == 0);
+  MCP_CHECK_EQ(replies[5]["result"]["content"].size(), 2);
+  MCP_CHECK(strcmp(replies[5]["result"]["content"][1]["text"] | "", "第二行\"引号\"") == 0);
+  MCP_CHECK(!replies[5]["result"]["isError"].as<bool>());
+}
+
+// 只有通知的批量请求没有响应
+static void testNotificationOnlyBatch() {
+  TestPeer peer;
+  WebSocketMCP mcp;
+  MCP_CHECK(mcpTestConnect(mcp, peer));
+  mcpTestRequest(mcp, peer,
+                 "[{\"jsonrpc\":\"2.0\",\"method\":\"notifications/cancelled\",\"params\":{}},"
+                 "{\"jsonrpc\":\"2.0\",\"method\":\"notifications/initialized\"}]");
+  MCP_CHECK_EQ(peer.messages.size(), 0);
+}
+
+// 批量响应之后的单个请求照常作为独立消息发出
+static void testBatchThenSingle() {
+  TestPeer peer;
+  WebSocketMCP mcp;
+  MCP_CHECK(mcpTestConnect(mcp, peer));
+  peer.post("[{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"ping\"},{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"ping\"}]");
+  peer.post("{\"jsonrpc\":\"2.0\",\"id\":3,\"method\":\"ping\"}");
+  mcp.loop();
+  MCP_CHECK_EQ(peer.messages.size(), 2);
+  if (peer.messages.size() == 2) {
+    MCP_CHECK(peer.messages[0].json[0] == '[');
+    MCP_CHECK_CONTAINS(peer.messages[1].json, "\"id\":3");
+  }
+}
+
+// 单个请求：未知方法回复-32601，对端发来的响应不回复
+static void testSingleInvalidRequests() {
+  TestPeer peer;
+  WebSocketMCP mcp;
+  MCP_CHECK(mcpTestConnect(mcp, peer));
+  mcpTestRequest(mcp, peer, "{\"jsonrpc\":\"2.0\",\"id\":9,\"method\":\"no/such/method\"}");
+  MCP_CHECK_EQ(peer.messages.size(), 1);
+  MCP_CHECK_CONTAINS(peer.find("\"id\":9"), "-32601");
+  peer.messages.clear();
+  mcpTestRequest(mcp, peer, "{\"jsonrpc\":\"2.0\",\"id\":10,\"result\":{}}");
+  mcpTestRequest(mcp, peer, "{\"jsonrpc\":\"2.0\",\"method\":\"notifications/no_such_event\"}");
+  MCP_CHECK_EQ(peer.messages.size(), 0);
+}
+
+int main() {
+  testBatchReplies();
+  testNotificationOnlyBatch();
+  testBatchThenSingle();
+  testSingleInvalidRequests();
+  return MCP_TEST_RESULT();
+}
@@ -0,0 +1,71 @@
+/**
+ * test_errors.cpp
+ * 解析失败的请求：超出解析文档容量时按原id回复-32603，格式错误时以null为id回复-32700，之后的请求照常处理
+ * 非固定内存模式下解析文档按帧长分配，同样的大请求应正常调用工具
+ */
+
+#include "mcp_test.h"
+
+static void testOversizedRequest() {
+  TestPeer peer;
+  WebSocketMCP mcp;
+  int calls = 0;
+  mcp.registerTool("sum", "求和", "{\"type\":\"object\"}", [&calls](JsonObjectConst, McpToolResult &result) {
+    calls++;
+    result.print("ok");
+  });
+  MCP_CHECK(mcpTestConnect(mcp, peer));
+
+  // 约2000个整数参数，解析后的节点远超MCP_REQUEST_DOC_SIZE
+  std::string frame = "{\"jsonrpc\":\"2.0\",\"id\":77,\"method\":\"tools/call\",\"params\":{\"name\":\"sum\",\"arguments\":{";
+  for (int i = 0; i < 2000; i++) {
+    frame += (i ? ",\"" : "\"") + std::to_string(i) + "\":" + std::to_string(i);
+  }
+  frame += "}}}";
+  mcpTestRequest(mcp, peer, frame.c_str());
+#if !MCP_FIXED_MEMORY
+  MCP_CHECK_EQ(calls, 1);
+  MCP_CHECK_CONTAINS(peer.find("\"id\":77"), "\"result\"");
+#else
+  MCP_CHECK_EQ(calls, 0);
+  MCP_CHECK_EQ(peer.messages.size(), 1);
+  if (peer.messages.size() == 1) {
+    DynamicJsonDocument doc(1024);
+    MCP_CHECK(!deserializeJson(doc, peer.messages[0].json));
+    MCP_CHECK_EQ(doc["id"].as<long>(), 77);
+    MCP_CHECK_EQ(doc["error"]["code"].as<long>(), -32603);
+  }
+
+  // 字符串id原样带回
+  peer.messages.clear();
+  frame.replace(frame.find("\"id\":77"), 7, "\"id\":\"a\\\"b\"");
+  mcpTestRequest(mcp, peer, frame.c_str());
+  MCP_CHECK_CONTAINS(peer.find("-32603"), "\"id\":\"a\\\"b\"");
+#endif
+}
+
+static void testMalformedRequest() {
+  TestPeer peer;
+  WebSocketMCP mcp;
+  MCP_CHECK(mcpTestConnect(mcp, peer));
+  mcpTestRequest(mcp, peer, "{\"jsonrpc\":\"2.0\",\"id\":5,\"method\":\"ping\"");
+  MCP_CHECK_EQ(peer.messages.size(), 1);
+  if (peer.messages.size() == 1) {
+    DynamicJsonDocument doc(1024);
+    MCP_CHECK(!deserializeJson(doc, peer.messages[0].json));
+    MCP_CHECK(doc["id"].isNull());
+    MCP_CHECK_EQ(doc["error"]["code"].as<long>(), -32700);
+  }
+
+  // 之后的请求照常处理
+  peer.messages.clear();
+  mcpTestRequest(mcp, peer, "{\"jsonrpc\":\"2.0\",\"id\":6,\"method\":\"ping\"}");
+  MCP_CHECK_EQ(peer.messages.size(), 1);
+  MCP_CHECK_CONTAINS(peer.find("\"id\":6"), "\"result\"");
+}
+
+int main() {
+  testOversizedRequest();
+  testMalformedRequest();
+  return MCP_TEST_RESULT();
+}
@@ -0,0 +1,206 @@
+/**
+ * test_json_escape.cpp
+ * JSON转义：mcpJsonFindEscape与逐字节查找结果一致，mcpWriteJsonEscaped与逐字节转义结果一致
+ * 每个需要转义的字节(0x00-0x1F、'"'、'\\')放在每种字对齐偏移、每种尾部长度的每个位置；
+ * 0x7F和UTF-8多字节字符原样输出
+ */
+
+#include "mcp_test.h"
+#include "McpJsonWriter.h"
+
+// 偏移覆盖两个机器字，长度覆盖若干整字加上每种尾部长度
+static const size_t MAX_OFFSET = 2 * sizeof(uintptr_t);
+static const size_t MAX_LENGTH = 5 * sizeof(uintptr_t) + sizeof(uintptr_t) - 1;
+
+// 最多打印的失败详情条数，其余只计数
+static const int MAX_REPORTS = 10;
+
+class StdStringWriter {
+public:
+  explicit StdStringWriter(std::string &target) : _target(target) {}
+  size_t write(uint8_t c) {
+    _target += (char)c;
+    return 1;
+  }
+  size_t write(const uint8_t *data, size_t length) {
+    _target.append((const char *)data, length);
+    return length;
+  }
+
+private:
+  std::string &_target;
+};
+
+static size_t referenceFind(const char *text, size_t from, size_t length) {
+  for (size_t i = from; i < length; i++) {
+    uint8_t c = (uint8_t)text[i];
+    if (c < 0x20 || c == '"' || c == '\\') {
+      return i;
+    }
+  }
+  return length;
+}
+
+static std::string referenceEscape(const char *text, size_t length) {
+  std::string out;
+  for (size_t i = 0; i < length; i++) {
+    uint8_t c = (uint8_t)text[i];
+    switch (c) {
+      case '"':  out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\b': out += "\\b"; break;
+      case '\f': out += "\\f"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        if (c < 0x20) {
+          char escaped[8];
+          snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          out += escaped;
+        } else {
+          out += (char)c;
+        }
+        break;
+    }
+  }
+  return out;
+}
+
+static std::string hexDump(const char *text, size_t length) {
+  std::string out;
+  for (size_t i = 0; i < length; i++) {
+    char hex[4];
+    snprintf(hex, sizeof(hex), "%02x ", (uint8_t)text[i]);
+    out += hex;
+  }
+  return out;
+}
+
+// 对text[0, length)逐个from比较查找结果，并比较转义输出和转义长度，返回不一致的项数
+static int checkText(const char *text, size_t length, size_t offset, int &reports) {
+  int mismatches = 0;
+  for (size_t from = 0; from <= length; from++) {
+    size_t actual = mcpJsonFindEscape(text, from, length);
+    size_t expected = referenceFind(text, from, length);
+    if (actual != expected) {
+      mismatches++;
+      if (reports++ < MAX_REPORTS) {
+        printf("查找不一致: 偏移%zu 长度%zu from=%zu 实际%zu 期望%zu 内容 %s\n", offset, length, from,
+               actual, expected, hexDump(text, length).c_str());
+      }
+    }
+  }
+
+  std::string written;
+  StdStringWriter writer(written);
+  mcpWriteJsonEscaped(writer, text, length);
+  std::string expected = referenceEscape(text, length);
+  if (written != expected || mcpJsonEscapedLength(text, length) != expected.size()) {
+    mismatches++;
+    if (reports++ < MAX_REPORTS) {
+      printf("转义不一致: 偏移%zu 长度%zu 内容 %s\n", offset, length, hexDump(text, length).c_str());
+    }
+  }
+  return mismatches;
+}
+
+// 填充不需要转义的字节：可打印ASCII、0x7F和0x80-0xFF轮流出现，覆盖各种高位和借位情况
+static void fillPlain(char *text, size_t length, size_t seed) {
+  for (size_t i = 0; i < length; i++) {
+    uint8_t c = (uint8_t)(0x20 + (seed + i * 37) % 0xE0);
+    if (c == '"' || c == '\\') {
+      c = 0x7F;
+    }
+    text[i] = (char)c;
+  }
+}
+
+static void testSingleSpecialByte() {
+  // 按机器字对齐，text = buffer + offset 覆盖每种对齐
+  alignas(16) char buffer[MAX_OFFSET + MAX_LENGTH + 16];
+  int mismatches = 0;
+  int reports = 0;
+  std::vector<uint8_t> specials;
+  for (int c = 0; c < 0x20; c++) {
+    specials.push_back((uint8_t)c);
+  }
+  specials.push_back('"');
+  specials.push_back('\\');
+
+  for (size_t offset = 0; offset < MAX_OFFSET; offset++) {
+    char *text = buffer + offset;
+    for (size_t length = 0; length <= MAX_LENGTH; length++) {
+      // 没有需要转义的字节
+      fillPlain(text, length, offset + length);
+      mismatches += checkText(text, length, offset, reports);
+
+      for (size_t position = 0; position < length; position++) {
+        for (size_t k = 0; k < specials.size(); k++) {
+          fillPlain(text, length, offset + length + position + k);
+          text[position] = (char)specials[k];
+          mismatches += checkText(text, length, offset, reports);
+        }
+      }
+    }
+  }
+  MCP_CHECK_EQ(mismatches, 0);
+}
+
+static void testAdjacentSpecialBytes() {
+  // 同一个字内有两个需要转义的字节，以及与0x7F、0xFF等相邻时减法借位不能产生误判
+  alignas(16) char buffer[MAX_OFFSET + 32];
+  const uint8_t neighbours[] = {0x00, 0x1F, 0x20, 0x21, '"', 0x23, 0x5B, '\\', 0x5D, 0x7F, 0x80, 0xA0, 0xDF, 0xFF};
+  const size_t count = sizeof(neighbours) / sizeof(neighbours[0]);
+  const size_t length = 3 * sizeof(uintptr_t);
+  int mismatches = 0;
+  int reports = 0;
+  for (size_t offset = 0; offset < MAX_OFFSET; offset++) {
+    char *text = buffer + offset;
+    for (size_t position = 0; position + 1 < length; position++) {
+      for (size_t a = 0; a < count; a++) {
+        for (size_t b = 0; b < count; b++) {
+          memset(text, 'x', length);
+          text[position] = (char)neighbours[a];
+          text[position + 1] = (char)neighbours[b];
+          mismatches += checkText(text, length, offset, reports);
+        }
+      }
+    }
+  }
+  MCP_CHECK_EQ(mismatches, 0);
+}
+
+static void testUtf8AndDelete() {
+  // 0x7F和UTF-8多字节字符原样输出，跨字边界也不拆分
+  const char *samples[] = {"\x7f", "é", "中", "😀", "é中😀\x7f", "中\"文\\\n😀"};
+  alignas(16) char buffer[MAX_OFFSET + 64];
+  int mismatches = 0;
+  int reports = 0;
+  for (size_t s = 0; s < sizeof(samples) / sizeof(samples[0]); s++) {
+    size_t sampleLength = strlen(samples[s]);
+    for (size_t offset = 0; offset < MAX_OFFSET; offset++) {
+      for (size_t prefix = 0; prefix <= sizeof(uintptr_t); prefix++) {
+        char *text = buffer + offset;
+        memset(text, 'a', prefix);
+        memcpy(text + prefix, samples[s], sampleLength);
+        mismatches += checkText(text, prefix + sampleLength, offset, reports);
+      }
+    }
+  }
+  MCP_CHECK_EQ(mismatches, 0);
+
+  String escaped;
+  mcpAppendJsonEscaped(escaped, String("é中😀\x7f"));
+  MCP_CHECK(escaped == "é中😀\x7f");
+  escaped = "";
+  mcpAppendJsonEscaped(escaped, String("中\"文\\\x01\n"));
+  MCP_CHECK(escaped == "中\\\"文\\\\\\u0001\\n");
+}
+
+int main() {
+  testSingleSpecialByte();
+  testAdjacentSpecialBytes();
+  testUtf8AndDelete();
+  return MCP_TEST_RESULT();
+}
@@ -0,0 +1,273 @@
+/**
+ * test_msgpack.cpp
+ * MessagePack会话：initialize以MessagePack发来后出站消息改用二进制帧，解码后与文本会话的响应内容一致；
+ * 超过MCP_MSGPACK_MAX_MESSAGE的消息仍用文本帧；批量请求中的initialize在响应数组发出后才切换编码；未启用时二进制帧被忽略；
+ * 直接转码与经JsonDocument转码的结果一致；tools/list使用缓存的目录编码，不再逐次转码
+ */
+
+#include "mcp_test.h"
+
+static const char *const REQUESTS[] = {
+  "{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"ping\"}",
+  "{\"jsonrpc\":\"2.0\",\"id\":3,\"method\":\"tools/list\"}",
+  "{\"jsonrpc\":\"2.0\",\"id\":4,\"method\":\"tools/call\",\"params\":{\"name\":\"status\",\"arguments\":{\"n\":-7}}}",
+  "[{\"jsonrpc\":\"2.0\",\"id\":5,\"method\":\"ping\"},"
+  "{\"jsonrpc\":\"2.0\",\"id\":\"六\",\"method\":\"tools/call\",\"params\":{\"name\":\"status\",\"arguments\":{\"n\":300000}}}]",
+};
+
+static void registerTools(WebSocketMCP &mcp) {
+  mcp.registerTool("status", "设备状态\"引号\"", "{\"type\":\"object\",\"properties\":{\"n\":{\"type\":\"integer\"}}}",
+                   [](JsonObjectConst args, McpToolResult &result) {
+                     result.beginObject().add("n", args["n"] | 0).add("ratio", 0.5).add("name", "客厅\n灯").endObject();
+                   });
+  mcp.registerStreamingTool("huge", "大输出", "{}", [](JsonObjectConst, WebSocketMCP::ToolStream &stream) {
+    for (int i = 0; i < MCP_MSGPACK_MAX_MESSAGE; i++) {
+      stream.print('z');
+    }
+  });
+}
+
+// 两种编码下依次发出同样的请求，比较解码后的响应
+static void testRoundTrip() {
+  TestPeer textPeer;
+  WebSocketMCP text;
+  text.setBinaryEncoding(true);
+  registerTools(text);
+  MCP_CHECK(mcpTestConnect(text, textPeer));
+  MCP_CHECK(!text.isBinarySession());
+  for (size_t i = 0; i < sizeof(REQUESTS) / sizeof(REQUESTS[0]); i++) {
+    mcpTestRequest(text, textPeer, REQUESTS[i]);
+  }
+
+  TestPeer binaryPeer;
+  WebSocketMCP binary;
+  binary.setBinaryEncoding(true);
+  registerTools(binary);
+  WebSocketsClient::hostSetPeer(&binaryPeer);
+  binary.begin("ws://localhost:8080/mcp");
+  binary.loop();
+  binaryPeer.postBinary("{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"initialize\",\"params\":{}}");
+  binary.loop();
+  binary.loop();
+  MCP_CHECK(binary.isBinarySession());
+  // initialize响应已经是MessagePack，并声明了msgpack扩展
+  MCP_CHECK(!binaryPeer.messages.empty() && binaryPeer.messages[0].binary);
+  MCP_CHECK_CONTAINS(binaryPeer.find("\"id\":1"), "\"msgpack\"");
+  binaryPeer.messages.clear();
+  for (size_t i = 0; i < sizeof(REQUESTS) / sizeof(REQUESTS[0]); i++) {
+    binaryPeer.postBinary(REQUESTS[i]);
+    binary.loop();
+  }
+
+  MCP_CHECK_EQ(binaryPeer.messages.size(), textPeer.messages.size());
+  for (size_t i = 0; i < binaryPeer.messages.size() && i < textPeer.messages.size(); i++) {
+    MCP_CHECK(binaryPeer.messages[i].binary);
+    // 文本会话的响应经同一个解析器规范化后比较
+    DynamicJsonDocument doc(16384);
+    deserializeJson(doc, textPeer.messages[i].json);
+    std::string expected;
+    serializeJson(doc, expected);
+    if (binaryPeer.messages[i].json != expected) {
+      printf("第%u条响应不一致:\n  文本: %.200s\n  二进制: %.200s\n", (unsigned)i, expected.c_str(),
+             binaryPeer.messages[i].json.c_str());
+    }
+    MCP_CHECK(binaryPeer.messages[i].json == expected);
+    MCP_CHECK(binaryPeer.messages[i].bytes < textPeer.messages[i].bytes);
+  }
+
+  // 超长消息改用文本帧，内容完整
+  binaryPeer.messages.clear();
+  binaryPeer.postBinary("{\"jsonrpc\":\"2.0\",\"id\":9,\"method\":\"tools/call\",\"params\":{\"name\":\"huge\",\"arguments\":{}}}");
+  binary.loop();
+  MCP_CHECK_EQ(binaryPeer.messages.size(), 1);
+  if (binaryPeer.messages.size() == 1) {
+    MCP_CHECK(!binaryPeer.messages[0].binary);
+    DynamicJsonDocument doc(MCP_MSGPACK_MAX_MESSAGE * 2);
+    MCP_CHECK(!deserializeJson(doc, binaryPeer.messages[0].json));
+    MCP_CHECK_EQ(strlen(doc["result"]["content"][0]["text"] | ""), MCP_MSGPACK_MAX_MESSAGE);
+  }
+}
+
+// 经文档规范化后的JSON文本
+static std::string normalized(const char *json) {
+  DynamicJsonDocument doc(4096);
+  deserializeJson(doc, json);
+  std::string text;
+  serializeJson(doc, text);
+  return text;
+}
+
+static void testDirectEncoder() {
+  static const char *const VALID[] = {
+    "{}", "[]", " [ ] ", "0", "null", "true", "false", "\"\"",
+    "[0,127,128,255,256,65535,65536,4294967295,4294967296,18446744073709551615]",
+    "[-1,-32,-33,-128,-129,-32768,-32769,-2147483648,-2147483649,-9223372036854775808]",
+    "[0.5,0.1,-2.25,1e3,1.5E-3,1e300,123456789.125]",
+    "{\"s\":\"a\\\"b\\\\c\\n\\u0001\",\"u\":\"客厅灯😀\"}",
+    "{\"jsonrpc\":\"2.0\",\"id\":7,\"result\":{\"content\":[{\"type\":\"text\",\"text\":\"ok\"}],\"isError\":false}}",
+    "{\"a\":[1,[2,[3,{\"b\":{}}]]],\"c\" : { \"d\" : [ ] } }",
+  };
+  uint32_t counts[MCP_MSGPACK_MAX_CONTAINERS];
+  for (size_t i = 0; i < sizeof(VALID) / sizeof(VALID[0]); i++) {
+    McpMsgPackEncoder encoder(counts, MCP_MSGPACK_MAX_CONTAINERS);
+    const char *json = VALID[i];
+    MCP_CHECK(encoder.measure(json, strlen(json)));
+    std::vector<uint8_t> packed(encoder.size() + 1);
+    MCP_CHECK_EQ(encoder.encode(json, strlen(json), packed.data()), encoder.size());
+    DynamicJsonDocument doc(4096);
+    MCP_CHECK(!deserializeMsgPack(doc, packed.data(), encoder.size()));
+    std::string decoded;
+    serializeJson(doc, decoded);
+    if (decoded != normalized(json)) {
+      printf("转码不一致: %s\n  得到: %s\n", json, decoded.c_str());
+    }
+    MCP_CHECK(decoded == normalized(json));
+  }
+
+  // 转义按ArduinoJson的规则解码为UTF-8(代理对合成一个字符)；超出64位整数范围的整数按浮点数编码
+  static const char SPECIAL[] =
+      "{\"s\":\"\\/\\b\\f\\r\\t\\u00e9\\u4e2d\\ud83d\\ude00\",\"big\":18446744073709551616,\"low\":-9223372036854775809}";
+  {
+    McpMsgPackEncoder encoder(counts, MCP_MSGPACK_MAX_CONTAINERS);
+    MCP_CHECK(encoder.measure(SPECIAL, strlen(SPECIAL)));
+    std::vector<uint8_t> packed(encoder.size());
+    encoder.encode(SPECIAL, strlen(SPECIAL), packed.data());
+    DynamicJsonDocument doc(1024);
+    MCP_CHECK(!deserializeMsgPack(doc, packed.data(), packed.size()));
+    MCP_CHECK(strcmp(doc["s"] | "", "/\b\f\r\té中😀") == 0);
+    MCP_CHECK(doc["big"].as<double>() == 18446744073709551616.0);
+    MCP_CHECK(doc["low"].as<double>() == -9223372036854775809.0);
+  }
+
+  // 长字符串和多成员容器使用较长的头部
+  std::string longText = "{\"k\":\"" + std::string(300, 'x') + "\",\"a\":[";
+  for (int i = 0; i < 20; i++) {
+    longText += (i ? "," : "") + std::to_string(i);
+  }
+  longText += "]}";
+  McpMsgPackEncoder encoder(counts, MCP_MSGPACK_MAX_CONTAINERS);
+  MCP_CHECK(encoder.measure(longText.data(), longText.size()));
+  std::vector<uint8_t> packed(encoder.size());
+  encoder.encode(longText.data(), longText.size(), packed.data());
+  DynamicJsonDocument doc(4096);
+  MCP_CHECK(!deserializeMsgPack(doc, packed.data(), packed.size()));
+  MCP_CHECK_EQ(strlen(doc["k"] | ""), 300);
+  MCP_CHECK_EQ(doc["a"].size(), 20);
+
+  // 无效的JSON、容器或嵌套超过上限时不转码
+  static const char *const INVALID[] = {
+    "", " ", "{", "[1,]", "[1 2]", "{\"a\" 1}", "{\"a\":1,}", "{1:2}", "{\"a\":1}x", "tru", "-", "1.", "1e",
+    "\"\\x\"", "\"\\u12\"", "\"abc", "[}", "{]",
+  };
+  for (size_t i = 0; i < sizeof(INVALID) / sizeof(INVALID[0]); i++) {
+    McpMsgPackEncoder invalid(counts, MCP_MSGPACK_MAX_CONTAINERS);
+    if (invalid.measure(INVALID[i], strlen(INVALID[i]))) {
+      printf("应拒绝: %s\n", INVALID[i]);
+      MCP_CHECK(false);
+    }
+  }
+  std::string deep = std::string(MCP_MSGPACK_MAX_DEPTH + 1, '[') + std::string(MCP_MSGPACK_MAX_DEPTH + 1, ']');
+  MCP_CHECK(!encoder.measure(deep.data(), deep.size()));
+  std::string many = "[";
+  for (int i = 0; i < MCP_MSGPACK_MAX_CONTAINERS; i++) {
+    many += i ? ",{}" : "{}";
+  }
+  many += "]";
+  MCP_CHECK(!encoder.measure(many.data(), many.size()));
+}
+
+// tools/list在MessagePack会话中直接发出缓存的目录编码，注册表变化后重新编码
+static void testPackedCatalog() {
+  TestPeer peer;
+  WebSocketMCP mcp;
+  mcp.setBinaryEncoding(true);
+  registerTools(mcp);
+  WebSocketsClient::hostSetPeer(&peer);
+  mcp.begin("ws://localhost:8080/mcp");
+  mcp.loop();
+  peer.postBinary("{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"initialize\",\"params\":{}}");
+  mcp.loop();
+  mcp.loop();
+  MCP_CHECK(mcp.isBinarySession());
+  peer.messages.clear();
+
+  uint32_t encoded = mcp.getStats().encoded.count;
+  for (int id = 2; id <= 3; id++) {
+    char frame[96];
+    snprintf(frame, sizeof(frame), "{\"jsonrpc\":\"2.0\",\"id\":%d,\"method\":\"tools/list\"}", id);
+    peer.postBinary(frame);
+    mcp.loop();
+  }
+  MCP_CHECK_EQ(mcp.getStats().encoded.count, encoded);
+  MCP_CHECK_EQ(peer.messages.size(), 2);
+  if (peer.messages.size() == 2) {
+    MCP_CHECK(peer.messages[1].binary);
+    DynamicJsonDocument doc(8192);
+    MCP_CHECK(!deserializeJson(doc, peer.messages[1].json));
+    MCP_CHECK_EQ(doc["id"].as<long>(), 3);
+    MCP_CHECK_EQ(doc["result"]["tools"].size(), 2);
+  }
+
+  mcp.registerTool("extra", "新工具", "{}", [](JsonObjectConst, McpToolResult &result) { result.print("x"); });
+  mcp.loop();
+  peer.messages.clear();
+  peer.postBinary("{\"jsonrpc\":\"2.0\",\"id\":4,\"method\":\"tools/list\"}");
+  mcp.loop();
+  MCP_CHECK_CONTAINS(peer.find("\"id\":4"), "\"extra\"");
+}
+
+// 批量请求中的initialize：响应数组整体沿用原编码，数组发出后才改用MessagePack
+static void testInitializeInBatch() {
+  TestPeer peer;
+  WebSocketMCP mcp;
+  mcp.setBinaryEncoding(true);
+  mcp.registerStreamingTool("long", "较长输出", "{}", [](JsonObjectConst, WebSocketMCP::ToolStream &stream) {
+    for (int i = 0; i < 4000; i++) {
+      stream.print('y');
+    }
+  });
+  MCP_CHECK(mcpTestConnect(mcp, peer));
+  MCP_CHECK(!mcp.isBinarySession());
+
+  // initialize之前的项已经把数组的前几个分片以文本帧发出
+  peer.postBinary("[{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"tools/call\",\"params\":{\"name\":\"long\",\"arguments\":{}}},"
+                  "{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"initialize\",\"params\":{}},"
+                  "{\"jsonrpc\":\"2.0\",\"id\":3,\"method\":\"ping\"}]");
+  mcp.loop();
+  mcp.loop();
+  MCP_CHECK(mcp.isBinarySession());
+  MCP_CHECK(!peer.messages.empty() && !peer.messages[0].binary);
+  if (!peer.messages.empty()) {
+    DynamicJsonDocument doc(16384);
+    MCP_CHECK(!deserializeJson(doc, peer.messages[0].json));
+    MCP_CHECK_EQ(doc.as<JsonArrayConst>().size(), 3);
+    MCP_CHECK_EQ(strlen(doc[0]["result"]["content"][0]["text"] | ""), 4000);
+    MCP_CHECK_EQ(doc[2]["id"].as<long>(), 3);
+  }
+  // 数组之后的initialized通知和响应都是MessagePack
+  MCP_CHECK(peer.messages.size() >= 2 && peer.messages.back().binary);
+  peer.messages.clear();
+  peer.postBinary("{\"jsonrpc\":\"2.0\",\"id\":4,\"method\":\"ping\"}");
+  mcp.loop();
+  MCP_CHECK(peer.messages.size() == 1 && peer.messages[0].binary);
+}
+
+// 未启用MessagePack时二进制帧不作为请求处理
+static void testDisabled() {
+  TestPeer peer;
+  WebSocketMCP mcp;
+  MCP_CHECK(mcpTestConnect(mcp, peer));
+  peer.postBinary("{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"ping\"}");
+  mcp.loop();
+  MCP_CHECK_EQ(peer.messages.size(), 0);
+  MCP_CHECK(!mcp.isBinarySession());
+}
+
+int main() {
+  testRoundTrip();
+  testDirectEncoder();
+  testPackedCatalog();
+  testInitializeInBatch();
+  testDisabled();
+  return MCP_TEST_RESULT();
+}
@@ -0,0 +1,121 @@
+/**
+ * test_resources.cpp
+ * 资源：list/read，订阅后的更新通知(内容未变不通知，多次变化合并)，取消订阅，
+ * 资源列表变化通知，以及订阅只对本次连接有效
+ */
+
+#include "mcp_test.h"
+
+static const char SUBSCRIBE_LIGHT[] =
+    "{\"jsonrpc\":\"2.0\",\"id\":5,\"method\":\"resources/subscribe\",\"params\":{\"uri\":\"device://light\"}}";
+
+static void testListAndRead() {
+  TestPeer peer;
+  WebSocketMCP mcp;
+  mcp.registerResource("device://light", "客厅灯", "灯的开关状态");
+  mcp.registerResource("device://temp", "温度", "", "text/plain");
+  mcp.updateResource("device://light", "{\"on\":false}");
+  MCP_CHECK(mcpTestConnect(mcp, peer));
+
+  mcpTestRequest(mcp, peer, "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"resources/list\"}");
+  mcpTestRequest(mcp, peer,
+                 "{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"resources/read\",\"params\":{\"uri\":\"device://light\"}}");
+  mcpTestRequest(mcp, peer,
+                 "{\"jsonrpc\":\"2.0\",\"id\":3,\"method\":\"resources/read\",\"params\":{\"uri\":\"device://none\"}}");
+  MCP_CHECK_EQ(peer.messages.size(), 3);
+  if (peer.messages.size() != 3) {
+    return;
+  }
+  DynamicJsonDocument doc(4096);
+  MCP_CHECK(!deserializeJson(doc, peer.messages[0].json));
+  MCP_CHECK_EQ(doc["result"]["resources"].size(), 2);
+  MCP_CHECK(strcmp(doc["result"]["resources"][1]["mimeType"] | "", "text/plain") == 0);
+  MCP_CHECK(!deserializeJson(doc, peer.messages[1].json));
+  MCP_CHECK(strcmp(doc["result"]["contents"][0]["text"] | "", "{\"on\":false}") == 0);
+  MCP_CHECK(!deserializeJson(doc, peer.messages[2].json));
+  MCP_CHECK_EQ(doc["error"]["code"].as<long>(), -32002);
+}
+
+static void testSubscriptions() {
+  TestPeer peer;
+  WebSocketMCP mcp;
+  mcp.registerResource("device://light", "客厅灯");
+  mcp.registerResource("device://temp", "温度");
+  mcp.updateResource("device://light", "{\"on\":false}");
+  MCP_CHECK(mcpTestConnect(mcp, peer));
+  mcpTestRequest(mcp, peer, SUBSCRIBE_LIGHT);
+  MCP_CHECK_EQ(peer.messages.size(), 1);
+  peer.messages.clear();
+
+  // 内容未变不算更新
+  MCP_CHECK(!mcp.updateResource("device://light", "{\"on\":false}"));
+  mcp.loop();
+  MCP_CHECK_EQ(peer.messages.size(), 0);
+
+  // 同一轮中的多次变化合并为一条通知；未订阅的资源不通知
+  MCP_CHECK(mcp.updateResource("device://light", "{\"on\":true}"));
+  MCP_CHECK(mcp.updateResource("device://light", "{\"on\":true,\"level\":3}"));
+  MCP_CHECK(mcp.updateResource("device://temp", "21.5"));
+  mcp.loop();
+  MCP_CHECK_EQ(peer.messages.size(), 1);
+  MCP_CHECK_EQ(peer.count("notifications/resources/updated"), 1);
+  MCP_CHECK_CONTAINS(peer.find("updated"), "device://light");
+
+  mcpTestRequest(mcp, peer,
+                 "{\"jsonrpc\":\"2.0\",\"id\":6,\"method\":\"resources/unsubscribe\",\"params\":{\"uri\":\"device://light\"}}");
+  peer.messages.clear();
+  mcp.updateResource("device://light", "{}");
+  mcp.loop();
+  MCP_CHECK_EQ(peer.messages.size(), 0);
+
+  // 订阅不存在的资源返回错误
+  mcpTestRequest(mcp, peer,
+                 "{\"jsonrpc\":\"2.0\",\"id\":7,\"method\":\"resources/subscribe\",\"params\":{\"uri\":\"device://none\"}}");
+  MCP_CHECK_CONTAINS(peer.find("\"id\":7"), "-32002");
+}
+
+static void testListChanged() {
+  TestPeer peer;
+  WebSocketMCP mcp;
+  mcp.registerResource("device://light", "客厅灯");
+  MCP_CHECK(mcpTestConnect(mcp, peer));
+  mcp.registerResource("device://door", "门");
+  mcp.registerResource("device://window", "窗");
+  mcp.loop();
+  MCP_CHECK_EQ(peer.count("notifications/resources/list_changed"), 1);
+  MCP_CHECK(mcp.unregisterResource("device://door"));
+  mcp.loop();
+  MCP_CHECK_EQ(peer.count("notifications/resources/list_changed"), 2);
+}
+
+static void testSubscriptionEndsWithConnection() {
+  TestPeer peer;
+  WebSocketMCP mcp;
+  mcp.registerResource("device://light", "客厅灯");
+  MCP_CHECK(mcpTestConnect(mcp, peer));
+  mcpTestRequest(mcp, peer, SUBSCRIBE_LIGHT);
+
+  peer.client->hostDrop();
+  mcp.loop();
+  MCP_CHECK(!mcp.isConnected());
+  for (int i = 0; i < 100 && !mcp.isConnected(); i++) {
+    delay(50);
+    mcp.loop();
+  }
+  MCP_CHECK(mcp.isConnected());
+  peer.post("{\"jsonrpc\":\"2.0\",\"id\":0,\"method\":\"initialize\",\"params\":{}}");
+  mcp.loop();
+  mcp.loop();
+  peer.messages.clear();
+  mcp.updateResource("device://light", "{\"on\":true}");
+  mcp.loop();
+  MCP_CHECK_EQ(peer.count("notifications/resources/updated"), 0);
+}
+
+int main() {
+  testListAndRead();
+  testSubscriptions();
+  testListChanged();
+  testSubscriptionEndsWithConnection();
+  return MCP_TEST_RESULT();
+}
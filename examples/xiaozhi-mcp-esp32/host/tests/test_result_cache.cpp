@@ -0,0 +1,169 @@
+/**
+ * test_result_cache.cpp
+ * 工具结果缓存：TTL到期(含millis()回绕)、满时淘汰最久未使用的条目、按工具失效、参数哈希碰撞，
+ * 以及tools/call在TTL内命中缓存时不再调用工具，命中仍计入工具的调用统计
+ */
+
+#include "mcp_test.h"
+
+// 参数{"k":args}，argsHash按实际参数计算
+struct Args {
+  DynamicJsonDocument doc;
+  explicit Args(long value) : doc(128) {
+    doc["k"] = value;
+  }
+  JsonObjectConst object() const {
+    return doc.as<JsonObjectConst>();
+  }
+  uint32_t hash() const {
+    return McpResultCache::hashArguments(object());
+  }
+};
+
+static void store(McpResultCache &cache, uint32_t tool, long args, uint32_t ttl, unsigned long now,
+                  const char *text) {
+  Args a(args);
+  cache.store(tool, a.hash(), a.object(), ttl, now, text, strlen(text));
+}
+
+static const String *find(McpResultCache &cache, uint32_t tool, long args, unsigned long now) {
+  Args a(args);
+  return cache.find(tool, a.hash(), a.object(), now);
+}
+
+static void testTtl() {
+  McpResultCache cache;
+  store(cache, 1, 10, 100, 1000, "a");
+  MCP_CHECK(find(cache, 1, 10, 1099) != nullptr);
+  MCP_CHECK(find(cache, 1, 10, 1100) == nullptr);
+  // 过期条目在查找时释放
+  MCP_CHECK_EQ(cache.size(), 0);
+
+  // 有效期跨过millis()回绕
+  unsigned long nearWrap = (unsigned long)-50;
+  store(cache, 1, 10, 100, nearWrap, "b");
+  MCP_CHECK(find(cache, 1, 10, nearWrap + 99) != nullptr);
+  MCP_CHECK(find(cache, 1, 10, nearWrap + 100) == nullptr);
+  MCP_CHECK_EQ(cache.hits(), 2);
+  MCP_CHECK_EQ(cache.misses(), 2);
+}
+
+static void testLruEviction() {
+  McpResultCache cache;
+  for (uint32_t i = 0; i < MCP_RESULT_CACHE_ENTRIES; i++) {
+    store(cache, 1, i, 10000, 0, "r");
+  }
+  MCP_CHECK_EQ(cache.size(), MCP_RESULT_CACHE_ENTRIES);
+  // 访问第0条后，第1条成为最久未使用的条目
+  MCP_CHECK(find(cache, 1, 0, 1) != nullptr);
+  store(cache, 1, 100, 10000, 2, "new");
+  MCP_CHECK_EQ(cache.size(), MCP_RESULT_CACHE_ENTRIES);
+  MCP_CHECK(find(cache, 1, 0, 3) != nullptr);
+  MCP_CHECK(find(cache, 1, 1, 3) == nullptr);
+  const String *latest = find(cache, 1, 100, 3);
+  MCP_CHECK(latest && *latest == "new");
+
+  // 同键再次保存时替换原条目，不占用新条目
+  store(cache, 1, 100, 10000, 4, "newer");
+  latest = find(cache, 1, 100, 5);
+  MCP_CHECK(latest && *latest == "newer");
+  MCP_CHECK_EQ(cache.size(), MCP_RESULT_CACHE_ENTRIES);
+}
+
+static void testInvalidateAndLimit() {
+  McpResultCache cache;
+  store(cache, 1, 1, 1000, 0, "x");
+  store(cache, 2, 1, 1000, 0, "y");
+  cache.invalidate(1);
+  MCP_CHECK(find(cache, 1, 1, 1) == nullptr);
+  MCP_CHECK(find(cache, 2, 1, 1) != nullptr);
+
+  // 超过MCP_RESULT_CACHE_MAX的结果不缓存
+  std::string large(MCP_RESULT_CACHE_MAX + 1, 'z');
+  Args one(1);
+  cache.store(3, one.hash(), one.object(), 1000, 0, large.data(), large.size());
+  MCP_CHECK(find(cache, 3, 1, 1) == nullptr);
+}
+
+// 参数哈希相同但参数不同时不命中，也不替换对方的条目
+static void testHashCollision() {
+  McpResultCache cache;
+  Args first(1);
+  Args second(2);
+  const uint32_t hash = 0x1234;
+  cache.store(1, hash, first.object(), 1000, 0, "first", 5);
+  MCP_CHECK(cache.find(1, hash, second.object(), 1) == nullptr);
+  cache.store(1, hash, second.object(), 1000, 0, "second", 6);
+  MCP_CHECK_EQ(cache.size(), 2);
+  const String *hit = cache.find(1, hash, first.object(), 2);
+  MCP_CHECK(hit && *hit == "first");
+  hit = cache.find(1, hash, second.object(), 2);
+  MCP_CHECK(hit && *hit == "second");
+
+  // 参数文本超过MCP_RESULT_CACHE_MAX时不缓存
+  DynamicJsonDocument doc(MCP_RESULT_CACHE_MAX * 4);
+  std::string text(MCP_RESULT_CACHE_MAX, 'a');
+  doc["k"] = text.c_str();
+  JsonObjectConst large = doc.as<JsonObjectConst>();
+  cache.store(2, 1, large, 1000, 0, "x", 1);
+  MCP_CHECK(cache.find(2, 1, large, 1) == nullptr);
+}
+
+// tools/call：TTL内相同参数命中缓存，不同参数和过期后重新调用
+static void testToolCallUsesCache() {
+  TestPeer peer;
+  WebSocketMCP mcp;
+  int calls = 0;
+  mcp.registerTool("weather", "天气", "{\"type\":\"object\"}",
+                   [&calls](JsonObjectConst args, McpToolResult &result) {
+                     calls++;
+                     result.print(args["city"] | "?");
+                     result.print(':');
+                     result.print(calls);
+                   },
+                   200);
+  MCP_CHECK(mcpTestConnect(mcp, peer));
+
+  const char *beijing = "{\"jsonrpc\":\"2.0\",\"id\":%d,\"method\":\"tools/call\",\"params\":{\"name\":\"weather\","
+                        "\"arguments\":{\"city\":\"北京\"}}}";
+  char frame[256];
+  for (int id = 1; id <= 3; id++) {
+    snprintf(frame, sizeof(frame), beijing, id);
+    mcpTestRequest(mcp, peer, frame);
+  }
+  mcpTestRequest(mcp, peer, "{\"jsonrpc\":\"2.0\",\"id\":4,\"method\":\"tools/call\",\"params\":{\"name\":\"weather\","
+                            "\"arguments\":{\"city\":\"上海\"}}}");
+  MCP_CHECK_EQ(calls, 2);
+  MCP_CHECK_EQ(peer.messages.size(), 4);
+  if (peer.messages.size() == 4) {
+    // 命中缓存的响应带本次请求的id
+    MCP_CHECK_CONTAINS(peer.messages[2].json, "\"id\":3");
+    MCP_CHECK_CONTAINS(peer.messages[2].json, "北京:1");
+    MCP_CHECK_CONTAINS(peer.messages[3].json, "上海:2");
+  }
+  WebSocketMCP::CacheStats stats = mcp.getCacheStats();
+  MCP_CHECK_EQ(stats.hits, 2);
+  const McpToolStats *toolStats = mcp.getToolStats("weather");
+  MCP_CHECK(toolStats != nullptr);
+  if (toolStats) {
+    MCP_CHECK_EQ(toolStats->calls, 4);
+    MCP_CHECK_EQ(toolStats->cacheHits, 2);
+    MCP_CHECK_EQ(toolStats->latency.count(), 4);
+  }
+  MCP_CHECK_CONTAINS(std::string(mcp.getStatsJson().c_str()), "\"cache_hits\":2");
+
+  delay(250);
+  snprintf(frame, sizeof(frame), beijing, 5);
+  mcpTestRequest(mcp, peer, frame);
+  MCP_CHECK_EQ(calls, 3);
+  MCP_CHECK_CONTAINS(peer.messages.back().json, "北京:3");
+}
+
+int main() {
+  testTtl();
+  testLruEviction();
+  testInvalidateAndLimit();
+  testHashCollision();
+  testToolCallUsesCache();
+  return MCP_TEST_RESULT();
+}
@@ -0,0 +1,200 @@
+/**
+ * test_send_queue.cpp
+ * 发送队列：环形存储的追加、回绕和丢弃，控制通道优先，断线期间排队、重连后按序发出，
+ * 流式响应和批量响应写出期间发出的消息在响应之后完整发出
+ */
+
+#include "mcp_test.h"
+
+static std::string frontText(const McpMessageRing &ring) {
+  std::string text;
+  size_t offset = 0;
+  while (offset < ring.frontLength()) {
+    size_t n;
+    const uint8_t *data = ring.frontData(offset, &n);
+    text.append((const char *)data, n);
+    offset += n;
+  }
+  return text;
+}
+
+static bool push(McpMessageRing &ring, const std::string &text) {
+  ring.beginMessage();
+  // 分两次追加，和写入器按块写入一样
+  size_t half = text.size() / 2;
+  ring.append((const uint8_t *)text.data(), half);
+  ring.append((const uint8_t *)text.data() + half, text.size() - half);
+  return ring.commitMessage();
+}
+
+static void testRingOrderAndWrap() {
+  uint8_t storage[64];
+  McpMessageRing ring(storage, sizeof(storage));
+  // 每条消息占4字节长度头加内容，反复进出使写入位置跨过存储末尾
+  for (int round = 0; round < 50; round++) {
+    std::string a = "a" + std::to_string(round) + std::string(round % 13, 'x');
+    std::string b = "b" + std::to_string(round);
+    MCP_CHECK(push(ring, a));
+    MCP_CHECK(push(ring, b));
+    MCP_CHECK_EQ(ring.count(), 2);
+    MCP_CHECK(frontText(ring) == a);
+    ring.popFront();
+    MCP_CHECK(frontText(ring) == b);
+    ring.popFront();
+    MCP_CHECK(ring.empty());
+  }
+  MCP_CHECK_EQ(ring.dropped(), 0);
+}
+
+static void testRingDropsWholeMessage() {
+  uint8_t storage[32];
+  McpMessageRing ring(storage, sizeof(storage));
+  MCP_CHECK(push(ring, std::string(20, 'k')));
+  // 剩余8字节放不下，整条消息丢弃，已有消息不受影响
+  MCP_CHECK(!push(ring, std::string(10, 'z')));
+  MCP_CHECK_EQ(ring.dropped(), 1);
+  MCP_CHECK_EQ(ring.count(), 1);
+  MCP_CHECK(frontText(ring) == std::string(20, 'k'));
+  // 放弃的消息不计入丢弃
+  ring.beginMessage();
+  ring.append((const uint8_t *)"abc", 3);
+  ring.abortMessage();
+  MCP_CHECK_EQ(ring.count(), 1);
+  MCP_CHECK_EQ(ring.dropped(), 1);
+  MCP_CHECK_EQ(ring.highWater(), 24);
+}
+
+static void testControlLaneFirst() {
+  McpSendQueue queue;
+  MCP_CHECK(push(queue.lane(McpSendQueue::LANE_BULK), "bulk"));
+  MCP_CHECK(push(queue.lane(McpSendQueue::LANE_CONTROL), "pong"));
+  MCP_CHECK(frontText(queue.next()) == "pong");
+  queue.next().popFront();
+  MCP_CHECK(frontText(queue.next()) == "bulk");
+  queue.next().popFront();
+  MCP_CHECK(queue.empty());
+}
+
+// 已连接时对请求的响应不被丢弃：100个工具的目录用完本轮发送预算，工具回调发出的通知排队，
+// 之后的tools/list超过队列剩余空间，仍应先发出排队的通知再完整发出
+static void testRepliesNeverDropped() {
+  TestPeer peer;
+  WebSocketMCP mcp;
+  char name[32];
+  for (int i = 0; i < 100; i++) {
+    snprintf(name, sizeof(name), "device_%03d", i);
+    mcp.registerTool(name, "控制一个米家设备：开、关、亮度和色温", "{\"type\":\"object\",\"properties\":{}}",
+                     [](JsonObjectConst, McpToolResult &result) { result.print("ok"); });
+  }
+  mcp.registerTool("notify", "发出一条通知", "{}", [&mcp](JsonObjectConst, McpToolResult &result) {
+    mcp.sendMessage("{\"jsonrpc\":\"2.0\",\"method\":\"notifications/message\",\"params\":{}}");
+    result.print("sent");
+  });
+  MCP_CHECK(mcpTestConnect(mcp, peer));
+
+  peer.post("{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"tools/list\"}");
+  peer.post("{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"tools/call\",\"params\":{\"name\":\"notify\",\"arguments\":{}}}");
+  peer.post("{\"jsonrpc\":\"2.0\",\"id\":3,\"method\":\"tools/list\"}");
+  peer.post("{\"jsonrpc\":\"2.0\",\"id\":4,\"method\":\"ping\"}");
+  mcp.loop();
+
+  WebSocketMCP::SendQueueStats stats = mcp.getSendQueueStats();
+  MCP_CHECK_EQ(stats.dropped, 0);
+  MCP_CHECK_EQ(stats.queuedMessages, 0);
+  MCP_CHECK_EQ(peer.messages.size(), 5);
+  if (peer.messages.size() != 5) {
+    return;
+  }
+  // 通知在它之后的响应之前发出
+  MCP_CHECK_CONTAINS(peer.messages[1].json, "notifications/message");
+  MCP_CHECK_CONTAINS(peer.messages[2].json, "\"id\":2");
+  MCP_CHECK_CONTAINS(peer.messages[4].json, "\"id\":4");
+  const size_t lists[] = {0, 3};
+  for (size_t i = 0; i < 2; i++) {
+    const std::string &json = peer.messages[lists[i]].json;
+    MCP_CHECK(json.size() > MCP_SEND_QUEUE_BYTES);
+    DynamicJsonDocument doc(json.size() * 4);
+    MCP_CHECK(!deserializeJson(doc, json));
+    MCP_CHECK_EQ(doc["result"]["tools"].size(), 101);
+  }
+}
+
+// 流式响应或批量响应写出期间调用sendMessage()：消息比控制通道的队列大也不丢，响应发完后按序发出
+static void testMessagesDuringOpenResponse() {
+  TestPeer peer;
+  WebSocketMCP mcp;
+  std::string payload(MCP_CONTROL_QUEUE_BYTES * 2, 'n');
+  String notification((std::string("{\"jsonrpc\":\"2.0\",\"method\":\"notifications/message\",\"params\":{\"data\":\"") +
+                       payload + "\"}}").c_str());
+  mcp.registerStreamingTool("report", "分段输出", "{}",
+                            [&mcp, &notification](JsonObjectConst, WebSocketMCP::ToolStream &stream) {
+                              stream.text(std::string(MCP_FRAME_CHUNK * 2, 'a').c_str());
+                              MCP_CHECK(mcp.sendMessage(notification));
+                              MCP_CHECK(mcp.sendMessage("{\"n\":2}"));
+                              stream.text("end");
+                            });
+  mcp.registerTool("notify", "发出一条通知", "{}", [&mcp, &notification](JsonObjectConst, McpToolResult &result) {
+    MCP_CHECK(mcp.sendMessage(notification));
+    result.print("sent");
+  });
+  MCP_CHECK(mcpTestConnect(mcp, peer));
+
+  mcpTestRequest(mcp, peer,
+                 "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"tools/call\",\"params\":{\"name\":\"report\",\"arguments\":{}}}");
+  mcpTestRequest(mcp, peer,
+                 "[{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"ping\"},"
+                 "{\"jsonrpc\":\"2.0\",\"id\":3,\"method\":\"tools/call\",\"params\":{\"name\":\"notify\",\"arguments\":{}}}]");
+  MCP_CHECK_EQ(mcp.getSendQueueStats().dropped, 0);
+  MCP_CHECK_EQ(peer.messages.size(), 5);
+  if (peer.messages.size() != 5) {
+    return;
+  }
+  MCP_CHECK_CONTAINS(peer.messages[0].json, "\"id\":1");
+  MCP_CHECK_CONTAINS(peer.messages[0].json, "end");
+  MCP_CHECK(peer.messages[1].json == notification.c_str());
+  MCP_CHECK(peer.messages[2].json == "{\"n\":2}");
+  MCP_CHECK(peer.messages[3].json[0] == '[');
+  MCP_CHECK(peer.messages[4].json == notification.c_str());
+}
+
+// 断线期间的消息排队，重连后按提交顺序发出；超出队列容量的消息计入丢弃
+static void testQueueAcrossReconnect() {
+  TestPeer peer;
+  WebSocketMCP mcp;
+  MCP_CHECK(mcpTestConnect(mcp, peer));
+  peer.accept = false;
+  peer.client->hostDrop();
+  mcp.loop();
+  MCP_CHECK(!mcp.isConnected());
+
+  MCP_CHECK(mcp.sendMessage("{\"n\":1}"));
+  MCP_CHECK(mcp.sendMessage("{\"n\":2}"));
+  MCP_CHECK(!mcp.sendMessage(String(std::string(MCP_SEND_QUEUE_BYTES, 'x').c_str())));
+  WebSocketMCP::SendQueueStats stats = mcp.getSendQueueStats();
+  MCP_CHECK_EQ(stats.queuedMessages, 2);
+  MCP_CHECK_EQ(stats.dropped, 1);
+
+  peer.accept = true;
+  for (int i = 0; i < 100 && !mcp.isConnected(); i++) {
+    delay(50);
+    mcp.loop();
+  }
+  mcp.loop();
+  MCP_CHECK(mcp.isConnected());
+  MCP_CHECK_EQ(peer.messages.size(), 2);
+  if (peer.messages.size() == 2) {
+    MCP_CHECK(peer.messages[0].json == "{\"n\":1}");
+    MCP_CHECK(peer.messages[1].json == "{\"n\":2}");
+  }
+  MCP_CHECK_EQ(mcp.getSendQueueStats().queuedMessages, 0);
+}
+
+int main() {
+  testRingOrderAndWrap();
+  testRingDropsWholeMessage();
+  testControlLaneFirst();
+  testRepliesNeverDropped();
+  testMessagesDuringOpenResponse();
+  testQueueAcrossReconnect();
+  return MCP_TEST_RESULT();
+}
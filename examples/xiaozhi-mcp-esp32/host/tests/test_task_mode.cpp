@@ -0,0 +1,105 @@
+/**
+ * test_task_mode.cpp
+ * 网络任务模式：共享工具注册表的实例不能启动网络任务，工具回调中调用post()立即执行，
+ * 主循环中post()的操作在网络任务中执行，析构时网络任务停止；
+ * 析构时仍在执行的异步工具照常完成，结果入队时不再唤醒已停止的网络任务
+ */
+
+#include "mcp_test.h"
+
+#include <atomic>
+#include <thread>
+
+// 等到条件成立，最多timeoutMs毫秒
+template<typename Condition>
+static bool waitFor(Condition condition, unsigned long timeoutMs = 3000) {
+  unsigned long start = millis();
+  while (!condition()) {
+    if (millis() - start > timeoutMs) {
+      return false;
+    }
+    delay(5);
+  }
+  return true;
+}
+
+static void testSharedRegistryRejected() {
+  hostSerialSetEnabled(false);
+  WebSocketMCP::ToolRegistry registry;
+  WebSocketMCP mcp(registry);
+  MCP_CHECK(!mcp.beginTask("ws://localhost:8080/mcp"));
+  MCP_CHECK(!mcp.isTaskMode());
+}
+
+static void testPostInsideNetworkTask() {
+  TestPeer peer;
+  std::atomic<bool> called(false);
+  std::atomic<bool> ranInline(false);
+  std::atomic<bool> ranOnTask(false);
+  {
+    WebSocketMCP mcp;
+    mcp.registerTool("post_inline", "在工具回调中提交操作", "{}",
+                     [&](JsonObjectConst, McpToolResult &result) {
+                       bool executed = false;
+                       mcp.post([&executed](WebSocketMCP &) { executed = true; });
+                       // 在网络任务中post()返回前已经执行
+                       ranInline = executed;
+                       called = true;
+                       result.print("ok");
+                     });
+    hostSerialSetEnabled(false);
+    WebSocketsClient::hostSetPeer(&peer);
+    MCP_CHECK(mcp.beginTask("ws://localhost:8080/mcp"));
+    MCP_CHECK(mcp.isTaskMode());
+    MCP_CHECK(waitFor([&mcp]() { return mcp.isConnected(); }));
+
+    peer.post("{\"jsonrpc\":\"2.0\",\"id\":0,\"method\":\"initialize\",\"params\":{}}");
+    peer.post("{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"tools/call\",\"params\":{\"name\":\"post_inline\",\"arguments\":{}}}");
+    MCP_CHECK(waitFor([&called]() { return called.load(); }));
+    MCP_CHECK(ranInline.load());
+
+    // 主循环提交的操作交给网络任务执行
+    std::thread::id mainThread = std::this_thread::get_id();
+    MCP_CHECK(mcp.post([&ranOnTask, mainThread](WebSocketMCP &) {
+      ranOnTask = std::this_thread::get_id() != mainThread;
+    }));
+    MCP_CHECK(waitFor([&ranOnTask]() { return ranOnTask.load(); }));
+  }
+  // 析构后网络任务已退出，不再接收帧
+  size_t received = peer.messages.size();
+  delay(50);
+  MCP_CHECK_EQ(peer.messages.size(), received);
+  MCP_CHECK(peer.find("\"id\":1").find("ok") != std::string::npos);
+}
+
+static void testDestroyWithPendingAsyncCall() {
+  TestPeer peer;
+  std::atomic<bool> started(false);
+  std::atomic<bool> responded(false);
+  {
+    WebSocketMCP mcp;
+    mcp.registerAsyncTool("slow", "慢速异步工具", "{}", [&](JsonObjectConst, WebSocketMCP::ToolResponder responder) {
+      started = true;
+      delay(100);
+      responder.respond(WebSocketMCP::ToolResponse("{\"done\":true}"));
+      responded = true;
+    });
+    hostSerialSetEnabled(false);
+    WebSocketsClient::hostSetPeer(&peer);
+    MCP_CHECK(mcp.beginTask("ws://localhost:8080/mcp"));
+    MCP_CHECK(waitFor([&mcp]() { return mcp.isConnected(); }));
+    peer.post("{\"jsonrpc\":\"2.0\",\"id\":0,\"method\":\"initialize\",\"params\":{}}");
+    peer.post("{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"tools/call\",\"params\":{\"name\":\"slow\",\"arguments\":{}}}");
+    MCP_CHECK(waitFor([&started]() { return started.load(); }));
+  }
+  // 析构函数等工作线程执行完已提交的任务才返回
+  MCP_CHECK(responded.load());
+  MCP_CHECK(peer.find("\"id\":1").empty());
+}
+
+int main() {
+  testSharedRegistryRejected();
+  testPostInsideNetworkTask();
+  testDestroyWithPendingAsyncCall();
+  return MCP_TEST_RESULT();
+}
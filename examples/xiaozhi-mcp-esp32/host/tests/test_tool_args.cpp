@@ -0,0 +1,151 @@
+/**
+ * test_tool_args.cpp
+ * 类型化工具参数：由参数描述生成的inputSchema(包括可选值很多时)，缺少必填参数、类型不符、超出范围、不在可选值中时的错误，
+ * 错误信息中参数名和可选值的转义，可选值声明在非字符串参数上，可选参数的缺省值，以及经tools/call调用类型化工具
+ */
+
+#include "mcp_test.h"
+
+// 按参数描述校验一段JSON参数，返回错误信息(通过时为空)
+static std::string validate(const McpArgSpec *specs, size_t count, const char *arguments) {
+  DynamicJsonDocument doc(1024);
+  deserializeJson(doc, arguments);
+  char buffer[256];
+  McpToolResult result(buffer, sizeof(buffer));
+  if (mcpValidateArgs(specs, count, doc.as<JsonObjectConst>(), result)) {
+    return std::string();
+  }
+  return std::string(result.text(), result.length());
+}
+
+static void testSchema() {
+  McpArgList<const char *, int, bool> args =
+      mcpArgs(McpArg<const char *>("state", "开关").oneOf("on|off|blink"),
+              McpArg<int>("brightness", "亮度").range(0, 100).optional(80),
+              McpArg<bool>("fade", "渐变").optional(true));
+  String schema = mcpBuildArgsSchema(args.specs.data(), args.specs.size());
+  DynamicJsonDocument doc(2048);
+  MCP_CHECK(!deserializeJson(doc, schema));
+  MCP_CHECK(strcmp(doc["properties"]["state"]["type"] | "", "string") == 0);
+  MCP_CHECK_EQ(doc["properties"]["state"]["enum"].size(), 3);
+  MCP_CHECK(strcmp(doc["properties"]["state"]["enum"][2] | "", "blink") == 0);
+  MCP_CHECK(strcmp(doc["properties"]["brightness"]["type"] | "", "integer") == 0);
+  MCP_CHECK_EQ(doc["properties"]["brightness"]["maximum"].as<long>(), 100);
+  MCP_CHECK_EQ(doc["properties"]["brightness"]["default"].as<long>(), 80);
+  MCP_CHECK(doc["properties"]["fade"]["default"].as<bool>());
+  MCP_CHECK_EQ(doc["required"].size(), 1);
+  MCP_CHECK(strcmp(doc["required"][0] | "", "state") == 0);
+}
+
+// 可选值多且长时schema仍然完整：文档容量按参数描述计算
+static void testLargeEnumSchema() {
+  std::string values;
+  for (int i = 0; i < 60; i++) {
+    values += (i ? "|" : "") + std::string("scene_living_room_") + std::to_string(1000 + i);
+  }
+  McpArgList<const char *, int> args = mcpArgs(McpArg<const char *>("scene", "场景").oneOf(values.c_str()),
+                                               McpArg<int>("level", "强度").range(0, 10));
+  String schema = mcpBuildArgsSchema(args.specs.data(), args.specs.size());
+  DynamicJsonDocument doc(8192);
+  MCP_CHECK(!deserializeJson(doc, schema));
+  MCP_CHECK_EQ(doc["properties"]["scene"]["enum"].size(), 60);
+  MCP_CHECK(strcmp(doc["properties"]["scene"]["enum"][59] | "", "scene_living_room_1059") == 0);
+  MCP_CHECK_EQ(doc["properties"]["level"]["maximum"].as<long>(), 10);
+  MCP_CHECK_EQ(doc["required"].size(), 2);
+
+  // 空schema(生成失败)不能注册
+  WebSocketMCP mcp;
+  MCP_CHECK(!mcp.registerTool("broken", "无schema", "", [](JsonObjectConst, McpToolResult &) {}));
+}
+
+static void testValidation() {
+  McpArgList<const char *, int, double> args =
+      mcpArgs(McpArg<const char *>("state", "开关").oneOf("on|off"),
+              McpArg<int>("brightness", "亮度").range(0, 100).optional(80),
+              McpArg<double>("ratio", "比例").minimum(0.5).optional(1.0));
+  const McpArgSpec *specs = args.specs.data();
+  size_t count = args.specs.size();
+
+  MCP_CHECK(validate(specs, count, "{\"state\":\"on\"}").empty());
+  MCP_CHECK(validate(specs, count, "{\"state\":\"off\",\"brightness\":100,\"ratio\":0.5}").empty());
+  MCP_CHECK_CONTAINS(validate(specs, count, "{}"), "Missing required argument: state");
+  MCP_CHECK_CONTAINS(validate(specs, count, "{\"state\":1}"), "must be of type string");
+  MCP_CHECK_CONTAINS(validate(specs, count, "{\"state\":\"on\",\"brightness\":\"50\"}"), "must be of type integer");
+  MCP_CHECK_CONTAINS(validate(specs, count, "{\"state\":\"on\",\"brightness\":101}"), "brightness out of range");
+  MCP_CHECK_CONTAINS(validate(specs, count, "{\"state\":\"on\",\"ratio\":0.25}"), "ratio out of range");
+  // 可选值按整段比较，不接受前缀
+  MCP_CHECK_CONTAINS(validate(specs, count, "{\"state\":\"o\"}"), "must be one of: on|off");
+  MCP_CHECK_CONTAINS(validate(specs, count, "{\"state\":\"offline\"}"), "must be one of");
+}
+
+// 可选值声明在整数参数上时按数字的文本比较；错误信息是合法JSON，参数名中的引号被转义
+static void testEnumOnNonStringAndEscaping() {
+  McpArgList<int, const char *> args =
+      mcpArgs(McpArg<int>("level", "档位").oneOf("1|2|3"), McpArg<const char *>("say \"hi\"", "").oneOf("a\\b|c"));
+  const McpArgSpec *specs = args.specs.data();
+  size_t count = args.specs.size();
+  MCP_CHECK(validate(specs, count, "{\"level\":2,\"say \\\"hi\\\"\":\"c\"}").empty());
+  MCP_CHECK_CONTAINS(validate(specs, count, "{\"level\":4}"), "must be one of: 1|2|3");
+
+  const char *const invalid[] = {
+    "{\"level\":1}",
+    "{\"level\":1,\"say \\\"hi\\\"\":7}",
+    "{\"level\":1,\"say \\\"hi\\\"\":\"d\"}",
+  };
+  for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+    std::string error = validate(specs, count, invalid[i]);
+    DynamicJsonDocument doc(512);
+    MCP_CHECK(!deserializeJson(doc, error));
+    MCP_CHECK_CONTAINS(doc["error"] | "", "say \"hi\"");
+  }
+  std::string error = validate(specs, count, invalid[2]);
+  DynamicJsonDocument doc(512);
+  deserializeJson(doc, error);
+  MCP_CHECK_CONTAINS(doc["error"] | "", "must be one of: a\\b|c");
+}
+
+// 经tools/call调用：通过校验时回调收到解码后的参数和缺省值，不通过时返回isError且不调用回调
+static void testTypedToolCall() {
+  TestPeer peer;
+  WebSocketMCP mcp;
+  int calls = 0;
+  mcp.registerTool("set_light", "设置灯光",
+                   mcpArgs(McpArg<const char *>("state", "开关").oneOf("on|off"),
+                           McpArg<int>("brightness", "亮度").range(0, 100).optional(80)),
+                   [&calls](McpToolResult &result, const char *state, int brightness) {
+                     calls++;
+                     result.print(state);
+                     result.print('/');
+                     result.print(brightness);
+                   });
+  MCP_CHECK(mcpTestConnect(mcp, peer));
+
+  mcpTestRequest(mcp, peer, "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"tools/call\",\"params\":{\"name\":\"set_light\","
+                            "\"arguments\":{\"state\":\"on\"}}}");
+  mcpTestRequest(mcp, peer, "{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"tools/call\",\"params\":{\"name\":\"set_light\","
+                            "\"arguments\":{\"state\":\"off\",\"brightness\":5}}}");
+  mcpTestRequest(mcp, peer, "{\"jsonrpc\":\"2.0\",\"id\":3,\"method\":\"tools/call\",\"params\":{\"name\":\"set_light\","
+                            "\"arguments\":{\"state\":\"dim\"}}}");
+  MCP_CHECK_EQ(calls, 2);
+  MCP_CHECK_EQ(peer.messages.size(), 3);
+  if (peer.messages.size() != 3) {
+    return;
+  }
+  DynamicJsonDocument doc(2048);
+  deserializeJson(doc, peer.messages[0].json);
+  MCP_CHECK(strcmp(doc["result"]["content"][0]["text"] | "", "on/80") == 0);
+  deserializeJson(doc, peer.messages[1].json);
+  MCP_CHECK(strcmp(doc["result"]["content"][0]["text"] | "", "off/5") == 0);
+  deserializeJson(doc, peer.messages[2].json);
+  MCP_CHECK(doc["result"]["isError"].as<bool>());
+  MCP_CHECK_CONTAINS(doc["result"]["content"][0]["text"] | "", "must be one of");
+}
+
+int main() {
+  testSchema();
+  testLargeEnumSchema();
+  testValidation();
+  testEnumOnNonStringAndEscaping();
+  testTypedToolCall();
+  return MCP_TEST_RESULT();
+}
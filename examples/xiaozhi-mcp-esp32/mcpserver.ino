@@ -7,6 +7,7 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include "WebSocketMCP.h"
+#include "McpExpression.h"
 
 /********** 配置项 ***********/
 // WiFi设置
@@ -26,6 +27,9 @@ const char* MCP_ENDPOINT = "wss://api.xiaozhi.me/mcp/?token=e***************GciO
 // 添加LED控制引脚定义
 #define LED_PIN 2  // 默认使用ESP32板载LED
 
+// 设为1时MCP在独立的网络任务中处理请求，响应时间不受loop()中其他代码(如LED闪烁的delay)影响
+#define USE_MCP_NETWORK_TASK 0
+
 /********** 全局变量 ***********/
 WebSocketMCP mcpClient;
 
@@ -38,6 +42,8 @@ bool newCommandAvailable = false;
 // 连接状态
 bool wifiConnected = false;
 bool mcpConnected = false;
+// 控制LED的状态(由LED工具在工作线程中设置，loop()中写入资源)
+volatile bool controlLedOn = false;
 
 /********** 函数声明 ***********/
 void setupWifi();
@@ -47,6 +53,9 @@ void onMcpConnectionChange(bool connected);
 void processSerialCommands();
 void blinkLed(int times, int delayMs);
 void registerMcpTools();
+void ledBlinkTool(JsonObjectConst args, WebSocketMCP::ToolResponder responder);
+void systemInfoTool(JsonObjectConst args, McpToolResult &result);
+void updateDeviceResource();
 
 void setup() {
   // 初始化串口
@@ -62,8 +71,13 @@ void setup() {
   // 连接WiFi
   setupWifi();
   
+  // 工具在连接前注册一次，重连后依然有效
+  registerMcpTools();
+  
   // 初始化MCP客户端
-  if (mcpClient.begin(MCP_ENDPOINT, onMcpConnectionChange)) {
+  bool started = USE_MCP_NETWORK_TASK ? mcpClient.beginTask(MCP_ENDPOINT, onMcpConnectionChange)
+                                      : mcpClient.begin(MCP_ENDPOINT, onMcpConnectionChange);
+  if (started) {
     DEBUG_SERIAL.println("[ESP32 MCP客户端] 初始化成功，尝试连接到MCP服务器...");
   } else {
     DEBUG_SERIAL.println("[ESP32 MCP客户端] 初始化失败!");
@@ -78,12 +92,15 @@ void setup() {
 }
 
 void loop() {
-  // 处理MCP客户端
+  // 处理MCP客户端(网络任务模式下只执行连接状态回调)
   mcpClient.loop();
   
   // 处理来自串口的命令
   processSerialCommands();
   
+  // 刷新设备状态资源
+  updateDeviceResource();
+  
   // 状态LED显示
   if (!wifiConnected) {
     // WiFi未连接: 快速闪烁
@@ -145,117 +162,172 @@ void onMcpError(const String &error) {
   DEBUG_SERIAL.println(error);
 }
 
+/**
+ * LED控制工具 - 闪烁需要约2秒，注册为异步工具，执行期间不阻塞ping和其他请求
+ */
+void ledBlinkTool(JsonObjectConst args, WebSocketMCP::ToolResponder responder) {
+  // 参数已由WebSocketMCP解析，直接读取
+  if (args.isNull()) {
+    // 返回错误响应
+    responder.respond(WebSocketMCP::ToolResponse("{\"success\":false,\"error\":\"无效的参数格式\"}", true));
+    return;
+  }
+  
+  String state = args["state"] | "";
+  DEBUG_SERIAL.println("[工具] LED控制: " + state);
+  
+  // 控制LED
+  if (state == "on") {
+    digitalWrite(LED_PIN, HIGH);
+    controlLedOn = true;
+  } else if (state == "off") {
+    digitalWrite(LED_PIN, LOW);
+    controlLedOn = false;
+  } else if (state == "blink") {
+    // 这里可以触发闪烁模式
+    // 为简单起见，我们只是切换几次LED状态
+    for (int i = 0; i < 5; i++) {
+      digitalWrite(LED_PIN, HIGH);
+      delay(200);
+      digitalWrite(LED_PIN, LOW);
+      delay(200);
+      // 请求带progressToken时向服务器报告进度，否则忽略
+      responder.progress(i + 1, 5);
+    }
+    controlLedOn = false;
+  }
+  
+  // 返回成功响应；state来自请求，由McpToolResult转义后写入
+  char buffer[128];
+  McpToolResult result(buffer, sizeof(buffer));
+  result.beginObject().add("success", true).add("state", state.c_str()).endObject();
+  if (result.overflowed()) {
+    responder.respond(WebSocketMCP::ToolResponse("{\"success\":false,\"error\":\"state过长\"}", true));
+    return;
+  }
+  responder.respond(WebSocketMCP::ToolResponse(result.text()));
+}
+
+/**
+ * 系统信息工具
+ */
+void systemInfoTool(JsonObjectConst args, McpToolResult &result) {
+  // 结果直接写入库提供的缓冲区，不拼接String，长时间运行不产生堆碎片
+  char chipId[9];
+  snprintf(chipId, sizeof(chipId), "%lx", (unsigned long)(ESP.getEfuseMac() & 0xFFFFFFFF));
+  IPAddress ip = WiFi.localIP();
+  char ipAddress[16];
+  snprintf(ipAddress, sizeof(ipAddress), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+  result.beginObject()
+        .add("success", true)
+        .add("model", ESP.getChipModel())
+        .add("chipId", chipId)
+        .add("flashSize", (unsigned long)(ESP.getFlashChipSize() / 1024))
+        .add("freeHeap", (unsigned long)(ESP.getFreeHeap() / 1024))
+        .add("wifiStatus", WiFi.status() == WL_CONNECTED ? "connected" : "disconnected")
+        .add("ipAddress", ipAddress)
+        .endObject();
+}
+
+// 静态工具表：名称、描述和schema都是常量，保存在flash中，注册时不复制
+static const WebSocketMCP::StaticTool MCP_TOOLS[] = {
+  {"led_blink", "控制ESP32 LED状态",
+   "{\"properties\":{\"state\":{\"title\":\"LED状态\",\"type\":\"string\",\"enum\":[\"on\",\"off\",\"blink\"]}},\"required\":[\"state\"],\"title\":\"ledControlArguments\",\"type\":\"object\"}",
+   nullptr, ledBlinkTool, 0},
+  // 系统信息变化很慢，5秒内的重复调用直接返回缓存结果
+  {"system-info", "获取ESP32系统信息",
+   "{\"properties\":{},\"title\":\"systemInfoArguments\",\"type\":\"object\"}",
+   systemInfoTool, nullptr, 5000},
+};
+
 /**
  * 注册MCP工具
- * 在连接成功后注册工具
+ * 在begin()之前调用一次，重连时不需要重新注册
  */
 void registerMcpTools() {
   DEBUG_SERIAL.println("[MCP] 注册工具...");
   
-  // 注册LED控制工具
+  mcpClient.registerTools(MCP_TOOLS);
+  DEBUG_SERIAL.println("[MCP] LED控制和系统信息工具已注册");
+  
+  // 注册计算器工具：表达式编译为字节码后求值，最近用过的公式不再重新解析
   mcpClient.registerTool(
-    "led_blink",  // 工具名称
-    "控制ESP32 LED状态", // 工具描述
-    "{\"properties\":{\"state\":{\"title\":\"LED状态\",\"type\":\"string\",\"enum\":[\"on\",\"off\",\"blink\"]}},\"required\":[\"state\"],\"title\":\"ledControlArguments\",\"type\":\"object\"}",  // 输入schema
-    [](const String& args) {
-      // 解析参数
-      DEBUG_SERIAL.println("[工具] LED控制: " + args);
-      DynamicJsonDocument doc(256);
-      DeserializationError error = deserializeJson(doc, args);
+    "calculator",
+    "计算数学表达式，支持+ - * / % ^、括号、比较和逻辑运算(< > == && ||等，结果为1或0)、"
+    "函数abs sqrt floor ceil round exp ln log10 sin cos tan min max、常量pi e，以及变量(值由variables给出)",
+    mcpArgs(McpArg<const char *>("expression", "表达式，如(f-32)*5/9"),
+            McpArg<JsonObjectConst>("variables", "表达式中变量的值，如{\"f\":98.6}").optional()),
+    [](McpToolResult &out, const char *expr, JsonObjectConst variables) {
+      // 参数已按schema校验并解码，缺少expression的调用不会到达这里
+      DEBUG_SERIAL.printf("[工具] 计算器: %s\n", expr);
       
-      if (error) {
-        // 返回错误响应
-        WebSocketMCP::ToolResponse response("{\"success\":false,\"error\":\"无效的参数格式\"}", true);
-        return response;
+      static McpExpressionCache expressions;
+      McpExpression::Error error;
+      size_t position;
+      const McpExpression *program = expressions.compile(expr, strlen(expr), error, position);
+      if (!program) {
+        out.beginObject()
+           .add("success", false)
+           .add("error", McpExpression::errorText(error))
+           .add("position", (unsigned long)position)
+           .endObject();
+        out.setError();
+        return;
       }
       
-      String state = doc["state"].as<String>();
-      DEBUG_SERIAL.println("[工具] LED控制: " + state);
-      
-      // 控制LED
-      if (state == "on") {
-        digitalWrite(LED_PIN, HIGH);
-      } else if (state == "off") {
-        digitalWrite(LED_PIN, LOW);
-      } else if (state == "blink") {
-        // 这里可以触发闪烁模式
-        // 为简单起见，我们只是切换几次LED状态
-        for (int i = 0; i < 5; i++) {
-          digitalWrite(LED_PIN, HIGH);
-          delay(200);
-          digitalWrite(LED_PIN, LOW);
-          delay(200);
+      double values[MCP_EXPR_MAX_VARS];
+      for (size_t i = 0; i < program->variableCount(); i++) {
+        JsonVariantConst value = variables[program->variableName(i)];
+        if (!value.is<double>()) {
+          out.beginObject()
+             .add("success", false)
+             .add("error", "missing variable")
+             .add("variable", program->variableName(i))
+             .endObject();
+          out.setError();
+          return;
         }
+        values[i] = value.as<double>();
       }
-      
-      // 返回成功响应
-      String resultJson = "{\"success\":true,\"state\":\"" + state + "\"}";
-      return WebSocketMCP::ToolResponse(resultJson);
+      double result = 0;
+      program->evaluate(values, program->variableCount(), result);
+      out.beginObject()
+         .add("success", true)
+         .add("expression", expr)
+         .add("result", result)
+         .endObject();
     }
   );
-  DEBUG_SERIAL.println("[MCP] LED控制工具已注册");
+  DEBUG_SERIAL.println("[MCP] 计算器工具已注册");
   
-  // 注册系统信息工具
-  mcpClient.registerTool(
-    "system-info",
-    "获取ESP32系统信息",
-    "{\"properties\":{},\"title\":\"systemInfoArguments\",\"type\":\"object\"}",
-    [](const String& args) {
-      DEBUG_SERIAL.println("[获取ESP32系统信息: " + args);
-      // 收集系统信息
-      String chipModel = ESP.getChipModel();
-      uint32_t chipId = ESP.getEfuseMac() & 0xFFFFFFFF;
-      uint32_t flashSize = ESP.getFlashChipSize() / 1024;
-      uint32_t freeHeap = ESP.getFreeHeap() / 1024;
-      
-      // 构造JSON响应
-      String resultJson = "{\"success\":true,\"model\":\"" + chipModel + "\",\"chipId\":\"" + String(chipId, HEX) + 
-                         "\",\"flashSize\":" + String(flashSize) + ",\"freeHeap\":" + String(freeHeap) + 
-                         ",\"wifiStatus\":\"" + (WiFi.status() == WL_CONNECTED ? "connected" : "disconnected") + 
-                         "\",\"ipAddress\":\"" + WiFi.localIP().toString() + "\"}";
-      
-      return WebSocketMCP::ToolResponse(resultJson);
-    }
-  );
-  DEBUG_SERIAL.println("[MCP] 系统信息工具已注册");
+  // 注册内置统计工具，可直接问"MCP运行统计"查看各工具耗时和内存低水位
+  mcpClient.registerStatsTool();
   
-  // 注册计算器工具 (简单示例)
-  mcpClient.registerTool(
-    "calculator",
-    "简单计算器",
-    "{\"properties\":{\"expression\":{\"title\":\"表达式\",\"type\":\"string\"}},\"required\":[\"expression\"],\"title\":\"calculatorArguments\",\"type\":\"object\"}",
-    [](const String& args) {
-       DEBUG_SERIAL.println("[简单计算器: " + args);
-      DynamicJsonDocument doc(256);
-      deserializeJson(doc, args);
-      
-      String expr = doc["expression"].as<String>();
-      DEBUG_SERIAL.println("[工具] 计算器: " + expr);
-      
-      // 这里只是演示，实际应用中需要实现表达式计算
-      // 我们只处理简单的加减法
-      int result = 0;
-      if (expr.indexOf("+") > 0) {
-        int plusPos = expr.indexOf("+");
-        int a = expr.substring(0, plusPos).toInt();
-        int b = expr.substring(plusPos + 1).toInt();
-        result = a + b;
-      } else if (expr.indexOf("-") > 0) {
-        int minusPos = expr.indexOf("-");
-        int a = expr.substring(0, minusPos).toInt();
-        int b = expr.substring(minusPos + 1).toInt();
-        result = a - b;
-      }
-      
-      String resultJson = "{\"success\":true,\"expression\":\"" + expr + "\",\"result\":" + String(result) + "}";
-      return WebSocketMCP::ToolResponse(resultJson);
-    }
-  );
-  DEBUG_SERIAL.println("[MCP] 计算器工具已注册");
+  // 设备状态资源：客户端直接读取缓存的状态，订阅后状态变化时收到通知
+  mcpClient.registerResource("device://esp32/status", "ESP32状态", "控制LED开关、WiFi连接状态和可用内存");
   
   DEBUG_SERIAL.println("[MCP] 工具注册完成，共" + String(mcpClient.getToolCount()) + "个工具");
 }
 
+/**
+ * 每秒把设备状态写入资源，内容没有变化时不会通知客户端
+ */
+void updateDeviceResource() {
+  static unsigned long lastUpdate = 0;
+  if (lastUpdate != 0 && millis() - lastUpdate < 1000) {
+    return;
+  }
+  lastUpdate = millis();
+  
+  char state[96];
+  snprintf(state, sizeof(state), "{\"led\":\"%s\",\"wifi\":\"%s\",\"freeHeapKB\":%lu}",
+           controlLedOn ? "on" : "off", WiFi.status() == WL_CONNECTED ? "connected" : "disconnected",
+           (unsigned long)(ESP.getFreeHeap() / 1024));
+  String text(state);
+  // 网络任务模式下资源只能在网络任务中访问
+  mcpClient.post([text](WebSocketMCP &mcp) { mcp.updateResource("device://esp32/status", text); });
+}
+
 /**
  * MCP连接状态变化回调函数
  */
@@ -263,8 +335,6 @@ void onMcpConnectionChange(bool connected) {
   mcpConnected = connected;
   if (connected) {
     DEBUG_SERIAL.println("[MCP] 已连接到MCP服务器");
-    // 连接成功后注册工具
-    registerMcpTools();
   } else {
     DEBUG_SERIAL.println("[MCP] 与MCP服务器断开连接");
   }
@@ -295,14 +365,15 @@ void processSerialCommands() {
             printStatus();
           } else if (command == "reconnect") {
             DEBUG_SERIAL.println("正在重新连接...");
-            mcpClient.disconnect();
+            // 通过post()执行，网络任务模式下也不会与网络任务同时操作连接
+            mcpClient.post([](WebSocketMCP &mcp) { mcp.disconnect(); });
           } else if (command == "tools") {
             // 显示已注册工具
             DEBUG_SERIAL.println("已注册工具数量: " + String(mcpClient.getToolCount()));
           } else {
             // 将命令发送到MCP服务器(stdin替代)
             if (mcpClient.isConnected()) {
-              mcpClient.sendMessage(command);
+              mcpClient.post([command](WebSocketMCP &mcp) { mcp.sendMessage(command); });
               DEBUG_SERIAL.println("[发送] " + command);
             } else {
               DEBUG_SERIAL.println("未连接到MCP服务器，无法发送命令");